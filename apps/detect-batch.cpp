@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <helper.h>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <snowboy-detect.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+const static auto root = detect_project_root();
+
+struct batch_args {
+	std::string resource;
+	std::string model;
+	std::string sensitivity;
+	std::string high_sensitivity;
+	std::string list;
+	std::string output;
+	std::vector<std::string> inputs;
+	int64_t threads;
+	int64_t chunk_size;
+	bool frontend;
+};
+
+bool parse_args(int argc, const char** argv, batch_args& args);
+
+/**
+ * Read only memory mapping of a pcm wave file.
+ *
+ * Only the fmt and data chunks are interpreted, samples points into the mapping.
+ */
+class mapped_wave {
+	void* m_map = MAP_FAILED;
+	size_t m_size = 0;
+
+public:
+	const int16_t* samples = nullptr;
+	size_t num_samples = 0;
+	uint16_t channels = 0;
+	uint32_t sample_rate = 0;
+	uint16_t bits_per_sample = 0;
+
+	explicit mapped_wave(const std::string& filename) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("failed to open file: " + std::string(strerror(errno)));
+		struct stat st {};
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("failed to stat file: " + std::string(strerror(errno)));
+		}
+		m_size = st.st_size;
+		if (m_size != 0) m_map = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (m_map == MAP_FAILED) throw std::runtime_error("failed to map file: " + std::string(strerror(errno)));
+		// Every chunk is read exactly once from start to end
+		madvise(m_map, m_size, MADV_SEQUENTIAL);
+
+		auto data = static_cast<const uint8_t*>(m_map);
+		if (m_size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+			release();
+			throw std::runtime_error("not a riff wave file");
+		}
+		uint16_t format = 0;
+		for (size_t pos = 12; pos + 8 <= m_size;) {
+			uint32_t len;
+			memcpy(&len, data + pos + 4, sizeof(len));
+			auto body = pos + 8;
+			if (memcmp(data + pos, "fmt ", 4) == 0 && len >= 16 && body + 16 <= m_size) {
+				memcpy(&format, data + body, sizeof(format));
+				memcpy(&channels, data + body + 2, sizeof(channels));
+				memcpy(&sample_rate, data + body + 4, sizeof(sample_rate));
+				memcpy(&bits_per_sample, data + body + 14, sizeof(bits_per_sample));
+			} else if (memcmp(data + pos, "data", 4) == 0) {
+				// Truncated files are common in archives, use what is there
+				auto available = std::min<size_t>(len, m_size - body);
+				samples = reinterpret_cast<const int16_t*>(data + body);
+				num_samples = available / sizeof(int16_t);
+				break;
+			}
+			// Chunks are padded to an even size
+			pos = body + len + (len & 1);
+		}
+		if (format != 1 || samples == nullptr) {
+			release();
+			throw std::runtime_error("not a pcm wave file");
+		}
+	}
+	mapped_wave(const mapped_wave&) = delete;
+	mapped_wave& operator=(const mapped_wave&) = delete;
+	~mapped_wave() { release(); }
+
+	void release() noexcept {
+		if (m_map != MAP_FAILED) munmap(m_map, m_size);
+		m_map = MAP_FAILED;
+		samples = nullptr;
+	}
+};
+
+static std::string json_escape(const std::string& str) {
+	std::stringstream res;
+	for (char c : str) {
+		switch (c) {
+		case '"': res << "\\\""; break;
+		case '\\': res << "\\\\"; break;
+		case '\n': res << "\\n"; break;
+		case '\t': res << "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+				res << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			else
+				res << c;
+		}
+	}
+	return res.str();
+}
+
+static void collect_files(const std::string& path, std::vector<std::string>* files) {
+	namespace fs = std::filesystem;
+	if (!fs::is_directory(path)) {
+		files->push_back(path);
+		return;
+	}
+	std::vector<std::string> found;
+	for (auto& e : fs::recursive_directory_iterator(path, fs::directory_options::follow_directory_symlink)) {
+		if (!e.is_regular_file()) continue;
+		auto ext = e.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if (ext == ".wav") found.push_back(e.path().string());
+	}
+	// Directory order is arbitrary, sorting keeps the output reproducible
+	std::sort(found.begin(), found.end());
+	files->insert(files->end(), found.begin(), found.end());
+}
+
+int main(int argc, const char** argv) try {
+	batch_args args;
+	if (!parse_args(argc, argv, args)) return -1;
+	if (args.model.empty()) return 0;
+
+	std::vector<std::string> files;
+	for (auto& e : args.inputs)
+		collect_files(e, &files);
+	if (!args.list.empty()) {
+		std::ifstream list{args.list};
+		if (!list) {
+			std::cerr << "Failed to open " << args.list << std::endl;
+			return -1;
+		}
+		std::string line;
+		while (std::getline(list, line)) {
+			trim(line);
+			if (line.empty() || line[0] == '#') continue;
+			collect_files(line, &files);
+		}
+	}
+	if (files.empty()) {
+		std::cerr << "No input files" << std::endl;
+		return -1;
+	}
+
+	std::ofstream output_file;
+	if (!args.output.empty()) {
+		output_file.open(args.output, std::ios::trunc);
+		if (!output_file) {
+			std::cerr << "Failed to open " << args.output << std::endl;
+			return -1;
+		}
+	}
+	std::ostream& out = args.output.empty() ? std::cout : output_file;
+	std::mutex out_mtx;
+
+	std::atomic<size_t> next_file{0};
+	std::atomic<uint64_t> total_samples{0};
+	std::atomic<size_t> num_failed{0};
+	std::atomic<size_t> num_detections{0};
+	std::atomic<int> sample_rate{16000};
+	std::mutex error_mtx;
+	std::string init_error;
+	const auto num_threads = std::min<size_t>(args.threads, files.size());
+
+	auto worker = [&]() {
+		std::unique_ptr<snowboy::SnowboyDetect> detector;
+		try {
+			detector.reset(new snowboy::SnowboyDetect(args.resource, args.model));
+			if (!args.sensitivity.empty()) detector->SetSensitivity(args.sensitivity);
+			if (!args.high_sensitivity.empty()) detector->SetHighSensitivity(args.high_sensitivity);
+			detector->ApplyFrontend(args.frontend);
+		} catch (const std::exception& e) {
+			std::unique_lock<std::mutex> lck{error_mtx};
+			init_error = e.what();
+			next_file = files.size();
+			return;
+		}
+		const auto rate = detector->SampleRate();
+		sample_rate = rate;
+		std::stringstream lines;
+		for (auto idx = next_file++; idx < files.size(); idx = next_file++) {
+			auto& file = files[idx];
+			lines.str("");
+			try {
+				mapped_wave wave{file};
+				if (wave.channels != detector->NumChannels() || wave.sample_rate != static_cast<uint32_t>(rate) || wave.bits_per_sample != detector->BitsPerSample())
+					throw std::runtime_error("unsupported format, expected " + std::to_string(rate) + "Hz " + std::to_string(detector->BitsPerSample()) + " bit mono");
+				detector->Reset();
+				for (size_t pos = 0; pos < wave.num_samples; pos += args.chunk_size) {
+					auto len = std::min<size_t>(args.chunk_size, wave.num_samples - pos);
+					auto res = detector->RunDetection(wave.samples + pos, len, pos + len == wave.num_samples);
+					if (res <= 0) continue;
+					// Detections are reported at the end of the chunk they were found in
+					lines << "{\"file\":\"" << json_escape(file) << "\",\"hotword\":" << res << ",\"time\":" << std::fixed << std::setprecision(3)
+						  << (pos + len) / static_cast<double>(rate) << "}\n";
+					num_detections++;
+				}
+				total_samples += wave.num_samples;
+			} catch (const std::exception& e) {
+				lines.str("");
+				lines << "{\"file\":\"" << json_escape(file) << "\",\"error\":\"" << json_escape(e.what()) << "\"}\n";
+				num_failed++;
+			}
+			// One write per file keeps the lines of a file together
+			auto str = lines.str();
+			if (!str.empty()) {
+				std::unique_lock<std::mutex> lck{out_mtx};
+				out << str << std::flush;
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < num_threads; i++)
+		threads.emplace_back(worker);
+	for (auto& e : threads)
+		e.join();
+	std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+	if (!init_error.empty()) {
+		std::cerr << "Failed to create detector: " << init_error << std::endl;
+		return -1;
+	}
+
+	const double audio_hours = total_samples / static_cast<double>(sample_rate) / 3600.0;
+	std::cerr << "Processed " << files.size() - num_failed << " of " << files.size() << " files with " << num_threads << " threads, "
+			  << num_detections << " detections" << std::endl;
+	std::cerr << std::fixed << std::setprecision(3) << audio_hours << " hours of audio in " << wall.count() << " seconds, "
+			  << std::setprecision(5) << audio_hours / wall.count() << " audio hours per second (" << std::setprecision(1)
+			  << audio_hours * 3600.0 / wall.count() << "x real time)" << std::endl;
+	return num_failed == 0 ? 0 : 1;
+} catch (const std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return -1;
+}
+
+bool parse_args(int argc, const char** argv, batch_args& args) {
+	args.resource = root + "resources/common.res";
+	args.threads = std::max<int64_t>(std::thread::hardware_concurrency(), 1);
+	args.chunk_size = 16000;
+	args.frontend = false;
+	option_parser parser;
+	parser.option("--resource", &args.resource).set_shortname("-r").set_description("Resource file");
+	parser.option("--model", &args.model).set_shortname("-m").set_required(true).set_description("Model(s) to detect, comma separated");
+	parser.option("--sensitivity", &args.sensitivity).set_shortname("-s").set_description("Sensitivity of every hotword, comma separated");
+	parser.option("--high-sensitivity", &args.high_sensitivity).set_shortname("-hs").set_description("High sensitivity of every hotword, comma separated");
+	parser.option("--list", &args.list).set_shortname("-l").set_description("File with one wave file or directory per line");
+	parser.option("--output", &args.output).set_shortname("-o").set_description("Output JSONL file, defaults to stdout");
+	parser.option("--threads", &args.threads).set_min(1).set_shortname("-t").set_description("Number of worker threads, defaults to the number of cpus");
+	parser.option("--chunk-size", &args.chunk_size).set_min(1).set_shortname("-c").set_description("Number of samples passed to the detector at once, detections are reported with this granularity");
+	parser.option("--frontend", &args.frontend).set_shortname("-f").set_description("Apply the noise suppression and gain control frontend");
+	bool print_help = false;
+	parser.option("--help", &print_help).set_shortname("-h").set_description("Print help");
+	try {
+		// argv[0] is the program name
+		args.inputs = parser.parse(argc - 1, argv + 1);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+	if (print_help) {
+		std::cout << "detect-batch [options] <wave file or directory>..." << std::endl;
+		parser.print_help(std::cout);
+		args.model.clear();
+		return true;
+	}
+	if (args.model.empty() || (args.inputs.empty() && args.list.empty())) {
+		std::cerr << "Missing required argument" << std::endl;
+		return false;
+	}
+	return true;
+}
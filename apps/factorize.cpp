@@ -0,0 +1,128 @@
+#include <chrono>
+#include <helper.h>
+#include <iostream>
+#include <snowboy-detect.h>
+#include <universal-detect-stream.h>
+
+const static auto root = detect_project_root();
+
+struct factorize_args {
+	std::string resource;
+	std::string model;
+	std::string output;
+	std::string sensitivity;
+	std::vector<std::string> samples;
+	int64_t rank;
+	int64_t chunk_size;
+};
+
+struct detection_run {
+	std::vector<std::pair<int, size_t>> detections;
+	double seconds = 0.0;
+};
+
+bool parse_args(int argc, const char** argv, factorize_args& args);
+void run_detection(snowboy::SnowboyDetect& detector, const std::vector<short>& data, size_t chunk_size, detection_run& run);
+
+int main(int argc, const char** argv) try {
+	factorize_args args;
+	if (!parse_args(argc, argv, args)) return -1;
+	if (args.model.empty()) return 0;
+
+	if (split(args.model, ",").size() != split(args.output, ",").size()) {
+		std::cerr << "Number of output files does not match the number of models" << std::endl;
+		return -1;
+	}
+
+	{
+		snowboy::UniversalDetectStreamOptions options{};
+		options.slide_step = 1;
+		options.model_str = args.model;
+		snowboy::UniversalDetectStream stream{options};
+		for (size_t i = 0; i < stream.m_model_info.size(); i++) {
+			auto replaced = stream.m_model_info[i].network.FactorizeAffineComponents(args.rank);
+			std::cerr << "Model " << i << ": factorized " << replaced << " affine components" << std::endl;
+		}
+		stream.WriteHotwordModel(true, args.output);
+	}
+
+	// Compare the detections of both models on the samples
+	snowboy::SnowboyDetect original{args.resource, args.model};
+	snowboy::SnowboyDetect factorized{args.resource, args.output};
+	if (!args.sensitivity.empty()) {
+		original.SetSensitivity(args.sensitivity);
+		factorized.SetSensitivity(args.sensitivity);
+	}
+	size_t agree = 0;
+	double original_seconds = 0.0, factorized_seconds = 0.0;
+	for (auto& file : args.samples) {
+		auto data = read_sample_file(file, true);
+		detection_run a, b;
+		run_detection(original, data, args.chunk_size, a);
+		run_detection(factorized, data, args.chunk_size, b);
+		original_seconds += a.seconds;
+		factorized_seconds += b.seconds;
+		auto same = a.detections == b.detections;
+		if (same) agree++;
+		std::cout << file << ": " << (same ? "agree" : "differ") << " (original";
+		for (auto& e : a.detections)
+			std::cout << " " << e.first << "@" << e.second;
+		std::cout << ", factorized";
+		for (auto& e : b.detections)
+			std::cout << " " << e.first << "@" << e.second;
+		std::cout << ")" << std::endl;
+	}
+	std::cout << "Agreement: " << agree << "/" << args.samples.size() << " files" << std::endl;
+	std::cout << "Detection time: original " << original_seconds << "s, factorized " << factorized_seconds << "s" << std::endl;
+	return 0;
+} catch (const std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return -1;
+}
+
+void run_detection(snowboy::SnowboyDetect& detector, const std::vector<short>& data, size_t chunk_size, detection_run& run) {
+	detector.Reset();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < data.size(); i += chunk_size) {
+		auto len = std::min(chunk_size, data.size() - i);
+		auto res = detector.RunDetection(data.data() + i, len, false);
+		if (res > 0) run.detections.emplace_back(res, i + len);
+	}
+	run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool parse_args(int argc, const char** argv, factorize_args& args) {
+	args.resource = root + "resources/common.res";
+	args.rank = 0;
+	args.chunk_size = 1600;
+	option_parser parser;
+	parser.option("--resource", &args.resource).set_shortname("-r").set_description("Resource file");
+	parser.option("--model", &args.model).set_shortname("-m").set_required(true).set_description("Universal model(s) to factorize");
+	parser.option("--output", &args.output).set_shortname("-o").set_required(true).set_description("Output model(s), one per input model");
+	parser.option("--rank", &args.rank).set_min(1).set_shortname("-k").set_required(true).set_description("Rank of the factorized layers, layers which would not get cheaper are kept");
+	parser.option("--sensitivity", &args.sensitivity).set_shortname("-s").set_description("Sensitivity used for the comparison, defaults to the model values");
+	parser.option("--sample", &args.samples).set_shortname("-i").set_description("Wave files used for the comparison, defaults to the bundled audio samples");
+	parser.option("--chunk-size", &args.chunk_size).set_min(1).set_shortname("-c").set_description("Number of samples passed to the detector at once");
+	bool print_help = false;
+	parser.option("--help", &print_help).set_shortname("-h").set_description("Print help");
+	try {
+		parser.parse(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+	if (print_help) {
+		parser.print_help(std::cout);
+		args.model.clear();
+		return true;
+	}
+	if (args.model.empty() || args.output.empty() || args.rank <= 0) {
+		std::cerr << "Missing required argument" << std::endl;
+		return false;
+	}
+	if (args.samples.empty()) {
+		for (auto file : {"hotword1.wav", "hotword2.wav", "hotword3.wav", "hotword3_fail.wav", "noise1.wav", "noise2.wav", "noise3.wav", "sample1.wav", "snowboy.wav"})
+			args.samples.push_back(root + "audio_samples/" + file);
+	}
+	return true;
+}
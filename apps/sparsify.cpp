@@ -0,0 +1,66 @@
+#include <helper.h>
+#include <iostream>
+#include <universal-detect-stream.h>
+
+struct sparsify_args {
+	std::string model;
+	std::string output;
+	std::string threshold;
+	std::string min_sparsity;
+};
+
+bool parse_args(int argc, const char** argv, sparsify_args& args);
+
+int main(int argc, const char** argv) try {
+	sparsify_args args;
+	if (!parse_args(argc, argv, args)) return -1;
+	if (args.model.empty()) return 0;
+
+	auto threshold = std::stof(args.threshold);
+	auto min_sparsity = std::stof(args.min_sparsity);
+	if (split(args.model, ",").size() != split(args.output, ",").size()) {
+		std::cerr << "Number of output files does not match the number of models" << std::endl;
+		return -1;
+	}
+
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = args.model;
+	snowboy::UniversalDetectStream stream{options};
+	for (size_t i = 0; i < stream.m_model_info.size(); i++) {
+		auto replaced = stream.m_model_info[i].network.SparsifyAffineComponents(threshold, min_sparsity);
+		std::cerr << "Model " << i << ": replaced " << replaced << " affine components" << std::endl;
+	}
+	stream.WriteHotwordModel(true, args.output);
+	return 0;
+} catch (const std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return -1;
+}
+
+bool parse_args(int argc, const char** argv, sparsify_args& args) {
+	args.min_sparsity = "0.5";
+	option_parser parser;
+	parser.option("--model", &args.model).set_shortname("-m").set_required(true).set_description("Universal model(s) to prune");
+	parser.option("--output", &args.output).set_shortname("-o").set_required(true).set_description("Output model(s), one per input model");
+	parser.option("--threshold", &args.threshold).set_shortname("-t").set_required(true).set_description("Weights with an absolute value not above this are dropped");
+	parser.option("--min-sparsity", &args.min_sparsity).set_shortname("-s").set_description("Only store layers sparse if at least this fraction of weights is dropped");
+	bool print_help = false;
+	parser.option("--help", &print_help).set_shortname("-h").set_description("Print help");
+	try {
+		parser.parse(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+	if (print_help) {
+		parser.print_help(std::cout);
+		args.model.clear();
+		return true;
+	}
+	if (args.model.empty() || args.output.empty() || args.threshold.empty()) {
+		std::cerr << "Missing required argument" << std::endl;
+		return false;
+	}
+	return true;
+}
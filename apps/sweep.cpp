@@ -0,0 +1,116 @@
+#include <fstream>
+#include <helper.h>
+#include <iostream>
+#include <sensitivity-sweep.h>
+
+const static auto root = detect_project_root();
+
+struct sweep_args {
+	std::string resource;
+	std::string model;
+	std::string list;
+	std::string output;
+	std::string sensitivities;
+	std::string high_sensitivities;
+	int64_t chunk_size;
+};
+
+bool parse_args(int argc, const char** argv, sweep_args& args);
+bool parse_range(const std::string& str, std::vector<float>& res);
+
+int main(int argc, const char** argv) try {
+	sweep_args args;
+	if (!parse_args(argc, argv, args)) return -1;
+	if (args.model.empty()) return 0;
+
+	std::vector<float> sensitivities, high_sensitivities;
+	if (!parse_range(args.sensitivities, sensitivities) || !parse_range(args.high_sensitivities, high_sensitivities)) {
+		std::cerr << "Invalid sensitivity range" << std::endl;
+		return -1;
+	}
+
+	snowboy::SensitivitySweep sweep{args.resource, args.model, static_cast<size_t>(args.chunk_size)};
+	std::ifstream list{args.list};
+	if (!list) {
+		std::cerr << "Failed to open " << args.list << std::endl;
+		return -1;
+	}
+	std::string line;
+	while (std::getline(list, line)) {
+		trim(line);
+		if (line.empty() || line[0] == '#') continue;
+		// <expected hotword> <filename>, hotword 0 means the file should not trigger
+		auto parts = split(line, " ", 2);
+		if (parts.size() != 2) {
+			std::cerr << "Invalid line in list: " << line << std::endl;
+			return -1;
+		}
+		trim(parts[1]);
+		auto data = read_sample_file(parts[1]);
+		std::cerr << "Processing " << parts[1] << std::endl;
+		sweep.AddFile(parts[1], data.data(), data.size(), std::stoi(parts[0]));
+	}
+
+	auto points = sweep.Run(sensitivities, high_sensitivities);
+	if (args.output.empty()) {
+		snowboy::SensitivitySweep::WriteCsv(points, std::cout);
+	} else {
+		std::ofstream out{args.output};
+		snowboy::SensitivitySweep::WriteCsv(points, out);
+	}
+	return 0;
+} catch (const std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return -1;
+}
+
+bool parse_range(const std::string& str, std::vector<float>& res) {
+	if (str.empty()) return true;
+	// Either a comma separated list or start:stop:step
+	auto range = split(str, ":");
+	if (range.size() == 3) {
+		auto start = std::stof(range[0]);
+		auto stop = std::stof(range[1]);
+		auto step = std::stof(range[2]);
+		if (step <= 0.0f) return false;
+		for (size_t i = 0; start + i * step <= stop + step / 2; i++)
+			res.push_back(start + i * step);
+		return true;
+	} else if (range.size() != 1)
+		return false;
+	for (auto& e : split(str, ","))
+		res.push_back(std::stof(e));
+	return true;
+}
+
+bool parse_args(int argc, const char** argv, sweep_args& args) {
+	args.resource = root + "resources/common.res";
+	args.sensitivities = "0.05:0.95:0.05";
+	args.chunk_size = 1600;
+	option_parser parser;
+	parser.option("--resource", &args.resource).set_shortname("-r").set_description("Resource file");
+	parser.option("--model", &args.model).set_shortname("-m").set_required(true).set_description("Model(s) to evaluate");
+	parser.option("--list", &args.list).set_shortname("-l").set_required(true).set_description("File with one \"<hotword id> <wav file>\" per line, use 0 for negative samples");
+	parser.option("--output", &args.output).set_shortname("-o").set_description("Output CSV file, defaults to stdout");
+	parser.option("--sensitivity", &args.sensitivities).set_shortname("-s").set_description("Sensitivities as list (0.3,0.5) or range (start:stop:step)");
+	parser.option("--high-sensitivity", &args.high_sensitivities).set_shortname("-hs").set_description("High sensitivities as list or range, defaults to the model values");
+	parser.option("--chunk-size", &args.chunk_size).set_min(1).set_shortname("-c").set_description("Number of samples passed to the detector at once");
+	bool print_help = false;
+	parser.option("--help", &print_help).set_shortname("-h").set_description("Print help");
+	try {
+		parser.parse(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+	if (print_help) {
+		parser.print_help(std::cout);
+		args.model.clear();
+		return true;
+	}
+	if (args.model.empty() || args.list.empty()) {
+		std::cerr << "Missing required argument" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+#include <helper.h>
+#include <snowboy-detect.h>
+
+using namespace snowboy;
+
+const static auto root = detect_project_root();
+
+const static std::string samples[]{
+	"hotword1.wav",
+	"hotword2.wav",
+	"hotword3.wav",
+	"hotword3_fail.wav",
+	"noise1.wav",
+	"noise2.wav",
+	"noise3.wav",
+	"sample1.wav",
+	"snowboy.wav"};
+
+/**
+ * End to end RunDetection over all audio samples in chunks of the given number of samples.
+ *
+ * The audio_seconds counter is the seconds of audio processed per second, the inverse of the real time factor.
+ */
+static void BM_RunDetection(benchmark::State& state, const std::string& models, const std::string& sensitivity) {
+	std::vector<std::vector<short>> audio;
+	size_t total_samples = 0;
+	for (auto& e : samples) {
+		audio.push_back(read_sample_file(root + "audio_samples/" + e, true));
+		total_samples += audio.back().size();
+	}
+	std::string model_str;
+	for (auto& e : split(models, ","))
+		model_str += (model_str.empty() ? "" : ",") + root + "resources/models/" + e;
+	SnowboyDetect detector{root + "resources/common.res", model_str};
+	detector.SetSensitivity(sensitivity);
+	detector.ApplyFrontend(false);
+
+	const size_t chunk = state.range(0);
+	for (auto _ : state) {
+		for (auto& data : audio) {
+			for (size_t pos = 0; pos < data.size(); pos += chunk)
+				benchmark::DoNotOptimize(detector.RunDetection(data.data() + pos, std::min(chunk, data.size() - pos), false));
+			detector.Reset();
+		}
+	}
+	const double audio_seconds = total_samples / static_cast<double>(detector.SampleRate());
+	state.counters["audio_seconds"] = benchmark::Counter(audio_seconds * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+static const bool detect_benchmarks_registered = [] {
+	std::pair<const char*, const char*> configs[]{
+		{"snowboy.umdl", "0.5"},
+		{"computer.umdl,hey_extreme.umdl,view_glass.umdl,snowboy.umdl", "0.5,0.5,0.5,0.5"},
+		{"jarvis.umdl,neoya.umdl,smart_mirror.umdl,subex.umdl", "0.5,0.5,0.5,0.5,0.5,0.5"}};
+	for (auto& e : configs) {
+		benchmark::RegisterBenchmark(("BM_RunDetection/" + std::string(e.first)).c_str(), BM_RunDetection, e.first, e.second)
+			->ArgName("chunk")
+			->Arg(160)
+			->Arg(1600)
+			->Arg(16000)
+			->Unit(benchmark::kMillisecond);
+	}
+	return true;
+}();
@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+#include <dtw-lib.h>
+#include <matrix-wrapper.h>
+
+using namespace snowboy;
+
+static void fill(const MatrixBase& m, unsigned int seed) {
+	for (size_t r = 0; r < m.rows(); r++)
+		for (size_t c = 0; c < m.cols(); c++)
+			m(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+}
+
+// One slide step of a personal model template against the feature history, as done by TemplateDetectStream
+static void BM_SlidingDtw(benchmark::State& state) {
+	SlidingDtwOptions options;
+	options.band_width = 20;
+	options.distance_metric = state.range(2) ? "cosine" : "euclidean";
+	Matrix reference, history;
+	reference.Resize(state.range(0), 13);
+	fill(reference, 1);
+	SlidingDtw dtw{options};
+	dtw.SetReference(&reference);
+	history.Resize(dtw.GetWindowSize() + 200, 13);
+	fill(history, 2);
+	const int step = state.range(1);
+	size_t pos = 0;
+	for (auto _ : state) {
+		auto window = history.RowRange(pos, dtw.GetWindowSize());
+		benchmark::DoNotOptimize(dtw.ComputeDtwDistance(step, window));
+		pos = (pos + step) % 200;
+	}
+}
+BENCHMARK(BM_SlidingDtw)->ArgNames({"template", "step", "cosine"})->ArgsProduct({{60, 120}, {1, 10}, {0, 1}});
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+#include <feat-lib.h>
+#include <vector-wrapper.h>
+
+using namespace snowboy;
+
+static void fill(const VectorBase& v, unsigned int seed) {
+	for (size_t i = 0; i < v.size(); i++)
+		v[i] = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+}
+
+template <typename T>
+static void BM_Fft(benchmark::State& state) {
+	FftOptions options;
+	options.field_x00 = true;
+	options.num_fft_points = state.range(0);
+	T fft{options};
+	Vector src, data;
+	src.Resize(state.range(0));
+	fill(src, 1);
+	data.Resize(state.range(0));
+	for (auto _ : state) {
+		data.CopyFromVec(src);
+		fft.DoFft(&data);
+		benchmark::DoNotOptimize(data.data());
+	}
+}
+// TODO: Add SplitRadixFft once it is finished, FftStream always uses Fft for now
+BENCHMARK_TEMPLATE(BM_Fft, Fft)->Arg(256)->Arg(512);
+
+static void BM_ComputePowerSpectrumReal(benchmark::State& state) {
+	Vector in, out;
+	in.Resize(state.range(0));
+	fill(in, 1);
+	out.Resize(state.range(0) / 2);
+	for (auto _ : state) {
+		ComputePowerSpectrumReal(in, out);
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+BENCHMARK(BM_ComputePowerSpectrumReal)->Arg(512);
+
+// Same settings as the mfcc stream of the personal model pipeline
+static void BM_MelFilterBank(benchmark::State& state) {
+	MelFilterBankOptions options;
+	options.num_bins = state.range(0);
+	options.num_fft_points = 512;
+	options.sample_rate = 16000;
+	options.low_frequency = 20.0f;
+	options.high_frequency = 8000.0f;
+	options.vtln_low_frequency = 100.0f;
+	options.vtln_high_frequency = 7500.0f;
+	options.vtln_warping_factor = 1.0f;
+	MelFilterBank bank{options};
+	Vector power, energy;
+	power.Resize(options.num_fft_points / 2);
+	for (size_t i = 0; i < power.size(); i++)
+		power[i] = (i * 7919) % 1000 + 1.0f;
+	energy.Resize(options.num_bins);
+	for (auto _ : state) {
+		bank.ComputeMelFilterBankEnergy(power, energy);
+		benchmark::DoNotOptimize(energy.data());
+	}
+}
+BENCHMARK(BM_MelFilterBank)->ArgName("bins")->Arg(23);
@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <matrix-wrapper.h>
+#include <vector-wrapper.h>
+
+using namespace snowboy;
+
+static void fill(const MatrixBase& m, unsigned int seed) {
+	for (size_t r = 0; r < m.rows(); r++)
+		for (size_t c = 0; c < m.cols(); c++)
+			m(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+}
+
+static void fill(const VectorBase& v, unsigned int seed, float offset = -1.0f) {
+	for (size_t i = 0; i < v.size(); i++)
+		v[i] = (rand_r(&seed) % 2000) / 1000.0f + offset;
+}
+
+// Affine layer shapes of the universal models: frames x input -> frames x output
+static void BM_AddMatMat(benchmark::State& state) {
+	Matrix in, weights, out;
+	in.Resize(state.range(0), state.range(1));
+	weights.Resize(state.range(2), state.range(1));
+	out.Resize(state.range(0), state.range(2));
+	fill(in, 1);
+	fill(weights, 2);
+	for (auto _ : state) {
+		out.AddMatMat(1.0f, in, MatrixTransposeType::kNoTrans, weights, MatrixTransposeType::kTrans, 0.0f);
+		benchmark::DoNotOptimize(out.m_data);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddMatMat)
+	->ArgNames({"frames", "in", "out"})
+	->ArgsProduct({{1, 8, 64}, {1320}, {128}})
+	->ArgsProduct({{1, 8, 64}, {128}, {128, 3}});
+
+static void BM_AddMatVec(benchmark::State& state) {
+	Matrix weights;
+	Vector in, out;
+	weights.Resize(state.range(1), state.range(0));
+	in.Resize(state.range(0));
+	out.Resize(state.range(1));
+	fill(weights, 1);
+	fill(in, 2);
+	for (auto _ : state) {
+		out.AddMatVec(1.0f, weights, MatrixTransposeType::kNoTrans, in, 0.0f);
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+BENCHMARK(BM_AddMatVec)->ArgNames({"in", "out"})->Args({40, 13})->Args({1320, 128})->Args({128, 128});
+
+static void BM_DotVec(benchmark::State& state) {
+	Vector a, b;
+	a.Resize(state.range(0));
+	b.Resize(state.range(0));
+	fill(a, 1);
+	fill(b, 2);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(a.DotVec(b));
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DotVec)->Arg(13)->Arg(40)->Arg(128)->Arg(1320);
+
+static void BM_ApplyLog(benchmark::State& state) {
+	Vector v, src;
+	src.Resize(state.range(0));
+	fill(src, 1, 0.001f);
+	v.Resize(state.range(0));
+	for (auto _ : state) {
+		v.CopyFromVec(src);
+		v.ApplyLog();
+		benchmark::DoNotOptimize(v.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ApplyLog)->Arg(40)->Arg(1024);
+
+static void BM_ApplySoftmax(benchmark::State& state) {
+	Vector v, src;
+	src.Resize(state.range(0));
+	fill(src, 1);
+	v.Resize(state.range(0));
+	for (auto _ : state) {
+		v.CopyFromVec(src);
+		benchmark::DoNotOptimize(v.ApplySoftmax());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ApplySoftmax)->Arg(3)->Arg(128);
+
+static void BM_ApplySoftmaxPerRow(benchmark::State& state) {
+	Matrix m, src;
+	src.Resize(state.range(0), 3);
+	fill(src, 1);
+	for (auto _ : state) {
+		m = src;
+		m.ApplySoftmaxPerRow();
+		benchmark::DoNotOptimize(m.m_data);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ApplySoftmaxPerRow)->ArgName("frames")->Arg(8)->Arg(64);
+
+static void BM_ApplyPowRsqrt(benchmark::State& state) {
+	Vector v, src;
+	src.Resize(state.range(0));
+	fill(src, 1, 0.001f);
+	v.Resize(state.range(0));
+	for (auto _ : state) {
+		v.CopyFromVec(src);
+		v.ApplyPow(-0.5f);
+		benchmark::DoNotOptimize(v.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ApplyPowRsqrt)->Arg(128);
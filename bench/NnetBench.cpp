@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+#include <frame-info.h>
+#include <helper.h>
+#include <matrix-wrapper.h>
+#include <nnet-lib.h>
+#include <universal-detect-stream.h>
+
+using namespace snowboy;
+
+const static auto root = detect_project_root();
+
+const static std::string universal_models[]{
+	"computer.umdl",
+	"hey_extreme.umdl",
+	"jarvis.umdl",
+	"neoya.umdl",
+	"smart_mirror.umdl",
+	"snowboy.umdl",
+	"subex.umdl",
+	"view_glass.umdl"};
+
+// Every network of the model on chunks of the given number of frames, the detect pipeline feeds 10 frames per 100ms
+static void BM_NnetCompute(benchmark::State& state, const std::string& model) {
+	UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/" + model;
+	UniversalDetectStream stream{options};
+
+	std::vector<Nnet> networks;
+	for (auto& e : stream.m_model_info)
+		networks.emplace_back(e.network);
+	const size_t frames = state.range(0);
+	Matrix input, output;
+	input.Resize(frames, networks[0].InputDim());
+	unsigned int seed = 1;
+	for (size_t r = 0; r < input.rows(); r++)
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	std::vector<FrameInfo> in_info(frames), out_info;
+	unsigned int frame_id = 0;
+	for (auto _ : state) {
+		for (auto& info : in_info)
+			info = {frame_id++, 0};
+		for (auto& network : networks) {
+			network.Compute(input, in_info, &output, &out_info);
+			benchmark::DoNotOptimize(output.m_data);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * frames);
+}
+
+static const bool nnet_benchmarks_registered = [] {
+	for (auto& model : universal_models)
+		benchmark::RegisterBenchmark(("BM_NnetCompute/" + model).c_str(), BM_NnetCompute, model)->ArgName("frames")->Arg(1)->Arg(10)->Arg(50);
+	return true;
+}();
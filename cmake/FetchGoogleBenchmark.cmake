@@ -0,0 +1,12 @@
+find_package(benchmark QUIET)
+if(NOT benchmark_FOUND)
+  include(FetchContent)
+  set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+  set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE BOOL "" FORCE)
+  FetchContent_Declare(
+    googlebenchmark
+    GIT_REPOSITORY https://github.com/google/benchmark.git
+    GIT_TAG        v1.7.1
+  )
+  FetchContent_MakeAvailable(googlebenchmark)
+endif()
@@ -1,102 +1,133 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <frontend-lib.h>
 
 extern "C"
 {
-	// not sure if those are correct
-	struct TAgc_config {
-		short level;
-		short power;
-	};
-	struct TAgc_Instance {
-		unsigned char unknown1[8];
-		short unknown2;
-		unsigned char unknown3[0x28e];
-	};
-	//static_assert(sizeof(TAgc_Instance) == 0x298);
-	// TODO: Can we just copy the WebRtc implementation ?
-	// https://chromium.googlesource.com/external/webrtc/+/refs/heads/master/modules/audio_processing/agc/legacy/gain_control.h
-	extern void TAgc_Create(TAgc_Instance** ptr);
-	extern void TAgc_Init_org(TAgc_Instance* instance, uint64_t, uint64_t, int, int sample_rate);
-	extern void TAgc_Free(TAgc_Instance* instance);
-	extern int TAgc_set_config(TAgc_Instance* instance, TAgc_config cfg);
-	extern int TAgc_AddMic(TAgc_Instance* instance, long, long, short);
-	extern int TAgc_VirtualMic(TAgc_Instance* instance, long, long, short, int, int*);
-	extern int TAgc_Process(TAgc_Instance*, long, long, short, long, long, long, long*, long, long*);
-
-	int agc_targetlevel = 4;
-	int agc_targetpower = 5;
-
+	/**
+	 * Block based automatic gain control.
+	 *
+	 * A peak envelope with instant attack and slow release is driven towards
+	 * AGC_Level dB below full scale using at most AGC_Power dB of gain.
+	 * The gain changes by a few dB per second at most, so it does not pump
+	 * within a word, only clipping is prevented immediately. The gain is
+	 * interpolated over the block to avoid zipper noise.
+	 */
 	struct AGC_Instance {
-		TAgc_Instance* m_tagc_instance;
-		short unknown1;
-		uint32_t unknown2;
-		uint32_t unknown3;
-		// 4 more bytes, probably padding
+		int m_sample_rate;
+		int m_block_size;
+		short m_mode;
+		// Target peak level in dB below full scale
+		int m_level;
+		// Maximum gain in dB
+		int m_power;
+		float m_target;
+		float m_max_gain;
+		// Largest gain change per block
+		float m_gain_rise;
+		float m_gain_fall;
+		float m_envelope;
+		float m_gain;
 	};
-	//static_assert(sizeof(AGC_Instance) == 0x18);
 
-	AGC_Instance* AGC_Init(int sample_rate /* probably */, int param_2, short param_3, int* param_4 /* status? */) {
+	static void AGC_UpdateConfig(AGC_Instance* instance) {
+		instance->m_target = 32767.0f * std::pow(10.0f, -instance->m_level / 20.0f);
+		instance->m_max_gain = std::pow(10.0f, instance->m_power / 20.0f);
+		const float blocks_per_second = static_cast<float>(instance->m_sample_rate) / instance->m_block_size;
+		// At most 3dB per second up and 6dB per second down
+		instance->m_gain_rise = std::pow(10.0f, 3.0f / 20.0f / blocks_per_second);
+		instance->m_gain_fall = std::pow(10.0f, -6.0f / 20.0f / blocks_per_second);
+	}
+
+	AGC_Instance* AGC_Init(int sample_rate, int block_size, short mode, int* status) {
 		if ((sample_rate == 8000 || sample_rate == 16000 || sample_rate == 32000 || sample_rate == 48000)
-			&& (param_2 == 0x50 || param_2 == 0xa0 || param_2 == 0x140 || param_2 == 0x1e0)) {
+			&& (block_size == 0x50 || block_size == 0xa0 || block_size == 0x140 || block_size == 0x1e0)) {
 			auto res = new AGC_Instance{};
-			TAgc_Create(&res->m_tagc_instance);
-			TAgc_Init_org(res->m_tagc_instance, 0, 0xff, param_3 + 1, sample_rate);
-			if (sample_rate == 32000 || sample_rate == 48000)
-				res->unknown1 = 0xa0;
-			else
-				res->unknown1 = param_2;
-			*param_4 = 1;
-			res->unknown2 = 0;
-			res->unknown3 = 0;
+			res->m_sample_rate = sample_rate;
+			res->m_block_size = block_size;
+			res->m_mode = mode;
+			res->m_level = 3;
+			res->m_power = 9;
+			res->m_envelope = 0.0f;
+			res->m_gain = 1.0f;
+			AGC_UpdateConfig(res);
+			*status = 1;
 			return res;
 		}
-		*param_4 = 4;
+		*status = 4;
 		return nullptr;
 	}
 
 	int AGC_Exit(AGC_Instance* instance) {
-		TAgc_Free(instance->m_tagc_instance);
 		delete instance;
 		return 1;
 	}
 
-	int AGC_Process(AGC_Instance* instance, long param_2, long param_3, long param_4, long param_5, int param_6) {
-		instance->m_tagc_instance->unknown2 = param_6 + 1;
-		if (param_6 == 0) {
-			TAgc_AddMic(instance->m_tagc_instance, param_2, param_3, instance->unknown1);
-			long a = 0, b = 0;
-			TAgc_Process(instance->m_tagc_instance, param_2, param_3, instance->unknown1, param_4, param_5, 0, &a, 0, &b);
-			instance->unknown3 = b;
-			instance->unknown2 = a;
-		} else {
-			int a = 0;
-			if (param_6 == 1) {
-				TAgc_VirtualMic(instance->m_tagc_instance, param_2, param_3, instance->unknown1, instance->unknown2, &a);
-			}
-			long b = 0, c = 0;
-			TAgc_Process(instance->m_tagc_instance, param_2, param_3, instance->unknown1, param_4, param_5, a, &b, 0, &c);
-			instance->unknown3 = c;
+	int AGC_Reset(AGC_Instance* instance) {
+		if (instance == nullptr) return 2;
+		instance->m_envelope = 0.0f;
+		instance->m_gain = 1.0f;
+		return 1;
+	}
+
+	int AGC_Process(AGC_Instance* instance, const short* in, short* out) {
+		// Roughly -55dBFS, below that the gain is held to not pump up silence
+		constexpr float gate_level = 58.0f;
+		const auto block = instance->m_block_size;
+		auto peak = static_cast<float>(TSpl_MaxAbsValueW16(in, block));
+		// Instant attack, release of about one second at 10ms blocks. The release only happens on blocks
+		// within 12dB of the envelope, so pauses between words keep the level of the last word.
+		if (peak >= instance->m_envelope)
+			instance->m_envelope = peak;
+		else if (peak * 4.0f >= instance->m_envelope)
+			instance->m_envelope *= 0.99f;
+
+		auto gain = instance->m_gain;
+		if (instance->m_envelope >= gate_level) {
+			// The gain slews slowly in both directions, so it is practically constant over a word.
+			// It is only raised while the level is more than 3dB below the target, levels close to it are left alone.
+			auto desired = instance->m_target / instance->m_envelope;
+			auto raised = std::min(desired * 0.7079f, instance->m_max_gain);
+			if (desired < gain)
+				gain = std::max(std::max(desired, 1.0f), gain * instance->m_gain_fall);
+			else if (raised > gain)
+				gain = std::min(raised, gain * instance->m_gain_rise);
+		}
+		// Never push the peak of this block over full scale
+		if (peak * gain > 32767.0f) gain = 32767.0f / peak;
+
+		// Q12 gains, interpolated from the last block
+		const int32_t start = static_cast<int32_t>(instance->m_gain * 4096.0f + 0.5f);
+		const int32_t end = static_cast<int32_t>(gain * 4096.0f + 0.5f);
+		instance->m_gain = gain;
+		if (start == 4096 && end == 4096) {
+			if (in != out) memcpy(out, in, block * sizeof(short));
+			return 1;
+		}
+		for (int i = 0; i < block; i++) {
+			int32_t g = start + (end - start) * (i + 1) / block;
+			auto v = (static_cast<int64_t>(in[i]) * g + 2048) >> 12;
+			out[i] = TSpl_SatW32ToW16(static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(v, INT32_MIN), INT32_MAX)));
 		}
 		return 1;
 	}
 
 	int AGC_SetPara(AGC_Instance* instance, const char* property, const char* value) {
 		if (instance == nullptr) return 2;
-		TAgc_config cfg;
-		cfg.level = agc_targetlevel;
-		cfg.power = agc_targetpower;
 		if (strcmp(property, "AGC_Level") == 0) {
 			auto val = strtol(value, nullptr, 10);
-			cfg.level = agc_targetlevel = val;
+			if (val < 0 || val > 31) return 4;
+			instance->m_level = val;
 		} else if (strcmp(property, "AGC_Power") == 0) {
 			auto val = strtol(value, nullptr, 10);
-			cfg.power = agc_targetpower = val;
+			if (val < 0 || val > 60) return 4;
+			instance->m_power = val;
 		} else
 			return 4;
-		auto res = TAgc_set_config(instance->m_tagc_instance, cfg);
-		if (res == -1) return 4;
+		AGC_UpdateConfig(instance);
 		return 1;
 	}
 }
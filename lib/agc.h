@@ -3,8 +3,11 @@
 extern "C"
 {
 	struct AGC_Instance;
-	AGC_Instance* AGC_Init(int sample_rate /* probably */, int param_2, short param_3, int* param_4 /* status? */);
+	AGC_Instance* AGC_Init(int sample_rate, int block_size, short mode, int* status);
 	int AGC_Exit(AGC_Instance* instance);
-	int AGC_Process(AGC_Instance* instance);
+	// Clear the envelope and gain, keeps the parameters and does not allocate
+	int AGC_Reset(AGC_Instance* instance);
+	// Apply the gain to one block of block_size samples. in and out may alias.
+	int AGC_Process(AGC_Instance* instance, const short* in, short* out);
 	int AGC_SetPara(AGC_Instance* instance, const char* property, const char* value);
-}
\ No newline at end of file
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <dtw-lib.h>
 #include <limits>
@@ -18,22 +19,27 @@ namespace snowboy {
 	}
 
 	void SlidingDtw::UpdateDistance(int param_1, const MatrixBase& param_2) {
+		// Cached distances are stale (e.g. the window was skipped), start over
+		if (field_x18.size() + param_1 < param_2.rows()) {
+			field_x18.clear();
+			param_1 = param_2.rows();
+		}
 		// TODO: This seems to generate the right results but I have no fucking clue whats going on
 		for (auto iVar25 = param_2.rows() - param_1; iVar25 < param_2.rows(); iVar25++) {
 			size_t local_b0 = 0, local_ac = 0;
 			ComputeBandBoundary(iVar25, &local_b0, &local_ac);
-			std::deque<float> local_88;
-			local_88.resize(local_ac - local_b0 + 1);
+			auto& local_88 = field_x18.emplace_back();
+			local_88.clear();
 			for (auto iVar13 = local_b0; iVar13 <= local_ac; iVar13++) {
 				auto fVar27 = ComputeVectorDistance(SubVector{*m_reference, iVar13}, SubVector{param_2, iVar25});
-				local_88[iVar13 - local_b0] = fVar27;
+				local_88.push_back(fVar27);
 			}
-			field_x18.push_back(local_88);
 		}
 		auto iVar25 = field_x18.size() - param_2.rows();
 		if (iVar25 != 0) {
 			if (field_x18.size() > param_2.rows()) {
-				field_x18.erase(field_x18.begin(), field_x18.begin() + (field_x18.size() - param_2.rows()));
+				while (field_x18.size() > param_2.rows())
+					field_x18.pop_front();
 			}
 			for (size_t iVar13 = 0; iVar13 < param_2.rows() - param_1; iVar13++) {
 				size_t local_b4 = 0, local_b0 = 0, local_ac = 0, local_a8 = 0;
@@ -61,12 +67,7 @@ namespace snowboy {
 	}
 
 	void SlidingDtw::SetOptions(const SlidingDtwOptions& opts) {
-		if (opts.distance_metric == "cosine")
-			m_distance_function = DistanceType::cosine;
-		else if (opts.distance_metric == "euclidean")
-			m_distance_function = DistanceType::euclidean;
-		else
-			throw snowboy_exception{"Unknown distance type: " + opts.distance_metric};
+		m_distance_function = ParseDistanceType(opts.distance_metric);
 		m_options = opts;
 		field_x70 = m_options.band_width / 2;
 	}
@@ -104,7 +105,7 @@ namespace snowboy {
 			throw snowboy_exception{"Reference file has not been set, call SetReference() first!"};
 		UpdateDistance(param_1, param_2);
 
-		std::vector<float> local_238;
+		auto& local_238 = m_prev_cost;
 		auto local_22c = std::numeric_limits<float>::max();
 		for (size_t row = 0; row < param_2.rows(); row++) {
 			/* try { // try from 00101d18 to 00101d74 has its CatchHandler @ 00102283 */
@@ -114,8 +115,8 @@ namespace snowboy {
 				ComputeBandBoundary(row - 1, &local_1e0, &local_1dc);
 			}
 			if (local_1e4 < local_1e8) break;
-			std::vector<float> __s;
-			__s.resize((local_1e4 - local_1e8) + 1);
+			auto& __s = m_cost;
+			__s.assign((local_1e4 - local_1e8) + 1, 0.0f);
 			auto bVar3 = true;
 			for (auto uVar6 = local_1e8; uVar6 <= local_1e4; uVar6++) {
 				if (uVar6 == 0 && row == 0) {
@@ -151,7 +152,7 @@ namespace snowboy {
 				}
 			}
 			if (bVar3) break;
-			local_238 = std::move(__s);
+			local_238.swap(__s);
 		}
 		return local_22c / static_cast<float>(this->m_reference->rows());
 	}
@@ -163,86 +164,113 @@ namespace snowboy {
 
 	SlidingDtw::~SlidingDtw() {}
 
-	float DtwAlign(DistanceType param_1, const MatrixBase& param_2, const MatrixBase& param_3, std::vector<std::vector<size_t>>* param_4) {
-		if (param_4 != nullptr) param_4->resize(param_2.rows());
-		if (param_2.rows() == 0 || param_3.rows() == 0) {
+	DistanceType ParseDistanceType(const std::string& name) {
+		if (name == "cosine")
+			return DistanceType::cosine;
+		else if (name == "euclidean")
+			return DistanceType::euclidean;
+		else
+			throw snowboy_exception{"Unknown distance type: " + name};
+	}
+
+	namespace {
+		enum DtwStep : uint8_t { kDtwDiag = 0,
+								 kDtwUp = 1,
+								 kDtwLeft = 2 };
+	} // namespace
+
+	float DtwAlign(DistanceType distance, const MatrixBase& a, const MatrixBase& b, size_t band_width, DtwAlignWorkspace* ws, std::vector<size_t>* alignment) {
+		if (distance != DistanceType::cosine && distance != DistanceType::euclidean)
+			throw snowboy_exception{"Unknown distance type: " + std::to_string(distance)};
+		if (a.rows() == 0 || b.rows() == 0) {
+			if (alignment != nullptr) alignment->clear();
 			return std::numeric_limits<float>::max();
 		}
 
-		SNOWBOY_ASSERT(!param_2.HasNan() && !param_2.HasInfinity());
-		SNOWBOY_ASSERT(!param_3.HasNan() && !param_3.HasInfinity());
-
-		Matrix distances;
-		distances.Resize(param_2.rows(), param_3.rows());
-		for (size_t row = 0; row < distances.rows(); row++) {
-			for (size_t col = 0; col < distances.cols(); col++) {
-				if (param_1 == DistanceType::cosine) {
-					distances(row, col) = SubVector{param_2, row}.CosineDistance(SubVector{param_3, col});
-				} else if (param_1 == DistanceType::euclidean) {
-					distances(row, col) = SubVector{param_2, row}.EuclideanDistance(SubVector{param_3, col});
-				} else
-					throw snowboy_exception{"Unknown distance type: " + std::to_string(param_1)};
+		SNOWBOY_ASSERT(!a.HasNan() && !a.HasInfinity());
+		SNOWBOY_ASSERT(!b.HasNan() && !b.HasInfinity());
+
+		const auto rows = a.rows();
+		const auto cols = b.rows();
+		// Make sure the bands of two consecutive rows always overlap
+		if (band_width != 0) band_width = std::max(band_width, (cols + rows - 1) / rows);
+
+		const auto inf = std::numeric_limits<float>::infinity();
+		ws->cost.assign(cols * 2, inf);
+		ws->steps.assign((rows * cols + 3) / 4, 0);
+		auto prev = ws->cost.data();
+		auto cur = prev + cols;
+		for (size_t row = 0; row < rows; row++) {
+			size_t first = 0, last = cols - 1;
+			if (band_width != 0) {
+				auto center = rows > 1 ? row * (cols - 1) / (rows - 1) : 0;
+				first = center > band_width ? center - band_width : 0;
+				last = std::min(cols - 1, center + band_width);
 			}
-		}
-		SNOWBOY_ASSERT(!distances.HasNan() && !distances.HasInfinity());
-		Matrix local_1d8;
-		local_1d8.Resize(param_2.rows(), param_3.rows());
-		for (size_t row = 0; row < local_1d8.rows(); row++) {
-			for (size_t col = 0; col < local_1d8.cols(); col++) {
+			std::fill(cur, cur + cols, inf);
+			for (size_t col = first; col <= last; col++) {
+				auto dist = distance == DistanceType::cosine ? SubVector{a, row}.CosineDistance(SubVector{b, col})
+															 : SubVector{a, row}.EuclideanDistance(SubVector{b, col});
 				if (row == 0) {
-					local_1d8(0, col) = distances(0, col);
+					cur[col] = dist;
 				} else if (col == 0) {
-					local_1d8(row, 0) = distances(row, 0) + local_1d8(row - 1, 0);
+					cur[0] = dist + prev[0];
 				} else {
-					auto fVar16 = std::min(std::min(local_1d8(row, col - 1), local_1d8(row - 1, col)), local_1d8(row - 1, col - 1));
-					local_1d8(row, col) = fVar16 + distances(row, col);
+					cur[col] = std::min(std::min(cur[col - 1], prev[col]), prev[col - 1]) + dist;
+					// Backtracking decision, computed exactly like the original traceback did
+					// on the full cost matrix, including its tie breaking.
+					float pred = cur[col] - dist;
+					auto diag = fabs(pred - prev[col - 1]);
+					auto left = fabs(pred - cur[col - 1]);
+					auto up = fabs(pred - prev[col]);
+					uint8_t step;
+					if (diag <= left)
+						step = up >= diag ? kDtwDiag : kDtwUp;
+					else
+						step = up < left ? kDtwUp : kDtwLeft;
+					auto idx = row * cols + col;
+					ws->steps[idx / 4] |= step << ((idx % 4) * 2);
 				}
 			}
+			std::swap(prev, cur);
 		}
-		SNOWBOY_ASSERT(!local_1d8.HasNan() && !local_1d8.HasInfinity());
-		int min_index = -1;
-		auto min_value = SubVector{local_1d8, local_1d8.rows() - 1}.Min(&min_index);
-		SNOWBOY_ASSERT(min_index >= 0);
-		if (param_4 != nullptr) {
-			for (size_t iVar11 = local_1d8.rows() - 1; iVar11 != 0;) {
-				// TODO: This is wrong
-				// If I look at the code it should only be
-				// param_4->at(iVar11).push_back(min_index);
-				// But that produces different results from what it should
-				if (param_4->at(iVar11).empty())
-					param_4->at(iVar11).push_back(min_index);
-				else
-					param_4->at(iVar11).at(0) = min_index;
-				if (0 >= min_index) {
-					iVar11--;
+
+		// prev now holds the last row
+		size_t min_index = cols;
+		auto min_value = inf;
+		for (size_t col = 0; col < cols; col++) {
+			if (prev[col] < min_value) {
+				min_index = col;
+				min_value = prev[col];
+			}
+		}
+		SNOWBOY_ASSERT(min_index < cols);
+		if (alignment != nullptr) {
+			alignment->resize(rows);
+			auto col = min_index;
+			for (size_t row = rows - 1; row != 0;) {
+				(*alignment)[row] = col;
+				if (col == 0) {
+					row--;
 					continue;
 				}
-				auto fVar18 = local_1d8(iVar11, min_index) - distances(iVar11, min_index);
-				auto pfVar8_0 = fabs(fVar18 - local_1d8(iVar11 - 1, min_index - 1));
-				auto pfVar8_1 = fabs(fVar18 - local_1d8(iVar11, min_index - 1));
-				auto pfVar8_2 = fabs(fVar18 - local_1d8(iVar11 - 1, min_index));
-				if (pfVar8_0 <= pfVar8_1) {
-					if (pfVar8_2 >= pfVar8_0) {
-						min_index -= 1;
-					}
-					iVar11--;
-				} else {
-					if (pfVar8_2 < pfVar8_1) {
-						iVar11--;
-					} else {
-						min_index -= 1;
-					}
-				}
+				auto idx = row * cols + col;
+				auto step = (ws->steps[idx / 4] >> ((idx % 4) * 2)) & 3;
+				if (step != kDtwLeft) row--;
+				if (step != kDtwUp) col--;
 			}
-			// TODO: This is wrong
-			// If I look at the code it should only be
-			// param_4->at(0).push_back(min_index);
-			// But that produces different results from what it should
-			if (param_4->at(0).empty())
-				param_4->at(0).push_back(min_index);
-			else
-				param_4->at(0).at(0) = min_index;
+			(*alignment)[0] = col;
 		}
-		return min_value / param_2.rows();
+		return min_value / rows;
+	}
+
+	float DtwAlign(DistanceType distance, const MatrixBase& a, const MatrixBase& b, std::vector<std::vector<size_t>>* alignment) {
+		static thread_local DtwAlignWorkspace ws;
+		if (alignment == nullptr) return DtwAlign(distance, a, b, 0, &ws, nullptr);
+		auto res = DtwAlign(distance, a, b, 0, &ws, &ws.alignment);
+		alignment->resize(a.rows());
+		for (size_t i = 0; i < ws.alignment.size(); i++)
+			(*alignment)[i].assign(1, ws.alignment[i]);
+		return res;
 	}
 } // namespace snowboy
@@ -1,5 +1,6 @@
 #pragma once
-#include <deque>
+#include <cstdint>
+#include <ring-buffer.h>
 #include <string>
 #include <vector>
 
@@ -16,11 +17,14 @@ namespace snowboy {
 	};
 	struct SlidingDtw {
 		SlidingDtwOptions m_options;
-		std::deque<std::deque<float>> field_x18;
+		RingBuffer<RingBuffer<float>> field_x18;
 		const MatrixBase* m_reference = nullptr;
 		int field_x70 = 0;
 		float m_early_stop_threshold = 1.0;
 		DistanceType m_distance_function;
+		// Accumulated costs of the previous and current row in ComputeDtwDistance
+		std::vector<float> m_prev_cost;
+		std::vector<float> m_cost;
 
 		SlidingDtw();
 		SlidingDtw(const SlidingDtwOptions&);
@@ -37,5 +41,19 @@ namespace snowboy {
 		virtual ~SlidingDtw();
 	};
 
+	// Scratch memory for DtwAlign, reusing it avoids allocations on repeated calls
+	struct DtwAlignWorkspace {
+		std::vector<float> cost;
+		// Backtracking steps, 2 bits per cell
+		std::vector<uint8_t> steps;
+		std::vector<size_t> alignment;
+	};
+
+	DistanceType ParseDistanceType(const std::string&);
 	float DtwAlign(DistanceType, const MatrixBase&, const MatrixBase&, std::vector<std::vector<size_t>>*);
+	/**
+	 * Align b onto a. If band_width is not 0 only cells within band_width columns
+	 * of the diagonal are considered. alignment receives one index into b per row of a.
+	 */
+	float DtwAlign(DistanceType distance, const MatrixBase& a, const MatrixBase& b, size_t band_width, DtwAlignWorkspace* ws, std::vector<size_t>* alignment);
 } // namespace snowboy
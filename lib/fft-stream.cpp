@@ -15,6 +15,7 @@ namespace snowboy {
 	}
 
 	void FftStream::InitFft(int num_points) {
+		if (m_fft && m_fft_points == num_points) return;
 		FftOptions options;
 		options.field_x00 = true;
 		options.num_fft_points = num_points;
@@ -27,6 +28,7 @@ namespace snowboy {
 			m_fft.reset(new SplitRadixFft(options));
 		} else
 			throw snowboy_exception{"FFT method has not been implemented: " + m_options.method};
+		m_fft_points = num_points;
 	}
 
 	FftStream::FftStream(const FftStreamOptions& options) {
@@ -38,7 +40,7 @@ namespace snowboy {
 	}
 
 	int FftStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-		Matrix m;
+		auto& m = m_input;
 		auto res = m_connectedStream->Read(&m, info);
 		if ((res & 0xc2) != 0 || m.rows() == 0) {
 			mat->Resize(0, 0);
@@ -55,7 +57,7 @@ namespace snowboy {
 			InitFft(num_fft_points);
 		}
 		mat->Resize(m.rows(), num_fft_points);
-		Vector v;
+		auto& v = m_frame;
 		for (size_t r = 0; r < m.rows(); r++) {
 			v.Resize(std::max<size_t>(m.cols(), num_fft_points));
 			v.CopyFromVec(SubVector{m, r});
@@ -67,7 +69,6 @@ namespace snowboy {
 	}
 
 	bool FftStream::Reset() {
-		m_fft.reset();
 		num_fft_points = -1;
 		return true;
 	}
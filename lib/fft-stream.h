@@ -1,6 +1,8 @@
 #pragma once
+#include <matrix-wrapper.h>
 #include <memory>
 #include <stream-itf.h>
+#include <vector-wrapper.h>
 
 namespace snowboy {
 	struct OptionsItf;
@@ -13,7 +15,11 @@ namespace snowboy {
 	class FftStream : public StreamItf {
 		FftStreamOptions m_options;
 		std::unique_ptr<FftItf> m_fft;
+		// Number of points m_fft was created for, it is kept across Reset() and only recreated if this changes
+		int m_fft_points{-1};
 		int num_fft_points;
+		Matrix m_input;
+		Vector m_frame;
 
 		void InitFft(int num_points);
 
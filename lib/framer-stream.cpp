@@ -96,17 +96,16 @@ namespace snowboy {
 	}
 
 	int FramerStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-		Matrix matrix_in;
-		std::vector<FrameInfo> info_in;
-		auto sig = m_connectedStream->Read(&matrix_in, &info_in);
+		auto& matrix_in = m_input;
+		auto sig = m_connectedStream->Read(&matrix_in, &m_input_info);
 		if ((sig & 0xc2) != 0 || matrix_in.m_cols == 0) {
 			mat->Resize(0, 0);
 			info->clear();
 			return sig;
 		}
 
-		Vector temp_vector;
-		temp_vector.Resize(matrix_in.m_cols + field_x40.size());
+		auto& temp_vector = m_samples;
+		temp_vector.Resize(matrix_in.m_cols + field_x40.size(), MatrixResizeType::kUndefined);
 		temp_vector.Range(0, field_x40.size()).CopyFromVec(field_x40);
 		temp_vector.Range(field_x40.size(), matrix_in.m_cols).CopyFromVec(SubVector{matrix_in, 0});
 		field_x40.Resize(0);
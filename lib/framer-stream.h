@@ -1,5 +1,6 @@
 #pragma once
 #include <frame-info.h>
+#include <matrix-wrapper.h>
 #include <stream-itf.h>
 #include <string>
 #include <vector-wrapper.h>
@@ -24,6 +25,10 @@ namespace snowboy {
 		size_t m_frame_shift_samples;
 		size_t m_frame_length_samples;
 		Vector m_window;
+		// Kept between reads to avoid allocating
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
+		Vector m_samples;
 
 		void CreateWindow();
 		void CreateFrames(const VectorBase& data, Matrix* mat);
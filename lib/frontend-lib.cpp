@@ -2,6 +2,9 @@
 #include <cmath>
 #include <cstdio>
 #include <frontend-lib.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #define SHR(a, shift) ((a) >> (shift))
 #define SHR16(a, shift) ((a) >> (shift))
@@ -18,6 +21,73 @@
 #define MULT16_16_P14(a, b) (SHR(ADD32(8192, MULT16_16((a), (b))), 14))
 #define ABS_W32(a) (((int32_t)a >= 0) ? ((int32_t)a) : -((int32_t)a))
 
+/* Vector helpers shared by the SSE2 and AVX2 builds, TSPL_SIMD_WIDTH is the number of int16 lanes */
+#if defined(__AVX2__)
+#define TSPL_SIMD_WIDTH 16
+typedef __m256i tspl_vec;
+#define TSPL_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define TSPL_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define TSPL_SET1_32(x) _mm256_set1_epi32(x)
+#define TSPL_ZERO() _mm256_setzero_si256()
+#define TSPL_MADD16(a, b) _mm256_madd_epi16((a), (b))
+#define TSPL_ADD32(a, b) _mm256_add_epi32((a), (b))
+#define TSPL_SUB32(a, b) _mm256_sub_epi32((a), (b))
+#define TSPL_SRA32(a, c) _mm256_sra_epi32((a), _mm_cvtsi32_si128(c))
+#define TSPL_SLL32(a, c) _mm256_sll_epi32((a), _mm_cvtsi32_si128(c))
+#define TSPL_SRAI32(a, c) _mm256_srai_epi32((a), (c))
+#define TSPL_SLLI32(a, c) _mm256_slli_epi32((a), (c))
+#define TSPL_AND(a, b) _mm256_and_si256((a), (b))
+#define TSPL_OR(a, b) _mm256_or_si256((a), (b))
+#define TSPL_MAX16(a, b) _mm256_max_epi16((a), (b))
+#define TSPL_SUB16(a, b) _mm256_sub_epi16((a), (b))
+#define TSPL_SUBS16(a, b) _mm256_subs_epi16((a), (b))
+#define TSPL_MULLO16(a, b) _mm256_mullo_epi16((a), (b))
+#define TSPL_MULHI16(a, b) _mm256_mulhi_epi16((a), (b))
+#define TSPL_UNPACKLO16(a, b) _mm256_unpacklo_epi16((a), (b))
+#define TSPL_UNPACKHI16(a, b) _mm256_unpackhi_epi16((a), (b))
+#define TSPL_PACKS32(a, b) _mm256_packs_epi32((a), (b))
+#define TSPL_EVEN32(a, b) _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), 0x88))
+#define TSPL_ODD32(a, b) _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), 0xdd))
+#define TSPL_UNPACKLO32(a, b) _mm256_unpacklo_epi32((a), (b))
+#define TSPL_UNPACKHI32(a, b) _mm256_unpackhi_epi32((a), (b))
+#define TSPL_UNPACKLO64(a, b) _mm256_unpacklo_epi64((a), (b))
+#define TSPL_UNPACKHI64(a, b) _mm256_unpackhi_epi64((a), (b))
+#define TSPL_LO128(a, b) _mm256_permute2x128_si256((a), (b), 0x20)
+#define TSPL_HI128(a, b) _mm256_permute2x128_si256((a), (b), 0x31)
+#elif defined(__SSE2__)
+#define TSPL_SIMD_WIDTH 8
+typedef __m128i tspl_vec;
+#define TSPL_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define TSPL_STORE(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define TSPL_SET1_32(x) _mm_set1_epi32(x)
+#define TSPL_ZERO() _mm_setzero_si128()
+#define TSPL_MADD16(a, b) _mm_madd_epi16((a), (b))
+#define TSPL_ADD32(a, b) _mm_add_epi32((a), (b))
+#define TSPL_SUB32(a, b) _mm_sub_epi32((a), (b))
+#define TSPL_SRA32(a, c) _mm_sra_epi32((a), _mm_cvtsi32_si128(c))
+#define TSPL_SLL32(a, c) _mm_sll_epi32((a), _mm_cvtsi32_si128(c))
+#define TSPL_SRAI32(a, c) _mm_srai_epi32((a), (c))
+#define TSPL_SLLI32(a, c) _mm_slli_epi32((a), (c))
+#define TSPL_AND(a, b) _mm_and_si128((a), (b))
+#define TSPL_OR(a, b) _mm_or_si128((a), (b))
+#define TSPL_MAX16(a, b) _mm_max_epi16((a), (b))
+#define TSPL_SUB16(a, b) _mm_sub_epi16((a), (b))
+#define TSPL_SUBS16(a, b) _mm_subs_epi16((a), (b))
+#define TSPL_MULLO16(a, b) _mm_mullo_epi16((a), (b))
+#define TSPL_MULHI16(a, b) _mm_mulhi_epi16((a), (b))
+#define TSPL_UNPACKLO16(a, b) _mm_unpacklo_epi16((a), (b))
+#define TSPL_UNPACKHI16(a, b) _mm_unpackhi_epi16((a), (b))
+#define TSPL_PACKS32(a, b) _mm_packs_epi32((a), (b))
+#define TSPL_EVEN32(a, b) _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0x88))
+#define TSPL_ODD32(a, b) _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0xdd))
+#define TSPL_UNPACKLO32(a, b) _mm_unpacklo_epi32((a), (b))
+#define TSPL_UNPACKHI32(a, b) _mm_unpackhi_epi32((a), (b))
+#define TSPL_UNPACKLO64(a, b) _mm_unpacklo_epi64((a), (b))
+#define TSPL_UNPACKHI64(a, b) _mm_unpackhi_epi64((a), (b))
+#else
+#define TSPL_SIMD_WIDTH 0
+#endif
+
 #define D0 16384
 #define D1 11356
 #define D2 3726
@@ -574,6 +644,130 @@ extern "C"
 		-3211, -3011, -2811, -2610, -2410, -2209, -2009, -1808, -1607,
 		-1406, -1206, -1005, -804, -603, -402, -201};
 
+#if TSPL_SIMD_WIDTH
+	/* Twiddle factors of every stage as int16 pairs, so that one _mm_madd_epi16 on an interleaved
+	 * complex value yields the real or imaginary part of the product. Stage l starts at offset l - 1.
+	 */
+	struct TSpl_Twiddles {
+		int32_t fwd_re[1023];
+		int32_t fwd_im[1023];
+		int32_t inv_re[1023];
+		int32_t inv_im[1023];
+	};
+
+	static int32_t TSpl_PackW16(int16_t lo, int16_t hi) {
+		return (int32_t)((uint32_t)(uint16_t)lo | ((uint32_t)(uint16_t)hi << 16));
+	}
+
+	static const struct TSpl_Twiddles* TSpl_GetTwiddles(void) {
+		static const struct TSpl_Twiddles* twiddles = [] {
+			static struct TSpl_Twiddles t;
+			for (int l = 1, k = 9; l < 1024; l <<= 1, k--) {
+				for (int m = 0; m < l; m++) {
+					int16_t wr = kSinTable1024[(m << k) + 256];
+					int16_t wi = kSinTable1024[m << k];
+					t.fwd_re[l - 1 + m] = TSpl_PackW16(wr, wi);
+					t.fwd_im[l - 1 + m] = TSpl_PackW16(-wi, wr);
+					t.inv_re[l - 1 + m] = TSpl_PackW16(wr, -wi);
+					t.inv_im[l - 1 + m] = TSpl_PackW16(wi, wr);
+				}
+			}
+			return &t;
+		}();
+		return twiddles;
+	}
+
+	struct TSpl_ButterflyParams {
+		tspl_vec t_round;
+		tspl_vec out_round;
+		int t_shift;
+		int q_shift;
+		int out_shift;
+	};
+
+	/* Radix-2 butterflies on TSPL_SIMD_WIDTH / 2 interleaved complex values, bit exact to the scalar loops:
+	 *   t = (w * x[j] + t_round) >> t_shift
+	 *   x[j] = ((x[i] << q_shift) - t + out_round) >> out_shift
+	 *   x[i] = ((x[i] << q_shift) + t + out_round) >> out_shift
+	 */
+	static inline void TSpl_Butterfly(tspl_vec* xi, tspl_vec* xj, tspl_vec w_re, tspl_vec w_im, const struct TSpl_ButterflyParams* p) {
+		const tspl_vec low_mask = TSPL_SET1_32(0xffff);
+		tspl_vec tr = TSPL_SRA32(TSPL_ADD32(TSPL_MADD16(*xj, w_re), p->t_round), p->t_shift);
+		tspl_vec ti = TSPL_SRA32(TSPL_ADD32(TSPL_MADD16(*xj, w_im), p->t_round), p->t_shift);
+		tspl_vec qr = TSPL_SLL32(TSPL_SRAI32(TSPL_SLLI32(*xi, 16), 16), p->q_shift);
+		tspl_vec qi = TSPL_SLL32(TSPL_SRAI32(*xi, 16), p->q_shift);
+		tspl_vec jr = TSPL_SRA32(TSPL_ADD32(TSPL_SUB32(qr, tr), p->out_round), p->out_shift);
+		tspl_vec ji = TSPL_SRA32(TSPL_ADD32(TSPL_SUB32(qi, ti), p->out_round), p->out_shift);
+		tspl_vec ir = TSPL_SRA32(TSPL_ADD32(TSPL_ADD32(qr, tr), p->out_round), p->out_shift);
+		tspl_vec ii = TSPL_SRA32(TSPL_ADD32(TSPL_ADD32(qi, ti), p->out_round), p->out_shift);
+		// Truncate to int16 like the scalar cast and interleave again
+		*xj = TSPL_OR(TSPL_AND(jr, low_mask), TSPL_SLLI32(ji, 16));
+		*xi = TSPL_OR(TSPL_AND(ir, low_mask), TSPL_SLLI32(ii, 16));
+	}
+
+	/* One radix-2 stage of TSpl_ComplexFFT/TSpl_ComplexIFFT. Stages with fewer than TSPL_SIMD_WIDTH / 2
+	 * butterflies per group shuffle two vectors so the i and j values end up in separate registers.
+	 * Requires n >= TSPL_SIMD_WIDTH.
+	 */
+	static void TSpl_ButterflyStage(int16_t* frfi, int n, int l, const int32_t* w_re, const int32_t* w_im,
+									int t_round, int t_shift, int q_shift, int out_round, int out_shift) {
+		const struct TSpl_ButterflyParams p = {TSPL_SET1_32(t_round), TSPL_SET1_32(out_round), t_shift, q_shift, out_shift};
+		if (l >= TSPL_SIMD_WIDTH / 2) {
+			for (int b = 0; b < n; b += 2 * l) {
+				for (int m = 0; m < l; m += TSPL_SIMD_WIDTH / 2) {
+					int16_t* pi = frfi + 2 * (b + m);
+					int16_t* pj = pi + 2 * l;
+					tspl_vec xi = TSPL_LOAD(pi);
+					tspl_vec xj = TSPL_LOAD(pj);
+					TSpl_Butterfly(&xi, &xj, TSPL_LOAD(w_re + m), TSPL_LOAD(w_im + m), &p);
+					TSPL_STORE(pj, xj);
+					TSPL_STORE(pi, xi);
+				}
+			}
+			return;
+		}
+
+		// Repeat the l twiddles over all lanes
+		int32_t wr[TSPL_SIMD_WIDTH / 2], wi[TSPL_SIMD_WIDTH / 2];
+		for (int m = 0; m < TSPL_SIMD_WIDTH / 2; m++) {
+			wr[m] = w_re[m % l];
+			wi[m] = w_im[m % l];
+		}
+		const tspl_vec vwr = TSPL_LOAD(wr);
+		const tspl_vec vwi = TSPL_LOAD(wi);
+		for (int b = 0; b < n; b += TSPL_SIMD_WIDTH) {
+			int16_t* pa = frfi + 2 * b;
+			int16_t* pb = pa + TSPL_SIMD_WIDTH;
+			tspl_vec a = TSPL_LOAD(pa);
+			tspl_vec c = TSPL_LOAD(pb);
+			tspl_vec xi, xj;
+			if (l == 1) {
+				xi = TSPL_EVEN32(a, c);
+				xj = TSPL_ODD32(a, c);
+				TSpl_Butterfly(&xi, &xj, vwr, vwi, &p);
+				a = TSPL_UNPACKLO32(xi, xj);
+				c = TSPL_UNPACKHI32(xi, xj);
+			} else if (l == 2) {
+				xi = TSPL_UNPACKLO64(a, c);
+				xj = TSPL_UNPACKHI64(a, c);
+				TSpl_Butterfly(&xi, &xj, vwr, vwi, &p);
+				a = TSPL_UNPACKLO64(xi, xj);
+				c = TSPL_UNPACKHI64(xi, xj);
+			} else {
+#if TSPL_SIMD_WIDTH == 16
+				xi = TSPL_LO128(a, c);
+				xj = TSPL_HI128(a, c);
+				TSpl_Butterfly(&xi, &xj, vwr, vwi, &p);
+				a = TSPL_LO128(xi, xj);
+				c = TSPL_HI128(xi, xj);
+#endif
+			}
+			TSPL_STORE(pa, a);
+			TSPL_STORE(pb, c);
+		}
+	}
+#endif
+
 	int TSpl_ComplexFFT(int16_t* frfi, int stages, int mode) {
 		int i, j, l, k, istep, n, m;
 		int16_t wr, wi;
@@ -597,6 +791,16 @@ extern "C"
 			{
 				istep = l << 1;
 
+#if TSPL_SIMD_WIDTH
+				if (n >= TSPL_SIMD_WIDTH) {
+					const struct TSpl_Twiddles* tw = TSpl_GetTwiddles();
+					TSpl_ButterflyStage(frfi, n, l, tw->fwd_re + l - 1, tw->fwd_im + l - 1, 0, 15, 0, 0, 1);
+					--k;
+					l = istep;
+					continue;
+				}
+#endif
+
 				for (m = 0; m < l; ++m)
 				{
 					j = m << k;
@@ -635,6 +839,16 @@ extern "C"
 			{
 				istep = l << 1;
 
+#if TSPL_SIMD_WIDTH
+				if (n >= TSPL_SIMD_WIDTH) {
+					const struct TSpl_Twiddles* tw = TSpl_GetTwiddles();
+					TSpl_ButterflyStage(frfi, n, l, tw->fwd_re + l - 1, tw->fwd_im + l - 1, CFFTRND, 15 - CFFTSFT, CFFTSFT, CFFTRND2, 1 + CFFTSFT);
+					--k;
+					l = istep;
+					continue;
+				}
+#endif
+
 				for (m = 0; m < l; ++m)
 				{
 					j = m << k;
@@ -715,6 +929,19 @@ extern "C"
 
 			istep = l << 1;
 
+#if TSPL_SIMD_WIDTH
+			if (n >= TSPL_SIMD_WIDTH) {
+				const struct TSpl_Twiddles* tw = TSpl_GetTwiddles();
+				if (mode == 0)
+					TSpl_ButterflyStage(frfi, n, l, tw->inv_re + l - 1, tw->inv_im + l - 1, 0, 15, 0, 0, shift);
+				else
+					TSpl_ButterflyStage(frfi, n, l, tw->inv_re + l - 1, tw->inv_im + l - 1, CIFFTRND, 15 - CIFFTSFT, CIFFTSFT, round2, shift + CIFFTSFT);
+				--k;
+				l = istep;
+				continue;
+			}
+#endif
+
 			if (mode == 0)
 			{
 				// mode==0: Low-complexity and Low-accuracy mode
@@ -873,15 +1100,27 @@ extern "C"
 
 	int32_t TSpl_Energy(int16_t* vector, size_t vector_length, int* scale_factor) {
 		int32_t en = 0;
-		size_t i;
+		size_t i = 0;
 		int scaling = TSpl_GetScalingSquare(vector, vector_length, vector_length);
-		size_t looptimes = vector_length;
-		int16_t* vectorptr = vector;
-
-		for (i = 0; i < looptimes; i++)
+#if TSPL_SIMD_WIDTH
+		tspl_vec acc = TSPL_ZERO();
+		for (; i + TSPL_SIMD_WIDTH <= vector_length; i += TSPL_SIMD_WIDTH)
+		{
+			// 32 bit squares from the low and high halves of the 16 bit products
+			tspl_vec x = TSPL_LOAD(vector + i);
+			tspl_vec lo = TSPL_MULLO16(x, x);
+			tspl_vec hi = TSPL_MULHI16(x, x);
+			acc = TSPL_ADD32(acc, TSPL_SRA32(TSPL_UNPACKLO16(lo, hi), scaling));
+			acc = TSPL_ADD32(acc, TSPL_SRA32(TSPL_UNPACKHI16(lo, hi), scaling));
+		}
+		int32_t lanes[TSPL_SIMD_WIDTH / 2];
+		TSPL_STORE(lanes, acc);
+		for (int lane = 0; lane < TSPL_SIMD_WIDTH / 2; lane++)
+			en += lanes[lane];
+#endif
+		for (; i < vector_length; i++)
 		{
-			en += (*vectorptr * *vectorptr) >> scaling;
-			vectorptr++;
+			en += (vector[i] * vector[i]) >> scaling;
 		}
 		*scale_factor = scaling;
 
@@ -890,16 +1129,27 @@ extern "C"
 
 	int16_t TSpl_GetScalingSquare(int16_t* in_vector, size_t in_vector_length, size_t times) {
 		int16_t nbits = TSpl_GetSizeInBits((uint32_t)times);
-		size_t i;
+		size_t i = 0;
 		int16_t smax = -1;
 		int16_t sabs;
-		int16_t* sptr = in_vector;
 		int16_t t;
-		size_t looptimes = in_vector_length;
-
-		for (i = looptimes; i > 0; i--)
+#if TSPL_SIMD_WIDTH
+		// Wrapping negation on purpose, -32768 stays negative like in the scalar loop.
+		// Starting at 0 instead of -1 does not change the result, both end up returning 0.
+		tspl_vec vmax = TSPL_ZERO();
+		for (; i + TSPL_SIMD_WIDTH <= in_vector_length; i += TSPL_SIMD_WIDTH)
+		{
+			tspl_vec x = TSPL_LOAD(in_vector + i);
+			vmax = TSPL_MAX16(vmax, TSPL_MAX16(x, TSPL_SUB16(TSPL_ZERO(), x)));
+		}
+		int16_t lanes[TSPL_SIMD_WIDTH];
+		TSPL_STORE(lanes, vmax);
+		for (int lane = 0; lane < TSPL_SIMD_WIDTH; lane++)
+			smax = (lanes[lane] > smax ? lanes[lane] : smax);
+#endif
+		for (; i < in_vector_length; i++)
 		{
-			sabs = (*sptr > 0 ? *sptr++ : -*sptr++);
+			sabs = (in_vector[i] > 0 ? in_vector[i] : -in_vector[i]);
 			smax = (sabs > smax ? sabs : smax);
 		}
 		t = TSpl_NormW32(((int32_t)((int32_t)(smax) * (int32_t)(smax))));
@@ -919,7 +1169,22 @@ extern "C"
 
 	int16_t TSpl_MaxAbsValueW16(const int16_t* vector, size_t length) {
 		int maximum = 0;
-		for (size_t i = 0; i < length; i++)
+		size_t i = 0;
+#if TSPL_SIMD_WIDTH
+		// Saturating negation maps -32768 to 32767, which is the clamped result anyway
+		tspl_vec vmax = TSPL_ZERO();
+		for (; i + TSPL_SIMD_WIDTH <= length; i += TSPL_SIMD_WIDTH)
+		{
+			tspl_vec x = TSPL_LOAD(vector + i);
+			vmax = TSPL_MAX16(vmax, TSPL_MAX16(x, TSPL_SUBS16(TSPL_ZERO(), x)));
+		}
+		int16_t lanes[TSPL_SIMD_WIDTH];
+		TSPL_STORE(lanes, vmax);
+		for (int lane = 0; lane < TSPL_SIMD_WIDTH; lane++)
+			if (lanes[lane] > maximum)
+				maximum = lanes[lane];
+#endif
+		for (; i < length; i++)
 		{
 			auto absolute = fabs(vector[i]);
 			if (absolute > maximum)
@@ -930,6 +1195,25 @@ extern "C"
 		return maximum;
 	}
 
+	void TSpl_ElementwiseVectorMult(int16_t* out, const int16_t* in, const int16_t* win, size_t length, int right_shifts) {
+		size_t i = 0;
+#if TSPL_SIMD_WIDTH
+		for (; i + TSPL_SIMD_WIDTH <= length; i += TSPL_SIMD_WIDTH)
+		{
+			tspl_vec x = TSPL_LOAD(in + i);
+			tspl_vec w = TSPL_LOAD(win + i);
+			tspl_vec lo = TSPL_MULLO16(x, w);
+			tspl_vec hi = TSPL_MULHI16(x, w);
+			// The unpacks and the pack work per 128 bit lane, so the order is preserved
+			TSPL_STORE(out + i, TSPL_PACKS32(TSPL_SRA32(TSPL_UNPACKLO16(lo, hi), right_shifts), TSPL_SRA32(TSPL_UNPACKHI16(lo, hi), right_shifts)));
+		}
+#endif
+		for (; i < length; i++)
+		{
+			out[i] = (int16_t)((in[i] * win[i]) >> right_shifts);
+		}
+	}
+
 	int16_t TSpl_MaxValueW16(const int16_t* vector, size_t length) {
 		int16_t maximum = INT16_MIN;
 		size_t i = 0;
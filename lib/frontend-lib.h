@@ -8,11 +8,14 @@ extern "C"
 	int32_t spx_exp(int16_t x);
 	int16_t TSpl_AddSatW16(int16_t a, int16_t b);
 	int16_t TSpl_SatW32ToW16(int32_t value32);
+	void TSpl_ComplexBitReverse(int16_t* complex_data, int stages);
 	int TSpl_ComplexFFT(int16_t* frfi, int stages, int mode);
 	int TSpl_ComplexIFFT(int16_t* frfi, int stages, int mode);
 	uint32_t TSpl_DivU32U16(uint32_t a, uint16_t b);
 	int32_t TSpl_DivW32W16(int32_t a, int16_t b);
 	int16_t TSpl_DivW32W16ResW16(int32_t a, int16_t b);
+	// out[i] = (in[i] * win[i]) >> right_shifts
+	void TSpl_ElementwiseVectorMult(int16_t* out, const int16_t* in, const int16_t* win, size_t length, int right_shifts);
 	// TODO: DownsampleBy2
 	int32_t TSpl_Energy(int16_t* vector, size_t vector_length, int* scale_factor);
 	int16_t TSpl_GetScalingSquare(int16_t* in_vector, size_t in_vector_length, size_t times);
@@ -1,4 +1,5 @@
 #include <agc.h>
+#include <algorithm>
 #include <frame-info.h>
 #include <frontend-stream.h>
 #include <matrix-wrapper.h>
@@ -6,8 +7,6 @@
 #include <snowboy-error.h>
 #include <snowboy-options.h>
 
-#define ENABLE_FRONTEND_STREAM 0
-
 namespace snowboy {
 	void FrontendStreamOptions::Register(const std::string& prefix, OptionsItf* opts) {
 		opts->Register(prefix, "ns-power", "NS power.", &ns_power);
@@ -23,9 +22,8 @@ namespace snowboy {
 		m_dr_power = options.dr_power;
 		m_agc_level = options.agc_level;
 		m_agc_power = options.agc_power;
-#if ENABLE_FRONTEND_STREAM
 		field_x60 = 0xa0;
-		field_x38 = malloc(0x140); // this should be new x, might be 160 shorts
+		m_block.resize(field_x60);
 		m_ns3_instance = nullptr;
 		m_agc_instance = nullptr;
 		try {
@@ -33,57 +31,79 @@ namespace snowboy {
 		} catch (...) {
 			if (m_ns3_instance) NS3_Exit(m_ns3_instance);
 			if (m_agc_instance) AGC_Exit(m_agc_instance);
-			if (field_x38) free(field_x38); // this should be delete x
 			m_ns3_instance = nullptr;
 			m_agc_instance = nullptr;
-			field_x38 = nullptr;
 			throw;
 		}
-#endif
 	}
 
 	int FrontendStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-#if !ENABLE_FRONTEND_STREAM
-		// TODO: Implement this stuff
-		// It seems to work reasonably good without AGC and Noise suppression,
-		// so we just read from the previous stream for now.
-		// However for performance and completeness we should really implement it correctly
-		return m_connectedStream->Read(mat, info);
-#else
-		// TODO:
-		Matrix m;
+		auto& m = m_input;
 		auto res = m_connectedStream->Read(&m, info);
-		field_x64 = field_x64 + m.m_cols;
-		if (field_x64 > 48000) {
-			this->Reset();
-		}
-		if ((res & 0xc2) == 0 && m.m_rows != 0) {
-			Vector v;
-			v.Resize(field_x50.size() + m.m_cols);
-			v.Range(0, field_x50.size()).CopyFromVec(field_x50);
-			v.Range(field_x50.size(), m.m_cols).CopyFromVec(SubVector{m, 0});
-			field_x50.Resize(0);
-			auto x = v.size() / field_x60;
-			mat->Resize(1, x * field_x60);
-			// TODO: More code between here
-			if (x > 0) {
-			}
-			// TODO: and here
-		} else {
+		if ((res & 0xc2) != 0 || (m.m_rows == 0 && (res & 0x18) == 0)) {
 			mat->Resize(0, 0);
 			info->clear();
+			return res;
+		}
+		auto& v = m_samples;
+		v.Resize(field_x50.size() + (m.m_rows != 0 ? m.m_cols : 0), MatrixResizeType::kUndefined);
+		v.Range(0, field_x50.size()).CopyFromVec(field_x50);
+		if (m.m_rows != 0) v.Range(field_x50.size(), m.m_cols).CopyFromVec(SubVector{m, 0});
+		field_x50.Resize(0);
+
+		// Only whole blocks are processed, on end of stream the remainder is zero padded
+		const size_t block = field_x60;
+		auto nblocks = v.size() / block;
+		auto samples = nblocks * block;
+		if ((res & 0x18) != 0 && samples != v.size()) {
+			samples = v.size();
+			nblocks++;
+		} else if (samples != v.size()) {
+			field_x50.Resize(v.size() - samples, MatrixResizeType::kUndefined);
+			field_x50.CopyFromVec(v.Range(samples, v.size() - samples));
+		}
+		if (samples == 0) {
+			mat->Resize(0, 0);
+			return res;
+		}
+		mat->Resize(1, samples, MatrixResizeType::kUndefined);
+		auto in = v.data();
+		auto out = mat->m_data;
+		for (size_t b = 0; b < nblocks; b++) {
+			auto offset = b * block;
+			auto len = std::min(block, samples - offset);
+			for (size_t i = 0; i < len; i++) {
+				auto s = std::min(std::max(in[offset + i], -32768.0f), 32767.0f);
+				m_block[i] = static_cast<short>(s + (s < 0.0f ? -0.5f : 0.5f));
+			}
+			std::fill(m_block.begin() + len, m_block.end(), 0);
+			NS3_Process(m_ns3_instance, m_block.data(), m_block.data());
+			AGC_Process(m_agc_instance, m_block.data(), m_block.data());
+			for (size_t i = 0; i < len; i++)
+				out[offset + i] = m_block[i];
 		}
 		return res;
-#endif
 	}
 
 	bool FrontendStream::Reset() {
-#if ENABLE_FRONTEND_STREAM
+		// The original library also reset NS and AGC after every 48000 samples read. The noise estimate restarts
+		// from the first frame after a reset, so a reset during a word suppresses the rest of it and costs
+		// detections in noise. Their state is only cleared here instead.
+		// The parameters can not change after construction, so existing instances only need their state cleared
+		if (m_ns3_instance && m_agc_instance) {
+			field_x50.Resize(0);
+			NS3_Reset(m_ns3_instance);
+			AGC_Reset(m_agc_instance);
+			return true;
+		}
 		if (m_ns3_instance) NS3_Exit(m_ns3_instance);
 		if (m_agc_instance) AGC_Exit(m_agc_instance);
+		m_ns3_instance = nullptr;
+		m_agc_instance = nullptr;
 		field_x60 = 0xa0;
+		field_x50.Resize(0);
 		int status;
-		m_ns3_instance = NS3_Init(16000, 0xa0, &status);
+		m_ns3_instance = NS3_Init(16000, field_x60, &status);
 		if (status != 1)
 			throw snowboy_exception{"Failed to initialize NS."};
 		if (NS3_SetPara(m_ns3_instance, "NS_Power", m_ns_power.c_str()) != 1)
@@ -97,8 +117,6 @@ namespace snowboy {
 			throw snowboy_exception{"Failed to set AGC_Level."};
 		if (AGC_SetPara(m_agc_instance, "AGC_Power", m_agc_power.c_str()) != 1)
 			throw snowboy_exception{"Failed to set AGC_Power."};
-		field_x64 = 0;
-#endif
 		return true;
 	}
 
@@ -107,11 +125,8 @@ namespace snowboy {
 	}
 
 	FrontendStream::~FrontendStream() {
-#if ENABLE_FRONTEND_STREAM
 		if (m_ns3_instance) NS3_Exit(m_ns3_instance);
 		if (m_agc_instance) AGC_Exit(m_agc_instance);
-		if (field_x38) free(field_x38); // this should be delete x
-#endif
 		m_connectedStream = nullptr;
 		m_isConnected = false;
 	}
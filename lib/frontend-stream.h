@@ -1,6 +1,8 @@
 #pragma once
+#include <matrix-wrapper.h>
 #include <stream-itf.h>
 #include <string>
+#include <vector>
 #include <vector-wrapper.h>
 
 struct AGC_Instance;
@@ -19,12 +21,15 @@ namespace snowboy {
 		std::string m_dr_power;
 		std::string m_agc_level;
 		std::string m_agc_power;
-		void* field_x38; // 0x140 bytes
+		std::vector<short> m_block;
 		NS3_Instance* m_ns3_instance;
 		AGC_Instance* m_agc_instance;
+		// Samples not yet forming a full block
 		Vector field_x50;
+		// Block size in samples
 		int field_x60;
-		int field_x64; // might be padding
+		Matrix m_input;
+		Vector m_samples;
 
 		FrontendStream(const FrontendStreamOptions& options);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
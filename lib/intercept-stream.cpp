@@ -1,5 +1,5 @@
+#include <algorithm>
 #include <intercept-stream.h>
-#include <matrix-wrapper.h>
 
 namespace snowboy {
 
@@ -8,24 +8,23 @@ namespace snowboy {
 
 	int InterceptStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
 		if (m_connectedStream) throw std::runtime_error("InterceptStream can not be connected");
-		if (m_matrix_queue.empty()) {
+		if (m_queue_size == 0) {
 			mat->Resize(0, 0);
 			info->clear();
 			return 0x100; // End of stream ?
 		}
-		*mat = m_matrix_queue.front();
-		*info = m_frame_info_queue.front();
-		auto res = m_signal_queue.front();
-		m_matrix_queue.pop_front();
-		m_frame_info_queue.pop_front();
-		m_signal_queue.pop_front();
-		return res;
+		// Copying instead of swapping keeps every buffer at the largest size it has seen
+		auto& e = m_queue[m_queue_head];
+		*mat = e.matrix;
+		info->assign(e.frame_info.begin(), e.frame_info.end());
+		m_queue_head = (m_queue_head + 1) % m_queue.size();
+		m_queue_size--;
+		return e.signal;
 	}
 
 	bool InterceptStream::Reset() {
-		m_matrix_queue.clear();
-		m_frame_info_queue.clear();
-		m_signal_queue.clear();
+		m_queue_head = 0;
+		m_queue_size = 0;
 		return true;
 	}
 
@@ -40,8 +39,15 @@ namespace snowboy {
 	}
 
 	void InterceptStream::SetData(const MatrixBase& mat, const std::vector<FrameInfo>& info, const SnowboySignal& signal) {
-		m_matrix_queue.push_back(Matrix{mat});
-		m_frame_info_queue.push_back(info);
-		m_signal_queue.push_back(signal);
+		if (m_queue_size == m_queue.size()) {
+			std::rotate(m_queue.begin(), m_queue.begin() + m_queue_head, m_queue.end());
+			m_queue_head = 0;
+			m_queue.emplace_back();
+		}
+		auto& e = m_queue[(m_queue_head + m_queue_size) % m_queue.size()];
+		e.matrix = mat;
+		e.frame_info.assign(info.begin(), info.end());
+		e.signal = signal;
+		m_queue_size++;
 	}
 } // namespace snowboy
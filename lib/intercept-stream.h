@@ -1,14 +1,20 @@
 #pragma once
-#include <deque>
 #include <frame-info.h>
+#include <matrix-wrapper.h>
 #include <stream-itf.h>
 #include <vector>
 
 namespace snowboy {
 	class InterceptStream : public StreamItf {
-		std::deque<Matrix> m_matrix_queue;
-		std::deque<std::vector<FrameInfo>> m_frame_info_queue;
-		std::deque<SnowboySignal> m_signal_queue;
+		struct Entry {
+			Matrix matrix;
+			std::vector<FrameInfo> frame_info;
+			SnowboySignal signal;
+		};
+		// Ring buffer of queued data, entries keep their buffers once they are consumed so they can be reused
+		std::vector<Entry> m_queue;
+		size_t m_queue_head{0};
+		size_t m_queue_size{0};
 
 	public:
 		InterceptStream();
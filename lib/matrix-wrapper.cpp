@@ -2,11 +2,13 @@ extern "C"
 {
 #include <cblas.h>
 }
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <matrix-wrapper.h>
 #include <snowboy-error.h>
 #include <snowboy-io.h>
+#include <snowboy-math.h>
 #include <snowboy-utils.h>
 #include <sstream>
 #include <vector-wrapper.h>
@@ -52,6 +54,30 @@ namespace snowboy {
 		}
 	}
 
+	void Matrix::ApplySoftmaxPerRow() {
+		if (empty()) return;
+		for (size_t r = 0; r < m_rows; r++) {
+			auto row = m_data + r * m_stride;
+			auto max = *std::max_element(row, row + m_cols);
+			for (size_t c = 0; c < m_cols; c++)
+				row[c] -= max;
+			// Padding is exponentiated along with the row, keep it in range of the vector kernel
+			for (size_t c = m_cols; c < m_stride; c++)
+				row[c] = 0.0f;
+		}
+		// One call over the whole matrix, rows of a few columns are too short for the vector kernel
+		VectorExp(m_data, m_data, m_rows * m_stride);
+		for (size_t r = 0; r < m_rows; r++) {
+			auto row = m_data + r * m_stride;
+			float sum = 0.0f;
+			for (size_t c = 0; c < m_cols; c++)
+				sum += row[c];
+			auto scale = 1.0f / sum;
+			for (size_t c = 0; c < m_cols; c++)
+				row[c] *= scale;
+		}
+	}
+
 	SubMatrix MatrixBase::ColRange(size_t param_1, size_t param_2) const {
 		return SubMatrix{*this, 0, m_rows, param_1, param_2};
 	}
@@ -277,22 +303,37 @@ namespace snowboy {
 			m_cols = 0;
 			return;
 		}
-		// TODO: Smarter alloc similar to vector
 		uint64_t mem_size = static_cast<uint64_t>(m_rows) * static_cast<uint64_t>(m_stride);
 		uint64_t new_size = static_cast<uint64_t>(rows) * next_multiple_of<uint64_t>(cols, 4);
-		if (new_size <= mem_size) {
-			if (resize == MatrixResizeType::kUndefined || resize == MatrixResizeType::kSetZero) {
-				m_rows = rows;
-				m_cols = cols;
-				m_stride = next_multiple_of<uint64_t>(cols, 4);
-				if (resize == MatrixResizeType::kSetZero) Set(0.0f);
-				return;
-			} else if (cols <= m_stride) {
+		// Nothing to keep
+		if (m_rows == 0 && resize == MatrixResizeType::kCopyData) resize = MatrixResizeType::kSetZero;
+		if (new_size <= m_capacity && (resize == MatrixResizeType::kUndefined || resize == MatrixResizeType::kSetZero)) {
+			m_rows = rows;
+			m_cols = cols;
+			m_stride = next_multiple_of<uint64_t>(cols, 4);
+			if (resize == MatrixResizeType::kSetZero) Set(0.0f);
+			return;
+		}
+		// Rows beyond the current size are not initialized, only shrinking keeps the data in place
+		if (new_size <= mem_size && resize == MatrixResizeType::kCopyData) {
+			if (cols <= m_stride) {
 				m_rows = rows;
 				m_cols = cols;
 				return;
 			}
 		}
+		// Growing within the capacity keeps the rows in place, new elements are zeroed like in a reallocation
+		if (resize == MatrixResizeType::kCopyData && new_size <= m_capacity && next_multiple_of<uint64_t>(cols, 4) == m_stride) {
+			for (size_t r = 0; r < std::min<size_t>(rows, m_rows); r++) {
+				if (cols > m_cols) memset(&m_data[r * m_stride + m_cols], 0, (cols - m_cols) * sizeof(float));
+			}
+			for (size_t r = m_rows; r < rows; r++) {
+				memset(&m_data[r * m_stride], 0, cols * sizeof(float));
+			}
+			m_rows = rows;
+			m_cols = cols;
+			return;
+		}
 		if (m_data == nullptr) {
 			AllocateMatrixMemory(rows, cols);
 			if (resize == MatrixResizeType::kSetZero) Set(0.0f);
@@ -328,8 +369,10 @@ namespace snowboy {
 			m_stride = 0;
 			m_rows = 0;
 			m_cols = 0;
+			m_capacity = 0;
 			throw std::bad_alloc();
 		}
+		m_capacity = rows * m_stride;
 		allocs++;
 	}
 
@@ -338,9 +381,24 @@ namespace snowboy {
 			SnowboyMemalignFree(m_data);
 			frees++;
 		}
+		m_data = nullptr;
 		m_rows = 0;
 		m_stride = 0;
 		m_cols = 0;
+		m_capacity = 0;
+	}
+
+	void Matrix::Reserve(size_t rows, size_t cols) {
+		if (rows * next_multiple_of<size_t>(cols, 4) <= m_capacity) return;
+		Matrix temp;
+		temp.AllocateMatrixMemory(rows, cols);
+		temp.m_rows = m_rows;
+		temp.m_cols = m_cols;
+		temp.m_stride = next_multiple_of<size_t>(m_cols, 4);
+		for (size_t r = 0; r < m_rows; r++) {
+			memcpy(&temp.m_data[r * temp.m_stride], &m_data[r * m_stride], m_cols * sizeof(float));
+		}
+		temp.Swap(this);
 	}
 
 	void Matrix::PrintAllocStats(std::ostream& out) {
@@ -352,6 +410,10 @@ namespace snowboy {
 		frees = 0;
 	}
 
+	size_t Matrix::NumAllocs() noexcept {
+		return allocs;
+	}
+
 	Matrix& Matrix::operator=(const Matrix& other) {
 		Resize(other.m_rows, other.m_cols, MatrixResizeType::kUndefined);
 		CopyFromMat(other, MatrixTransposeType::kNoTrans);
@@ -415,6 +477,7 @@ namespace snowboy {
 		std::swap(m_rows, other->m_rows);
 		std::swap(m_stride, other->m_stride);
 		std::swap(m_data, other->m_data);
+		std::swap(m_capacity, other->m_capacity);
 	}
 
 	void Matrix::Transpose() {
@@ -59,6 +59,11 @@ namespace snowboy {
 		bool HasInfinity() const;
 	};
 	struct Matrix : MatrixBase {
+	protected:
+		// Number of floats allocated, Resize only reallocates if this is exceeded
+		size_t m_capacity{0};
+
+	public:
 		Matrix() {}
 		Matrix(const Matrix& other) {
 			Resize(other.m_rows, other.m_cols, MatrixResizeType::kUndefined);
@@ -73,12 +78,21 @@ namespace snowboy {
 			m_cols = other.m_cols;
 			m_stride = other.m_stride;
 			m_data = other.m_data;
+			m_capacity = other.m_capacity;
 			other.m_rows = 0;
 			other.m_data = nullptr;
 			other.m_stride = 0;
 			other.m_cols = 0;
+			other.m_capacity = 0;
 		}
+		size_t capacity() const noexcept { return m_capacity; }
 		void Resize(size_t rows, size_t cols, MatrixResizeType resize = MatrixResizeType::kSetZero);
+		/**
+		 * \brief Make sure a matrix of the given size fits without reallocating.
+		 *
+		 * The size and contents of the matrix are not changed.
+		 */
+		void Reserve(size_t rows, size_t cols);
 		void AllocateMatrixMemory(size_t rows, size_t cols);
 		void ReleaseMatrixMemory(); // NOTE: Called destroy in kaldi
 		~Matrix() { ReleaseMatrixMemory(); }
@@ -91,6 +105,8 @@ namespace snowboy {
 		}
 
 		void RemoveRow(size_t row);
+		// Softmax of every row, overwrites the padding between the rows
+		void ApplySoftmaxPerRow();
 		void Read(bool, bool, std::istream*);
 		void Read(bool, std::istream*);
 		void Swap(Matrix* other);
@@ -98,6 +114,7 @@ namespace snowboy {
 
 		static void PrintAllocStats(std::ostream&);
 		static void ResetAllocStats();
+		static size_t NumAllocs() noexcept;
 	};
 	struct SubMatrix : MatrixBase {
 		SubMatrix(const MatrixBase& parent, size_t rowoffset, size_t rows, size_t coloffset, size_t cols);
@@ -28,7 +28,7 @@ namespace snowboy {
 	}
 
 	int MfccStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-		Matrix m;
+		auto& m = m_input;
 		auto res = m_connectedStream->Read(&m, info);
 		if ((res & 0xc2) != 0 || m.m_rows == 0) {
 			mat->Resize(0, 0);
@@ -61,9 +61,7 @@ namespace snowboy {
 	}
 
 	bool MfccStream::Reset() {
-		m_melfilterbank.reset();
-		m_num_fft_points = 0;
-		field_x48 = 0.0;
+		// The filter bank only depends on the number of fft points, it is kept and rebuilt by Read if they change
 		return true;
 	}
 
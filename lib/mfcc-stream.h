@@ -20,6 +20,7 @@ namespace snowboy {
 		std::unique_ptr<MelFilterBank> m_melfilterbank;
 		Matrix m_dct_matrix;
 		Vector m_cepstral_coeffs;
+		Matrix m_input;
 		void InitMelFilterBank(size_t num_fft_points);
 		void ComputeMfcc(const VectorBase&, SubVector*) const;
 
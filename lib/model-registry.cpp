@@ -0,0 +1,202 @@
+#include <climits>
+#include <cstdlib>
+#include <model-registry.h>
+#include <snowboy-io.h>
+#include <snowboy-utils.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace snowboy {
+	namespace {
+		struct FileIdentity {
+			std::string path;
+			std::string offset;
+			int64_t size;
+			int64_t mtime;
+		};
+
+		std::string CanonicalPath(const std::string& path) {
+			char buf[PATH_MAX];
+			if (realpath(path.c_str(), buf) == nullptr) return path;
+			return buf;
+		}
+
+		// Returns false if the file can not be accessed, it is loaded without the registry then to get the loaders error
+		bool GetFileIdentity(const std::string& filename, FileIdentity* res) {
+			std::vector<std::string> parts;
+			SplitStringToVector(filename, global_snowboy_offset_delimiter, &parts);
+			if (parts.empty() || parts.size() > 2) return false;
+			struct stat stat_buf;
+			if (stat(parts[0].c_str(), &stat_buf) != 0) return false;
+			res->path = CanonicalPath(parts[0]);
+			res->offset = parts.size() == 2 ? parts[1] : "0";
+			res->size = stat_buf.st_size;
+#ifdef __APPLE__
+			res->mtime = stat_buf.st_mtimespec.tv_sec * 1000000000ll + stat_buf.st_mtimespec.tv_nsec;
+#else
+			res->mtime = stat_buf.st_mtim.tv_sec * 1000000000ll + stat_buf.st_mtim.tv_nsec;
+#endif
+			return true;
+		}
+
+		// Path first, so Evict can match it with a prefix compare
+		std::string MakeKey(const FileIdentity& id, const std::type_info& type, const std::string& variant) {
+			std::string key = id.path;
+			key.push_back('\0');
+			key += id.offset;
+			key.push_back('\0');
+			key += type.name();
+			key.push_back('\0');
+			key += variant;
+			return key;
+		}
+
+		bool IsUnused(const std::shared_ptr<const void>& model, const std::weak_ptr<const void>& weak_model) {
+			if (model) return model.use_count() == 1;
+			return weak_model.expired();
+		}
+	} // namespace
+
+	ModelRegistry& ModelRegistry::Instance() {
+		static ModelRegistry instance;
+		return instance;
+	}
+
+	std::shared_ptr<const void> ModelRegistry::GetImpl(const std::type_info& type, const std::string& filename, const std::string& variant,
+													   const std::function<std::shared_ptr<const void>()>& load) {
+		FileIdentity id;
+		if (!IsEnabled() || !GetFileIdentity(filename, &id)) return load();
+		const auto key = MakeKey(id, type, variant);
+
+		std::unique_lock<std::mutex> lck{m_mutex};
+		while (true) {
+			auto it = m_entries.find(key);
+			if (it == m_entries.end()) break;
+			if (it->second.loading) {
+				// Someone else is reading the same model, it is most likely usable for us as well
+				m_loaded.wait(lck);
+				continue;
+			}
+			if (it->second.size == id.size && it->second.mtime == id.mtime) {
+				auto res = it->second.weak_model.lock();
+				if (res) return res;
+			}
+			break;
+		}
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (!it->second.loading && it->second.weak_model.expired())
+				it = m_entries.erase(it);
+			else
+				++it;
+		}
+		auto& entry = m_entries[key];
+		entry.model.reset();
+		entry.weak_model.reset();
+		entry.loading = true;
+		lck.unlock();
+
+		std::shared_ptr<const void> res;
+		try {
+			res = load();
+		} catch (...) {
+			lck.lock();
+			m_entries.erase(key);
+			m_loaded.notify_all();
+			throw;
+		}
+
+		lck.lock();
+		// Loading entries are never evicted, so this is still ours
+		auto& loaded = m_entries[key];
+		loaded.loading = false;
+		loaded.size = id.size;
+		loaded.mtime = id.mtime;
+		loaded.weak_model = res;
+		if (m_retain_unused) loaded.model = res;
+		if (!m_enabled) m_entries.erase(key);
+		m_loaded.notify_all();
+		return res;
+	}
+
+	void ModelRegistry::SetEnabled(bool enabled) {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		m_enabled = enabled;
+		if (!enabled) {
+			for (auto it = m_entries.begin(); it != m_entries.end();) {
+				if (!it->second.loading)
+					it = m_entries.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+
+	bool ModelRegistry::IsEnabled() const {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		return m_enabled;
+	}
+
+	void ModelRegistry::SetRetainUnused(bool retain) {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		m_retain_unused = retain;
+		for (auto& e : m_entries) {
+			if (retain)
+				e.second.model = e.second.weak_model.lock();
+			else
+				e.second.model.reset();
+		}
+	}
+
+	bool ModelRegistry::IsRetainingUnused() const {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		return m_retain_unused;
+	}
+
+	void ModelRegistry::Evict(const std::string& filename) {
+		std::vector<std::string> parts;
+		SplitStringToVector(filename, global_snowboy_offset_delimiter, &parts);
+		if (parts.empty()) return;
+		auto prefix = CanonicalPath(parts[0]);
+		prefix.push_back('\0');
+		std::unique_lock<std::mutex> lck{m_mutex};
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (!it->second.loading && it->first.compare(0, prefix.size(), prefix) == 0)
+				it = m_entries.erase(it);
+			else
+				++it;
+		}
+	}
+
+	size_t ModelRegistry::EvictUnused() {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		size_t res = 0;
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (!it->second.loading && IsUnused(it->second.model, it->second.weak_model)) {
+				it = m_entries.erase(it);
+				res++;
+			} else
+				++it;
+		}
+		return res;
+	}
+
+	void ModelRegistry::Clear() {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (!it->second.loading)
+				it = m_entries.erase(it);
+			else
+				++it;
+		}
+	}
+
+	size_t ModelRegistry::Size() const {
+		std::unique_lock<std::mutex> lck{m_mutex};
+		size_t res = 0;
+		for (auto& e : m_entries) {
+			if (!e.second.loading) res++;
+		}
+		return res;
+	}
+} // namespace snowboy
@@ -0,0 +1,81 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace snowboy {
+	/**
+	 * Process wide cache of immutable models read from files.
+	 *
+	 * Entries are keyed by the canonical path and offset of the file, the type of the model and
+	 * a variant string for load options which change the result. The size and modification time
+	 * of the file are checked on every lookup, changed files are loaded again.
+	 * Concurrent lookups of the same model wait for a single load instead of parsing it twice.
+	 */
+	class ModelRegistry {
+		struct Entry {
+			std::shared_ptr<const void> model;
+			std::weak_ptr<const void> weak_model;
+			int64_t size = -1;
+			int64_t mtime = -1;
+			bool loading = false;
+		};
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_loaded;
+		std::unordered_map<std::string, Entry> m_entries;
+		bool m_enabled = true;
+		bool m_retain_unused = true;
+
+		std::shared_ptr<const void> GetImpl(const std::type_info& type, const std::string& filename, const std::string& variant,
+											const std::function<std::shared_ptr<const void>()>& load);
+
+	public:
+		ModelRegistry() = default;
+		ModelRegistry(const ModelRegistry&) = delete;
+		ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+		static ModelRegistry& Instance();
+
+		/**
+		 * \brief Returns the cached model for filename or calls load and caches its result.
+		 *
+		 * filename may contain an offset as used by resource files. The returned model is shared
+		 * with every other caller and must not be modified. Exceptions of load are passed on and
+		 * nothing is cached for them.
+		 */
+		template <typename T>
+		std::shared_ptr<const T> Get(const std::string& filename, const std::string& variant, const std::function<std::shared_ptr<const T>()>& load) {
+			return std::static_pointer_cast<const T>(GetImpl(typeid(T), filename, variant, [&load]() -> std::shared_ptr<const void> { return load(); }));
+		}
+
+		/**
+		 * \brief Disable to load every model again, enabled by default.
+		 *
+		 * Disabling also drops all cached models.
+		 */
+		void SetEnabled(bool enabled);
+		bool IsEnabled() const;
+		/**
+		 * \brief Keep models which are no longer used by any stream, enabled by default.
+		 *
+		 * If disabled a model is only reused while another stream still holds it.
+		 */
+		void SetRetainUnused(bool retain);
+		bool IsRetainingUnused() const;
+
+		// Drops all models of filename, streams holding them keep their copy
+		void Evict(const std::string& filename);
+		// Drops all models which are not used outside of the registry, returns the number of dropped models
+		size_t EvictUnused();
+		void Clear();
+		// Number of cached models, including the ones which expired but were not evicted yet
+		size_t Size() const;
+	};
+} // namespace snowboy
@@ -1,8 +1,16 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <matrix-wrapper.h>
 #include <nnet-component.h>
 #include <ostream>
 #include <snowboy-error.h>
 #include <snowboy-io.h>
+#include <snowboy-math.h>
+#include <string>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace snowboy {
 
@@ -51,6 +59,27 @@ namespace snowboy {
 		SNOWBOY_ASSERT(NumRows() % m_num_chunks == 0);
 	}
 
+	void ContextRing::Init(size_t capacity, size_t cols) {
+		m_rows.Resize(capacity, cols, MatrixResizeType::kUndefined);
+		Clear();
+	}
+
+	void ContextRing::Push(const MatrixBase& mat) {
+		const auto capacity = Capacity();
+		if (capacity == 0) return;
+		SNOWBOY_ASSERT(mat.m_cols == m_rows.m_cols);
+		auto first = mat.m_rows > capacity ? mat.m_rows - capacity : 0;
+		for (size_t r = first; r < mat.m_rows; r++) {
+			auto idx = m_begin + m_size;
+			if (idx >= capacity) idx -= capacity;
+			std::copy(mat.m_data + r * mat.m_stride, mat.m_data + r * mat.m_stride + mat.m_cols, m_rows.m_data + idx * m_rows.m_stride);
+			if (m_size < capacity)
+				m_size++;
+			else if (++m_begin == capacity)
+				m_begin = 0;
+		}
+	}
+
 	std::ostream& operator<<(std::ostream& os, const ChunkInfo& e) {
 		os << "{.m_feat_dim=" << e.m_feat_dim
 		   << ", .m_num_chunks=" << e.m_num_chunks
@@ -96,6 +125,10 @@ namespace snowboy {
 			return std::unique_ptr<Component>(new PosteriorMapComponent());
 		if (type == "SpliceComponent")
 			return std::unique_ptr<Component>(new SpliceComponent());
+		if (type == "SparseAffineComponent")
+			return std::unique_ptr<Component>(new SparseAffineComponent());
+		if (type == "FactorizedAffineComponent")
+			return std::unique_ptr<Component>(new FactorizedAffineComponent());
 		return nullptr;
 	}
 
@@ -113,6 +146,20 @@ namespace snowboy {
 		return ptr;
 	}
 
+	// Bitwise comparison, parameters read from identical model data compare equal
+	static bool SameValues(const MatrixBase& a, const MatrixBase& b) noexcept {
+		if (a.m_rows != b.m_rows || a.m_cols != b.m_cols) return false;
+		if (a.m_cols == 0) return true;
+		for (size_t r = 0; r < a.m_rows; r++) {
+			if (memcmp(a.m_data + r * a.m_stride, b.m_data + r * b.m_stride, a.m_cols * sizeof(float)) != 0) return false;
+		}
+		return true;
+	}
+
+	static bool SameValues(const VectorBase& a, const VectorBase& b) noexcept {
+		return a.size() == b.size() && (a.size() == 0 || memcmp(a.begin(), b.begin(), a.size() * sizeof(float)) == 0);
+	}
+
 	std::string AffineComponent::Type() const {
 		return "AffineComponent";
 	}
@@ -130,7 +177,7 @@ namespace snowboy {
 									Matrix&& in,
 									Matrix* out) const {
 		in_info.CheckSize(in);
-		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols());
+		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols(), MatrixResizeType::kUndefined);
 		out_info.CheckSize(*out);
 		out->CopyRowsFromVec(m_bias_params);
 		out->AddMatMat(1.0, in, MatrixTransposeType::kNoTrans, m_linear_params, MatrixTransposeType::kTrans, 1.0);
@@ -166,6 +213,11 @@ namespace snowboy {
 		return res;
 	}
 
+	bool AffineComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const AffineComponent*>(&other);
+		return o != nullptr && SameValues(m_linear_params, o->m_linear_params) && SameValues(m_bias_params, o->m_bias_params);
+	}
+
 	std::string CmvnComponent::Type() const {
 		return "CmvnComponent";
 	}
@@ -219,6 +271,109 @@ namespace snowboy {
 		return res;
 	}
 
+	bool CmvnComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const CmvnComponent*>(&other);
+		return o != nullptr && SameValues(m_scales, o->m_scales) && SameValues(m_offsets, o->m_offsets);
+	}
+
+	FactorizedAffineComponent::FactorizedAffineComponent(const AffineComponent& dense, size_t rank) {
+		auto& linear = dense.LinearParams();
+		rank = std::min(rank, std::min(linear.m_rows, linear.m_cols));
+		if (rank == 0) throw snowboy_exception{"FactorizedAffineComponent: rank needs to be at least 1"};
+		// The leading eigenvectors of the smaller gram matrix are the leading singular vectors of the weights
+		Matrix gram, eigenvectors;
+		Vector eigenvalues;
+		if (linear.m_rows <= linear.m_cols) {
+			// W ~= U * (U^T * W)
+			gram.Resize(linear.m_rows, linear.m_rows);
+			gram.AddMatMat(1.0, linear, MatrixTransposeType::kNoTrans, linear, MatrixTransposeType::kTrans, 0.0);
+			SymmetricEigen(gram, &eigenvalues, &eigenvectors);
+			auto u = eigenvectors.RowRange(0, rank);
+			m_input_projection.Resize(rank, linear.m_cols);
+			m_input_projection.AddMatMat(1.0, u, MatrixTransposeType::kNoTrans, linear, MatrixTransposeType::kNoTrans, 0.0);
+			m_output_projection.Resize(linear.m_rows, rank);
+			m_output_projection.CopyFromMat(u, MatrixTransposeType::kTrans);
+		} else {
+			// W ~= (W * V) * V^T
+			gram.Resize(linear.m_cols, linear.m_cols);
+			gram.AddMatMat(1.0, linear, MatrixTransposeType::kTrans, linear, MatrixTransposeType::kNoTrans, 0.0);
+			SymmetricEigen(gram, &eigenvalues, &eigenvectors);
+			auto v = eigenvectors.RowRange(0, rank);
+			m_input_projection = v;
+			m_output_projection.Resize(linear.m_rows, rank);
+			m_output_projection.AddMatMat(1.0, linear, MatrixTransposeType::kNoTrans, v, MatrixTransposeType::kTrans, 0.0);
+		}
+		m_bias_params = dense.BiasParams();
+	}
+
+	std::string FactorizedAffineComponent::Type() const {
+		return "FactorizedAffineComponent";
+	}
+
+	int32_t FactorizedAffineComponent::InputDim() const {
+		return m_input_projection.m_cols;
+	}
+
+	int32_t FactorizedAffineComponent::OutputDim() const {
+		return m_output_projection.m_rows;
+	}
+
+	void FactorizedAffineComponent::Propagate(const ChunkInfo& in_info,
+											  const ChunkInfo& out_info,
+											  Matrix&& in,
+											  Matrix* out) const {
+		in_info.CheckSize(in);
+		// Kept per thread because components are shared between networks
+		static thread_local Matrix projected;
+		projected.Resize(in.m_rows, Rank(), MatrixResizeType::kUndefined);
+		projected.AddMatMat(1.0, in, MatrixTransposeType::kNoTrans, m_input_projection, MatrixTransposeType::kTrans, 0.0);
+		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols(), MatrixResizeType::kUndefined);
+		out_info.CheckSize(*out);
+		out->CopyRowsFromVec(m_bias_params);
+		out->AddMatMat(1.0, projected, MatrixTransposeType::kNoTrans, m_output_projection, MatrixTransposeType::kTrans, 1.0);
+	}
+
+	void FactorizedAffineComponent::Read(bool binary, std::istream* is) {
+		auto beg_token = "<" + Type() + ">";
+		auto end_token = "</" + Type() + ">";
+		ExpectOneOrTwoTokens(binary, beg_token, "<InputProjection>", is);
+		m_input_projection.Read(binary, is);
+		ExpectToken(binary, "<OutputProjection>", is);
+		m_output_projection.Read(binary, is);
+		ExpectToken(binary, "<BiasParams>", is);
+		m_bias_params.Read(binary, is);
+		ExpectToken(binary, end_token, is);
+		if (m_input_projection.m_rows != m_output_projection.m_cols || m_output_projection.m_rows != m_bias_params.size())
+			throw snowboy_exception{"FactorizedAffineComponent: inconsistent sizes"};
+	}
+
+	void FactorizedAffineComponent::Write(bool binary, std::ostream* os) const {
+		auto beg_token = "<" + Type() + ">";
+		auto end_token = "</" + Type() + ">";
+		WriteToken(binary, beg_token, os);
+		WriteToken(binary, "<InputProjection>", os);
+		m_input_projection.Write(binary, os);
+		WriteToken(binary, "<OutputProjection>", os);
+		m_output_projection.Write(binary, os);
+		WriteToken(binary, "<BiasParams>", os);
+		m_bias_params.Write(binary, os);
+		WriteToken(binary, end_token, os);
+	}
+
+	Component* FactorizedAffineComponent::Copy() const {
+		auto res = new FactorizedAffineComponent();
+		res->m_input_projection = m_input_projection;
+		res->m_output_projection = m_output_projection;
+		res->m_bias_params = m_bias_params;
+		return res;
+	}
+
+	bool FactorizedAffineComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const FactorizedAffineComponent*>(&other);
+		return o != nullptr && SameValues(m_input_projection, o->m_input_projection) && SameValues(m_output_projection, o->m_output_projection)
+			   && SameValues(m_bias_params, o->m_bias_params);
+	}
+
 	std::string NormalizeComponent::Type() const {
 		return "NormalizeComponent";
 	}
@@ -237,15 +392,14 @@ namespace snowboy {
 									   Matrix* out) const {
 		in_info.CheckSize(in);
 
-		Vector vec;
-		vec.Resize(in.m_rows);
-		vec.AddDiagMat2(1.0 / in.m_cols, in, MatrixTransposeType::kNoTrans, 0.0);
-		vec.ApplyFloor(field_x14);
-		vec.ApplyPow(-0.5);
-
 		*out = std::move(in);
 		out_info.CheckSize(*out);
-		out->MulRowsVec(vec);
+		// Scale every row to unit root mean square in place
+		const float inv_cols = 1.0 / out->m_cols;
+		for (size_t r = 0; r < out->m_rows; r++) {
+			SubVector row{*out, r};
+			row.Scale(1.0f / std::sqrt(std::max(field_x14, row.DotVec(row) * inv_cols)));
+		}
 	}
 
 	void NormalizeComponent::Read(bool binary, std::istream* is) {
@@ -274,6 +428,11 @@ namespace snowboy {
 		return res;
 	}
 
+	bool NormalizeComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const NormalizeComponent*>(&other);
+		return o != nullptr && m_dim == o->m_dim;
+	}
+
 	std::string PosteriorMapComponent::Type() const {
 		return "PosteriorMapComponent";
 	}
@@ -291,30 +450,52 @@ namespace snowboy {
 										  Matrix&& in,
 										  Matrix* out) const {
 		in_info.CheckSize(in);
-		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols());
+		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols(), MatrixResizeType::kUndefined);
 		out_info.CheckSize(*out);
 
-		for (size_t r = 0; r < in.m_rows; r++)
-		{
-			if (out->m_cols < 2)
-			{
-				out->m_data[out->m_stride * r] = 1.0;
-			} else {
-				// TODO: I did my best but between here
-				auto ptr = out->m_data + (out->m_stride * r);
-				float sum = 0.0f;
-				for (auto& idx_vec : m_indices) {
-					ptr++;
-					for (auto idx : idx_vec) {
-						auto v = in.m_data[in.m_stride * r + idx];
-						*ptr += v;
-						sum += v;
-					}
+		const size_t groups = m_group_offsets.empty() ? 0 : m_group_offsets.size() - 1;
+		if (out->m_cols < 2 || groups == 0) {
+			for (size_t r = 0; r < out->m_rows; r++)
+				(*out)(r, 0) = 1.0f;
+			return;
+		}
+		// Column 0 is the remaining probability which is not mapped to any group
+		SubMatrix mapped{*out, 0, out->m_rows, 1, groups};
+		if (m_map.m_rows != 0) {
+			mapped.AddMatMat(1.0, in, MatrixTransposeType::kNoTrans, m_map, MatrixTransposeType::kTrans, 0.0);
+		} else {
+			for (size_t r = 0; r < in.m_rows; r++) {
+				auto row = in.m_data + r * in.m_stride;
+				auto dst = mapped.m_data + r * mapped.m_stride;
+				for (size_t g = 0; g < groups; g++) {
+					float sum = 0.0f;
+					for (auto i = m_group_offsets[g]; i < m_group_offsets[g + 1]; i++)
+						sum += row[m_indices[i]];
+					dst[g] = sum;
 				}
-				out->m_data[out->m_stride * r] = 1.0 - sum;
-				// TODO: and here are probably a number of bugs
 			}
 		}
+		for (size_t r = 0; r < out->m_rows; r++) {
+			auto dst = out->m_data + r * out->m_stride;
+			float sum = 0.0f;
+			for (size_t g = 1; g <= groups; g++)
+				sum += dst[g];
+			dst[0] = 1.0f - sum;
+		}
+	}
+
+	void PosteriorMapComponent::InitMap() {
+		const size_t groups = m_group_offsets.size() - 1;
+		// A GEMM over the full input is cheaper than gathering unless only a few inputs are mapped
+		if (groups == 0 || m_indices.size() * 8 < static_cast<size_t>(m_inputDim) * groups) {
+			m_map.Resize(0, 0);
+			return;
+		}
+		m_map.Resize(groups, m_inputDim);
+		for (size_t g = 0; g < groups; g++) {
+			for (auto i = m_group_offsets[g]; i < m_group_offsets[g + 1]; i++)
+				m_map(g, m_indices[i]) += 1.0f;
+		}
 	}
 
 	void PosteriorMapComponent::Read(bool binary, std::istream* is) {
@@ -325,10 +506,21 @@ namespace snowboy {
 		ExpectToken(binary, "<OutputDim>", is);
 		ReadBasicType<int32_t>(binary, &m_outputDim, is);
 		ExpectToken(binary, "<Indices>", is);
-		m_indices.resize(m_outputDim - 1);
-		for (auto& e : m_indices)
-			ReadIntegerVector<int32_t>(binary, &e, is);
+		// Flatten the index lists so Propagate walks a single array
+		m_indices.clear();
+		m_group_offsets.assign(1, 0);
+		std::vector<int32_t> group;
+		for (int32_t g = 1; g < m_outputDim; g++) {
+			ReadIntegerVector<int32_t>(binary, &group, is);
+			for (auto idx : group) {
+				if (idx < 0 || idx >= m_inputDim)
+					throw snowboy_exception{"PosteriorMapComponent: index " + std::to_string(idx) + " out of range"};
+			}
+			m_indices.insert(m_indices.end(), group.begin(), group.end());
+			m_group_offsets.push_back(m_indices.size());
+		}
 		ExpectToken(binary, end_token, is);
+		InitMap();
 		field_xc = 1;
 	}
 
@@ -341,8 +533,10 @@ namespace snowboy {
 		WriteToken(binary, "<OutputDim>", os);
 		WriteBasicType<int32_t>(binary, m_outputDim, os);
 		WriteToken(binary, "<Indices>", os);
-		for (auto& e : m_indices)
-			WriteIntegerVector(binary, e, os);
+		for (size_t g = 0; g + 1 < m_group_offsets.size(); g++) {
+			std::vector<int32_t> group{m_indices.begin() + m_group_offsets[g], m_indices.begin() + m_group_offsets[g + 1]};
+			WriteIntegerVector(binary, group, os);
+		}
 		WriteToken(binary, end_token, os);
 	}
 
@@ -352,9 +546,16 @@ namespace snowboy {
 		res->m_inputDim = m_inputDim;
 		res->m_outputDim = m_outputDim;
 		res->m_indices = m_indices;
+		res->m_group_offsets = m_group_offsets;
+		res->m_map = m_map;
 		return res;
 	}
 
+	bool PosteriorMapComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const PosteriorMapComponent*>(&other);
+		return o != nullptr && m_inputDim == o->m_inputDim && m_outputDim == o->m_outputDim && m_indices == o->m_indices && m_group_offsets == o->m_group_offsets;
+	}
+
 	std::string RectifiedLinearComponent::Type() const {
 		return "RectifiedLinearComponent";
 	}
@@ -402,6 +603,11 @@ namespace snowboy {
 		return res;
 	}
 
+	bool RectifiedLinearComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const RectifiedLinearComponent*>(&other);
+		return o != nullptr && m_dim == o->m_dim;
+	}
+
 	std::string SoftmaxComponent::Type() const {
 		return "SoftmaxComponent";
 	}
@@ -422,11 +628,7 @@ namespace snowboy {
 
 		*out = std::move(in);
 		out_info.CheckSize(*out);
-		for (size_t i = 0; i < out->rows(); i++)
-		{
-			SubVector vec{*out, i};
-			vec.ApplySoftmax();
-		}
+		out->ApplySoftmaxPerRow();
 		// This floor on the output helps us deal with
 		// almost-zeros in a way that doesn't lead to overflow.
 		out->ApplyFloor(1.0e-20);
@@ -457,6 +659,215 @@ namespace snowboy {
 		return res;
 	}
 
+	bool SoftmaxComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const SoftmaxComponent*>(&other);
+		return o != nullptr && m_dim == o->m_dim;
+	}
+
+	// Frames processed together by the sparse kernel, the input is transposed into blocks of this many frames
+	constexpr size_t sparse_block_frames = 8;
+
+	// out[j] = bias + sum values[k] * block[cols[k]][j] for the frames j of one transposed input block
+	static inline void SparseRowBlock(const float* values, const int32_t* cols, size_t nnz, const float* block, float bias, float* out) noexcept {
+#if defined(__AVX__)
+		auto acc = _mm256_set1_ps(bias);
+		for (size_t k = 0; k < nnz; k++) {
+			auto in = _mm256_loadu_ps(block + cols[k] * sparse_block_frames);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(values[k]), in));
+		}
+		_mm256_storeu_ps(out, acc);
+#elif defined(__SSE2__)
+		auto acc0 = _mm_set1_ps(bias);
+		auto acc1 = acc0;
+		for (size_t k = 0; k < nnz; k++) {
+			auto ptr = block + cols[k] * sparse_block_frames;
+			auto v = _mm_set1_ps(values[k]);
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(v, _mm_load_ps(ptr)));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(v, _mm_load_ps(ptr + 4)));
+		}
+		_mm_storeu_ps(out, acc0);
+		_mm_storeu_ps(out + 4, acc1);
+#else
+		for (size_t j = 0; j < sparse_block_frames; j++)
+			out[j] = bias;
+		for (size_t k = 0; k < nnz; k++) {
+			auto ptr = block + cols[k] * sparse_block_frames;
+			for (size_t j = 0; j < sparse_block_frames; j++)
+				out[j] += values[k] * ptr[j];
+		}
+#endif
+	}
+
+	// Sum of values[k] * row[cols[k]] for a single frame, split over independent sums to hide the load latency
+	static inline float SparseRowDot(const float* values, const int32_t* cols, size_t nnz, const float* row) noexcept {
+		float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+		size_t k = 0;
+		for (; k + 4 <= nnz; k += 4) {
+			sum0 += values[k] * row[cols[k]];
+			sum1 += values[k + 1] * row[cols[k + 1]];
+			sum2 += values[k + 2] * row[cols[k + 2]];
+			sum3 += values[k + 3] * row[cols[k + 3]];
+		}
+		for (; k < nnz; k++)
+			sum0 += values[k] * row[cols[k]];
+		return (sum0 + sum1) + (sum2 + sum3);
+	}
+
+	SparseAffineComponent::SparseAffineComponent(const AffineComponent& dense, float threshold) {
+		auto& linear = dense.LinearParams();
+		m_input_dim = linear.m_cols;
+		m_row_offsets.reserve(linear.m_rows + 1);
+		m_row_offsets.push_back(0);
+		std::vector<float> values;
+		for (size_t r = 0; r < linear.m_rows; r++) {
+			for (size_t c = 0; c < linear.m_cols; c++) {
+				if (std::abs(linear(r, c)) <= threshold) continue;
+				values.push_back(linear(r, c));
+				m_col_indices.push_back(c);
+			}
+			m_row_offsets.push_back(values.size());
+		}
+		m_values.Resize(values.size(), MatrixResizeType::kUndefined);
+		std::copy(values.begin(), values.end(), m_values.begin());
+		m_bias_params = dense.BiasParams();
+	}
+
+	std::string SparseAffineComponent::Type() const {
+		return "SparseAffineComponent";
+	}
+
+	int32_t SparseAffineComponent::InputDim() const {
+		return m_input_dim;
+	}
+
+	int32_t SparseAffineComponent::OutputDim() const {
+		return m_bias_params.size();
+	}
+
+	void SparseAffineComponent::Propagate(const ChunkInfo& in_info,
+										  const ChunkInfo& out_info,
+										  Matrix&& in,
+										  Matrix* out) const {
+		in_info.CheckSize(in);
+		out->Resize(out_info.NumChunks() * out_info.ChunkSize(), out_info.NumCols(), MatrixResizeType::kUndefined);
+		out_info.CheckSize(*out);
+
+		// Transposing does not pay off for a few frames, gather the inputs of every weight instead
+		if (in.m_rows < sparse_block_frames / 2) {
+			for (size_t f = 0; f < in.m_rows; f++) {
+				auto row = in.m_data + f * in.m_stride;
+				for (size_t r = 0; r < m_bias_params.size(); r++) {
+					auto begin = m_row_offsets[r];
+					(*out)(f, r) = m_bias_params[r] + SparseRowDot(m_values.data() + begin, m_col_indices.data() + begin, m_row_offsets[r + 1] - begin, row);
+				}
+			}
+			return;
+		}
+
+		// Transposed input, one row per input dimension and block of frames. Kept per thread because
+		// components are shared between networks.
+		static thread_local Matrix blocks;
+		const size_t num_blocks = (in.m_rows + sparse_block_frames - 1) / sparse_block_frames;
+		blocks.Resize(num_blocks * m_input_dim, sparse_block_frames, MatrixResizeType::kUndefined);
+		for (size_t b = 0; b < num_blocks; b++) {
+			auto block = blocks.m_data + b * m_input_dim * sparse_block_frames;
+			for (size_t j = 0; j < sparse_block_frames; j++) {
+				auto r = b * sparse_block_frames + j;
+				if (r < in.m_rows) {
+					auto row = in.m_data + r * in.m_stride;
+					for (int32_t c = 0; c < m_input_dim; c++)
+						block[c * sparse_block_frames + j] = row[c];
+				} else {
+					for (int32_t c = 0; c < m_input_dim; c++)
+						block[c * sparse_block_frames + j] = 0.0f;
+				}
+			}
+		}
+
+		// Every block of frames is run through all rows while it is hot in the cache
+		float res[sparse_block_frames];
+		for (size_t b = 0; b < num_blocks; b++) {
+			auto block = blocks.m_data + b * m_input_dim * sparse_block_frames;
+			auto frames = std::min(sparse_block_frames, in.m_rows - b * sparse_block_frames);
+			for (size_t r = 0; r < m_bias_params.size(); r++) {
+				auto begin = m_row_offsets[r];
+				SparseRowBlock(m_values.data() + begin, m_col_indices.data() + begin, m_row_offsets[r + 1] - begin, block, m_bias_params[r], res);
+				for (size_t j = 0; j < frames; j++)
+					(*out)(b * sparse_block_frames + j, r) = res[j];
+			}
+		}
+	}
+
+	void SparseAffineComponent::Check() const {
+		if (m_row_offsets.size() != m_bias_params.size() + 1 || m_row_offsets.front() != 0
+			|| static_cast<size_t>(m_row_offsets.back()) != m_values.size() || m_col_indices.size() != m_values.size())
+			throw snowboy_exception{"SparseAffineComponent: inconsistent sizes"};
+		for (size_t r = 1; r < m_row_offsets.size(); r++) {
+			if (m_row_offsets[r] < m_row_offsets[r - 1])
+				throw snowboy_exception{"SparseAffineComponent: row offsets are not sorted"};
+		}
+		for (auto c : m_col_indices) {
+			if (c < 0 || c >= m_input_dim)
+				throw snowboy_exception{"SparseAffineComponent: column index " + std::to_string(c) + " out of range"};
+		}
+	}
+
+	void SparseAffineComponent::Read(bool binary, std::istream* is) {
+		auto beg_token = "<" + Type() + ">";
+		auto end_token = "</" + Type() + ">";
+		ExpectOneOrTwoTokens(binary, beg_token, "<InputDim>", is);
+		ReadBasicType<int32_t>(binary, &m_input_dim, is);
+		ExpectToken(binary, "<RowOffsets>", is);
+		ReadIntegerVector<int32_t>(binary, &m_row_offsets, is);
+		ExpectToken(binary, "<ColIndices>", is);
+		ReadIntegerVector<int32_t>(binary, &m_col_indices, is);
+		ExpectToken(binary, "<Values>", is);
+		m_values.Read(binary, is);
+		ExpectToken(binary, "<BiasParams>", is);
+		m_bias_params.Read(binary, is);
+		ExpectToken(binary, end_token, is);
+		Check();
+	}
+
+	void SparseAffineComponent::Write(bool binary, std::ostream* os) const {
+		auto beg_token = "<" + Type() + ">";
+		auto end_token = "</" + Type() + ">";
+		WriteToken(binary, beg_token, os);
+		WriteToken(binary, "<InputDim>", os);
+		WriteBasicType<int32_t>(binary, m_input_dim, os);
+		WriteToken(binary, "<RowOffsets>", os);
+		WriteIntegerVector<int32_t>(binary, m_row_offsets, os);
+		WriteToken(binary, "<ColIndices>", os);
+		WriteIntegerVector<int32_t>(binary, m_col_indices, os);
+		WriteToken(binary, "<Values>", os);
+		m_values.Write(binary, os);
+		WriteToken(binary, "<BiasParams>", os);
+		m_bias_params.Write(binary, os);
+		WriteToken(binary, end_token, os);
+	}
+
+	Component* SparseAffineComponent::Copy() const {
+		auto res = new SparseAffineComponent();
+		res->m_input_dim = m_input_dim;
+		res->m_row_offsets = m_row_offsets;
+		res->m_col_indices = m_col_indices;
+		res->m_values = m_values;
+		res->m_bias_params = m_bias_params;
+		return res;
+	}
+
+	bool SparseAffineComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const SparseAffineComponent*>(&other);
+		return o != nullptr && m_input_dim == o->m_input_dim && m_row_offsets == o->m_row_offsets && m_col_indices == o->m_col_indices
+			   && SameValues(m_values, o->m_values) && SameValues(m_bias_params, o->m_bias_params);
+	}
+
+	float SparseAffineComponent::Sparsity() const noexcept {
+		auto total = static_cast<size_t>(m_input_dim) * m_bias_params.size();
+		if (total == 0) return 0.0f;
+		return 1.0f - static_cast<float>(m_values.size()) / static_cast<float>(total);
+	}
+
 	std::string SpliceComponent::Type() const {
 		return "SpliceComponent";
 	}
@@ -554,6 +965,36 @@ namespace snowboy {
 		}
 	}
 
+	void SpliceComponent::PropagateStreaming(ContextRing* history, const MatrixBase& in, Matrix* out) const {
+		const size_t span = m_context.back() - m_context.front();
+		const size_t num_history = history->Size();
+		const size_t total = num_history + in.m_rows;
+		if (total <= span) {
+			out->Resize(0, 0);
+			history->Push(in);
+			return;
+		}
+		const size_t out_rows = total - span;
+		out->Resize(out_rows, OutputDim(), MatrixResizeType::kUndefined);
+		const size_t dim = m_inputDim - m_constComponentDim;
+		// Row i of the virtual matrix [history; in]
+		auto row = [&](size_t i) -> const float* {
+			return i < num_history ? history->Row(i) : in.m_data + (i - num_history) * in.m_stride;
+		};
+		for (size_t r = 0; r < out_rows; r++) {
+			auto dst = out->m_data + r * out->m_stride;
+			for (size_t c = 0; c < m_context.size(); c++) {
+				auto src = row(r + m_context[c] - m_context.front());
+				std::copy(src, src + dim, dst + c * dim);
+			}
+			if (m_constComponentDim != 0) {
+				auto src = row(r) + dim;
+				std::copy(src, src + m_constComponentDim, dst + m_context.size() * dim);
+			}
+		}
+		history->Push(in);
+	}
+
 	void SpliceComponent::Read(bool binary, std::istream* is) {
 		auto beg_token = "<" + Type() + ">";
 		auto end_token = "</" + Type() + ">";
@@ -589,4 +1030,9 @@ namespace snowboy {
 		return res;
 	}
 
+	bool SpliceComponent::Equals(const Component& other) const {
+		auto o = dynamic_cast<const SpliceComponent*>(&other);
+		return o != nullptr && m_inputDim == o->m_inputDim && m_constComponentDim == o->m_constComponentDim && m_context == o->m_context;
+	}
+
 } // namespace snowboy
@@ -57,6 +57,30 @@ namespace snowboy {
 	};
 	std::ostream& operator<<(std::ostream& os, const ChunkInfo& e);
 
+	// Keeps the last input rows a component needs as context for the next rows in streaming mode
+	class ContextRing {
+		Matrix m_rows;
+		size_t m_begin = 0;
+		size_t m_size = 0;
+
+	public:
+		void Init(size_t capacity, size_t cols);
+		void Clear() noexcept {
+			m_begin = 0;
+			m_size = 0;
+		}
+		size_t Size() const noexcept { return m_size; }
+		size_t Capacity() const noexcept { return m_rows.m_rows; }
+		// Row i counted from the oldest row
+		const float* Row(size_t i) const noexcept {
+			auto idx = m_begin + i;
+			if (idx >= m_rows.m_rows) idx -= m_rows.m_rows;
+			return m_rows.m_data + idx * m_rows.m_stride;
+		}
+		// Pushes the last rows of mat, dropping the oldest rows if full
+		void Push(const MatrixBase& mat);
+	};
+
 	class Component {
 	public:
 		Component() : m_index(-1) {}
@@ -76,6 +100,8 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) = 0;
 		virtual void Write(bool binary, std::ostream* os) const = 0;
 		virtual Component* Copy() const = 0;
+		// True if other is of the same type and computes the same function, the index is ignored
+		virtual bool Equals(const Component& other) const = 0;
 		virtual ~Component() {}
 
 		static std::unique_ptr<Component> NewComponentOfType(const std::string& type);
@@ -106,7 +132,11 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~AffineComponent() {}
+
+		const Matrix& LinearParams() const noexcept { return m_linear_params; }
+		const Vector& BiasParams() const noexcept { return m_bias_params; }
 	};
 
 	class CmvnComponent : public Component {
@@ -126,9 +156,45 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~CmvnComponent() {}
 	};
 
+	/**
+	 * \brief AffineComponent with the linear parameters approximated by a product of two thin matrices.
+	 *
+	 * The input is projected to rank dimensions and back, sharing the bias of the original layer.
+	 * Cheaper than the dense layer if rank * (InputDim() + OutputDim()) < InputDim() * OutputDim().
+	 */
+	class FactorizedAffineComponent : public Component {
+		// rank x InputDim()
+		Matrix m_input_projection;
+		// OutputDim() x rank
+		Matrix m_output_projection;
+		Vector m_bias_params;
+
+	public:
+		FactorizedAffineComponent() {}
+		// Best rank approximation of a dense component in the least squares sense
+		FactorizedAffineComponent(const AffineComponent& dense, size_t rank);
+
+		virtual std::string Type() const override;
+		virtual int32_t InputDim() const override;
+		virtual int32_t OutputDim() const override;
+		virtual void Propagate(const ChunkInfo& in_info,
+							   const ChunkInfo& out_info,
+							   Matrix&& in,
+							   Matrix* out) const override;
+
+		virtual void Read(bool binary, std::istream* is) override;
+		virtual void Write(bool binary, std::ostream* os) const override;
+		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
+		virtual ~FactorizedAffineComponent() {}
+
+		size_t Rank() const noexcept { return m_input_projection.rows(); }
+	};
+
 	class NormalizeComponent : public Component {
 		int32_t m_dim = 0;
 		bool field_x10 = 0;
@@ -146,6 +212,7 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~NormalizeComponent() {}
 	};
 
@@ -153,7 +220,13 @@ namespace snowboy {
 		bool field_xc;
 		int32_t m_inputDim;
 		int32_t m_outputDim;
-		std::vector<std::vector<int>> m_indices;
+		// Input indices summed into output column g + 1 are [m_group_offsets[g], m_group_offsets[g + 1]) of m_indices
+		std::vector<int32_t> m_indices;
+		std::vector<int32_t> m_group_offsets;
+		// 0/1 matrix with one row per group, used instead of the gather if most inputs belong to some group
+		Matrix m_map;
+
+		void InitMap();
 
 	public:
 		virtual std::string Type() const override;
@@ -167,6 +240,7 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~PosteriorMapComponent() {}
 	};
 
@@ -186,6 +260,7 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~RectifiedLinearComponent() {}
 	};
 
@@ -205,9 +280,49 @@ namespace snowboy {
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~SoftmaxComponent() {}
 	};
 
+	/**
+	 * \brief AffineComponent with the linear parameters stored in compressed sparse row format.
+	 *
+	 * Used for pruned models, the work and memory needed is proportional to the number of non zero weights.
+	 */
+	class SparseAffineComponent : public Component {
+		int32_t m_input_dim = 0;
+		// Row r of the linear parameters is stored in [m_row_offsets[r], m_row_offsets[r + 1])
+		std::vector<int32_t> m_row_offsets;
+		std::vector<int32_t> m_col_indices;
+		Vector m_values;
+		Vector m_bias_params;
+
+		void Check() const;
+
+	public:
+		SparseAffineComponent() {}
+		// Converts a dense component, dropping every weight with an absolute value not above threshold
+		SparseAffineComponent(const AffineComponent& dense, float threshold);
+
+		virtual std::string Type() const override;
+		virtual int32_t InputDim() const override;
+		virtual int32_t OutputDim() const override;
+		virtual void Propagate(const ChunkInfo& in_info,
+							   const ChunkInfo& out_info,
+							   Matrix&& in,
+							   Matrix* out) const override;
+
+		virtual void Read(bool binary, std::istream* is) override;
+		virtual void Write(bool binary, std::ostream* os) const override;
+		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
+		virtual ~SparseAffineComponent() {}
+
+		size_t NumNonZeros() const noexcept { return m_values.size(); }
+		// Fraction of linear parameters which are zero
+		float Sparsity() const noexcept;
+	};
+
 	class SpliceComponent : public Component {
 		bool field_xc;
 		int m_inputDim;
@@ -224,10 +339,19 @@ namespace snowboy {
 							   const ChunkInfo& out_info,
 							   Matrix&& in,
 							   Matrix* out) const override;
+		/**
+		 * \brief Splice the rows of in, using the rows in history as left context.
+		 *
+		 * Every input row is spliced exactly once, the output has one row for every input row
+		 * once history holds Context().back() - Context().front() rows. The last input rows
+		 * are pushed to history afterwards.
+		 */
+		void PropagateStreaming(ContextRing* history, const MatrixBase& in, Matrix* out) const;
 
 		virtual void Read(bool binary, std::istream* is) override;
 		virtual void Write(bool binary, std::ostream* os) const override;
 		virtual Component* Copy() const override;
+		virtual bool Equals(const Component& other) const override;
 		virtual ~SpliceComponent() {}
 	};
 } // namespace snowboy
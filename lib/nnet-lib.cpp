@@ -1,20 +1,30 @@
+#include <algorithm>
 #include <cassert>
 #include <frame-info.h>
+#include <model-registry.h>
 #include <nnet-component.h>
 #include <nnet-lib.h>
 #include <set>
+#include <snowboy-error.h>
 #include <snowboy-io.h>
+#include <trace-recorder.h>
 
 namespace snowboy {
+	// Number of ChunkInfo plans kept for the chunked computation, evicted least recently used first
+	constexpr size_t chunk_plan_capacity = 8;
+
 	Nnet::Nnet() {
 		m_pad_input = 1;
 		m_is_first_chunk = 1;
 		field_xa = 0;
 		field_xb = 0;
 		field_xc = 0;
+		m_streaming = true;
 		m_left_context = 0;
 		m_right_context = 0;
-		field_x18 = 0;
+		m_pad_left = -1;
+		m_pad_right = -1;
+		m_max_chunk_size = 0;
 	}
 
 	Nnet::Nnet(bool pad_context) {
@@ -23,9 +33,12 @@ namespace snowboy {
 		field_xa = 0;
 		field_xb = 0;
 		field_xc = 0;
+		m_streaming = true;
 		m_left_context = 0;
 		m_right_context = 0;
-		field_x18 = 0;
+		m_pad_left = -1;
+		m_pad_right = -1;
+		m_max_chunk_size = 0;
 	}
 
 	Nnet::Nnet(const Nnet& other) {
@@ -34,19 +47,33 @@ namespace snowboy {
 		field_xa = other.field_xa;
 		field_xb = other.field_xb;
 		field_xc = other.field_xc;
+		m_streaming = other.m_streaming;
 		m_left_context = other.m_left_context;
 		m_right_context = other.m_right_context;
-		field_x18 = 0;
+		m_pad_left = other.m_pad_left;
+		m_pad_right = other.m_pad_right;
 		field_x20 = other.field_x20;
-		m_chunkinfo = other.m_chunkinfo;
+		m_chunk_plans = other.m_chunk_plans;
+		m_max_chunk_size = other.m_max_chunk_size;
 		m_reusable_component_inputs = other.m_reusable_component_inputs;
+		m_context_rings = other.m_context_rings;
 		field_b8 = other.field_b8;
 		m_unprocessed_buffer = other.m_unprocessed_buffer;
 		m_input_data = other.m_input_data;
 		m_output_data = other.m_output_data;
-		m_components.resize(other.m_components.size());
-		for (size_t i = 0; i < m_components.size(); i++)
-			m_components[i].reset(other.m_components[i]->Copy());
+		// Components are never modified after reading, so copies share them
+		m_components = other.m_components;
+		m_component_contexts = other.m_component_contexts;
+		PlanActivations();
+	}
+
+	std::shared_ptr<const Nnet> Nnet::Load(const std::string& filename, bool pad_context) {
+		return ModelRegistry::Instance().Get<Nnet>(filename, pad_context ? "pad" : "", [&]() {
+			auto res = std::make_shared<Nnet>(pad_context);
+			Input in{filename};
+			res->Read(in.is_binary(), in.Stream());
+			return std::shared_ptr<const Nnet>{std::move(res)};
+		});
 	}
 
 	Nnet::~Nnet() {
@@ -54,11 +81,37 @@ namespace snowboy {
 	}
 
 	void Nnet::Compute(const MatrixBase& input, const std::vector<FrameInfo>& b, Matrix* output, std::vector<FrameInfo>* d) {
+		SNOWBOY_TRACE_SCOPE("Nnet::Compute");
 		if (input.m_rows == 0) {
 			output->Resize(0, 0);
 			d->clear();
 			return;
 		}
+		// Both activation buffers grow together, otherwise swapping them between components reallocates again later
+		if (input.m_rows > m_max_chunk_size) SetMaxChunkSize(input.m_rows);
+		if (m_streaming)
+			ComputeStreaming(input, output);
+		else
+			ComputeChunked(input, output);
+		for (auto& frame : b) {
+			field_x20.push_back(frame);
+		}
+		if (field_xc == 0 && m_pad_input == 0 && input.m_rows > 0) {
+			for (int i = 0; i < m_left_context && !field_x20.empty(); i++) {
+				field_x20.pop_front();
+			}
+			field_xc = 1;
+		}
+		d->resize(output->m_rows);
+		for (auto& e : *d) {
+			// Networks fed by a shared prefix do not get frame infos
+			if (field_x20.empty()) break;
+			e = field_x20.front();
+			field_x20.pop_front();
+		}
+	}
+
+	void Nnet::ComputeChunked(const MatrixBase& input, Matrix* output) {
 		if (m_is_first_chunk == 0) {
 			m_input_data.Resize(input.m_rows + m_unprocessed_buffer.m_rows, input.m_cols);
 			if (m_unprocessed_buffer.m_rows > 0) {
@@ -69,10 +122,11 @@ namespace snowboy {
 		} else {
 			m_is_first_chunk = 0;
 			if (m_pad_input) {
-				if (m_left_context > 0) {
-					m_input_data.Resize(input.m_rows + m_left_context, input.m_cols);
-					m_input_data.RowRange(0, m_left_context).CopyRowsFromVec(SubVector{input, 0});
-					m_input_data.RowRange(m_left_context, input.m_rows).CopyFromMat(input, MatrixTransposeType::kNoTrans);
+				auto pad_left = m_pad_left < 0 ? m_left_context : m_pad_left;
+				if (pad_left > 0) {
+					m_input_data.Resize(input.m_rows + pad_left, input.m_cols);
+					m_input_data.RowRange(0, pad_left).CopyRowsFromVec(SubVector{input, 0});
+					m_input_data.RowRange(pad_left, input.m_rows).CopyFromMat(input, MatrixTransposeType::kNoTrans);
 				} else {
 					m_input_data.Resize(input.m_rows, input.m_cols);
 					m_input_data.CopyFromMat(input, MatrixTransposeType::kNoTrans);
@@ -84,10 +138,7 @@ namespace snowboy {
 		}
 		auto num_effective_input_rows = field_xa ? (m_input_data.m_rows + LeftContext() + RightContext()) : m_input_data.m_rows;
 		if (num_effective_input_rows > m_left_context + m_right_context) {
-			if (field_x18 != num_effective_input_rows) {
-				ComputeChunkInfo(num_effective_input_rows, 1);
-				field_x18 = num_effective_input_rows;
-			}
+			ComputeChunkInfo(num_effective_input_rows, 1);
 			field_b8 = SubVector{m_input_data, m_input_data.rows() - 1};
 			Propagate();
 			*output = m_output_data;
@@ -98,26 +149,43 @@ namespace snowboy {
 			m_input_data.Resize(0, 0);
 			output->Resize(0, 0);
 		}
-		for (auto& frame : b) {
-			field_x20.push_back(frame);
-		}
-		if (field_xc == 0 && m_pad_input == 0 && input.m_rows > 0) {
-			for (int i = 0; i < m_left_context; i++) {
-				field_x20.pop_front();
-			}
-			field_xc = 1;
+	}
+
+	void Nnet::ComputeStreaming(const MatrixBase& input, Matrix* output) {
+		auto pad_left = 0;
+		if (m_is_first_chunk) {
+			m_is_first_chunk = 0;
+			if (m_pad_input) pad_left = m_pad_left < 0 ? m_left_context : m_pad_left;
 		}
-		d->resize(output->m_rows);
-		for (auto& e : *d) {
-			e = field_x20.front();
-			field_x20.pop_front();
+		if (pad_left > 0) {
+			m_input_data.Resize(input.m_rows + pad_left, input.m_cols, MatrixResizeType::kUndefined);
+			m_input_data.RowRange(0, pad_left).CopyRowsFromVec(SubVector{input, 0});
+			m_input_data.RowRange(pad_left, input.m_rows).CopyFromMat(input, MatrixTransposeType::kNoTrans);
+		} else {
+			m_input_data.Resize(input.m_rows, input.m_cols, MatrixResizeType::kUndefined);
+			m_input_data.CopyFromMat(input, MatrixTransposeType::kNoTrans);
 		}
+		field_b8 = SubVector{input, input.rows() - 1};
+		PropagateStreaming();
+		*output = m_output_data;
+		m_output_data.Resize(0, 0);
 	}
 
 	// Note: Adopted from kaldi
 	void Nnet::ComputeChunkInfo(int input_chunk_size, int num_chunks) {
+		for (size_t i = 0; i < m_chunk_plans.size(); i++) {
+			auto& plan = m_chunk_plans[i];
+			if (plan.input_rows != input_chunk_size || plan.num_chunks != num_chunks) continue;
+			if (i != 0) std::rotate(m_chunk_plans.begin(), m_chunk_plans.begin() + i, m_chunk_plans.begin() + i + 1);
+			return;
+		}
+
+		SNOWBOY_TRACE_SCOPE("Nnet::ComputeChunkInfo");
 		const size_t output_chunk_size = (input_chunk_size - m_left_context) - m_right_context;
 		SNOWBOY_ASSERT(output_chunk_size > 0);
+		if (m_chunk_plans.size() >= chunk_plan_capacity) m_chunk_plans.pop_back();
+		m_chunk_plans.insert(m_chunk_plans.begin(), ChunkPlan{input_chunk_size, num_chunks, std::vector<ChunkInfo>(m_components.size() + 1)});
+		auto& chunkinfo = m_chunk_plans.front().chunkinfo;
 		std::vector<size_t> current_output_inds;
 		current_output_inds.resize(output_chunk_size);
 		for (size_t i = 0; i < output_chunk_size; i++)
@@ -126,7 +194,7 @@ namespace snowboy {
 		// indexes for last component is empty, since the last component's chunk is
 		// always contiguous
 		// component's output is always contiguous
-		m_chunkinfo[m_components.size()] = ChunkInfo(
+		chunkinfo[m_components.size()] = ChunkInfo(
 			m_components[m_components.size() - 1]->OutputDim(),
 			num_chunks, current_output_inds.front(),
 			current_output_inds.back());
@@ -145,72 +213,81 @@ namespace snowboy {
 			// checking if the vector has contiguous data
 			// assign indexes only if the data is not contiguous
 			if (current_output_inds.size() != current_output_inds.back() - current_output_inds.front() + 1) {
-				m_chunkinfo[i] = ChunkInfo(m_components[i]->InputDim(),
-										   num_chunks,
-										   current_output_inds);
+				chunkinfo[i] = ChunkInfo(m_components[i]->InputDim(),
+										 num_chunks,
+										 current_output_inds);
 			} else {
-				m_chunkinfo[i] = ChunkInfo(m_components[i]->InputDim(),
-										   num_chunks,
-										   current_output_inds.front(),
-										   current_output_inds.back());
+				chunkinfo[i] = ChunkInfo(m_components[i]->InputDim(),
+										 num_chunks,
+										 current_output_inds.front(),
+										 current_output_inds.back());
 			}
 		}
 
 		for (size_t i = 0; i < m_components.size(); i++) {
-			m_chunkinfo[i].MakeOffsetsContiguous();
+			chunkinfo[i].MakeOffsetsContiguous();
 			if (m_components[i]->HasDataRearragement())
 				break;
 		}
 
 		// sanity testing for chunk_info_out vector
-		for (auto& e : m_chunkinfo) {
+		for (auto& e : chunkinfo) {
 			e.Check();
 		}
 	}
 
 	void Nnet::Destroy() {
 		m_components.clear();
+		m_component_contexts.clear();
+		m_left_context = 0;
+		m_right_context = 0;
 	}
 
 	void Nnet::FlushOutput(const MatrixBase& param_1, const std::vector<FrameInfo>& param_2, Matrix* param_3, std::vector<FrameInfo>* param_4) {
+		SNOWBOY_TRACE_SCOPE("Nnet::FlushOutput");
 		param_3->Resize(0, 0);
 		param_4->clear();
 		if (param_1.m_rows > 0)
 			Compute(param_1, param_2, param_3, param_4);
 
-		auto uVar10 = m_unprocessed_buffer.m_rows;
-		auto num_effective_input_rows_new = (field_xa ? LeftContext() + RightContext() : 0) + m_unprocessed_buffer.m_rows;
-
-		if (m_pad_input && field_b8.size() > 0) {
-			auto t = RightContext();
-			num_effective_input_rows_new += t;
-			uVar10 += t;
-		}
-
-		if (LeftContext() + RightContext() < num_effective_input_rows_new) {
-			m_input_data.Resize(uVar10, InputDim());
-			if (m_unprocessed_buffer.m_rows > 0) {
-				m_input_data.RowRange(0, m_unprocessed_buffer.m_rows).CopyFromMat(m_unprocessed_buffer, MatrixTransposeType::kNoTrans);
+		auto pad_right = m_pad_right < 0 ? m_right_context : m_pad_right;
+		if (m_streaming) {
+			// Everything but the right padding has already been propagated
+			if (m_pad_input && 0 < pad_right && field_b8.size() > 0) {
+				m_input_data.Resize(pad_right, InputDim(), MatrixResizeType::kUndefined);
+				m_input_data.CopyRowsFromVec(field_b8);
+				PropagateStreaming();
 			}
-			assert(m_right_context == RightContext());
-			if (m_pad_input && 0 < RightContext()) {
-				m_input_data.RowRange(m_unprocessed_buffer.m_rows, RightContext()).CopyRowsFromVec(field_b8);
+		} else {
+			auto uVar10 = m_unprocessed_buffer.m_rows;
+			auto num_effective_input_rows_new = (field_xa ? m_left_context + m_right_context : 0) + m_unprocessed_buffer.m_rows;
+
+			if (m_pad_input && field_b8.size() > 0) {
+				num_effective_input_rows_new += pad_right;
+				uVar10 += pad_right;
 			}
-			if (num_effective_input_rows_new != field_x18) {
+
+			if (static_cast<size_t>(m_left_context + m_right_context) < num_effective_input_rows_new) {
+				m_input_data.Resize(uVar10, InputDim());
+				if (m_unprocessed_buffer.m_rows > 0) {
+					m_input_data.RowRange(0, m_unprocessed_buffer.m_rows).CopyFromMat(m_unprocessed_buffer, MatrixTransposeType::kNoTrans);
+				}
+				if (m_pad_input && 0 < pad_right && field_b8.size() > 0) {
+					m_input_data.RowRange(m_unprocessed_buffer.m_rows, pad_right).CopyRowsFromVec(field_b8);
+				}
 				ComputeChunkInfo(num_effective_input_rows_new, 1);
-				field_x18 = num_effective_input_rows_new;
+				Propagate();
 			}
-			Propagate();
-			if (m_output_data.m_rows > 0) {
-				if (param_3->m_rows != 0) {
-					param_3->Resize(m_output_data.m_rows + param_3->m_rows, param_3->m_cols, MatrixResizeType::kCopyData);
-					param_3->RowRange(param_3->m_rows - m_output_data.m_rows, m_output_data.m_rows).CopyFromMat(m_output_data, MatrixTransposeType::kNoTrans);
-				} else {
-					*param_3 = m_output_data;
-				}
+		}
+		if (m_output_data.m_rows > 0) {
+			if (param_3->m_rows != 0) {
+				param_3->Resize(m_output_data.m_rows + param_3->m_rows, param_3->m_cols, MatrixResizeType::kCopyData);
+				param_3->RowRange(param_3->m_rows - m_output_data.m_rows, m_output_data.m_rows).CopyFromMat(m_output_data, MatrixTransposeType::kNoTrans);
+			} else {
+				*param_3 = m_output_data;
 			}
-			m_output_data.Resize(0, 0);
 		}
+		m_output_data.Resize(0, 0);
 
 		param_4->resize(param_3->m_rows);
 		for (auto uVar7 = param_4->size() - field_x20.size(); uVar7 < param_4->size(); uVar7++) {
@@ -231,35 +308,36 @@ namespace snowboy {
 	}
 
 	void Nnet::Propagate() {
+		auto& chunkinfo = m_chunk_plans.front().chunkinfo;
 		for (size_t c = 0; c < m_components.size(); c++) {
-			auto ctx = m_components[c]->Context();
+			auto& ctx = m_component_contexts[c];
 			auto inputDim = m_components[c]->InputDim();
 			if (ctx.size() > 1) {
 				auto& rci = m_reusable_component_inputs[c];
 				if (rci.m_rows > 0) {
-					Matrix local_98;
-					local_98.Resize(rci.m_rows + m_input_data.m_rows, inputDim);
-					local_98.RowRange(0, rci.m_rows).CopyFromMat(rci, MatrixTransposeType::kNoTrans);
-					local_98.RowRange(rci.m_rows, m_input_data.m_rows).CopyFromMat(m_input_data, MatrixTransposeType::kNoTrans);
-					m_input_data = std::move(local_98);
+					m_context_data.Resize(rci.m_rows + m_input_data.m_rows, inputDim, MatrixResizeType::kUndefined);
+					m_context_data.RowRange(0, rci.m_rows).CopyFromMat(rci, MatrixTransposeType::kNoTrans);
+					m_context_data.RowRange(rci.m_rows, m_input_data.m_rows).CopyFromMat(m_input_data, MatrixTransposeType::kNoTrans);
+					m_input_data.Swap(&m_context_data);
 				}
 				rci.Resize(ctx.back() - ctx.front(), inputDim);
 				rci.CopyFromMat(m_input_data.RowRange(m_input_data.m_rows - rci.m_rows, rci.m_rows), MatrixTransposeType::kNoTrans);
 			}
-			m_chunkinfo[c].MakeOffsetsContiguous();
-			m_chunkinfo[c + 1].MakeOffsetsContiguous();
-			auto last_offset = m_chunkinfo[c].GetOffset(m_chunkinfo[c].ChunkSize() - 1);
+			chunkinfo[c].MakeOffsetsContiguous();
+			chunkinfo[c + 1].MakeOffsetsContiguous();
+			auto last_offset = chunkinfo[c].GetOffset(chunkinfo[c].ChunkSize() - 1);
 			ChunkInfo input_chunk_info{
-				m_chunkinfo[c].NumCols(),
-				m_chunkinfo[c].NumChunks(),
+				chunkinfo[c].NumCols(),
+				chunkinfo[c].NumChunks(),
 				last_offset - m_input_data.rows() + 1,
 				last_offset};
-			last_offset = m_chunkinfo[c + 1].GetOffset(m_chunkinfo[c + 1].ChunkSize() - 1);
+			last_offset = chunkinfo[c + 1].GetOffset(chunkinfo[c + 1].ChunkSize() - 1);
 			ChunkInfo output_chunk_info{
-				m_chunkinfo[c + 1].NumCols(),
-				m_chunkinfo[c + 1].NumChunks(),
+				chunkinfo[c + 1].NumCols(),
+				chunkinfo[c + 1].NumChunks(),
 				last_offset - (m_input_data.rows() - (ctx.back() - ctx.front())) + 1,
 				last_offset};
+			SNOWBOY_TRACE_SCOPE(m_components[c]->Type());
 			m_components[c]->Propagate(input_chunk_info, output_chunk_info, std::move(m_input_data), &m_output_data);
 			if (c < m_components.size() - 1) {
 				m_input_data = std::move(m_output_data);
@@ -270,6 +348,34 @@ namespace snowboy {
 		if (field_xa == 0) field_xa = 1;
 	}
 
+	void Nnet::PropagateStreaming() {
+		for (size_t c = 0; c < m_components.size(); c++) {
+			if (m_input_data.m_rows == 0 && m_context_rings[c].Capacity() == 0) {
+				// Nothing left to propagate
+				m_output_data.Resize(0, 0);
+				break;
+			}
+			SNOWBOY_TRACE_SCOPE(m_components[c]->Type());
+			if (m_context_rings[c].Capacity() != 0) {
+				auto splice = dynamic_cast<const SpliceComponent*>(m_components[c].get());
+				if (splice == nullptr)
+					throw snowboy_exception{"streaming computation does not support context in " + m_components[c]->Type()};
+				splice->PropagateStreaming(&m_context_rings[c], m_input_data, &m_output_data);
+			} else {
+				auto rows = m_input_data.m_rows;
+				ChunkInfo input_chunk_info{static_cast<size_t>(m_components[c]->InputDim()), 1, 0, rows - 1};
+				ChunkInfo output_chunk_info{static_cast<size_t>(m_components[c]->OutputDim()), 1, 0, rows - 1};
+				m_components[c]->Propagate(input_chunk_info, output_chunk_info, std::move(m_input_data), &m_output_data);
+			}
+			if (c < m_components.size() - 1) {
+				m_input_data = std::move(m_output_data);
+			} else {
+				m_input_data.Resize(0, 0);
+			}
+		}
+		field_xa = 1;
+	}
+
 	void Nnet::ResetComputation() {
 		m_is_first_chunk = 1;
 		field_xa = 0;
@@ -277,12 +383,14 @@ namespace snowboy {
 		for (auto& e : m_reusable_component_inputs) {
 			e.Resize(0, 0);
 		}
+		for (auto& e : m_context_rings) {
+			e.Clear();
+		}
 		field_b8.Resize(0);
 		m_unprocessed_buffer.Resize(0, 0);
 		m_input_data.Resize(0, 0);
 		m_output_data.Resize(0, 0);
 		field_x20.clear();
-		field_x18 = 0;
 	}
 
 	void Nnet::SetIndices() {
@@ -305,21 +413,64 @@ namespace snowboy {
 		ExpectToken(binary, "</Components>", is);
 		ExpectToken(binary, "</Nnet>", is);
 		SetIndices();
+		InitContext();
+	}
+
+	void Nnet::InitContext() {
 		m_left_context = 0;
 		m_right_context = 0;
+		m_component_contexts.clear();
 		if (!m_components.empty()) {
 			// Note: This used to be two loops, one summing m_left_context and one summing m_right_context
 			// Since neither have crossreferences I collapsed them into one.
 			for (auto& e : m_components) {
-				auto ctx = e->Context();
+				m_component_contexts.push_back(e->Context());
+				auto& ctx = m_component_contexts.back();
 				m_left_context += ctx.front();
 				m_right_context += ctx.back();
 			}
 			m_left_context = -m_left_context;
 		}
 		field_xb = 1;
-		m_chunkinfo.resize(num_components + 1);
-		m_reusable_component_inputs.resize(num_components + 1);
+		m_chunk_plans.clear();
+		m_reusable_component_inputs.resize(m_components.size() + 1);
+		m_context_rings.resize(m_components.size());
+		for (size_t i = 0; i < m_components.size(); i++) {
+			auto ctx = m_components[i]->Context();
+			m_context_rings[i].Init(ctx.back() - ctx.front(), m_components[i]->InputDim());
+		}
+		PlanActivations();
+	}
+
+	void Nnet::PlanActivations() {
+		if (m_max_chunk_size == 0 || m_components.empty()) return;
+		// Padding and frames held back by the chunked computation come on top of the new frames
+		auto pad_left = m_pad_input ? (m_pad_left < 0 ? m_left_context : m_pad_left) : 0;
+		auto pad_right = m_pad_input ? (m_pad_right < 0 ? m_right_context : m_pad_right) : 0;
+		size_t input_rows = m_max_chunk_size + std::max(pad_left, pad_right) + m_left_context + m_right_context;
+		size_t max_rows = 0, max_cols = 0, context_rows = 0, context_cols = 0;
+		for (size_t c = 0; c < m_components.size(); c++) {
+			auto ctx = m_components[c]->Context();
+			size_t span = ctx.back() - ctx.front();
+			// Both buffers swap roles between components, so each has to fit the largest activation
+			size_t rows = m_streaming ? input_rows : input_rows + span;
+			size_t cols = std::max(m_components[c]->InputDim(), m_components[c]->OutputDim());
+			if (rows * cols > max_rows * max_cols) {
+				max_rows = rows;
+				max_cols = cols;
+			}
+			if (!m_streaming && span != 0) {
+				m_reusable_component_inputs[c].Reserve(span, m_components[c]->InputDim());
+				if (rows * cols > context_rows * context_cols) {
+					context_rows = rows;
+					context_cols = cols;
+				}
+			}
+		}
+		m_input_data.Reserve(max_rows, max_cols);
+		m_output_data.Reserve(max_rows, max_cols);
+		m_context_data.Reserve(context_rows, context_cols);
+		if (!m_streaming) m_unprocessed_buffer.Reserve(input_rows, InputDim());
 	}
 
 	void Nnet::Write(bool binary, std::ostream* os) const {
@@ -335,19 +486,84 @@ namespace snowboy {
 	}
 
 	int32_t Nnet::LeftContext() const {
-		int32_t ctx = 0;
-		for (size_t i = 0; i < m_components.size(); i++) {
-			ctx += m_components[i]->Context().front();
-		}
-		return -ctx;
+		return m_left_context;
 	}
 
 	int32_t Nnet::RightContext() const {
-		int32_t ctx = 0;
-		for (size_t i = 0; i < m_components.size(); i++) {
-			ctx += m_components[i]->Context().back();
+		return m_right_context;
+	}
+
+	size_t Nnet::NumComponents() const {
+		return m_components.size();
+	}
+
+	size_t Nnet::CommonPrefixLength(const Nnet& other) const {
+		size_t res = 0;
+		for (; res < m_components.size() && res < other.m_components.size(); res++) {
+			auto& a = m_components[res];
+			auto& b = other.m_components[res];
+			if (a == b) continue;
+			if (a->InputDim() != b->InputDim() || a->OutputDim() != b->OutputDim() || !a->Equals(*b))
+				break;
+		}
+		return res;
+	}
+
+	void Nnet::ShareComponents(const Nnet& other, size_t begin, size_t end) {
+		if (begin > end || end > other.m_components.size())
+			throw snowboy_exception{"invalid component range [" + std::to_string(begin) + ", " + std::to_string(end) + ") for a network with "
+									+ std::to_string(other.m_components.size()) + " components"};
+		ResetComputation();
+		m_components.assign(other.m_components.begin() + begin, other.m_components.begin() + end);
+		InitContext();
+	}
+
+	void Nnet::SetStreaming(bool streaming) {
+		ResetComputation();
+		m_streaming = streaming;
+		PlanActivations();
+	}
+
+	void Nnet::SetPadding(int left, int right) {
+		m_pad_left = left;
+		m_pad_right = right;
+		PlanActivations();
+	}
+
+	void Nnet::SetMaxChunkSize(size_t frames) {
+		m_max_chunk_size = frames;
+		PlanActivations();
+	}
+
+	size_t Nnet::SparsifyAffineComponents(float threshold, float min_sparsity) {
+		size_t replaced = 0;
+		for (auto& e : m_components) {
+			auto affine = dynamic_cast<const AffineComponent*>(e.get());
+			if (affine == nullptr) continue;
+			std::shared_ptr<SparseAffineComponent> sparse{new SparseAffineComponent{*affine, threshold}};
+			if (sparse->Sparsity() < min_sparsity) continue;
+			sparse->SetIndex(e->Index());
+			e = std::move(sparse);
+			replaced++;
+		}
+		if (replaced != 0) ResetComputation();
+		return replaced;
+	}
+
+	size_t Nnet::FactorizeAffineComponents(size_t rank) {
+		size_t replaced = 0;
+		for (auto& e : m_components) {
+			auto affine = dynamic_cast<const AffineComponent*>(e.get());
+			if (affine == nullptr) continue;
+			size_t in = affine->InputDim(), out = affine->OutputDim();
+			if (rank * (in + out) >= in * out) continue;
+			std::shared_ptr<FactorizedAffineComponent> factorized{new FactorizedAffineComponent{*affine, rank}};
+			factorized->SetIndex(e->Index());
+			e = std::move(factorized);
+			replaced++;
 		}
-		return ctx;
+		if (replaced != 0) ResetComputation();
+		return replaced;
 	}
 
 } // namespace snowboy
@@ -1,16 +1,18 @@
 #pragma once
 #include <cstdint>
-#include <deque>
+#include <frame-info.h>
 #include <iosfwd>
 #include <matrix-wrapper.h>
 #include <memory>
+#include <ring-buffer.h>
+#include <string>
 #include <vector-wrapper.h>
 #include <vector>
 
 namespace snowboy {
-	struct FrameInfo;
 	class ChunkInfo;
 	class Component;
+	class ContextRing;
 	class Nnet {
 		// TODO: Figure out names for remaining data fields...
 		bool m_pad_input;
@@ -18,28 +20,55 @@ namespace snowboy {
 		bool field_xa;
 		bool field_xb;
 		bool field_xc;
-		// Padding ?
+		// Propagate every frame once using per component context rings instead of chunk plans
+		bool m_streaming;
 		int m_left_context;
 		int m_right_context;
-		size_t field_x18;
+		// Rows of padding added before/after the input, negative to use the network context
+		int m_pad_left;
+		int m_pad_right;
 		// Padding ?
-		std::deque<FrameInfo> field_x20;
-		std::vector<ChunkInfo> m_chunkinfo;
-		std::vector<std::unique_ptr<Component>> m_components;
+		RingBuffer<FrameInfo> field_x20;
+		// ChunkInfo of every component for one input size, used by the chunked computation
+		struct ChunkPlan {
+			int input_rows;
+			int num_chunks;
+			std::vector<ChunkInfo> chunkinfo;
+		};
+		// Most recently used plan first, the first plan is the one used by Propagate
+		std::vector<ChunkPlan> m_chunk_plans;
+		// Largest number of input frames per Compute call the activation buffers are planned for
+		size_t m_max_chunk_size;
+		std::vector<std::shared_ptr<Component>> m_components;
+		// Component::Context() of every component, cached by InitContext() because it returns a new vector
+		std::vector<std::vector<int32_t>> m_component_contexts;
 		std::vector<Matrix> m_reusable_component_inputs;
+		std::vector<ContextRing> m_context_rings;
 		Vector field_b8;
 		Matrix m_unprocessed_buffer;
+		// Ping-pong buffers, every component reads one and writes the other
 		Matrix m_input_data;
 		Matrix m_output_data;
+		// Input of a component with context prepended by the rows of the previous chunk
+		Matrix m_context_data;
 
 	public:
 		Nnet();
 		Nnet(bool pad_context);
+		// Copies the computation state, the components holding the weights are shared with other
 		Nnet(const Nnet& other);
 		~Nnet();
 
+		/**
+		 * \brief Reads the network in filename through the ModelRegistry.
+		 *
+		 * The result is shared by every caller, copy it to run a computation.
+		 */
+		static std::shared_ptr<const Nnet> Load(const std::string& filename, bool pad_context);
+
 		void Compute(const MatrixBase&, const std::vector<FrameInfo>&, Matrix*, std::vector<FrameInfo>*);
-		void ComputeChunkInfo(int, int);
+		// Makes the plan for the given input rows the current one, computing it if it is not cached
+		void ComputeChunkInfo(int input_chunk_size, int num_chunks);
 		void Destroy();
 		void FlushOutput(const MatrixBase&, const std::vector<FrameInfo>&, Matrix*, std::vector<FrameInfo>*);
 		int32_t InputDim() const;
@@ -52,5 +81,53 @@ namespace snowboy {
 
 		int32_t LeftContext() const;
 		int32_t RightContext() const;
+
+		size_t NumComponents() const;
+		// Number of leading components which are identical in both networks
+		size_t CommonPrefixLength(const Nnet& other) const;
+		// Replaces the components with the range [begin, end) of other without copying them
+		void ShareComponents(const Nnet& other, size_t begin, size_t end);
+		// Overrides the amount of padding if pad_context is set
+		void SetPadding(int left, int right);
+		/**
+		 * \brief Enable or disable streaming computation, enabled by default.
+		 *
+		 * In streaming mode each component with context keeps the last input rows it needs,
+		 * so every frame is spliced and propagated exactly once no matter how the input is chunked.
+		 * The output is identical to the chunked computation. Resets the computation.
+		 */
+		void SetStreaming(bool streaming);
+		bool IsStreaming() const noexcept { return m_streaming; }
+		// Number of ChunkInfo plans cached by the chunked computation, at most 8
+		size_t NumCachedChunkPlans() const noexcept { return m_chunk_plans.size(); }
+		/**
+		 * \brief Preallocate the activation buffers for chunks of up to the given number of input frames.
+		 *
+		 * The buffers are sized for the largest activation of any component and reused for the lifetime of the network,
+		 * so Compute does not allocate once they are planned. Compute raises the maximum if it gets a larger chunk.
+		 */
+		void SetMaxChunkSize(size_t frames);
+		/**
+		 * \brief Replace AffineComponents by SparseAffineComponents.
+		 *
+		 * Weights with an absolute value not above threshold are dropped. A component is only replaced if
+		 * at least min_sparsity of its weights are dropped, the sparse kernel is slower on dense weights.
+		 * Returns the number of replaced components.
+		 */
+		size_t SparsifyAffineComponents(float threshold, float min_sparsity);
+		/**
+		 * \brief Replace AffineComponents by FactorizedAffineComponents of the given rank.
+		 *
+		 * Only components which get cheaper at this rank are replaced. Returns the number of replaced components.
+		 */
+		size_t FactorizeAffineComponents(size_t rank);
+		size_t MaxChunkSize() const noexcept { return m_max_chunk_size; }
+
+	private:
+		void InitContext();
+		void PlanActivations();
+		void ComputeChunked(const MatrixBase& input, Matrix* output);
+		void ComputeStreaming(const MatrixBase& input, Matrix* output);
+		void PropagateStreaming();
 	};
 } // namespace snowboy
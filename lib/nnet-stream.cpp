@@ -2,7 +2,6 @@
 #include <nnet-lib.h>
 #include <nnet-stream.h>
 #include <snowboy-error.h>
-#include <snowboy-io.h>
 #include <snowboy-options.h>
 
 namespace snowboy {
@@ -16,16 +15,16 @@ namespace snowboy {
 		m_options = options;
 		if (m_options.model_filename == "")
 			throw snowboy_exception{"please specify the neural network model"};
-		m_nnet.reset(new Nnet(m_options.pad_context));
-
-		Input model{m_options.model_filename};
-		m_nnet->Read(model.is_binary(), model.Stream());
+		m_model = Nnet::Load(m_options.model_filename, m_options.pad_context);
+		m_nnet.reset(new Nnet{*m_model});
 	}
 
+	NnetStream::NnetStream(const NnetStream& other)
+		: m_options{other.m_options}, m_model{other.m_model}, m_nnet{new Nnet{*other.m_nnet}} {}
+
 	int NnetStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-		Matrix tmat;
-		tmat.Resize(0, 0);
-		std::vector<FrameInfo> tinfo;
+		auto& tmat = m_input;
+		auto& tinfo = m_input_info;
 		auto res = m_connectedStream->Read(&tmat, &tinfo);
 		if ((res & 0xc2) != 0) {
 			mat->Resize(0, 0);
@@ -51,4 +50,8 @@ namespace snowboy {
 
 	NnetStream::~NnetStream() {}
 
+	int32_t NnetStream::LeftContext() const {
+		return m_nnet->LeftContext();
+	}
+
 } // namespace snowboy
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstdint>
+#include <frame-info.h>
+#include <matrix-wrapper.h>
 #include <memory>
 #include <stream-itf.h>
 #include <string>
@@ -13,13 +16,21 @@ namespace snowboy {
 	};
 	class NnetStream : public StreamItf {
 		NnetStreamOptions m_options;
+		// Network as read from the model file, kept so the registry knows it is in use
+		std::shared_ptr<const Nnet> m_model;
 		std::unique_ptr<Nnet> m_nnet;
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
 
 	public:
 		NnetStream(const NnetStreamOptions& options);
+		// Copies the state, the network weights are shared with other
+		NnetStream(const NnetStream& other);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
 		virtual bool Reset() override;
 		virtual std::string Name() const override;
 		virtual ~NnetStream();
+
+		int32_t LeftContext() const;
 	};
 } // namespace snowboy
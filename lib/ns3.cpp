@@ -1,44 +1,298 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <frontend-lib.h>
+#include <vector>
 
 extern "C"
 {
-	extern int TNRx_Create(void** param_1);
-	extern int TNRx_Free(void* param_1);
-	extern void TNRx_Init(void* param_1, int sample_rate);
-	extern int TNRx_set_policy(void* param_1, long param_2);
-	extern int TNRx_set_dereverb(void* param_1, long param_2);
-	extern void TNRx_Process(void* param_1);
+	// Value based min and max, these compile to blends in vectorized loops instead of branches
+	static inline float NS3_Min(float a, float b) {
+		return b < a ? b : a;
+	}
+	static inline float NS3_Max(float a, float b) {
+		return a < b ? b : a;
+	}
+	// Round half away from zero and saturate to int16 without branches
+	static inline int16_t NS3_Round(float v) {
+		v = NS3_Min(NS3_Max(v, -32768.0f), 32767.0f);
+		return static_cast<int16_t>(v + std::copysign(0.5f, v));
+	}
 
+	/**
+	 * Single channel noise suppression on fixed size blocks.
+	 *
+	 * Each block is prepended with the tail of the previous one, windowed and transformed
+	 * using the fixed-point FFT. The noise spectrum is tracked with a smoothed minimum follower
+	 * and a decision directed wiener gain is applied before overlap adding the frames back.
+	 *
+	 * The frame is real, so its even and odd samples are packed into one complex FFT of half
+	 * the size and separated again in float, which halves the cost of both transforms.
+	 */
 	struct NS3_Instance {
-		void* m_tnrx_instance;
-		short m_unknown;
+		int m_block_size;
+		int m_overlap;
+		int m_frame_size;
+		// Real FFT size, the complex transforms use one stage less
+		int m_fft_stages;
+		int m_fft_size;
+		int m_policy;
+		int m_dereverb;
+		float m_overdrive;
+		float m_gain_floor;
+		size_t m_num_frames;
+		// Q15 analysis and synthesis window
+		std::vector<int16_t> m_window;
+		// Last m_overlap input samples followed by the current block
+		std::vector<int16_t> m_frame;
+		// Windowed frame, interleaved as m_fft_size / 2 complex values
+		std::vector<int16_t> m_frfi;
+		// Output of the complex FFT, the first value is repeated at the end
+		std::vector<float> m_packed_re;
+		std::vector<float> m_packed_im;
+		// Synthesis window as float, m_window / 32768
+		std::vector<float> m_window_float;
+		// cos and sin of pi * k / (m_fft_size / 2), separating the packed spectrum
+		std::vector<float> m_split_cos;
+		std::vector<float> m_split_sin;
+		std::vector<float> m_synthesis;
+		std::vector<float> m_spec_re;
+		std::vector<float> m_spec_im;
+		std::vector<float> m_power;
+		std::vector<float> m_smoothed_power;
+		std::vector<float> m_noise_power;
+		std::vector<float> m_clean_power;
 	};
-	//static_assert(sizeof(NS3_Instance) == 0x10);
 
-	NS3_Instance* NS3_Init(int sample_rate /* probably */, int unknown1, int* unknown2 /* status? */) {
+	static int NS3_SetPolicy(NS3_Instance* instance, long policy) {
+		static const float overdrive[] = {1.0f, 1.0f, 1.1f, 1.25f};
+		static const float gain_floor[] = {0.5f, 0.25f, 0.125f, 0.09f};
+		if (policy < 0 || policy > 3) return -1;
+		instance->m_policy = policy;
+		instance->m_overdrive = overdrive[policy];
+		instance->m_gain_floor = gain_floor[policy];
+		return 0;
+	}
+
+	NS3_Instance* NS3_Init(int sample_rate, int block_size, int* status) {
 		if ((sample_rate == 8000 || sample_rate == 16000 || sample_rate == 32000 || sample_rate == 48000)
-			&& (unknown1 == 0x50 || unknown1 == 0xa0 || unknown1 == 0x140 || unknown1 == 0x1e0)) {
+			&& (block_size == 0x50 || block_size == 0xa0 || block_size == 0x140 || block_size == 0x1e0)) {
 			auto res = new NS3_Instance{};
-			TNRx_Create(&res->m_tnrx_instance);
-			TNRx_Init(res->m_tnrx_instance, sample_rate);
-			TNRx_set_policy(res->m_tnrx_instance, 1);
-			res->m_unknown = unknown1;
-			*unknown2 = 1;
+			res->m_block_size = block_size;
+			res->m_overlap = block_size * 3 / 5;
+			res->m_frame_size = block_size + res->m_overlap;
+			res->m_fft_stages = 1;
+			while ((1 << res->m_fft_stages) < res->m_frame_size)
+				res->m_fft_stages++;
+			res->m_fft_size = 1 << res->m_fft_stages;
+			res->m_dereverb = 0;
+			NS3_SetPolicy(res, 1);
+
+			// Sine rise and cosine fall, squared they add up to one in the overlap
+			res->m_window.resize(res->m_frame_size, 32767);
+			for (int i = 0; i < res->m_overlap; i++) {
+				auto v = std::sin(M_PI * 0.5 * (i + 0.5) / res->m_overlap);
+				res->m_window[i] = static_cast<int16_t>(std::lround(v * 32767.0));
+				res->m_window[res->m_frame_size - 1 - i] = res->m_window[i];
+			}
+			const int bins = res->m_fft_size / 2 + 1;
+			res->m_window_float.resize(res->m_frame_size);
+			for (int i = 0; i < res->m_frame_size; i++)
+				res->m_window_float[i] = res->m_window[i] * (1.0f / 32768.0f);
+			res->m_frame.resize(res->m_frame_size, 0);
+			res->m_frfi.resize(res->m_fft_size, 0);
+			res->m_packed_re.resize(bins, 0.0f);
+			res->m_packed_im.resize(bins, 0.0f);
+			res->m_split_cos.resize(bins);
+			res->m_split_sin.resize(bins);
+			for (int k = 0; k < bins; k++) {
+				res->m_split_cos[k] = std::cos(2.0 * M_PI * k / res->m_fft_size);
+				res->m_split_sin[k] = std::sin(2.0 * M_PI * k / res->m_fft_size);
+			}
+			res->m_synthesis.resize(res->m_overlap, 0.0f);
+			res->m_spec_re.resize(bins, 0.0f);
+			res->m_spec_im.resize(bins, 0.0f);
+			res->m_power.resize(bins, 0.0f);
+			res->m_smoothed_power.resize(bins, 0.0f);
+			res->m_noise_power.resize(bins, 0.0f);
+			res->m_clean_power.resize(bins, 0.0f);
+			*status = 1;
 			return res;
 		}
+		*status = 4;
 		return nullptr;
 	}
 
 	int NS3_Exit(NS3_Instance* instance) {
-		TNRx_Free(instance->m_tnrx_instance);
 		delete instance;
 		return 1;
 	}
 
-	int NS3_Process(NS3_Instance* instance) {
-		TNRx_Process(instance->m_tnrx_instance);
+	int NS3_Reset(NS3_Instance* instance) {
+		if (instance == nullptr) return 2;
+		instance->m_num_frames = 0;
+		std::fill(instance->m_frame.begin(), instance->m_frame.end(), 0);
+		std::fill(instance->m_synthesis.begin(), instance->m_synthesis.end(), 0.0f);
+		std::fill(instance->m_smoothed_power.begin(), instance->m_smoothed_power.end(), 0.0f);
+		std::fill(instance->m_noise_power.begin(), instance->m_noise_power.end(), 0.0f);
+		std::fill(instance->m_clean_power.begin(), instance->m_clean_power.end(), 0.0f);
+		return 1;
+	}
+
+	/* Spectrum X of a real frame from the complex FFT Z of its even (real) and odd (imaginary) samples,
+	 * X[k] = E[k] + e^(-i pi k / half) O[k] for k <= half. Z[half] must repeat Z[0].
+	 * The bins half - k are read through mirrored pointers, so the loop vectorizes.
+	 */
+	static void NS3_SplitSpectrum(float* __restrict re, float* __restrict im, const float* __restrict z_re, const float* __restrict z_im,
+								  const float* __restrict twiddle_cos, const float* __restrict twiddle_sin, int half) {
+		const float* z_re_mirror = z_re + half;
+		const float* z_im_mirror = z_im + half;
+		for (int k = 0; k <= half; k++) {
+			const float even_re = 0.5f * (z_re[k] + z_re_mirror[-k]);
+			const float even_im = 0.5f * (z_im[k] - z_im_mirror[-k]);
+			const float odd_re = 0.5f * (z_im[k] + z_im_mirror[-k]);
+			const float odd_im = 0.5f * (z_re_mirror[-k] - z_re[k]);
+			re[k] = even_re + twiddle_cos[k] * odd_re + twiddle_sin[k] * odd_im;
+			im[k] = even_im + twiddle_cos[k] * odd_im - twiddle_sin[k] * odd_re;
+		}
+	}
+
+	// Inverse of NS3_SplitSpectrum, packs the half + 1 bins of a real spectrum into half complex values times scale
+	static void NS3_PackSpectrum(float* __restrict z_re, float* __restrict z_im, const float* __restrict re, const float* __restrict im,
+								 const float* __restrict twiddle_cos, const float* __restrict twiddle_sin, int half, float scale) {
+		const float* re_mirror = re + half;
+		const float* im_mirror = im + half;
+		for (int k = 0; k < half; k++) {
+			const float even_re = 0.5f * (re[k] + re_mirror[-k]);
+			const float even_im = 0.5f * (im[k] - im_mirror[-k]);
+			const float diff_re = 0.5f * (re[k] - re_mirror[-k]);
+			const float diff_im = 0.5f * (im[k] + im_mirror[-k]);
+			const float odd_re = twiddle_cos[k] * diff_re - twiddle_sin[k] * diff_im;
+			const float odd_im = twiddle_cos[k] * diff_im + twiddle_sin[k] * diff_re;
+			z_re[k] = (even_re - odd_im) * scale;
+			z_im[k] = (even_im + odd_re) * scale;
+		}
+	}
+
+	int NS3_Process(NS3_Instance* instance, const short* in, short* out) {
+		const auto block = instance->m_block_size;
+		const auto overlap = instance->m_overlap;
+		const auto frame_size = instance->m_frame_size;
+		const auto half = instance->m_fft_size / 2;
+		const auto stages = instance->m_fft_stages - 1;
+		auto frame = instance->m_frame.data();
+		auto frfi = instance->m_frfi.data();
+
+		memmove(frame, frame + block, overlap * sizeof(int16_t));
+		memcpy(frame + overlap, in, block * sizeof(int16_t));
+
+		// Normalize the frame to make the most out of the 16 bit FFT. Even samples become the real
+		// and odd samples the imaginary parts of a complex FFT of half the size.
+		auto max_abs = TSpl_MaxAbsValueW16(frame, frame_size);
+		int norm = max_abs == 0 ? 0 : TSpl_NormW16(max_abs);
+		TSpl_ElementwiseVectorMult(frfi, frame, instance->m_window.data(), frame_size, 15 - norm);
+		std::fill(frfi + frame_size, frfi + 2 * half, 0);
+		TSpl_ComplexBitReverse(frfi, stages);
+		TSpl_ComplexFFT(frfi, stages, 1);
+
+		// Separate the spectra of the even and odd samples
+		const int bins = half + 1;
+		auto packed_re = instance->m_packed_re.data();
+		auto packed_im = instance->m_packed_im.data();
+		for (int k = 0; k < half; k++) {
+			packed_re[k] = frfi[2 * k];
+			packed_im[k] = frfi[2 * k + 1];
+		}
+		packed_re[half] = packed_re[0];
+		packed_im[half] = packed_im[0];
+		auto spec_re = instance->m_spec_re.data();
+		auto spec_im = instance->m_spec_im.data();
+		NS3_SplitSpectrum(spec_re, spec_im, packed_re, packed_im, instance->m_split_cos.data(), instance->m_split_sin.data(), half);
+
+		// The FFT scales by 1/half, undo this and the normalization to track powers in sample units
+		const float scale = static_cast<float>(half) / static_cast<float>(1 << norm);
+		const float power_scale = scale * scale;
+		auto power = instance->m_power.data();
+		auto smoothed = instance->m_smoothed_power.data();
+		auto noise = instance->m_noise_power.data();
+		auto clean = instance->m_clean_power.data();
+		for (int k = 0; k < bins; k++)
+			power[k] = (spec_re[k] * spec_re[k] + spec_im[k] * spec_im[k]) * power_scale;
+
+		// The loops below are kept branch free so the compiler can vectorize them
+		const float smooth = instance->m_num_frames == 0 ? 0.0f : 0.8f;
+		for (int k = 0; k < bins; k++)
+			smoothed[k] = smooth * smoothed[k] + (1.0f - smooth) * power[k];
+		// Short recordings often start speaking right away, so the estimate starts at the first frame
+		// instead of averaging the first frames, which would mistake the speech for noise.
+		// It rises faster during the first half second to reach the noise level.
+		if (instance->m_num_frames == 0) {
+			for (int k = 0; k < bins; k++)
+				noise[k] = NS3_Max(smoothed[k], 1e-3f);
+		} else {
+			// Fast decay, slow rise capped at the smoothed power
+			const float rise = instance->m_num_frames < 50 ? 1.05f : 1.005f;
+			for (int k = 0; k < bins; k++) {
+				const float down = 0.9f * noise[k] + 0.1f * smoothed[k];
+				const float up = NS3_Min(noise[k] * rise, smoothed[k]);
+				noise[k] = NS3_Max(smoothed[k] < noise[k] ? down : up, 1e-3f);
+			}
+		}
+		instance->m_num_frames++;
+
+		// Decision directed wiener gain, prio / (prio + overdrive) with both sides multiplied by the noise power.
+		// Only the suppressed part of the spectrum is kept, it is transformed back and subtracted from the input.
+		const float overdrive = instance->m_overdrive;
+		const float gain_floor = instance->m_gain_floor;
+		for (int k = 0; k < bins; k++) {
+			const float prio = 0.98f * clean[k] + 0.02f * NS3_Max(power[k] - noise[k], 0.0f);
+			const float gain = NS3_Max(prio / (prio + overdrive * noise[k]), gain_floor);
+			clean[k] = gain * gain * power[k];
+			spec_re[k] *= 1.0f - gain;
+			spec_im[k] *= 1.0f - gain;
+		}
+		float max_removed = 0.0f;
+		for (int k = 0; k < bins; k++)
+			max_removed = NS3_Max(max_removed, NS3_Max(std::abs(spec_re[k]), std::abs(spec_im[k])));
+
+		// Nothing suppressed, the output is the delayed input
+		auto synthesis = instance->m_synthesis.data();
+		auto window = instance->m_window_float.data();
+		if (max_removed == 0.0f) {
+			for (int i = 0; i < overlap; i++)
+				out[i] = NS3_Round(frame[i] - synthesis[i]);
+			memcpy(out + overlap, frame + overlap, (block - overlap) * sizeof(int16_t));
+			std::fill(synthesis, synthesis + overlap, 0.0f);
+			return 1;
+		}
+
+		// Pack the suppressed part into a half size spectrum again, Z[k] = E[k] + i O[k].
+		// Scaled to use the range of the 16 bit IFFT, combining E and O can add up to 2.5 times the largest value.
+		int exponent;
+		std::frexp(max_removed, &exponent);
+		const int pack_shift = 13 - exponent;
+		const float pack_scale = std::ldexp(1.0f, pack_shift);
+		NS3_PackSpectrum(packed_re, packed_im, spec_re, spec_im, instance->m_split_cos.data(), instance->m_split_sin.data(), half, pack_scale);
+		for (int k = 0; k < half; k++) {
+			frfi[2 * k] = NS3_Round(packed_re[k]);
+			frfi[2 * k + 1] = NS3_Round(packed_im[k]);
+		}
+
+		TSpl_ComplexBitReverse(frfi, stages);
+		auto ifft_scale = TSpl_ComplexIFFT(frfi, stages, 1);
+		const float out_scale = std::ldexp(1.0f, ifft_scale - pack_shift - norm);
+
+		// The interleaved output holds the samples in order. Synthesis window and overlap add of the suppressed part,
+		// the last overlap samples are completed by the next block. The squared windows add up to one,
+		// so the input needs no windowing: the output is the delayed input minus the suppressed part.
+		for (int i = 0; i < overlap; i++)
+			out[i] = NS3_Round(frame[i] - (frfi[i] * out_scale * window[i] + synthesis[i]));
+		for (int i = overlap; i < block; i++)
+			out[i] = NS3_Round(frame[i] - frfi[i] * out_scale * window[i]);
+		for (int i = block; i < frame_size; i++)
+			synthesis[i - block] = frfi[i] * out_scale * window[i];
 		return 1;
 	}
 
@@ -46,12 +300,12 @@ extern "C"
 		if (instance == nullptr) return 2;
 		if (strcmp(property, "NS_Power") == 0) {
 			auto val = strtol(value, nullptr, 10);
-			TNRx_set_policy(instance->m_tnrx_instance, 1);
-			if (TNRx_set_policy(instance->m_tnrx_instance, val & 0xffffffff) == -1) return 4;
+			if (NS3_SetPolicy(instance, val) == -1) return 4;
 		} else if (strcmp(property, "DR_Power") == 0) {
+			// Dereverberation is not implemented, the value is only validated
 			auto val = strtol(value, nullptr, 10);
-			TNRx_set_dereverb(instance->m_tnrx_instance, 0);
-			if (TNRx_set_dereverb(instance->m_tnrx_instance, val & 0xffffffff) == -1) return 4;
+			if (val != 0 && val != 1) return 4;
+			instance->m_dereverb = val;
 		} else
 			return 4;
 		return 1;
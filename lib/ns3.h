@@ -3,8 +3,11 @@
 extern "C"
 {
 	struct NS3_Instance;
-	NS3_Instance* NS3_Init(int sample_rate /* probably */, int unknown1, int* unknown2 /* status? */);
+	NS3_Instance* NS3_Init(int sample_rate, int block_size, int* status);
 	int NS3_Exit(NS3_Instance* instance);
-	int NS3_Process(NS3_Instance* instance);
+	// Clear the noise estimate and buffered samples, keeps the parameters and does not allocate
+	int NS3_Reset(NS3_Instance* instance);
+	// Suppress noise in one block of block_size samples, output is delayed by 3/5 of a block. in and out may alias.
+	int NS3_Process(NS3_Instance* instance, const short* in, short* out);
 	int NS3_SetPara(NS3_Instance* instance, const char* property, const char* value);
-}
\ No newline at end of file
+}
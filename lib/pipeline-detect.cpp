@@ -6,6 +6,7 @@
 #include <intercept-stream.h>
 #include <license-lib.h>
 #include <mfcc-stream.h>
+#include <nnet-lib.h>
 #include <nnet-stream.h>
 #include <pipeline-detect.h>
 #include <raw-energy-vad-stream.h>
@@ -15,6 +16,7 @@
 #include <snowboy-options.h>
 #include <sstream>
 #include <template-detect-stream.h>
+#include <trace-recorder.h>
 #include <universal-detect-stream.h>
 #include <vad-state-stream.h>
 
@@ -23,6 +25,10 @@ namespace snowboy {
 	void PipelineDetectOptions::Register(const std::string& prefix, OptionsItf* opts) {
 		opts->Register(prefix, "sample-rate", "Sampling rate.", &sampleRate);
 		opts->Register(prefix, "apply-frontend", "If true, apply VQE frontend.", &applyFrontend);
+		opts->Register(prefix, "gate-non-voice", "If true, skip the hotword detectors during non-voice segments.", &gateNonVoice);
+		opts->Register(prefix, "gate-min-non-voice-frames", "Number of consecutive non-voice frames before the hotword detectors are skipped. "
+															"0 uses the number of frames replayed when voice resumes.",
+					   &gateMinNonVoiceFrames);
 	}
 
 	void PipelineDetect::RegisterOptions(const std::string& p, OptionsItf* opts) {
@@ -65,28 +71,72 @@ namespace snowboy {
 		if (m_templateDetectStreamOptions->model_str == "" && m_universalDetectStreamOptions->model_str == "")
 			throw snowboy_exception{"no model detected! You have to provide at least one personal or one universal model by calling SetModel()"};
 
+		InitStreams(nullptr);
+		return true;
+	}
+
+	std::unique_ptr<PipelineDetect> PipelineDetect::Clone() const {
+		if (!m_isInitialized)
+			throw snowboy_exception{"pipeline has not been initialized yet"};
+
+		std::unique_ptr<PipelineDetect> res{new PipelineDetect{m_pipelineDetectOptions}};
+		res->m_pipelineDetectOptions.applyFrontend = m_frontend_enabled;
+		*res->m_gainControlStreamOptions = *m_gainControlStreamOptions;
+		*res->m_frontendStreamOptions = *m_frontendStreamOptions;
+		*res->m_framerStreamOptions = *m_framerStreamOptions;
+		*res->m_rawEnergyVadStreamOptions = *m_rawEnergyVadStreamOptions;
+		*res->m_vadStateStreamOptions = *m_vadStateStreamOptions;
+		*res->m_fftStreamOptions = *m_fftStreamOptions;
+		*res->m_mfccStreamOptions = *m_mfccStreamOptions;
+		*res->m_rawNnetVadStreamOptions = *m_rawNnetVadStreamOptions;
+		*res->m_vadStateStream2Options = *m_vadStateStream2Options;
+		*res->m_templateDetectNnetStreamOptions = *m_templateDetectNnetStreamOptions;
+		*res->m_templateDetectStreamOptions = *m_templateDetectStreamOptions;
+		*res->m_universalDetectStreamOptions = *m_universalDetectStreamOptions;
+		res->m_is_personal_model = m_is_personal_model;
+		res->InitStreams(this);
+		res->Reset();
+		return res;
+	}
+
+	void PipelineDetect::InitStreams(const PipelineDetect* prototype) {
 		m_framerStreamOptions->sample_rate = m_pipelineDetectOptions.sampleRate;
 		m_mfccStreamOptions->mel_filter.sample_rate = m_pipelineDetectOptions.sampleRate;
 		m_frontend_enabled = m_pipelineDetectOptions.applyFrontend;
 		m_interceptStream.reset(new InterceptStream{});
-		m_gainControlStream.reset(new GainControlStream{*m_gainControlStreamOptions});
+		// The prototype holds the gain, the networks, models and templates, which are shared instead of loaded again
+		if (prototype)
+			m_gainControlStream.reset(new GainControlStream{*prototype->m_gainControlStream});
+		else
+			m_gainControlStream.reset(new GainControlStream{*m_gainControlStreamOptions});
 		m_frontendStream.reset(new FrontendStream{*m_frontendStreamOptions});
 		m_framerStream.reset(new FramerStream{*m_framerStreamOptions});
 		m_rawEnergyVadStream.reset(new RawEnergyVadStream{*m_rawEnergyVadStreamOptions});
 		m_vadStateStream.reset(new VadStateStream{*m_vadStateStreamOptions});
 		m_fftStream.reset(new FftStream{*m_fftStreamOptions});
 		m_mfccStream.reset(new MfccStream{*m_mfccStreamOptions});
-		m_rawNnetVadStream.reset(new RawNnetVadStream{*m_rawNnetVadStreamOptions});
+		if (prototype)
+			m_rawNnetVadStream.reset(new RawNnetVadStream{*prototype->m_rawNnetVadStream});
+		else
+			m_rawNnetVadStream.reset(new RawNnetVadStream{*m_rawNnetVadStreamOptions});
 		m_eavesdropStream.reset(new EavesdropStream{nullptr, &m_eavesdropStreamFrameInfoVector});
 		m_vadStateStream2.reset(new VadStateStream{*m_vadStateStream2Options});
 		if (m_templateDetectStreamOptions->model_str != "") {
 			m_templateDetectInterceptStream.reset(new InterceptStream{});
-			m_templateDetectNnetStream.reset(new NnetStream{*m_templateDetectNnetStreamOptions});
-			m_templateDetectStream.reset(new TemplateDetectStream{*m_templateDetectStreamOptions});
+			if (prototype) {
+				m_templateDetectNnetStream.reset(new NnetStream{*prototype->m_templateDetectNnetStream});
+				m_templateDetectStream.reset(new TemplateDetectStream{*prototype->m_templateDetectStream});
+			} else {
+				m_templateDetectNnetStream.reset(new NnetStream{*m_templateDetectNnetStreamOptions});
+				m_templateDetectStream.reset(new TemplateDetectStream{*m_templateDetectStreamOptions});
+			}
 		}
 		if (m_universalDetectStreamOptions->model_str != "") {
 			m_universalDetectInterceptStream.reset(new InterceptStream{});
-			m_universalDetectStream.reset(new UniversalDetectStream{*m_universalDetectStreamOptions});
+			if (prototype)
+				m_universalDetectStream.reset(new UniversalDetectStream{*prototype->m_universalDetectStream});
+			else
+				m_universalDetectStream.reset(new UniversalDetectStream{*m_universalDetectStreamOptions});
 		}
 		m_gainControlStream->Connect(m_interceptStream.get());
 		if (!m_frontend_enabled) {
@@ -129,8 +179,19 @@ namespace snowboy {
 				npersonal++;
 			}
 		}
+		m_gate_warmup_frames = 0;
+		if (m_templateDetectStream) {
+			m_gate_warmup_frames = std::max<size_t>(m_gate_warmup_frames, m_templateDetectNnetStream->LeftContext() + m_templateDetectStream->field_x70);
+		}
+		if (m_universalDetectStream) {
+			for (auto& e : m_universalDetectStream->m_model_info) {
+				m_gate_warmup_frames = std::max<size_t>(m_gate_warmup_frames, e.network.LeftContext() + e.smooth_window + e.slide_window);
+			}
+		}
+		// Shorter pauses save nothing, the replay computes as many frames as were skipped
+		m_gate_min_non_voice_frames = m_pipelineDetectOptions.gateMinNonVoiceFrames > 0 ? m_pipelineDetectOptions.gateMinNonVoiceFrames : m_gate_warmup_frames;
+		m_stats.Invalidate();
 		m_isInitialized = true;
-		return true;
 	}
 
 	bool PipelineDetect::Reset() {
@@ -147,21 +208,29 @@ namespace snowboy {
 			m_rawNnetVadStream->Reset();
 			m_eavesdropStream->Reset();
 			m_vadStateStream2->Reset();
-			if (m_templateDetectStream) {
-				m_templateDetectInterceptStream->Reset();
-				m_templateDetectNnetStream->Reset();
-				m_templateDetectStream->Reset();
-			}
-			if (m_universalDetectStream) {
-				m_universalDetectInterceptStream->Reset();
-				m_universalDetectStream->Reset();
-			}
+			ResetDetectors();
 		}
 		m_eavesdropStreamFrameInfoVector.clear();
 		field_x168 = true;
+		m_gate_suspended = false;
+		m_gate_non_voice_frames = 0;
+		m_gate_history_pos = 0;
+		m_gate_history_rows = 0;
 		return true;
 	}
 
+	void PipelineDetect::ResetDetectors() {
+		if (m_templateDetectStream) {
+			m_templateDetectInterceptStream->Reset();
+			m_templateDetectNnetStream->Reset();
+			m_templateDetectStream->Reset();
+		}
+		if (m_universalDetectStream) {
+			m_universalDetectInterceptStream->Reset();
+			m_universalDetectStream->Reset();
+		}
+	}
+
 	std::string PipelineDetect::Name() const {
 		return "PipelineDetect";
 	}
@@ -196,6 +265,7 @@ namespace snowboy {
 		m_rawEnergyVadStreamOptions->bg_energy_cap = 12.0f;
 		m_rawEnergyVadStreamOptions->bg_buffer_size = 60;
 		m_rawEnergyVadStreamOptions->raw_buffer_extra = 0;
+		m_rawEnergyVadStreamOptions->confident_margin = -1.0f;
 		m_vadStateStreamOptions.reset(new VadStateStreamOptions{});
 		m_vadStateStreamOptions->min_non_voice_frames = 100;
 		m_vadStateStreamOptions->min_voice_frames = 10;
@@ -234,6 +304,7 @@ namespace snowboy {
 		m_templateDetectStreamOptions->model_str = "";
 		m_templateDetectStreamOptions->sensitivity_str = "";
 		m_templateDetectStreamOptions->slide_step = 1;
+		m_templateDetectStreamOptions->prefilter_threshold = 0.0f;
 		m_universalDetectStreamOptions.reset(new UniversalDetectStreamOptions{});
 		m_universalDetectStreamOptions->slide_step = 1;
 		m_universalDetectStreamOptions->min_num_frames_per_phone = 3;
@@ -263,9 +334,18 @@ namespace snowboy {
 				m_frontendStream->Connect(m_gainControlStream.get());
 				m_framerStream->Connect(m_frontendStream.get());
 			}
+			m_stats.Invalidate();
 		}
 	}
 
+	void PipelineDetect::GateNonVoice(bool gate) {
+		m_pipelineDetectOptions.gateNonVoice = gate;
+		m_gate_suspended = false;
+		m_gate_non_voice_frames = 0;
+		m_gate_history_pos = 0;
+		m_gate_history_rows = 0;
+	}
+
 	void PipelineDetect::ClassifyModels(const std::string& model_str, std::string* personal_models, std::string* universal_models) {
 		personal_models->clear();
 		universal_models->clear();
@@ -304,7 +384,7 @@ namespace snowboy {
 		param_3->clear();
 		std::vector<std::string> parts;
 		SplitStringToVector(param_1, global_snowboy_string_delimiter, &parts);
-		auto num_personal = m_templateDetectStream == nullptr ? 0 : m_templateDetectStream->m_models.size();
+		auto num_personal = m_templateDetectStream == nullptr ? 0 : m_templateDetectStream->NumModels();
 		auto num_universal = 0;
 		if (m_universalDetectStream != nullptr
 			&& !m_universalDetectStream->m_model_info.empty()
@@ -343,6 +423,19 @@ namespace snowboy {
 		return id;
 	}
 
+	size_t PipelineDetect::GetContextSamples() const {
+		if (!m_isInitialized)
+			throw snowboy_exception{"pipeline has not been initialized yet"};
+
+		// Frames after which a freshly reset pipeline is in the same state as one that has been running all along:
+		// the detector context, the background energy buffer, the vad network context and the vad state hysteresis.
+		size_t frames = m_gate_warmup_frames + m_rawEnergyVadStreamOptions->bg_buffer_size + m_rawNnetVadStream->m_nnet->LeftContext();
+		for (auto opts : {m_vadStateStreamOptions.get(), m_vadStateStream2Options.get()})
+			frames += std::max(opts->min_non_voice_frames, opts->min_voice_frames) + opts->extra_frame_adjust;
+		const size_t samples_per_ms = m_pipelineDetectOptions.sampleRate / 1000;
+		return (frames * m_framerStreamOptions->frame_shift_ms + m_framerStreamOptions->frame_length_ms) * samples_per_ms;
+	}
+
 	std::string PipelineDetect::GetSensitivity() const {
 		if (!m_isInitialized)
 			throw snowboy_exception{"pipeline has not been initialized yet"};
@@ -372,52 +465,33 @@ namespace snowboy {
 			throw snowboy_exception{"pipeline has not been initialized yet"};
 
 		int num_hotwords = 0;
-		if (m_templateDetectStream) num_hotwords += m_templateDetectStream->m_models.size();
+		if (m_templateDetectStream) num_hotwords += m_templateDetectStream->NumModels();
 		if (m_universalDetectStream && !m_universalDetectStream->m_model_info.empty() && !m_universalDetectStream->m_model_info.back().keywords.empty())
 			num_hotwords += m_universalDetectStream->m_model_info.back().keywords.back().hotword_id;
 		return num_hotwords;
 	}
 
 	int PipelineDetect::RunDetection(const MatrixBase& data, bool is_end) {
+		SNOWBOY_TRACE_SCOPE("PipelineDetect::RunDetection");
 		if (!m_isInitialized)
 			throw snowboy_exception{"pipeline has not been initialized yet"};
 
-		std::vector<FrameInfo> info;
-		info.resize(data.m_rows);
+		auto& info = m_input_info;
+		info.assign(data.m_rows, FrameInfo{});
 		m_interceptStream->SetData(data, info, static_cast<SnowboySignal>(is_end ? 0x30 : 0x20));
 		int x = 0;
 		while (x == 0) {
-			Matrix tmat;
-			std::vector<FrameInfo> tinfo;
-			auto tres = m_vadStateStream2->Read(&tmat, &tinfo);
+			auto& tmat = m_output;
+			auto& tinfo = m_output_info;
+			auto tres = m_stats.Read(m_vadStateStream2.get(), &tmat, &tinfo);
 			m_rawEnergyVadStream->UpdateBackgroundEnergy(m_eavesdropStreamFrameInfoVector);
 			m_eavesdropStreamFrameInfoVector.clear();
-			if (m_templateDetectStream) {
-				Matrix ptmat;
-				std::vector<FrameInfo> ptinfo;
-				m_templateDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
-				x = m_templateDetectStream->Read(&ptmat, &ptinfo);
-				if (ptmat.m_rows == 1 && ptmat.m_cols == 1) {
-					this->Reset();
-					auto f = ptmat.m_data[0] - 1.0f;
-					if (f >= 9.223372e+18) f -= 9.223372e+18;
-					x = m_personal_kw_mapping[static_cast<int>(f)];
-					return x;
-				}
-			}
-			if (m_universalDetectStream) {
-				Matrix utmat;
-				std::vector<FrameInfo> utinfo;
-				m_universalDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
-				auto utres = m_universalDetectStream->Read(&utmat, &utinfo);
-				x |= utres;
-				if (utmat.m_rows == 1 && utmat.m_cols == 1) {
-					this->Reset();
-					auto f = utmat.m_data[0] - 1.0f;
-					if (f >= 9.223372e+18) f -= 9.223372e+18;
-					x = m_universal_kw_mapping[static_cast<int>(f)];
-					return x;
-				}
+			if (m_pipelineDetectOptions.gateNonVoice && !GateDetectors(&tmat, &tinfo)) {
+				x = tres;
+			} else {
+				int hotword = 0;
+				x = RunDetectors(tmat, tinfo, tres, &hotword);
+				if (hotword != 0) return hotword;
 			}
 			if ((x & 4) != 0) {
 				field_x168 = false;
@@ -430,6 +504,102 @@ namespace snowboy {
 		return this->field_x168 ? -2 : 0;
 	}
 
+	int PipelineDetect::RunDetectors(const MatrixBase& tmat, const std::vector<FrameInfo>& tinfo, int tres, int* hotword) {
+		int x = 0;
+		if (m_templateDetectStream) {
+			auto& ptmat = m_detect_output;
+			auto& ptinfo = m_detect_output_info;
+			m_templateDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
+			x = m_stats.Read(m_templateDetectStream.get(), &ptmat, &ptinfo);
+			if (ptmat.m_rows == 1 && ptmat.m_cols == 1) {
+				this->Reset();
+				auto f = ptmat.m_data[0] - 1.0f;
+				if (f >= 9.223372e+18) f -= 9.223372e+18;
+				*hotword = m_personal_kw_mapping[static_cast<int>(f)];
+				return x;
+			}
+		}
+		if (m_universalDetectStream) {
+			auto& utmat = m_detect_output;
+			auto& utinfo = m_detect_output_info;
+			m_universalDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
+			auto utres = m_stats.Read(m_universalDetectStream.get(), &utmat, &utinfo);
+			x |= utres;
+			if (utmat.m_rows == 1 && utmat.m_cols == 1) {
+				this->Reset();
+				auto f = utmat.m_data[0] - 1.0f;
+				if (f >= 9.223372e+18) f -= 9.223372e+18;
+				*hotword = m_universal_kw_mapping[static_cast<int>(f)];
+				return x;
+			}
+		}
+		return x;
+	}
+
+	bool PipelineDetect::GateDetectors(Matrix* mat, std::vector<FrameInfo>* info) {
+		bool voice = false;
+		for (auto& e : *info) {
+			if ((e.flags & 1) != 0) {
+				voice = true;
+				break;
+			}
+		}
+		if (info->empty()) return !m_gate_suspended;
+		if (!voice) {
+			PushGateHistory(*mat, *info);
+			if (m_gate_suspended) return false;
+			// Short pauses inside speech keep the detectors running
+			m_gate_non_voice_frames += info->size();
+			if (m_gate_non_voice_frames < m_gate_min_non_voice_frames) return true;
+			ResetDetectors();
+			m_gate_suspended = true;
+			return false;
+		}
+		m_gate_non_voice_frames = 0;
+		if (m_gate_suspended) {
+			// Replay the frames before the voice onset so the network context
+			// and the search windows are filled like they would be without gating.
+			auto rows = m_gate_history_rows;
+			auto& replay = m_gate_replay;
+			replay.Resize(rows + mat->rows(), mat->cols(), MatrixResizeType::kUndefined);
+			auto& replay_info = m_gate_replay_info;
+			replay_info.clear();
+			auto first = (m_gate_history_pos + m_gate_warmup_frames - rows) % m_gate_warmup_frames;
+			for (size_t i = 0; i < rows; i++) {
+				auto r = (first + i) % m_gate_warmup_frames;
+				SubVector{replay, i}.CopyFromVec(SubVector{m_gate_history, r});
+				replay_info.push_back(m_gate_history_info[r]);
+			}
+			replay.RowRange(rows, mat->rows()).CopyFromMat(*mat, MatrixTransposeType::kNoTrans);
+			replay_info.insert(replay_info.end(), info->begin(), info->end());
+			PushGateHistory(*mat, *info);
+			mat->Swap(&replay);
+			info->swap(replay_info);
+			m_gate_suspended = false;
+			return true;
+		}
+		PushGateHistory(*mat, *info);
+		return true;
+	}
+
+	void PipelineDetect::PushGateHistory(const MatrixBase& mat, const std::vector<FrameInfo>& info) {
+		if (m_gate_warmup_frames == 0) return;
+		if (m_gate_history.rows() != m_gate_warmup_frames || m_gate_history.cols() != mat.cols()) {
+			m_gate_history.Resize(m_gate_warmup_frames, mat.cols());
+			m_gate_history_info.resize(m_gate_warmup_frames);
+			m_gate_history_pos = 0;
+			m_gate_history_rows = 0;
+		}
+		// Only the last m_gate_warmup_frames rows can ever be replayed
+		auto skip = mat.rows() > m_gate_warmup_frames ? mat.rows() - m_gate_warmup_frames : 0;
+		for (size_t r = skip; r < mat.rows(); r++) {
+			SubVector{m_gate_history, m_gate_history_pos}.CopyFromVec(SubVector{mat, r});
+			m_gate_history_info[m_gate_history_pos] = info[r];
+			m_gate_history_pos = (m_gate_history_pos + 1) % m_gate_warmup_frames;
+		}
+		m_gate_history_rows = std::min(m_gate_history_rows + mat.rows() - skip, m_gate_warmup_frames);
+	}
+
 	void PipelineDetect::SetAudioGain(float gain) {
 		if (!m_isInitialized)
 			throw snowboy_exception{"pipeline has not been initialized yet"};
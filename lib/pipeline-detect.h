@@ -1,4 +1,5 @@
 #pragma once
+#include <matrix-wrapper.h>
 #include <memory>
 #include <pipeline-itf.h>
 #include <vector>
@@ -20,6 +21,7 @@ namespace snowboy {
 	class NnetStream;
 	struct TemplateDetectStream;
 	struct UniversalDetectStream;
+	class SensitivitySweep;
 
 	struct GainControlStreamOptions;
 	struct FrontendStreamOptions;
@@ -36,6 +38,9 @@ namespace snowboy {
 	struct PipelineDetectOptions {
 		int sampleRate;
 		bool applyFrontend;
+		bool gateNonVoice;
+		// Consecutive non-voice frames before the detectors are suspended, 0 uses the warm-up length
+		int gateMinNonVoiceFrames;
 		// Padding
 		void Register(const std::string&, OptionsItf*);
 	};
@@ -52,8 +57,18 @@ namespace snowboy {
 
 		PipelineDetect(const PipelineDetectOptions& options);
 
+		/**
+		 * \brief Creates a pipeline with the same models and settings in the reset state.
+		 *
+		 * The network weights and templates are shared with this pipeline instead of being loaded again.
+		 */
+		std::unique_ptr<PipelineDetect> Clone() const;
 		void ApplyFrontend(bool apply);
+		void GateNonVoice(bool gate);
+		// True while non-voice gating keeps the detectors suspended
+		bool DetectorsSuspended() const noexcept { return m_gate_suspended; }
 		uint64_t GetDetectedFrameId() const;
+		size_t GetContextSamples() const;
 		std::string GetSensitivity() const;
 		int NumHotwords() const;
 		int RunDetection(const MatrixBase& data, bool is_end);
@@ -65,9 +80,17 @@ namespace snowboy {
 		void UpdateModel() const;
 
 	private:
+		friend class SensitivitySweep;
+
 		void ClassifyModels(const std::string&, std::string*, std::string*);
 		bool ClassifyModel(const std::string& model_filename);
 		void ClassifySensitivities(const std::string&, std::string*, std::string*) const;
+		// Creates and connects the streams, the heavy ones are copied from prototype if it is set
+		void InitStreams(const PipelineDetect* prototype);
+		bool GateDetectors(Matrix* mat, std::vector<FrameInfo>* info);
+		void PushGateHistory(const MatrixBase& mat, const std::vector<FrameInfo>& info);
+		void ResetDetectors();
+		int RunDetectors(const MatrixBase& mat, const std::vector<FrameInfo>& info, int signal, int* hotword);
 
 		std::unique_ptr<InterceptStream> m_interceptStream;
 		std::unique_ptr<GainControlStream> m_gainControlStream;
@@ -109,5 +132,26 @@ namespace snowboy {
 
 		bool field_x168 = false;
 		bool m_frontend_enabled = false;
+
+		// Non-voice gating: the detectors are reset once non-voice lasted for
+		// m_gate_min_non_voice_frames and the last m_gate_warmup_frames frames
+		// are replayed once voice starts again.
+		bool m_gate_suspended = false;
+		size_t m_gate_warmup_frames = 0;
+		size_t m_gate_min_non_voice_frames = 0;
+		size_t m_gate_non_voice_frames = 0;
+		size_t m_gate_history_pos = 0;
+		size_t m_gate_history_rows = 0;
+		Matrix m_gate_history;
+		std::vector<FrameInfo> m_gate_history_info;
+		Matrix m_gate_replay;
+		std::vector<FrameInfo> m_gate_replay_info;
+
+		// Buffers passed between the streams, kept between calls to avoid allocating
+		std::vector<FrameInfo> m_input_info;
+		Matrix m_output;
+		std::vector<FrameInfo> m_output_info;
+		Matrix m_detect_output;
+		std::vector<FrameInfo> m_detect_output_info;
 	};
 } // namespace snowboy
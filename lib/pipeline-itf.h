@@ -1,4 +1,5 @@
 #pragma once
+#include <stream-stats.h>
 #include <string>
 namespace snowboy {
 	struct OptionsItf;
@@ -13,7 +14,12 @@ namespace snowboy {
 		virtual std::string OptionPrefix() const = 0;
 		virtual ~PipelineItf();
 
+		StreamStats& Stats() noexcept { return m_stats; }
+		const StreamStats& Stats() const noexcept { return m_stats; }
+
 	protected:
 		bool m_isInitialized = false;
+		// Streams read by the pipeline itself go through m_stats.Read so every stage is timed
+		StreamStats m_stats;
 	};
 } // namespace snowboy
@@ -52,6 +52,7 @@ namespace snowboy {
 		m_mfccStream->Connect(m_fftStream.get());
 		m_nnetStream->Connect(m_mfccStream.get());
 		m_templateEnrollStream->Connect(m_nnetStream.get());
+		m_stats.Invalidate();
 
 		m_isInitialized = true;
 		return true;
@@ -121,7 +122,7 @@ namespace snowboy {
 			std::vector<FrameInfo> info;
 			info.resize(data.m_rows);
 			m_interceptStream->SetData(data, info, SnowboySignal(8));
-			return m_templateEnrollStream->Read(nullptr, nullptr);
+			return m_stats.Read(m_templateEnrollStream.get(), nullptr, nullptr);
 		}
 		return 2;
 	}
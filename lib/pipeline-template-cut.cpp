@@ -62,6 +62,7 @@ namespace snowboy {
 		m_fftStream->Connect(m_eavesdropStream.get());
 		m_mfccStream->Connect(m_fftStream.get());
 		m_rawNnetVadStream->Connect(m_mfccStream.get());
+		m_stats.Invalidate();
 
 		m_isInitialized = true;
 		return true;
@@ -128,7 +129,7 @@ namespace snowboy {
 		m_interceptStream->SetData(in, info, SnowboySignal(8));
 		Matrix read_mat;
 		std::vector<FrameInfo> read_info;
-		m_rawNnetVadStream->Read(&read_mat, &read_info);
+		m_stats.Read(m_rawNnetVadStream.get(), &read_mat, &read_info);
 		read_mat.Resize(0, 0);
 		if (m_eavesdropMatrix.m_rows == 0) {
 			return 0x400;
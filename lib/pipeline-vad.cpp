@@ -14,6 +14,8 @@
 #include <snowboy-io.h>
 #include <snowboy-options.h>
 #include <template-detect-stream.h>
+#include <tiered-vad-stream.h>
+#include <trace-recorder.h>
 #include <universal-detect-stream.h>
 #include <vad-state-stream.h>
 
@@ -22,6 +24,7 @@ namespace snowboy {
 	void PipelineVadOptions::Register(const std::string& prefix, OptionsItf* opts) {
 		opts->Register(prefix, "sample-rate", "Sampling rate.", &sampleRate);
 		opts->Register(prefix, "apply-frontend", "If true, apply VQE frontend.", &applyFrontend);
+		opts->Register(prefix, "tiered-vad", "If true, only chunks the energy VAD is not confident about are passed to the neural network VAD.", &tieredVad);
 	}
 
 	void PipelineVad::RegisterOptions(const std::string& p, OptionsItf* opts) {
@@ -54,20 +57,54 @@ namespace snowboy {
 		if (m_isInitialized)
 			throw snowboy_exception{"class has already been initialized."};
 
+		InitStreams(nullptr);
+		return true;
+	}
+
+	std::unique_ptr<PipelineVad> PipelineVad::Clone() const {
+		if (!m_isInitialized)
+			throw snowboy_exception{"pipeline has not been initialized yet"};
+
+		std::unique_ptr<PipelineVad> res{new PipelineVad{m_pipelineVadOptions}};
+		res->m_pipelineVadOptions.applyFrontend = field_xd1;
+		*res->m_gainControlStreamOptions = *m_gainControlStreamOptions;
+		*res->m_frontendStreamOptions = *m_frontendStreamOptions;
+		*res->m_framerStreamOptions = *m_framerStreamOptions;
+		*res->m_rawEnergyVadStreamOptions = *m_rawEnergyVadStreamOptions;
+		*res->m_vadStateStreamOptions = *m_vadStateStreamOptions;
+		*res->m_fftStreamOptions = *m_fftStreamOptions;
+		*res->m_mfccStreamOptions = *m_mfccStreamOptions;
+		*res->m_rawNnetVadStreamOptions = *m_rawNnetVadStreamOptions;
+		*res->m_vadStateStream2Options = *m_vadStateStream2Options;
+		res->InitStreams(this);
+		res->Reset();
+		return res;
+	}
+
+	void PipelineVad::InitStreams(const PipelineVad* prototype) {
 		m_framerStreamOptions->sample_rate = m_pipelineVadOptions.sampleRate;
 		m_mfccStreamOptions->mel_filter.sample_rate = m_pipelineVadOptions.sampleRate;
 		field_xd1 = m_pipelineVadOptions.applyFrontend;
 		m_interceptStream.reset(new InterceptStream{});
-		m_gainControlStream.reset(new GainControlStream{*m_gainControlStreamOptions});
+		// The prototype holds the gain and the network, which is shared instead of loaded again
+		if (prototype)
+			m_gainControlStream.reset(new GainControlStream{*prototype->m_gainControlStream});
+		else
+			m_gainControlStream.reset(new GainControlStream{*m_gainControlStreamOptions});
 		m_frontendStream.reset(new FrontendStream{*m_frontendStreamOptions});
 		m_framerStream.reset(new FramerStream{*m_framerStreamOptions});
 		m_rawEnergyVadStream.reset(new RawEnergyVadStream{*m_rawEnergyVadStreamOptions});
 		m_vadStateStream.reset(new VadStateStream{*m_vadStateStreamOptions});
 		m_fftStream.reset(new FftStream{*m_fftStreamOptions});
 		m_mfccStream.reset(new MfccStream{*m_mfccStreamOptions});
-		m_rawNnetVadStream.reset(new RawNnetVadStream{*m_rawNnetVadStreamOptions});
+		if (prototype)
+			m_rawNnetVadStream.reset(new RawNnetVadStream{*prototype->m_rawNnetVadStream});
+		else
+			m_rawNnetVadStream.reset(new RawNnetVadStream{*m_rawNnetVadStreamOptions});
 		m_eavesdropStream.reset(new EavesdropStream{nullptr, &m_eavesdropStreamFrameInfoVector});
 		m_vadStateStream2.reset(new VadStateStream{*m_vadStateStream2Options});
+		m_nnetInterceptStream.reset(new InterceptStream{});
+		m_tieredVadStream.reset(new TieredVadStream{m_nnetInterceptStream.get(), m_eavesdropStream.get(), m_rawEnergyVadStreamOptions->bg_buffer_size});
 
 		m_gainControlStream->Connect(m_interceptStream.get());
 		if (!field_xd1) {
@@ -78,15 +115,13 @@ namespace snowboy {
 		}
 		m_rawEnergyVadStream->Connect(m_framerStream.get());
 		m_vadStateStream->Connect(m_rawEnergyVadStream.get());
-		m_fftStream->Connect(m_vadStateStream.get());
 		m_mfccStream->Connect(m_fftStream.get());
 		m_rawNnetVadStream->Connect(m_mfccStream.get());
 		m_eavesdropStream->Connect(m_rawNnetVadStream.get());
-		m_vadStateStream2->Connect(m_eavesdropStream.get());
+		ConnectVadStreams();
 		m_vadStateStream->field_x2c = 1;
 		m_vadStateStream2->field_x2c = 2;
 		m_isInitialized = true;
-		return true;
 	}
 
 	bool PipelineVad::Reset() {
@@ -103,6 +138,8 @@ namespace snowboy {
 			m_rawNnetVadStream->Reset();
 			m_eavesdropStream->Reset();
 			m_vadStateStream2->Reset();
+			m_nnetInterceptStream->Reset();
+			m_tieredVadStream->Reset();
 		}
 		m_eavesdropStreamFrameInfoVector.clear();
 		field_xd0 = true;
@@ -143,6 +180,7 @@ namespace snowboy {
 		m_rawEnergyVadStreamOptions->bg_energy_cap = 12.0f;
 		m_rawEnergyVadStreamOptions->bg_buffer_size = 60;
 		m_rawEnergyVadStreamOptions->raw_buffer_extra = 0;
+		m_rawEnergyVadStreamOptions->confident_margin = 3.0f;
 		m_vadStateStreamOptions.reset(new VadStateStreamOptions{});
 		m_vadStateStreamOptions->min_non_voice_frames = 100;
 		m_vadStateStreamOptions->min_voice_frames = 10;
@@ -191,20 +229,53 @@ namespace snowboy {
 				m_frontendStream->Connect(m_gainControlStream.get());
 				m_framerStream->Connect(m_frontendStream.get());
 			}
+			m_stats.Invalidate();
+		}
+	}
+
+	void PipelineVad::SetTieredVad(bool tiered) {
+		if (tiered == m_pipelineVadOptions.tieredVad) return;
+		m_pipelineVadOptions.tieredVad = tiered;
+		if (m_isInitialized) {
+			// Drop frames buffered in the old chain, they would be reordered otherwise
+			m_fftStream->Reset();
+			m_mfccStream->Reset();
+			m_rawNnetVadStream->Reset();
+			m_nnetInterceptStream->Reset();
+			m_tieredVadStream->Reset();
+			ConnectVadStreams();
+		}
+	}
+
+	void PipelineVad::ConnectVadStreams() {
+		// The energy VAD decides confident chunks on its own in tiered mode,
+		// the rest takes the detour through fft, mfcc and the nnet VAD.
+		// Only frames decided by the nnet VAD update the background energy.
+		if (m_pipelineVadOptions.tieredVad) {
+			m_fftStream->Connect(m_nnetInterceptStream.get());
+			m_tieredVadStream->Connect(m_vadStateStream.get());
+			m_vadStateStream2->Connect(m_tieredVadStream.get());
+		} else {
+			m_fftStream->Connect(m_vadStateStream.get());
+			m_vadStateStream2->Connect(m_eavesdropStream.get());
 		}
+		// Only the tiers need a real background estimate, the full path keeps the original one
+		m_rawEnergyVadStream->m_exact_bg_energy = m_pipelineVadOptions.tieredVad;
+		m_stats.Invalidate();
 	}
 
 	int PipelineVad::RunVad(const MatrixBase& data, bool is_end) {
+		SNOWBOY_TRACE_SCOPE("PipelineVad::RunVad");
 		if (!m_isInitialized)
 			throw snowboy_exception{"pipeline has not been initialized yet."};
 
-		std::vector<FrameInfo> info;
-		info.resize(data.m_rows);
+		auto& info = m_input_info;
+		info.assign(data.m_rows, FrameInfo{});
 		m_interceptStream->SetData(data, info, static_cast<SnowboySignal>(is_end ? 0x30 : 0x20));
 		do {
-			Matrix tmat;
-			std::vector<FrameInfo> tinfo;
-			auto tres = m_vadStateStream2->Read(&tmat, &tinfo);
+			auto& tmat = m_output;
+			auto& tinfo = m_output_info;
+			auto tres = m_stats.Read(m_vadStateStream2.get(), &tmat, &tinfo);
 			m_rawEnergyVadStream->UpdateBackgroundEnergy(m_eavesdropStreamFrameInfoVector);
 			m_eavesdropStreamFrameInfoVector.clear();
 			if ((tres & 4) != 0) {
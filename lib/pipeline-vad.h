@@ -1,4 +1,5 @@
 #pragma once
+#include <matrix-wrapper.h>
 #include <memory>
 #include <pipeline-itf.h>
 #include <vector>
@@ -17,6 +18,7 @@ namespace snowboy {
 	class MfccStream;
 	struct RawNnetVadStream;
 	class EavesdropStream;
+	class TieredVadStream;
 
 	struct GainControlStreamOptions;
 	struct FrontendStreamOptions;
@@ -30,6 +32,7 @@ namespace snowboy {
 	struct PipelineVadOptions {
 		int sampleRate;
 		bool applyFrontend;
+		bool tieredVad;
 
 		void Register(const std::string& prefix, OptionsItf* opts);
 	};
@@ -45,6 +48,8 @@ namespace snowboy {
 		std::unique_ptr<RawNnetVadStream> m_rawNnetVadStream;
 		std::unique_ptr<VadStateStream> m_vadStateStream2;
 		std::unique_ptr<EavesdropStream> m_eavesdropStream;
+		std::unique_ptr<InterceptStream> m_nnetInterceptStream;
+		std::unique_ptr<TieredVadStream> m_tieredVadStream;
 		PipelineVadOptions m_pipelineVadOptions;
 		std::unique_ptr<GainControlStreamOptions> m_gainControlStreamOptions;
 		std::unique_ptr<FrontendStreamOptions> m_frontendStreamOptions;
@@ -58,6 +63,10 @@ namespace snowboy {
 		std::vector<FrameInfo> m_eavesdropStreamFrameInfoVector;
 		bool field_xd0;
 		bool field_xd1;
+		// Buffers passed between the streams, kept between calls to avoid allocating
+		std::vector<FrameInfo> m_input_info;
+		Matrix m_output;
+		std::vector<FrameInfo> m_output_info;
 
 		virtual void RegisterOptions(const std::string& prefix, OptionsItf* opts) override;
 		virtual int GetPipelineSampleRate() const override;
@@ -69,9 +78,21 @@ namespace snowboy {
 
 		PipelineVad(const PipelineVadOptions& options);
 
+		/**
+		 * \brief Creates a pipeline with the same settings in the reset state.
+		 *
+		 * The network weights are shared with this pipeline instead of being loaded again.
+		 */
+		std::unique_ptr<PipelineVad> Clone() const;
 		void ApplyFrontend(bool apply);
+		void SetTieredVad(bool tiered);
 		int RunVad(const MatrixBase& data, bool is_end);
 		void SetAudioGain(float gain);
 		void SetMaxAudioAmplitude(float maxAmplitude);
+
+	private:
+		void ConnectVadStreams();
+		// Creates and connects the streams, the network is copied from prototype if it is set
+		void InitStreams(const PipelineVad* prototype);
 	};
 } // namespace snowboy
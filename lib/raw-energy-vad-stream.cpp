@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <frame-info.h>
 #include <limits>
@@ -16,10 +17,14 @@ namespace snowboy {
 												   "This takes care ofthe frame delays when calling UpdateBackgroundEnergy().",
 					   &raw_buffer_extra);
 		opts->Register(prefix, "bg-energy-cap", "Cap of background energy, so that the energy VAD will not block the detection.", &bg_energy_cap);
+		opts->Register(prefix, "confident-margin", "Frames whose energy is further than this away from --bg-energy-threshold are "
+												   "flagged as decided by the energy VAD. Negative values disable the flag.",
+					   &confident_margin);
 	}
 
 	RawEnergyVadStream::RawEnergyVadStream(const RawEnergyVadStreamOptions& options) {
 		m_options = options;
+		m_exact_bg_energy = false;
 		Reset();
 	}
 
@@ -37,33 +42,33 @@ namespace snowboy {
 				auto dot = SubVector{*mat, r}.DotVec(SubVector{*mat, r});
 				dot = std::max(std::numeric_limits<float>::min(), dot);
 				dot = logf(dot);
-				auto energy = dot - m_bg_energy;
-				if (energy > m_options.bg_energy_threshold) {
-					info->at(r).flags |= 0x1;
-				} else {
-					info->at(r).flags &= ~0x1;
-				}
-				field_x38.push_back({info->at(r).frame_id, dot});
-			}
-			while (field_x38.size() > mat->rows() + m_options.raw_buffer_extra) {
-				field_x38.pop_front();
+				SetFrameFlags(dot - m_bg_energy, &info->at(r));
+				AddRawEnergy(info->at(r).frame_id, dot);
 			}
+			KeepRawEnergies(mat->rows() + m_options.raw_buffer_extra);
 		}
-		if ((sig & 0x18) != 0 && m_someMatrix.rows() != 0) {
-			mat->Swap(&m_someMatrix);
-			info->swap(field_xf0);
+		if ((sig & 0x18) != 0 && m_init_rows != 0) {
+			TakeInitFrames(mat, info);
 		}
 		return sig;
 	}
 
 	bool RawEnergyVadStream::Reset() {
 		m_bg_energy = 0;
-		field_x34 = 0;
 		field_x2c = m_options.init_bg_energy ^ 1;
-		field_x38.clear();
-		field_x88.clear();
+		// Keep the buffer, the energies of the next stream need the same amount of space
+		std::fill(m_raw_energies.begin(), m_raw_energies.end(), RawEnergy{0, 0.0f, true});
+		m_raw_begin = 0;
+		m_raw_end = 0;
+		m_bg_energies.assign(m_options.bg_buffer_size, 0.0f);
+		m_bg_energies_pos = 0;
+		m_bg_energies_count = 0;
+		m_bg_energies_sum = 0;
+		field_x34 = 0;
 		m_someMatrix.Resize(0, 0);
+		m_init_rows = 0;
 		field_xf0.clear();
+		m_bg_energy_valid = false;
 		return true;
 	}
 
@@ -75,72 +80,121 @@ namespace snowboy {
 
 	void RawEnergyVadStream::InitRawEnergyVad(Matrix* mat, std::vector<FrameInfo>* info) {
 		if (mat->m_rows == 0) return;
-		auto rows = m_someMatrix.m_rows;
-		m_someMatrix.Resize(mat->m_rows + rows, mat->m_cols, MatrixResizeType::kCopyData);
-		m_someMatrix.RowRange(rows, mat->m_cols).CopyFromMat(*mat, MatrixTransposeType::kNoTrans);
-		field_xf0.reserve(field_xf0.size() + info->size());
-		for (auto& e : *info)
-			field_xf0.push_back(e);
+		// Grow the buffer geometrically, the first chunks are usually all the same size
+		if (m_init_rows + mat->m_rows > m_someMatrix.m_rows) {
+			auto rows = std::max<size_t>(std::max<size_t>(m_init_rows + mat->m_rows, m_options.bg_buffer_size + mat->m_rows), m_someMatrix.m_rows * 2);
+			m_someMatrix.Resize(rows, mat->m_cols, MatrixResizeType::kCopyData);
+		}
+		m_someMatrix.RowRange(m_init_rows, mat->m_rows).CopyFromMat(*mat, MatrixTransposeType::kNoTrans);
+		field_xf0.insert(field_xf0.end(), info->begin(), info->end());
+		for (size_t r = 0; r < mat->m_rows; r++) {
+			auto dot = SubVector{*mat, r}.DotVec(SubVector{*mat, r});
+			dot = std::max(std::numeric_limits<float>::min(), dot);
+			AddRawEnergy(info->at(r).frame_id, logf(dot));
+		}
+		m_init_rows += mat->m_rows;
 		mat->Resize(0, 0);
 		info->clear();
-		if (m_someMatrix.m_rows >= m_options.bg_buffer_size) {
-			field_x38.resize(m_someMatrix.rows());
-			for (size_t r = 0; r < m_someMatrix.rows(); r++) {
-				auto dot = SubVector{m_someMatrix, r}.DotVec(SubVector{m_someMatrix, r});
-				dot = std::max(std::numeric_limits<float>::min(), dot);
-				dot = logf(dot);
-				auto& e = field_x38[r];
-				e.first = field_xf0[r].frame_id;
-				e.second = dot;
-			}
+		if (m_init_rows >= m_options.bg_buffer_size) {
+			auto half = m_options.bg_buffer_size / 2;
 			m_bg_energy = 0.0;
-			for (size_t i = m_options.bg_buffer_size / 2; i < field_x38.size(); i++) {
-				m_bg_energy += field_x38[i].second;
+			for (size_t i = half; i < m_init_rows; i++) {
+				m_bg_energy += m_raw_energies[field_xf0[i].frame_id & (m_raw_energies.size() - 1)].energy;
 			}
-			auto s = static_cast<ssize_t>(field_x38.size()) - m_options.bg_buffer_size / 2;
+			auto s = static_cast<ssize_t>(m_init_rows) - half;
 			if (s < 0) {
 				s *= 2;
 			}
 			m_bg_energy /= static_cast<float>(s);
 			m_bg_energy = std::min(m_options.bg_energy_cap, m_bg_energy);
-			for (size_t i = m_options.bg_buffer_size / 2; i < field_x38.size(); i++) {
-				if (field_x38[i].second - m_bg_energy > m_options.bg_energy_threshold)
-					field_xf0[i].flags |= 1;
-				else
-					field_xf0[i].flags &= ~1;
+			m_bg_energy_valid = true;
+			for (size_t i = half; i < m_init_rows; i++) {
+				SetFrameFlags(m_raw_energies[field_xf0[i].frame_id & (m_raw_energies.size() - 1)].energy - m_bg_energy, &field_xf0[i]);
 			}
-			mat->Swap(&m_someMatrix);
-			field_xf0.swap(*info);
+			TakeInitFrames(mat, info);
 			field_x2c = true;
 		}
 	}
 
+	void RawEnergyVadStream::TakeInitFrames(Matrix* mat, std::vector<FrameInfo>* info) {
+		if (m_init_rows == m_someMatrix.m_rows) {
+			mat->Swap(&m_someMatrix);
+		} else {
+			mat->Resize(m_init_rows, m_someMatrix.m_cols, MatrixResizeType::kUndefined);
+			mat->CopyFromMat(m_someMatrix.RowRange(0, m_init_rows), MatrixTransposeType::kNoTrans);
+		}
+		m_someMatrix.Resize(0, 0);
+		m_init_rows = 0;
+		info->clear();
+		info->swap(field_xf0);
+	}
+
+	void RawEnergyVadStream::AddRawEnergy(unsigned int frame_id, float energy) {
+		if (m_raw_begin == m_raw_end) {
+			m_raw_begin = frame_id;
+		} else if (frame_id != m_raw_end) {
+			// Frame ids are consecutive, anything else means a new stream
+			m_raw_begin = frame_id;
+		}
+		m_raw_end = frame_id + 1;
+		auto needed = static_cast<size_t>(m_raw_end - m_raw_begin);
+		if (needed > m_raw_energies.size()) {
+			size_t size = 16;
+			while (size < needed)
+				size *= 2;
+			std::vector<RawEnergy> energies(size, RawEnergy{0, 0.0f, true});
+			for (auto id = m_raw_begin; id != frame_id; id++) {
+				energies[id & (size - 1)] = m_raw_energies[id & (m_raw_energies.size() - 1)];
+			}
+			m_raw_energies.swap(energies);
+		}
+		m_raw_energies[frame_id & (m_raw_energies.size() - 1)] = RawEnergy{frame_id, energy, false};
+	}
+
+	void RawEnergyVadStream::KeepRawEnergies(size_t num_frames) {
+		if (m_raw_end - m_raw_begin > num_frames) m_raw_begin = m_raw_end - num_frames;
+	}
+
+	void RawEnergyVadStream::SetFrameFlags(float energy, FrameInfo* info) const {
+		if (energy > m_options.bg_energy_threshold) {
+			info->flags |= 0x1;
+		} else {
+			info->flags &= ~0x1;
+		}
+		// 0x2 marks frames the energy alone is enough to decide on
+		if (m_options.confident_margin >= 0.0f && m_bg_energy_valid && std::abs(energy - m_options.bg_energy_threshold) > m_options.confident_margin) {
+			info->flags |= 0x2;
+		} else {
+			info->flags &= ~0x2;
+		}
+	}
+
 	void RawEnergyVadStream::UpdateBackgroundEnergy(const std::vector<FrameInfo>& info) {
-		if (info.size() != 0) {
-			auto ppVar7 = field_x38.begin();
-			while (field_x38.size() != 0) {
-				if (info[0].frame_id <= ppVar7->first) {
-					for (size_t uVar20 = 0; uVar20 < info.size(); uVar20++) {
-						if (info[uVar20].frame_id == ppVar7->first) {
-							if ((info[uVar20].flags & 1) == 0) {
-								field_x88.push_back(ppVar7->second);
-							}
-							ppVar7 = field_x38.erase(ppVar7);
-						}
-					}
-					auto pfVar6 = field_x88.begin();
-					while (m_options.bg_buffer_size < field_x88.size()) {
-						this->field_x34 = this->field_x34 - *pfVar6;
-						pfVar6 = field_x88.erase(pfVar6);
-					}
-					if (m_options.bg_buffer_size != field_x88.size()) {
-						return;
-					}
-					m_bg_energy = std::min(field_x34 / (float)m_options.bg_buffer_size, m_options.bg_energy_cap);
-					return;
-				}
-				ppVar7 = field_x38.erase(ppVar7);
+		if (m_raw_energies.empty() || m_bg_energies.empty()) return;
+		bool updated = false;
+		for (auto& e : info) {
+			if (e.frame_id < m_raw_begin || e.frame_id >= m_raw_end) continue;
+			auto& raw = m_raw_energies[e.frame_id & (m_raw_energies.size() - 1)];
+			if (raw.used || raw.frame_id != e.frame_id) continue;
+			raw.used = true;
+			// Frames before this one will never be reported again
+			m_raw_begin = e.frame_id + 1;
+			if ((e.flags & 1) != 0) continue;
+			if (m_bg_energies_count == m_bg_energies.size()) {
+				m_bg_energies_sum -= m_bg_energies[m_bg_energies_pos];
+				field_x34 = static_cast<int>(field_x34 - m_bg_energies[m_bg_energies_pos]);
+			} else {
+				m_bg_energies_count++;
 			}
+			m_bg_energies[m_bg_energies_pos] = raw.energy;
+			m_bg_energies_sum += raw.energy;
+			m_bg_energies_pos = (m_bg_energies_pos + 1) % m_bg_energies.size();
+			updated = true;
+		}
+		if (updated && m_bg_energies_count == m_bg_energies.size()) {
+			auto sum = m_exact_bg_energy ? static_cast<float>(m_bg_energies_sum) : static_cast<float>(field_x34);
+			m_bg_energy = std::min(sum / static_cast<float>(m_bg_energies.size()), m_options.bg_energy_cap);
+			m_bg_energy_valid = true;
 		}
 	}
 
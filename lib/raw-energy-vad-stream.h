@@ -1,7 +1,7 @@
 #pragma once
-#include <deque>
 #include <matrix-wrapper.h>
 #include <stream-itf.h>
+#include <vector>
 
 struct AGC_Instance;
 struct NS3_Instance;
@@ -13,17 +13,41 @@ namespace snowboy {
 		float bg_energy_cap;
 		uint32_t bg_buffer_size;
 		uint32_t raw_buffer_extra;
+		float confident_margin;
 		void Register(const std::string&, OptionsItf*);
 	};
 	struct RawEnergyVadStream : StreamItf {
+		struct RawEnergy {
+			unsigned int frame_id;
+			float energy;
+			bool used;
+		};
+
 		RawEnergyVadStreamOptions m_options;
 		bool field_x2c;
 		float m_bg_energy; // might be
+		// Log energies of the recent frames, indexed by frame id modulo the size (a power of two)
+		std::vector<RawEnergy> m_raw_energies;
+		// Frame ids [m_raw_begin, m_raw_end) are valid in m_raw_energies
+		unsigned int m_raw_begin;
+		unsigned int m_raw_end;
+		// Circular buffer of the last bg_buffer_size non-voice energies and their sum
+		std::vector<float> m_bg_energies;
+		size_t m_bg_energies_pos;
+		size_t m_bg_energies_count;
+		double m_bg_energies_sum;
+		// Sum of the original library, which only ever subtracts the energies leaving the buffer.
+		// This keeps its estimate far below any real background, so the energy VAD rarely reports
+		// non-voice. Used for the estimate unless m_exact_bg_energy is set.
 		int field_x34;
-		std::deque<std::pair<unsigned int, float>> field_x38;
-		std::deque<float> field_x88;
+		// Estimate the background from m_bg_energies_sum instead, the tiered VAD relies on it
+		bool m_exact_bg_energy;
+		// Frames buffered until the background energy is initialized, only m_init_rows are used
 		Matrix m_someMatrix;
+		size_t m_init_rows;
 		std::vector<FrameInfo> field_xf0;
+		// False until the background energy was estimated once
+		bool m_bg_energy_valid;
 
 		RawEnergyVadStream(const RawEnergyVadStreamOptions& options);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
@@ -33,5 +57,11 @@ namespace snowboy {
 
 		void InitRawEnergyVad(Matrix*, std::vector<FrameInfo>*);
 		void UpdateBackgroundEnergy(const std::vector<FrameInfo>&);
+
+	private:
+		void SetFrameFlags(float energy, FrameInfo* info) const;
+		void AddRawEnergy(unsigned int frame_id, float energy);
+		void KeepRawEnergies(size_t num_frames);
+		void TakeInitFrames(Matrix* mat, std::vector<FrameInfo>* info);
 	};
 } // namespace snowboy
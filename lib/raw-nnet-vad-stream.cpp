@@ -2,7 +2,6 @@
 #include <nnet-lib.h>
 #include <raw-nnet-vad-stream.h>
 #include <snowboy-error.h>
-#include <snowboy-io.h>
 #include <snowboy-options.h>
 
 namespace snowboy {
@@ -16,25 +15,27 @@ namespace snowboy {
 		m_options = options;
 		if (m_options.model_filename == "")
 			throw snowboy_exception{"please specify the neural network VAD model."};
-		m_nnet.reset(new Nnet(true));
-		Input model{m_options.model_filename};
-		m_nnet->Read(model.is_binary(), model.Stream());
+		m_model = Nnet::Load(m_options.model_filename, true);
+		m_nnet.reset(new Nnet{*m_model});
 		auto dims = m_nnet->OutputDim();
 		if (dims <= m_options.non_voice_index || m_options.non_voice_index < 0)
 			throw snowboy_exception{"index " + std::to_string(m_options.non_voice_index)
 									+ " for non-voice label runs out of range (0 - " + std::to_string(dims) + "), wrong index?"};
 	}
 
+	RawNnetVadStream::RawNnetVadStream(const RawNnetVadStream& other)
+		: m_options{other.m_options}, m_model{other.m_model}, m_nnet{new Nnet{*other.m_nnet}}, m_fieldx30{other.m_fieldx30} {}
+
 	int RawNnetVadStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
-		Matrix tmat;
-		std::vector<FrameInfo> tinfo;
+		auto& tmat = m_input;
+		auto& tinfo = m_input_info;
 		auto sig = m_connectedStream->Read(&tmat, &tinfo);
 		if ((sig & 0xc2) != 0) {
 			mat->Resize(0, 0);
 			info->clear();
 			return sig;
 		}
-		Matrix nnet_output;
+		auto& nnet_output = m_nnet_output;
 		if ((sig & 0x18) == 0) {
 			m_nnet->Compute(tmat, tinfo, &nnet_output, info);
 		} else {
@@ -42,7 +43,7 @@ namespace snowboy {
 		}
 		auto cols = m_fieldx30.m_cols;
 		if (cols < 1) cols = tmat.m_cols;
-		Matrix m;
+		auto& m = m_joined;
 		m.Resize(tmat.m_rows + m_fieldx30.m_rows, cols);
 		if (m_fieldx30.m_rows > 0) {
 			m.RowRange(0, m_fieldx30.m_rows).CopyFromMat(m_fieldx30, MatrixTransposeType::kNoTrans);
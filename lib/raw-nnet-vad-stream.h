@@ -1,5 +1,6 @@
 #pragma once
 #include <deque>
+#include <frame-info.h>
 #include <matrix-wrapper.h>
 #include <memory>
 #include <stream-itf.h>
@@ -17,11 +18,20 @@ namespace snowboy {
 	};
 	struct RawNnetVadStream : StreamItf {
 		RawNnetVadStreamOptions m_options;
+		// Network as read from the model file, kept so the registry knows it is in use
+		std::shared_ptr<const Nnet> m_model;
 		std::unique_ptr<Nnet> m_nnet;
 		// TODO: Do we need this ?
 		Matrix m_fieldx30;
+		// Kept between reads to avoid allocating
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
+		Matrix m_nnet_output;
+		Matrix m_joined;
 
 		RawNnetVadStream(const RawNnetVadStreamOptions& options);
+		// Copies the state, the network weights are shared with other
+		RawNnetVadStream(const RawNnetVadStream& other);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
 		virtual bool Reset() override;
 		virtual std::string Name() const override;
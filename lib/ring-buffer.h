@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace snowboy {
+	/**
+	 * Double ended queue stored in a circular buffer.
+	 *
+	 * Unlike std::deque popping never frees storage, so a queue whose size is bounded stops allocating
+	 * once it reached its maximum size. Popped and cleared elements are not destroyed, elements which
+	 * own memory keep it for the next push.
+	 */
+	template <typename T>
+	class RingBuffer {
+		std::vector<T> m_data;
+		size_t m_begin = 0;
+		size_t m_size = 0;
+
+		void Grow() {
+			std::vector<T> data(std::max<size_t>(m_data.size() * 2, 16));
+			for (size_t i = 0; i < m_size; i++)
+				data[i] = std::move((*this)[i]);
+			m_data.swap(data);
+			m_begin = 0;
+		}
+
+	public:
+		bool empty() const noexcept { return m_size == 0; }
+		size_t size() const noexcept { return m_size; }
+		void clear() noexcept {
+			m_begin = 0;
+			m_size = 0;
+		}
+
+		// Element i counted from the front
+		T& operator[](size_t i) noexcept {
+			auto idx = m_begin + i;
+			if (idx >= m_data.size()) idx -= m_data.size();
+			return m_data[idx];
+		}
+		const T& operator[](size_t i) const noexcept {
+			auto idx = m_begin + i;
+			if (idx >= m_data.size()) idx -= m_data.size();
+			return m_data[idx];
+		}
+		T& front() noexcept { return m_data[m_begin]; }
+		const T& front() const noexcept { return m_data[m_begin]; }
+		T& back() noexcept { return (*this)[m_size - 1]; }
+		const T& back() const noexcept { return (*this)[m_size - 1]; }
+
+		void push_back(const T& value) {
+			if (m_size == m_data.size()) Grow();
+			m_size++;
+			back() = value;
+		}
+		// Appends an element and returns it, it holds the value of a previously popped element or a default constructed one
+		T& emplace_back() {
+			if (m_size == m_data.size()) Grow();
+			m_size++;
+			return back();
+		}
+		void push_front(const T& value) {
+			if (m_size == m_data.size()) Grow();
+			m_begin = (m_begin == 0 ? m_data.size() : m_begin) - 1;
+			m_size++;
+			front() = value;
+		}
+		void pop_front() noexcept {
+			if (++m_begin == m_data.size()) m_begin = 0;
+			m_size--;
+		}
+		void pop_back() noexcept { m_size--; }
+	};
+} // namespace snowboy
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <audio-lib.h>
+#include <frame-info.h>
+#include <intercept-stream.h>
+#include <limits>
+#include <matrix-wrapper.h>
+#include <nnet-lib.h>
+#include <nnet-stream.h>
+#include <ostream>
+#include <pipeline-detect.h>
+#include <raw-energy-vad-stream.h>
+#include <sensitivity-sweep.h>
+#include <snowboy-error.h>
+#include <snowboy-utils.h>
+#include <template-detect-stream.h>
+#include <universal-detect-stream.h>
+#include <vad-state-stream.h>
+
+namespace snowboy {
+	struct SensitivitySweep::File {
+		struct Chunk {
+			// Index of the block of samples this chunk was produced from
+			size_t block;
+			int signal;
+			// Rows of features belonging to this chunk
+			size_t template_begin;
+			size_t template_rows;
+			std::vector<FrameInfo> template_info;
+			// Raw network output for every universal model
+			std::vector<Matrix> posteriors;
+			std::vector<std::vector<FrameInfo>> posterior_info;
+		};
+
+		std::string name;
+		int expected_hotword;
+		double seconds;
+		std::vector<Chunk> chunks;
+		Matrix features;
+		// First history row for every slide step
+		std::vector<size_t> history_begin;
+		// DTW distance for every model, template and slide step
+		std::vector<std::vector<std::vector<float>>> distances;
+	};
+
+	SensitivitySweep::SensitivitySweep(const std::string& resource_filename, const std::string& model_str, size_t chunk_samples)
+		: m_chunk_samples{chunk_samples} {
+		if (m_chunk_samples == 0)
+			throw snowboy_exception{"chunk size should be positive"};
+		PipelineDetectOptions options{};
+		options.applyFrontend = false;
+		options.sampleRate = 16000;
+		m_pipeline.reset(new PipelineDetect{options});
+		m_pipeline->SetResource(resource_filename);
+		m_pipeline->SetModel(model_str);
+		m_pipeline->Init();
+		m_pipeline->SetMaxAudioAmplitude(GetMaxWaveAmplitude(16));
+		if (m_pipeline->m_universalDetectStream) {
+			for (auto& m : m_pipeline->m_universalDetectStream->m_model_info) {
+				for (auto& kw : m.keywords)
+					m_default_high_sensitivity.push_back(kw.high_sensitivity);
+			}
+		}
+	}
+
+	SensitivitySweep::~SensitivitySweep() {}
+
+	void SensitivitySweep::AddFile(const std::string& name, const int16_t* data, size_t num_samples, int expected_hotword) {
+		auto& p = *m_pipeline;
+		std::unique_ptr<File> file{new File{}};
+		file->name = name;
+		file->expected_hotword = expected_hotword;
+		file->seconds = num_samples / static_cast<double>(p.GetPipelineSampleRate());
+		file->features.Resize(0, 0);
+
+		p.Reset();
+		for (size_t offset = 0, block = 0; offset < num_samples; offset += m_chunk_samples, block++) {
+			auto len = std::min(m_chunk_samples, num_samples - offset);
+			auto is_end = offset + len >= num_samples;
+			Matrix samples;
+			samples.Resize(1, len, MatrixResizeType::kUndefined);
+			for (size_t i = 0; i < len; i++)
+				samples(0, i) = data[offset + i];
+
+			// Same as PipelineDetect::RunDetection, but the detect streams only
+			// produce the network outputs, the decision is made during replay.
+			std::vector<FrameInfo> info;
+			info.resize(samples.m_rows);
+			p.m_interceptStream->SetData(samples, info, static_cast<SnowboySignal>(is_end ? 0x30 : 0x20));
+			int x = 0;
+			while (x == 0) {
+				Matrix tmat;
+				std::vector<FrameInfo> tinfo;
+				auto tres = p.m_vadStateStream2->Read(&tmat, &tinfo);
+				p.m_rawEnergyVadStream->UpdateBackgroundEnergy(p.m_eavesdropStreamFrameInfoVector);
+				p.m_eavesdropStreamFrameInfoVector.clear();
+
+				File::Chunk chunk;
+				chunk.block = block;
+				chunk.signal = tres;
+				chunk.template_begin = file->features.rows();
+				chunk.template_rows = 0;
+				if (p.m_templateDetectStream) {
+					Matrix feat;
+					p.m_templateDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
+					x = p.m_templateDetectNnetStream->Read(&feat, &chunk.template_info);
+					if ((x & 0xc2) == 0 && feat.rows() != 0) {
+						chunk.template_rows = feat.rows();
+						file->features.Resize(chunk.template_begin + feat.rows(), feat.cols(), MatrixResizeType::kCopyData);
+						file->features.RowRange(chunk.template_begin, feat.rows()).CopyFromMat(feat, MatrixTransposeType::kNoTrans);
+					}
+				}
+				if (p.m_universalDetectStream) {
+					auto& u = *p.m_universalDetectStream;
+					Matrix umat;
+					std::vector<FrameInfo> uinfo;
+					p.m_universalDetectInterceptStream->SetData(tmat, tinfo, static_cast<SnowboySignal>(tres));
+					auto ures = p.m_universalDetectInterceptStream->Read(&umat, &uinfo);
+					if ((ures & 0xc2) == 0) {
+						chunk.posteriors.resize(u.m_model_info.size());
+						chunk.posterior_info.resize(u.m_model_info.size());
+						u.ComputeSharedPrefixes(umat, (ures & 0x18) != 0);
+						for (size_t m = 0; m < u.m_model_info.size(); m++) {
+							u.ComputeNetwork(m, umat, uinfo, (ures & 0x18) != 0, &chunk.posteriors[m], &chunk.posterior_info[m]);
+						}
+						if ((ures & 0x18) != 0) u.Reset();
+					}
+					x |= ures;
+				}
+				file->chunks.push_back(std::move(chunk));
+				x &= 0x20;
+			}
+		}
+		ComputeDistances(file.get());
+		m_files.push_back(std::move(file));
+	}
+
+	size_t SensitivitySweep::NumFiles() const {
+		return m_files.size();
+	}
+
+	int SensitivitySweep::NumHotwords() const {
+		return m_pipeline->NumHotwords();
+	}
+
+	void SensitivitySweep::ComputeDistances(File* file) const {
+		auto t = m_pipeline->m_templateDetectStream.get();
+		if (t == nullptr) return;
+		auto slide_step = static_cast<size_t>(t->m_options.slide_step);
+
+		size_t history_begin = 0;
+		for (auto& c : file->chunks) {
+			for (size_t slide_pos = 0; slide_pos < c.template_rows; slide_pos += slide_step)
+				file->history_begin.push_back(history_begin);
+			if ((c.signal & 0x18) != 0) history_begin = c.template_begin + c.template_rows;
+		}
+
+		std::vector<std::pair<size_t, size_t>> templates;
+		file->distances.resize(t->NumModels());
+		for (size_t m = 0; m < t->NumModels(); m++) {
+			auto ntemplates = t->m_index.GetModel(m).m_container.NumTemplates();
+			file->distances[m].resize(ntemplates);
+			for (size_t i = 0; i < ntemplates; i++)
+				templates.emplace_back(m, i);
+		}
+		// Templates are independent of each other, run them concurrently
+		ParallelFor(templates.size(), [&](size_t idx) {
+			auto m = templates[idx].first;
+			auto i = templates[idx].second;
+			SlidingDtw dtw{t->m_options.dtw_options};
+			dtw.SetReference(t->m_index.GetModel(m).m_container.GetTemplate(i));
+			// Only distances below the sensitivity matter, which early stopping does not change
+			dtw.SetEarlyStopThreshold(std::numeric_limits<float>::max());
+			auto& res = file->distances[m][i];
+			res.reserve(file->history_begin.size());
+			size_t step_id = 0;
+			for (auto& c : file->chunks) {
+				for (size_t slide_pos = 0; slide_pos < c.template_rows; slide_pos += slide_step) {
+					auto step = std::min(slide_step, c.template_rows - slide_pos);
+					auto end = c.template_begin + slide_pos + step;
+					auto begin = std::max(file->history_begin[step_id], end > dtw.GetWindowSize() ? end - dtw.GetWindowSize() : 0);
+					res.push_back(dtw.ComputeDtwDistance(step, file->features.RowRange(begin, end - begin)));
+					step_id++;
+				}
+				if ((c.signal & 0x18) != 0) dtw.Reset();
+			}
+		});
+	}
+
+	float SensitivitySweep::ComputeDistance(size_t model_id, size_t template_id, const File& file, size_t begin, size_t end) const {
+		auto t = m_pipeline->m_templateDetectStream.get();
+		SlidingDtw dtw{t->m_options.dtw_options};
+		dtw.SetReference(t->m_index.GetModel(model_id).m_container.GetTemplate(template_id));
+		dtw.SetEarlyStopThreshold(std::numeric_limits<float>::max());
+		return dtw.ComputeDtwDistance(end - begin, file.features.RowRange(begin, end - begin));
+	}
+
+	std::vector<std::vector<int>> SensitivitySweep::Replay(float sensitivity, float high_sensitivity) {
+		auto& p = *m_pipeline;
+		auto t = p.m_templateDetectStream.get();
+		auto u = p.m_universalDetectStream.get();
+		if (u) {
+			size_t idx = 0;
+			for (auto& m : u->m_model_info) {
+				for (auto& kw : m.keywords) {
+					kw.sensitivity = sensitivity;
+					kw.high_sensitivity = high_sensitivity < 0.0f ? m_default_high_sensitivity[idx] : high_sensitivity;
+					idx++;
+				}
+			}
+		}
+
+		std::vector<std::vector<int>> res(m_files.size());
+		for (size_t f = 0; f < m_files.size(); f++) {
+			auto& file = *m_files[f];
+			if (u) {
+				u->ResetDetection();
+				u->field_x58 = u->m_options.min_detection_interval;
+				u->field_x5c = u->m_options.min_detection_interval;
+				u->field_x60 = false;
+				u->field_x64 = 0;
+				u->field_x68 = false;
+				u->field_x6c = 0;
+			}
+			size_t history_begin = 0;
+			size_t step_id = 0;
+			size_t skip_block = std::numeric_limits<size_t>::max();
+			for (auto& c : file.chunks) {
+				int detected = 0;
+				if (t) {
+					auto slide_step = static_cast<size_t>(t->m_options.slide_step);
+					for (size_t slide_pos = 0; slide_pos < c.template_rows; slide_pos += slide_step, step_id++) {
+						if (detected != 0 || c.block == skip_block) continue;
+						auto step = std::min(slide_step, c.template_rows - slide_pos);
+						auto end = c.template_begin + slide_pos + step;
+						for (size_t m = 0; m < t->NumModels() && detected == 0; m++) {
+							size_t matched = 0;
+							auto& distances = file.distances[m];
+							for (size_t i = 0; i < distances.size(); i++) {
+								auto window = t->m_index.GetModel(m).m_container.GetTemplate(i)->rows();
+								auto start = end > window ? end - window : 0;
+								auto distance = distances[i][step_id];
+								// The cached distance assumed a different history, recompute
+								if (std::max(start, history_begin) != std::max(start, file.history_begin[step_id]))
+									distance = ComputeDistance(m, i, file, std::max(start, history_begin), end);
+								if (distance < sensitivity) matched++;
+							}
+							if (distances.size() * 0.5f < matched) detected = p.m_personal_kw_mapping[m];
+						}
+					}
+				}
+				if (u && detected == 0 && c.block != skip_block) {
+					for (size_t m = 0; m < c.posteriors.size() && detected == 0; m++) {
+						Matrix posteriors{c.posteriors[m]};
+						auto id = u->DetectHotword(m, &posteriors, c.posterior_info[m], nullptr);
+						if (id != 0) detected = p.m_universal_kw_mapping[id - 1];
+					}
+				}
+				if (detected != 0) {
+					// The pipeline is reset and the rest of the block is dropped
+					res[f].push_back(detected);
+					skip_block = c.block;
+					history_begin = c.template_begin + c.template_rows;
+					if (u) u->ResetDetection();
+				} else if ((c.signal & 0x18) != 0) {
+					history_begin = c.template_begin + c.template_rows;
+					if (u) u->ResetDetection();
+				}
+			}
+		}
+		return res;
+	}
+
+	std::vector<SensitivitySweep::Point> SensitivitySweep::Run(const std::vector<float>& sensitivities, const std::vector<float>& high_sensitivities) {
+		std::vector<float> high = high_sensitivities;
+		if (high.empty()) high.push_back(-1.0f);
+
+		size_t positives = 0;
+		double hours = 0.0;
+		for (auto& f : m_files) {
+			if (f->expected_hotword > 0) positives++;
+			hours += f->seconds / 3600.0;
+		}
+
+		std::vector<Point> res;
+		for (auto s : sensitivities) {
+			for (auto h : high) {
+				Point pt{};
+				pt.sensitivity = s;
+				pt.high_sensitivity = h;
+				auto detections = Replay(s, h);
+				for (size_t f = 0; f < m_files.size(); f++) {
+					auto expected = m_files[f]->expected_hotword;
+					auto it = std::find(detections[f].begin(), detections[f].end(), expected);
+					if (expected > 0 && it != detections[f].end()) {
+						pt.true_positives++;
+						pt.false_alarms += detections[f].size() - 1;
+					} else {
+						if (expected > 0) pt.false_negatives++;
+						pt.false_alarms += detections[f].size();
+					}
+				}
+				pt.recall = positives == 0 ? 0.0 : pt.true_positives / static_cast<double>(positives);
+				pt.miss_rate = positives == 0 ? 0.0 : pt.false_negatives / static_cast<double>(positives);
+				pt.false_alarms_per_hour = hours == 0.0 ? 0.0 : pt.false_alarms / hours;
+				res.push_back(pt);
+			}
+		}
+		return res;
+	}
+
+	void SensitivitySweep::WriteCsv(const std::vector<Point>& points, std::ostream& os) {
+		os << "sensitivity,high_sensitivity,true_positives,false_negatives,false_alarms,recall,miss_rate,false_alarms_per_hour\n";
+		for (auto& e : points) {
+			os << e.sensitivity << ",";
+			if (e.high_sensitivity >= 0.0f) os << e.high_sensitivity;
+			os << "," << e.true_positives << "," << e.false_negatives << "," << e.false_alarms
+			   << "," << e.recall << "," << e.miss_rate << "," << e.false_alarms_per_hour << "\n";
+		}
+	}
+} // namespace snowboy
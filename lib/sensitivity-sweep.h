@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace snowboy {
+	class PipelineDetect;
+
+	/**
+	 * Offline evaluation of a detector over a grid of sensitivities.
+	 *
+	 * Every file is run through the front end and the neural networks once,
+	 * the network outputs and template DTW distances are cached and the
+	 * detection decision is replayed for each point of the grid.
+	 * The replay resets the detection state after a detection like the
+	 * detect streams do, but the front end keeps running. Results can
+	 * therefore differ slightly from SnowboyDetect right after a detection.
+	 */
+	class SensitivitySweep {
+	public:
+		struct Point {
+			float sensitivity;
+			// Negative if the model defaults were used
+			float high_sensitivity;
+			// Positive files where the expected hotword was detected
+			size_t true_positives;
+			size_t false_negatives;
+			// Detections in negative files, detections of the wrong hotword and repeated detections
+			size_t false_alarms;
+			double recall;
+			double miss_rate;
+			double false_alarms_per_hour;
+		};
+
+		SensitivitySweep(const std::string& resource_filename, const std::string& model_str, size_t chunk_samples = 1600);
+		~SensitivitySweep();
+
+		/**
+		 * \brief Run the file through the pipeline and cache the results.
+		 *
+		 * @param data              16 bit mono samples at 16kHz
+		 * @param expected_hotword  Hotword id spoken in the file, 0 if it should not trigger
+		 */
+		void AddFile(const std::string& name, const int16_t* data, size_t num_samples, int expected_hotword);
+		size_t NumFiles() const;
+		int NumHotwords() const;
+
+		/**
+		 * \brief Replay a single setting, returns the detected hotword ids for every file.
+		 */
+		std::vector<std::vector<int>> Replay(float sensitivity, float high_sensitivity = -1.0f);
+
+		/**
+		 * \brief Evaluate every combination of sensitivity and high sensitivity.
+		 *
+		 * An empty high_sensitivities list keeps the values of the models.
+		 */
+		std::vector<Point> Run(const std::vector<float>& sensitivities, const std::vector<float>& high_sensitivities);
+
+		/**
+		 * \brief Write the points as CSV, usable as ROC (recall over false alarms per hour)
+		 * or DET (miss rate over false alarms per hour) curve.
+		 */
+		static void WriteCsv(const std::vector<Point>& points, std::ostream& os);
+
+	private:
+		struct File;
+
+		void ComputeDistances(File* file) const;
+		float ComputeDistance(size_t model_id, size_t template_id, const File& file, size_t begin, size_t end) const;
+
+		std::unique_ptr<PipelineDetect> m_pipeline;
+		size_t m_chunk_samples;
+		std::vector<std::unique_ptr<File>> m_files;
+		std::vector<float> m_default_high_sensitivity;
+	};
+} // namespace snowboy
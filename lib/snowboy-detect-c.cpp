@@ -37,6 +37,19 @@ extern "C"
 		}
 	}
 
+	SNOWMAN_Detect* SNOWMAN_Detect_Clone(SNOWMAN_Detect* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return nullptr;
+		}
+		try {
+			return new SNOWMAN_Detect{*instance};
+		} catch (...) {
+			errno = EIO;
+			return nullptr;
+		}
+	}
+
 	int SNOWMAN_Detect_Reset(SNOWMAN_Detect* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -212,6 +225,56 @@ extern "C"
 		}
 	}
 
+	int SNOWMAN_Detect_GateNonVoice(SNOWMAN_Detect* instance, int gate) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->GateNonVoice(gate != 0);
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_Detect_GetStats(SNOWMAN_Detect* instance, char** pointer) {
+		if (pointer == nullptr) return 0;
+		if (instance == nullptr || *pointer != nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			auto s = instance->GetStats();
+			*pointer = static_cast<char*>(malloc(s.size() + 1));
+			if (*pointer == nullptr) {
+				errno = ENOMEM;
+				return -1;
+			}
+			strcpy(*pointer, s.c_str());
+			(*pointer)[s.size()] = '\0';
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_Detect_ResetStats(SNOWMAN_Detect* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->ResetStats();
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
 	int SNOWMAN_Detect_SampleRate(SNOWMAN_Detect* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -275,6 +338,19 @@ extern "C"
 		}
 	}
 
+	SNOWMAN_Vad* SNOWMAN_Vad_Clone(SNOWMAN_Vad* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return nullptr;
+		}
+		try {
+			return new SNOWMAN_Vad{*instance};
+		} catch (...) {
+			errno = EIO;
+			return nullptr;
+		}
+	}
+
 	int SNOWMAN_Vad_Reset(SNOWMAN_Vad* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -373,6 +449,56 @@ extern "C"
 		}
 	}
 
+	int SNOWMAN_Vad_SetTieredVad(SNOWMAN_Vad* instance, int tiered) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->SetTieredVad(tiered != 0);
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_Vad_GetStats(SNOWMAN_Vad* instance, char** pointer) {
+		if (pointer == nullptr) return 0;
+		if (instance == nullptr || *pointer != nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			auto s = instance->GetStats();
+			*pointer = static_cast<char*>(malloc(s.size() + 1));
+			if (*pointer == nullptr) {
+				errno = ENOMEM;
+				return -1;
+			}
+			strcpy(*pointer, s.c_str());
+			(*pointer)[s.size()] = '\0';
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_Vad_ResetStats(SNOWMAN_Vad* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->ResetStats();
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
 	int SNOWMAN_Vad_SampleRate(SNOWMAN_Vad* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -520,6 +646,42 @@ extern "C"
 		}
 	}
 
+	int SNOWMAN_PersonalEnroll_GetStats(SNOWMAN_PersonalEnroll* instance, char** pointer) {
+		if (pointer == nullptr) return 0;
+		if (instance == nullptr || *pointer != nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			auto s = instance->GetStats();
+			*pointer = static_cast<char*>(malloc(s.size() + 1));
+			if (*pointer == nullptr) {
+				errno = ENOMEM;
+				return -1;
+			}
+			strcpy(*pointer, s.c_str());
+			(*pointer)[s.size()] = '\0';
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_PersonalEnroll_ResetStats(SNOWMAN_PersonalEnroll* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->ResetStats();
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
 	int SNOWMAN_PersonalEnroll_SampleRate(SNOWMAN_PersonalEnroll* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -619,6 +781,42 @@ extern "C"
 		}
 	}
 
+	int SNOWMAN_TemplateCut_GetStats(SNOWMAN_TemplateCut* instance, char** pointer) {
+		if (pointer == nullptr) return 0;
+		if (instance == nullptr || *pointer != nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			auto s = instance->GetStats();
+			*pointer = static_cast<char*>(malloc(s.size() + 1));
+			if (*pointer == nullptr) {
+				errno = ENOMEM;
+				return -1;
+			}
+			strcpy(*pointer, s.c_str());
+			(*pointer)[s.size()] = '\0';
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_TemplateCut_ResetStats(SNOWMAN_TemplateCut* instance) {
+		if (instance == nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			instance->ResetStats();
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
+
 	int SNOWMAN_TemplateCut_SampleRate(SNOWMAN_TemplateCut* instance) {
 		if (instance == nullptr) {
 			errno = EINVAL;
@@ -671,4 +869,45 @@ extern "C"
 			return;
 		}
 	}
+
+	int SNOWMAN_StartTrace(unsigned int max_events) {
+		if (max_events == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			snowboy::StartTrace(max_events);
+			return 0;
+		} catch (...) {
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	int SNOWMAN_StopTrace(void) {
+		snowboy::StopTrace();
+		return 0;
+	}
+
+	int SNOWMAN_GetTrace(char** pointer) {
+		if (pointer == nullptr) return 0;
+		if (*pointer != nullptr) {
+			errno = EINVAL;
+			return -1;
+		}
+		try {
+			auto s = snowboy::GetTraceJson();
+			*pointer = static_cast<char*>(malloc(s.size() + 1));
+			if (*pointer == nullptr) {
+				errno = ENOMEM;
+				return -1;
+			}
+			strcpy(*pointer, s.c_str());
+			(*pointer)[s.size()] = '\0';
+			return 0;
+		} catch (...) {
+			errno = EIO;
+			return -1;
+		}
+	}
 }
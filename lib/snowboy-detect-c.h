@@ -12,6 +12,8 @@ extern "C"
 	struct SNOWMAN_TemplateCut;
 
 	SNOWMAN_Detect* SNOWMAN_Detect_Create(const char* resource_filename, const char* model_str);
+	// Shares the loaded models with instance, the clone starts in the reset state
+	SNOWMAN_Detect* SNOWMAN_Detect_Clone(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_Reset(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_RunDetectionWave(SNOWMAN_Detect* instance, const void* data, unsigned int len, int is_end);
 	int SNOWMAN_Detect_RunDetectionFloat(SNOWMAN_Detect* instance, const float* data, unsigned int num_samples, int is_end);
@@ -25,12 +27,18 @@ extern "C"
 	int SNOWMAN_Detect_UpdateModel(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_NumHotwords(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_ApplyFrontend(SNOWMAN_Detect* instance, int apply);
+	int SNOWMAN_Detect_GateNonVoice(SNOWMAN_Detect* instance, int gate);
+	// Returned pointer needs to get freed using SNOWMAN_free
+	int SNOWMAN_Detect_GetStats(SNOWMAN_Detect* instance, char** pointer);
+	int SNOWMAN_Detect_ResetStats(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_SampleRate(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_NumChannels(SNOWMAN_Detect* instance);
 	int SNOWMAN_Detect_BitsPerSample(SNOWMAN_Detect* instance);
 	void SNOWMAN_Detect_Destroy(SNOWMAN_Detect* instance);
 
 	SNOWMAN_Vad* SNOWMAN_Vad_Create(const char* resource_filename);
+	// Shares the loaded network with instance, the clone starts in the reset state
+	SNOWMAN_Vad* SNOWMAN_Vad_Clone(SNOWMAN_Vad* instance);
 	int SNOWMAN_Vad_Reset(SNOWMAN_Vad* instance);
 	int SNOWMAN_Vad_RunVadWave(SNOWMAN_Vad* instance, const void* data, unsigned int len, int is_end);
 	int SNOWMAN_Vad_RunVadFloat(SNOWMAN_Vad* instance, const float* data, unsigned int num_samples, int is_end);
@@ -38,6 +46,10 @@ extern "C"
 	int SNOWMAN_Vad_RunVadInt(SNOWMAN_Vad* instance, const int* data, unsigned int num_samples, int is_end);
 	int SNOWMAN_Vad_SetAudioGain(SNOWMAN_Vad* instance, float gain);
 	int SNOWMAN_Vad_ApplyFrontend(SNOWMAN_Vad* instance, int apply);
+	int SNOWMAN_Vad_SetTieredVad(SNOWMAN_Vad* instance, int tiered);
+	// Returned pointer needs to get freed using SNOWMAN_free
+	int SNOWMAN_Vad_GetStats(SNOWMAN_Vad* instance, char** pointer);
+	int SNOWMAN_Vad_ResetStats(SNOWMAN_Vad* instance);
 	int SNOWMAN_Vad_SampleRate(SNOWMAN_Vad* instance);
 	int SNOWMAN_Vad_NumChannels(SNOWMAN_Vad* instance);
 	int SNOWMAN_Vad_BitsPerSample(SNOWMAN_Vad* instance);
@@ -50,6 +62,9 @@ extern "C"
 	int SNOWMAN_PersonalEnroll_RunEnrollmentShort(SNOWMAN_PersonalEnroll* instance, const short* data, unsigned int num_samples);
 	int SNOWMAN_PersonalEnroll_RunEnrollmentInt(SNOWMAN_PersonalEnroll* instance, const int* data, unsigned int num_samples);
 	int SNOWMAN_PersonalEnroll_GetNumTemplates(SNOWMAN_PersonalEnroll* instance);
+	// Returned pointer needs to get freed using SNOWMAN_free
+	int SNOWMAN_PersonalEnroll_GetStats(SNOWMAN_PersonalEnroll* instance, char** pointer);
+	int SNOWMAN_PersonalEnroll_ResetStats(SNOWMAN_PersonalEnroll* instance);
 	int SNOWMAN_PersonalEnroll_SampleRate(SNOWMAN_PersonalEnroll* instance);
 	int SNOWMAN_PersonalEnroll_NumChannels(SNOWMAN_PersonalEnroll* instance);
 	int SNOWMAN_PersonalEnroll_BitsPerSample(SNOWMAN_PersonalEnroll* instance);
@@ -59,11 +74,19 @@ extern "C"
 	int SNOWMAN_TemplateCut_Reset(SNOWMAN_TemplateCut* instance);
 	// Returned data needs to get freed using SNOWMAN_free
 	int SNOWMAN_TemplateCut_CutTemplateWave(SNOWMAN_TemplateCut* instance, const void* indata, unsigned int inlen, void** outdata, unsigned int* outlen);
+	// Returned pointer needs to get freed using SNOWMAN_free
+	int SNOWMAN_TemplateCut_GetStats(SNOWMAN_TemplateCut* instance, char** pointer);
+	int SNOWMAN_TemplateCut_ResetStats(SNOWMAN_TemplateCut* instance);
 	int SNOWMAN_TemplateCut_SampleRate(SNOWMAN_TemplateCut* instance);
 	int SNOWMAN_TemplateCut_NumChannels(SNOWMAN_TemplateCut* instance);
 	int SNOWMAN_TemplateCut_BitsPerSample(SNOWMAN_TemplateCut* instance);
 	void SNOWMAN_TemplateCut_Destroy(SNOWMAN_TemplateCut* instance);
 
+	int SNOWMAN_StartTrace(unsigned int max_events);
+	int SNOWMAN_StopTrace(void);
+	// Returned pointer needs to get freed using SNOWMAN_free
+	int SNOWMAN_GetTrace(char** pointer);
+
 #ifdef __cplusplus
 }
 #endif
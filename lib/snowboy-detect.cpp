@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <atomic>
 #include <audio-lib.h>
+#include <exception>
 #include <matrix-wrapper.h>
 #include <memory>
 #include <pipeline-detect.h>
@@ -7,12 +10,16 @@
 #include <pipeline-vad.h>
 #include <snowboy-detect.h>
 #include <snowboy-error.h>
+#include <thread>
+#include <trace-recorder.h>
 #include <wave-header.h>
 
 namespace snowboy {
 	SnowboyDetect::SnowboyDetect(const std::string& resource_filename, const std::string& model_str) {
 		PipelineDetectOptions options{};
 		options.applyFrontend = false;
+		options.gateNonVoice = false;
+		options.gateMinNonVoiceFrames = 0;
 		options.sampleRate = 16000;
 		detect_pipeline_.reset(new PipelineDetect{options});
 		detect_pipeline_->SetResource(resource_filename);
@@ -21,9 +28,17 @@ namespace snowboy {
 
 		wave_header_.reset(new WaveHeader{});
 		wave_header_->dwSamplesPerSec = detect_pipeline_->GetPipelineSampleRate();
+		input_.reset(new Matrix{});
 		detect_pipeline_->SetMaxAudioAmplitude(GetMaxWaveAmplitude(*wave_header_));
 	}
 
+	SnowboyDetect::SnowboyDetect(const SnowboyDetect& prototype)
+		: wave_header_{new WaveHeader{*prototype.wave_header_}}, detect_pipeline_{prototype.detect_pipeline_->Clone()}, input_{new Matrix{}} {}
+
+	std::unique_ptr<SnowboyDetect> SnowboyDetect::Clone() const {
+		return std::unique_ptr<SnowboyDetect>{new SnowboyDetect{*this}};
+	}
+
 	SnowboyDetect::~SnowboyDetect() {
 		wave_header_.reset();
 		detect_pipeline_.reset();
@@ -36,7 +51,7 @@ namespace snowboy {
 
 	int SnowboyDetect::RunDetection(const std::string& data, bool is_end) {
 		if ((data.size() % wave_header_->wBlockAlign) != 0) return -1;
-		Matrix data_mat;
+		auto& data_mat = *input_;
 		ReadRawWaveFromString(*wave_header_, data, &data_mat);
 		return detect_pipeline_->RunDetection(data_mat, is_end);
 	}
@@ -44,7 +59,7 @@ namespace snowboy {
 	int SnowboyDetect::RunDetection(const float* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyDetect: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -61,7 +76,7 @@ namespace snowboy {
 	int SnowboyDetect::RunDetection(const int16_t* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyDetect: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -77,7 +92,7 @@ namespace snowboy {
 	int SnowboyDetect::RunDetection(const int32_t* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyDetect: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -90,6 +105,105 @@ namespace snowboy {
 		return detect_pipeline_->RunDetection(mat, is_end);
 	}
 
+	std::vector<SnowboyDetection> SnowboyDetect::RunDetectionParallel(const int16_t* const data, const size_t array_length,
+																	  const int num_threads, const int chunk_length, const bool exact) {
+		if (data == nullptr)
+			throw snowboy_exception{"SnowboyDetect: data is NULL"};
+		if (num_threads < 1 || chunk_length < 1)
+			throw snowboy_exception{"SnowboyDetect: num_threads and chunk_length need to be positive"};
+
+		// Segment boundaries are aligned to chunks, so every segment sees the same chunks as a sequential run
+		const size_t chunk = chunk_length;
+		const size_t num_chunks = (array_length + chunk - 1) / chunk;
+		const size_t context_chunks = (detect_pipeline_->GetContextSamples() * wave_header_->wChannels + chunk - 1) / chunk;
+		const size_t context = context_chunks * chunk;
+		// A few segments per thread balance the load, but each needs to be long compared to its warm up
+		const size_t segment_chunks = std::max((num_chunks + num_threads * 4 - 1) / (num_threads * 4), context_chunks * 8);
+		const size_t num_segments = std::max<size_t>((num_chunks + segment_chunks - 1) / segment_chunks, 1);
+		auto segment_begin = [&](size_t i) { return std::min(i * segment_chunks * chunk, array_length); };
+		auto segment_warmup = [&](size_t i) { return segment_begin(i) > context ? segment_begin(i) - context : 0; };
+
+		// Every segment starts with a reset at its warm up position and records all detections, including
+		// the ones in the warm up, because each of them resets the pipeline.
+		std::vector<std::vector<SnowboyDetection>> results(num_segments);
+		std::atomic<size_t> next_segment{0};
+		std::vector<std::exception_ptr> errors(num_threads);
+		auto worker = [&](int id) {
+			try {
+				std::unique_ptr<SnowboyDetect> clone;
+				auto detector = this;
+				if (id != 0) {
+					clone = Clone();
+					detector = clone.get();
+				}
+				for (auto i = next_segment++; i < num_segments; i = next_segment++) {
+					detector->Reset();
+					for (size_t pos = segment_warmup(i); pos < segment_begin(i + 1); pos += chunk) {
+						auto len = std::min(chunk, array_length - pos);
+						auto res = detector->RunDetection(data + pos, len, pos + len == array_length);
+						if (res > 0) results[i].push_back({res, pos + len});
+					}
+				}
+			} catch (...) {
+				errors[id] = std::current_exception();
+				next_segment = num_segments;
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int i = 1; i < std::min<int>(num_threads, num_segments); i++)
+			threads.emplace_back(worker, i);
+		worker(0);
+		for (auto& e : threads)
+			e.join();
+		for (auto& e : errors) {
+			if (e) std::rethrow_exception(e);
+		}
+
+		// The pipeline never fully forgets: the background energy of the VAD and the smoothed posteriors of the
+		// detectors accumulate everything since the last reset. A segment is only in the state of the sequential
+		// pipeline once both were reset at the same position, at the start of the recording or by the same
+		// detection. Otherwise it is spliced in once both ran for at least the context since their last reset,
+		// which is close but not exact. Until then the segment is replaced by a sequential run.
+		auto segment_reset = [&](size_t i, size_t pos) {
+			auto res = segment_warmup(i);
+			for (auto& e : results[i]) {
+				if (e.position <= pos) res = e.position;
+			}
+			return res;
+		};
+		auto in_sync = [&](size_t reset, size_t other_reset, size_t pos) {
+			return reset == other_reset || (!exact && pos - reset >= context && pos - other_reset >= context);
+		};
+		std::vector<SnowboyDetection> res;
+		size_t last_reset = 0;
+		// End of the audio this detector has processed sequentially, it continues from there if nothing was spliced in between
+		size_t sequential_end = 0;
+		for (size_t i = 0; i < num_segments; i++) {
+			auto pos = segment_begin(i);
+			if (!in_sync(last_reset, segment_reset(i, pos), pos)) {
+				if (sequential_end != pos) {
+					Reset();
+					sequential_end = last_reset;
+				}
+				for (pos = sequential_end; pos < segment_begin(i + 1) && (pos < segment_begin(i) || !in_sync(last_reset, segment_reset(i, pos), pos)); pos += chunk) {
+					auto len = std::min(chunk, array_length - pos);
+					auto hotword = RunDetection(data + pos, len, pos + len == array_length);
+					if (hotword <= 0) continue;
+					res.push_back({hotword, pos + len});
+					last_reset = pos + len;
+				}
+				sequential_end = pos;
+			}
+			for (auto& e : results[i]) {
+				if (e.position <= pos) continue;
+				res.push_back(e);
+				last_reset = e.position;
+			}
+		}
+		Reset();
+		return res;
+	}
+
 	void SnowboyDetect::SetSensitivity(const std::string& sensitivity_str) {
 		detect_pipeline_->SetSensitivity(sensitivity_str);
 	}
@@ -118,6 +232,18 @@ namespace snowboy {
 		detect_pipeline_->ApplyFrontend(apply_frontend);
 	}
 
+	void SnowboyDetect::GateNonVoice(const bool gate_non_voice) {
+		detect_pipeline_->GateNonVoice(gate_non_voice);
+	}
+
+	std::string SnowboyDetect::GetStats() const {
+		return detect_pipeline_->Stats().ToJson();
+	}
+
+	void SnowboyDetect::ResetStats() {
+		detect_pipeline_->Stats().Clear();
+	}
+
 	int SnowboyDetect::SampleRate() const {
 		return wave_header_->dwSamplesPerSec;
 	}
@@ -140,9 +266,17 @@ namespace snowboy {
 
 		wave_header_.reset(new WaveHeader{});
 		wave_header_->dwSamplesPerSec = vad_pipeline_->GetPipelineSampleRate();
+		input_.reset(new Matrix{});
 		vad_pipeline_->SetMaxAudioAmplitude(GetMaxWaveAmplitude(*wave_header_));
 	}
 
+	SnowboyVad::SnowboyVad(const SnowboyVad& prototype)
+		: wave_header_{new WaveHeader{*prototype.wave_header_}}, vad_pipeline_{prototype.vad_pipeline_->Clone()}, input_{new Matrix{}} {}
+
+	std::unique_ptr<SnowboyVad> SnowboyVad::Clone() const {
+		return std::unique_ptr<SnowboyVad>{new SnowboyVad{*this}};
+	}
+
 	SnowboyVad::~SnowboyVad() {
 		wave_header_.reset();
 		vad_pipeline_.reset();
@@ -155,7 +289,7 @@ namespace snowboy {
 
 	int SnowboyVad::RunVad(const std::string& data, bool is_end) {
 		if ((data.size() % wave_header_->wBlockAlign) != 0) return -1;
-		Matrix data_mat;
+		auto& data_mat = *input_;
 		ReadRawWaveFromString(*wave_header_, data, &data_mat);
 		return vad_pipeline_->RunVad(data_mat, is_end);
 	}
@@ -163,7 +297,7 @@ namespace snowboy {
 	int SnowboyVad::RunVad(const float* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyVad: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -180,7 +314,7 @@ namespace snowboy {
 	int SnowboyVad::RunVad(const int16_t* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyVad: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -196,7 +330,7 @@ namespace snowboy {
 	int SnowboyVad::RunVad(const int32_t* const data, const int array_length, bool is_end) {
 		if (data == nullptr)
 			throw snowboy_exception{"SnowboyVad: data is NULL"};
-		Matrix mat;
+		auto& mat = *input_;
 		mat.Resize(wave_header_->wChannels, array_length / wave_header_->wChannels, MatrixResizeType::kSetZero);
 		// No idea if this is correct, but it looks right...
 		for (size_t c = 0; c < mat.cols(); c++)
@@ -217,6 +351,18 @@ namespace snowboy {
 		vad_pipeline_->ApplyFrontend(apply_frontend);
 	}
 
+	void SnowboyVad::SetTieredVad(const bool tiered_vad) {
+		vad_pipeline_->SetTieredVad(tiered_vad);
+	}
+
+	std::string SnowboyVad::GetStats() const {
+		return vad_pipeline_->Stats().ToJson();
+	}
+
+	void SnowboyVad::ResetStats() {
+		vad_pipeline_->Stats().Clear();
+	}
+
 	int SnowboyVad::SampleRate() const {
 		return wave_header_->dwSamplesPerSec;
 	}
@@ -315,6 +461,14 @@ namespace snowboy {
 		return enroll_pipeline_->GetNumTemplates();
 	}
 
+	std::string SnowboyPersonalEnroll::GetStats() const {
+		return enroll_pipeline_->Stats().ToJson();
+	}
+
+	void SnowboyPersonalEnroll::ResetStats() {
+		enroll_pipeline_->Stats().Clear();
+	}
+
 	int SnowboyPersonalEnroll::SampleRate() const {
 		return wave_header_->dwSamplesPerSec;
 	}
@@ -416,6 +570,14 @@ namespace snowboy {
 		return true;
 	}
 
+	std::string SnowboyTemplateCut::GetStats() const {
+		return cut_pipeline_->Stats().ToJson();
+	}
+
+	void SnowboyTemplateCut::ResetStats() {
+		cut_pipeline_->Stats().Clear();
+	}
+
 	int SnowboyTemplateCut::SampleRate() const {
 		return wave_header_->dwSamplesPerSec;
 	}
@@ -430,4 +592,20 @@ namespace snowboy {
 
 	SnowboyTemplateCut::~SnowboyTemplateCut() {}
 
+	void StartTrace(size_t max_events) {
+#ifdef SNOWMAN_ENABLE_TRACE
+		TraceRecorder::Start(max_events);
+#else
+		(void)max_events;
+#endif
+	}
+
+	void StopTrace() {
+		TraceRecorder::Stop();
+	}
+
+	std::string GetTraceJson() {
+		return TraceRecorder::ToJson();
+	}
+
 } // namespace snowboy
@@ -1,6 +1,9 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace snowboy {
 	namespace testing {
@@ -12,6 +15,17 @@ namespace snowboy {
 	class PipelinePersonalEnroll;
 	class PipelineTemplateCut;
 	struct MatrixBase;
+	struct Matrix;
+
+	/**
+	 * \brief Hotword found by SnowboyDetect::RunDetectionParallel().
+	 */
+	struct SnowboyDetection {
+		/** \brief Index of the hotword, see SnowboyDetect::RunDetection() */
+		int hotword;
+		/** \brief Offset in elements of the end of the chunk the hotword was detected in */
+		size_t position;
+	};
 
 	/**
 	 * \brief Hotword detector class.
@@ -48,6 +62,18 @@ namespace snowboy {
 		SnowboyDetect(const std::string& resource_filename,
 					  const std::string& model_str);
 
+		/**
+		 * \brief Creates a detector with the same models and settings.
+		 *
+		 * The neural networks and templates are shared with this detector instead of
+		 * being read from disk again, only the per stream state is created anew, which
+		 * makes this a lot cheaper than the constructor. The clone starts in the reset
+		 * state and can be used on a different thread than this detector.
+		 *
+		 * \return The new detector.
+		 */
+		std::unique_ptr<SnowboyDetect> Clone() const;
+
 		/**
 		 * \brief Resets the detection.
 		 *
@@ -149,6 +175,35 @@ namespace snowboy {
 		int RunDetection(const int32_t* const data,
 						 const int array_length, bool is_end = false);
 
+		/**
+		 * \brief Runs hotword detection on a complete recording using multiple threads.
+		 *
+		 * The recording is split into segments which are processed in parallel by clones
+		 * of this detector. Every segment is preceded by enough audio to fill the context
+		 * of the neural networks, the smoothing and search windows and the VAD. The
+		 * pipeline never fully forgets though, the smoothed posteriors of the detectors, the
+		 * background energy of the VAD and the frontend, if enabled, depend on everything
+		 * since the last detection.
+		 * By default the detections are therefore close to the ones of feeding the whole
+		 * recording to RunDetection() in chunks of chunk_length elements, with is_end set
+		 * on the last chunk, but can differ after a segment boundary, mostly in long
+		 * stretches of speech. With exact set, a segment is only used from the first
+		 * detection it shares with the sequential run and everything before is processed
+		 * again sequentially. The detections then match, but recordings with few
+		 * detections gain little from the threads.
+		 *
+		 * The detector is reset before and after processing the recording.
+		 *
+		 * \param [in]  data               Recording to be processed, see RunDetection(const int16_t* const, const int, bool).
+		 * \param [in]  array_length       Length of the data array in elements.
+		 * \param [in]  num_threads        Number of threads to use, including the calling one.
+		 * \param [in]  chunk_length       Number of elements passed to the detector at once.
+		 * \param [in]  exact              Match the detections of a sequential run exactly.
+		 * \return The detected hotwords ordered by position.
+		 */
+		std::vector<SnowboyDetection> RunDetectionParallel(const int16_t* const data, const size_t array_length,
+														   const int num_threads, const int chunk_length = 1600, const bool exact = false);
+
 		/**
 		 * \brief Sets the sensitivity string for the loaded hotwords.
 		 *
@@ -229,6 +284,38 @@ namespace snowboy {
 		 */
 		void ApplyFrontend(const bool apply_frontend);
 
+		/**
+		 * \brief Skip the hotword detectors during non-voice segments.
+		 *
+		 * If <gate_non_voice> is true, the neural networks and the hotword search
+		 * are suspended once the internal VAD reports a sustained non-voice segment.
+		 * When voice starts again the detectors are reset and the most recent
+		 * frames are replayed to fill their context. This saves most of the
+		 * computation on mostly silent audio, but detections can differ slightly
+		 * from ungated detection right at a voice onset.
+		 *
+		 * \param [in] gate_non_voice New gating state
+		 */
+		void GateNonVoice(const bool gate_non_voice);
+
+		/**
+		 * \brief Returns per stage call counts and timings of the detection pipeline.
+		 *
+		 * The result is a json object with one entry per stream of the pipeline containing the
+		 * number of Read calls, the number of frames it returned, the time spent in the stage itself
+		 * in nanoseconds and a histogram of the per call times in power of two nanosecond buckets.
+		 * Stats are only recorded if the library was built with SNOWMAN_ENABLE_STATS, otherwise
+		 * the list of stages is empty.
+		 *
+		 * \return The stats as a json string.
+		 */
+		std::string GetStats() const;
+
+		/**
+		 * \brief Clears the stats returned by GetStats().
+		 */
+		void ResetStats();
+
 		/**
 		 * \brief Returns the expected sample rate for audio provided to RunDetection().
 		 * \return The expected samplerate.
@@ -250,9 +337,15 @@ namespace snowboy {
 		/** \brief Destructor */
 		~SnowboyDetect();
 
+	protected:
+		/** \brief Creates a clone of prototype, see Clone() */
+		SnowboyDetect(const SnowboyDetect& prototype);
+
 	private:
 		std::unique_ptr<WaveHeader> wave_header_;
 		std::unique_ptr<PipelineDetect> detect_pipeline_;
+		// Converted input samples, reused between calls
+		std::unique_ptr<Matrix> input_;
 	};
 
 	/**
@@ -276,6 +369,17 @@ namespace snowboy {
 		 */
 		SnowboyVad(const std::string& resource_filename);
 
+		/**
+		 * \brief Creates a vad with the same settings.
+		 *
+		 * The neural network is shared with this vad instead of being read from disk
+		 * again. The clone starts in the reset state and can be used on a different
+		 * thread than this vad.
+		 *
+		 * \return The new vad.
+		 */
+		std::unique_ptr<SnowboyVad> Clone() const;
+
 		/**
 		 * \brief Resets the vad.
 		 *
@@ -390,6 +494,37 @@ namespace snowboy {
 		 */
 		void ApplyFrontend(const bool apply_frontend);
 
+		/**
+		 * \brief Enable or disable the tiered VAD mode.
+		 *
+		 * In tiered mode chunks in which the energy is clearly above or below
+		 * the background energy are decided by the energy VAD alone, only the
+		 * remaining chunks are passed through FFT, MFCC and the neural network VAD.
+		 * This makes the VAD a lot cheaper on long recordings at the cost of
+		 * slightly different results. It is off by default.
+		 *
+		 * \param [in] tiered_vad New tiered state
+		 */
+		void SetTieredVad(const bool tiered_vad);
+
+		/**
+		 * \brief Returns per stage call counts and timings of the vad pipeline.
+		 *
+		 * The result is a json object with one entry per stream of the pipeline containing the
+		 * number of Read calls, the number of frames it returned, the time spent in the stage itself
+		 * in nanoseconds and a histogram of the per call times in power of two nanosecond buckets.
+		 * Stats are only recorded if the library was built with SNOWMAN_ENABLE_STATS, otherwise
+		 * the list of stages is empty.
+		 *
+		 * \return The stats as a json string.
+		 */
+		std::string GetStats() const;
+
+		/**
+		 * \brief Clears the stats returned by GetStats().
+		 */
+		void ResetStats();
+
 		/**
 		 * \brief Returns the expected sample rate for audio provided to RunDetection().
 		 * \return The expected samplerate.
@@ -411,9 +546,15 @@ namespace snowboy {
 		/** \brief Destructor */
 		~SnowboyVad();
 
+	protected:
+		/** \brief Creates a clone of prototype, see Clone() */
+		SnowboyVad(const SnowboyVad& prototype);
+
 	private:
 		std::unique_ptr<WaveHeader> wave_header_;
 		std::unique_ptr<PipelineVad> vad_pipeline_;
+		// Converted input samples, reused between calls
+		std::unique_ptr<Matrix> input_;
 	};
 
 	/**
@@ -521,6 +662,24 @@ namespace snowboy {
 		 */
 		int GetNumTemplates() const;
 
+		/**
+		 * \brief Returns per stage call counts and timings of the enrollment pipeline.
+		 *
+		 * The result is a json object with one entry per stream of the pipeline containing the
+		 * number of Read calls, the number of frames it returned, the time spent in the stage itself
+		 * in nanoseconds and a histogram of the per call times in power of two nanosecond buckets.
+		 * Stats are only recorded if the library was built with SNOWMAN_ENABLE_STATS, otherwise
+		 * the list of stages is empty.
+		 *
+		 * \return The stats as a json string.
+		 */
+		std::string GetStats() const;
+
+		/**
+		 * \brief Clears the stats returned by GetStats().
+		 */
+		void ResetStats();
+
 		/**
 		 * \brief Returns the expected sample rate for audio provided to RunDetection().
 		 * \return The expected samplerate.
@@ -651,6 +810,24 @@ namespace snowboy {
 		 */
 		bool Reset();
 
+		/**
+		 * \brief Returns per stage call counts and timings of the template cut pipeline.
+		 *
+		 * The result is a json object with one entry per stream of the pipeline containing the
+		 * number of Read calls, the number of frames it returned, the time spent in the stage itself
+		 * in nanoseconds and a histogram of the per call times in power of two nanosecond buckets.
+		 * Stats are only recorded if the library was built with SNOWMAN_ENABLE_STATS, otherwise
+		 * the list of stages is empty.
+		 *
+		 * \return The stats as a json string.
+		 */
+		std::string GetStats() const;
+
+		/**
+		 * \brief Clears the stats returned by GetStats().
+		 */
+		void ResetStats();
+
 		/**
 		 * \brief Returns the expected sample rate for audio provided to RunDetection().
 		 * \return The expected samplerate.
@@ -677,4 +854,31 @@ namespace snowboy {
 		std::unique_ptr<PipelineTemplateCut> cut_pipeline_;
 	};
 
+	/**
+	 * \brief Starts recording a trace of all detectors in this process.
+	 *
+	 * Records begin and end events of every pipeline stage, neural network layer and hotword search
+	 * on all threads into a ring buffer of max_events events, replacing any previous trace.
+	 * Tracing is only available if the library was built with SNOWMAN_ENABLE_TRACE, otherwise
+	 * this does nothing and the trace stays empty.
+	 *
+	 * \param [in] max_events Number of events to keep, older events are overwritten once the buffer is full.
+	 */
+	void StartTrace(size_t max_events = 65536);
+
+	/**
+	 * \brief Stops recording the trace started by StartTrace().
+	 */
+	void StopTrace();
+
+	/**
+	 * \brief Returns the recorded trace in chrome trace event format.
+	 *
+	 * The json can be loaded in chrome://tracing or https://ui.perfetto.dev.
+	 * Call StopTrace() first to make sure events from other threads are complete.
+	 *
+	 * \return The trace as a json string.
+	 */
+	std::string GetTraceJson();
+
 } // namespace snowboy
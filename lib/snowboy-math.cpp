@@ -1,4 +1,74 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <matrix-wrapper.h>
+#include <numeric>
+#include <snowboy-error.h>
 #include <snowboy-math.h>
+#include <vector-wrapper.h>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* Float vector helpers shared by the SSE2 and AVX2 builds, SBM_WIDTH is the number of float lanes */
+#if defined(__AVX2__)
+#define SBM_WIDTH 8
+typedef __m256 sbm_vec;
+typedef __m256i sbm_ivec;
+#define SBM_LOAD(p) _mm256_loadu_ps(p)
+#define SBM_STORE(p, v) _mm256_storeu_ps((p), (v))
+#define SBM_SET1(x) _mm256_set1_ps(x)
+#define SBM_ADD(a, b) _mm256_add_ps((a), (b))
+#define SBM_SUB(a, b) _mm256_sub_ps((a), (b))
+#define SBM_MUL(a, b) _mm256_mul_ps((a), (b))
+#define SBM_DIV(a, b) _mm256_div_ps((a), (b))
+#define SBM_SQRT(a) _mm256_sqrt_ps(a)
+#define SBM_AND(a, b) _mm256_and_ps((a), (b))
+#define SBM_CMPLT(a, b) _mm256_cmp_ps((a), (b), _CMP_LT_OQ)
+#define SBM_INRANGE(x, lo, hi) _mm256_and_ps(_mm256_cmp_ps((x), (lo), _CMP_GE_OQ), _mm256_cmp_ps((x), (hi), _CMP_LE_OQ))
+#define SBM_ALLSET(mask) (_mm256_movemask_ps(mask) == 0xff)
+#define SBM_ROUND_TO_INT(a) _mm256_cvtps_epi32(a)
+#define SBM_TO_FLOAT(a) _mm256_cvtepi32_ps(a)
+#define SBM_CAST_INT(a) _mm256_castps_si256(a)
+#define SBM_CAST_FLOAT(a) _mm256_castsi256_ps(a)
+#define SBM_ISET1(x) _mm256_set1_epi32(x)
+#define SBM_IADD(a, b) _mm256_add_epi32((a), (b))
+#define SBM_ISUB(a, b) _mm256_sub_epi32((a), (b))
+#define SBM_IAND(a, b) _mm256_and_si256((a), (b))
+#define SBM_IOR(a, b) _mm256_or_si256((a), (b))
+#define SBM_ISRLI(a, c) _mm256_srli_epi32((a), (c))
+#define SBM_ISLLI(a, c) _mm256_slli_epi32((a), (c))
+#elif defined(__SSE2__)
+#define SBM_WIDTH 4
+typedef __m128 sbm_vec;
+typedef __m128i sbm_ivec;
+#define SBM_LOAD(p) _mm_loadu_ps(p)
+#define SBM_STORE(p, v) _mm_storeu_ps((p), (v))
+#define SBM_SET1(x) _mm_set1_ps(x)
+#define SBM_ADD(a, b) _mm_add_ps((a), (b))
+#define SBM_SUB(a, b) _mm_sub_ps((a), (b))
+#define SBM_MUL(a, b) _mm_mul_ps((a), (b))
+#define SBM_DIV(a, b) _mm_div_ps((a), (b))
+#define SBM_SQRT(a) _mm_sqrt_ps(a)
+#define SBM_AND(a, b) _mm_and_ps((a), (b))
+#define SBM_CMPLT(a, b) _mm_cmplt_ps((a), (b))
+#define SBM_INRANGE(x, lo, hi) _mm_and_ps(_mm_cmpge_ps((x), (lo)), _mm_cmple_ps((x), (hi)))
+#define SBM_ALLSET(mask) (_mm_movemask_ps(mask) == 0xf)
+#define SBM_ROUND_TO_INT(a) _mm_cvtps_epi32(a)
+#define SBM_TO_FLOAT(a) _mm_cvtepi32_ps(a)
+#define SBM_CAST_INT(a) _mm_castps_si128(a)
+#define SBM_CAST_FLOAT(a) _mm_castsi128_ps(a)
+#define SBM_ISET1(x) _mm_set1_epi32(x)
+#define SBM_IADD(a, b) _mm_add_epi32((a), (b))
+#define SBM_ISUB(a, b) _mm_sub_epi32((a), (b))
+#define SBM_IAND(a, b) _mm_and_si128((a), (b))
+#define SBM_IOR(a, b) _mm_or_si128((a), (b))
+#define SBM_ISRLI(a, c) _mm_srli_epi32((a), (c))
+#define SBM_ISLLI(a, c) _mm_slli_epi32((a), (c))
+#else
+#define SBM_WIDTH 0
+#endif
 
 namespace snowboy {
 	int NearestPowerOfTwoCeil(int v) {
@@ -11,4 +81,154 @@ namespace snowboy {
 		v++;
 		return v;
 	}
-} // namespace snowboy
\ No newline at end of file
+
+	void SymmetricEigen(const MatrixBase& mat, Vector* eigenvalues, Matrix* eigenvectors) {
+		if (mat.rows() != mat.cols()) throw snowboy_exception{"SymmetricEigen: matrix is not square"};
+		const size_t n = mat.rows();
+		// Work in double precision, the rotations accumulate rounding errors
+		std::vector<double> a(n * n), v(n * n, 0.0);
+		for (size_t r = 0; r < n; r++) {
+			for (size_t c = 0; c < n; c++)
+				a[r * n + c] = mat(r, c);
+			v[r * n + r] = 1.0;
+		}
+		double norm = 0.0;
+		for (auto e : a)
+			norm += e * e;
+		for (int sweep = 0; sweep < 100; sweep++) {
+			double off = 0.0;
+			for (size_t p = 0; p < n; p++) {
+				for (size_t q = p + 1; q < n; q++)
+					off += a[p * n + q] * a[p * n + q];
+			}
+			if (off <= norm * 1e-24) break;
+			for (size_t p = 0; p < n; p++) {
+				for (size_t q = p + 1; q < n; q++) {
+					auto apq = a[p * n + q];
+					if (apq == 0.0) continue;
+					// Rotation which zeroes a[p][q], see Numerical Recipes 11.1
+					auto theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+					auto t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+					auto c = 1.0 / std::sqrt(t * t + 1.0);
+					auto s = t * c;
+					for (size_t k = 0; k < n; k++) {
+						auto akp = a[k * n + p], akq = a[k * n + q];
+						a[k * n + p] = c * akp - s * akq;
+						a[k * n + q] = s * akp + c * akq;
+					}
+					for (size_t k = 0; k < n; k++) {
+						auto apk = a[p * n + k], aqk = a[q * n + k];
+						a[p * n + k] = c * apk - s * aqk;
+						a[q * n + k] = s * apk + c * aqk;
+					}
+					for (size_t k = 0; k < n; k++) {
+						auto vkp = v[k * n + p], vkq = v[k * n + q];
+						v[k * n + p] = c * vkp - s * vkq;
+						v[k * n + q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+		std::vector<size_t> order(n);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](size_t x, size_t y) { return a[x * n + x] > a[y * n + y]; });
+		eigenvalues->Resize(n, MatrixResizeType::kUndefined);
+		eigenvectors->Resize(n, n, MatrixResizeType::kUndefined);
+		for (size_t i = 0; i < n; i++) {
+			(*eigenvalues)[i] = a[order[i] * n + order[i]];
+			for (size_t k = 0; k < n; k++)
+				(*eigenvectors)(i, k) = v[k * n + order[i]];
+		}
+	}
+
+#if SBM_WIDTH > 0
+	// Cephes expf, the argument is reduced to r = x - n * ln(2) with |r| <= ln(2) / 2 and exp(x) = 2^n * p(r)
+	static inline sbm_vec SbmExp(sbm_vec x) noexcept {
+		auto n = SBM_ROUND_TO_INT(SBM_MUL(x, SBM_SET1(1.44269504088896341f)));
+		auto fn = SBM_TO_FLOAT(n);
+		// ln(2) split in two parts so n * 0.693359375 is exact
+		auto r = SBM_SUB(SBM_SUB(x, SBM_MUL(fn, SBM_SET1(0.693359375f))), SBM_MUL(fn, SBM_SET1(-2.12194440e-4f)));
+		auto p = SBM_SET1(1.9875691500e-4f);
+		p = SBM_ADD(SBM_MUL(p, r), SBM_SET1(1.3981999507e-3f));
+		p = SBM_ADD(SBM_MUL(p, r), SBM_SET1(8.3334519073e-3f));
+		p = SBM_ADD(SBM_MUL(p, r), SBM_SET1(4.1665795894e-2f));
+		p = SBM_ADD(SBM_MUL(p, r), SBM_SET1(1.6666665459e-1f));
+		p = SBM_ADD(SBM_MUL(p, r), SBM_SET1(5.0000001201e-1f));
+		p = SBM_ADD(SBM_ADD(SBM_MUL(p, SBM_MUL(r, r)), r), SBM_SET1(1.0f));
+		auto scale = SBM_CAST_FLOAT(SBM_ISLLI(SBM_IADD(n, SBM_ISET1(127)), 23));
+		return SBM_MUL(p, scale);
+	}
+
+	// Cephes logf, x = m * 2^e with m in [sqrt(0.5), sqrt(2)) and log(x) = e * ln(2) + log(m)
+	static inline sbm_vec SbmLog(sbm_vec x) noexcept {
+		auto bits = SBM_CAST_INT(x);
+		auto e = SBM_ISUB(SBM_ISRLI(bits, 23), SBM_ISET1(126));
+		// Mantissa in [0.5, 1)
+		auto m = SBM_CAST_FLOAT(SBM_IOR(SBM_IAND(bits, SBM_ISET1(0x007fffff)), SBM_ISET1(0x3f000000)));
+		auto fe = SBM_TO_FLOAT(e);
+		auto small = SBM_CMPLT(m, SBM_SET1(0.707106781186547524f));
+		// m < sqrt(0.5) ? (e - 1, 2m - 1) : (e, m - 1)
+		fe = SBM_SUB(fe, SBM_AND(small, SBM_SET1(1.0f)));
+		m = SBM_SUB(SBM_ADD(m, SBM_AND(small, m)), SBM_SET1(1.0f));
+		auto z = SBM_MUL(m, m);
+		auto p = SBM_SET1(7.0376836292e-2f);
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(-1.1514610310e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(1.1676998740e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(-1.2420140846e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(1.4249322787e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(-1.6668057665e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(2.0000714765e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(-2.4999993993e-1f));
+		p = SBM_ADD(SBM_MUL(p, m), SBM_SET1(3.3333331174e-1f));
+		auto y = SBM_MUL(SBM_MUL(p, m), z);
+		y = SBM_ADD(y, SBM_MUL(fe, SBM_SET1(-2.12194440e-4f)));
+		y = SBM_SUB(y, SBM_MUL(z, SBM_SET1(0.5f)));
+		return SBM_ADD(SBM_ADD(m, y), SBM_MUL(fe, SBM_SET1(0.693359375f)));
+	}
+
+	// Runs fn on full vectors, blocks with inputs outside [lo, hi] and the tail go through the scalar fallback
+	template <typename VecFn, typename ScalarFn>
+	static inline void SbmApply(const float* in, float* out, size_t n, float lo, float hi, VecFn fn, ScalarFn fallback) noexcept {
+		size_t i = 0;
+		for (; i + SBM_WIDTH <= n; i += SBM_WIDTH) {
+			auto x = SBM_LOAD(in + i);
+			if (SBM_ALLSET(SBM_INRANGE(x, SBM_SET1(lo), SBM_SET1(hi)))) {
+				SBM_STORE(out + i, fn(x));
+			} else {
+				for (size_t k = i; k < i + SBM_WIDTH; k++)
+					out[k] = fallback(in[k]);
+			}
+		}
+		for (; i < n; i++)
+			out[i] = fallback(in[i]);
+	}
+#endif
+
+	void VectorLog(const float* in, float* out, size_t n) noexcept {
+#if SBM_WIDTH > 0
+		SbmApply(in, out, n, std::numeric_limits<float>::min(), std::numeric_limits<float>::max(), SbmLog, [](float x) { return logf(x); });
+#else
+		for (size_t i = 0; i < n; i++)
+			out[i] = logf(in[i]);
+#endif
+	}
+
+	void VectorExp(const float* in, float* out, size_t n) noexcept {
+#if SBM_WIDTH > 0
+		SbmApply(in, out, n, -87.0f, 88.0f, SbmExp, [](float x) { return expf(x); });
+#else
+		for (size_t i = 0; i < n; i++)
+			out[i] = expf(in[i]);
+#endif
+	}
+
+	void VectorRsqrt(const float* in, float* out, size_t n) noexcept {
+		size_t i = 0;
+#if SBM_WIDTH > 0
+		for (; i + SBM_WIDTH <= n; i += SBM_WIDTH)
+			SBM_STORE(out + i, SBM_DIV(SBM_SET1(1.0f), SBM_SQRT(SBM_LOAD(in + i))));
+#endif
+		for (; i < n; i++)
+			out[i] = 1.0f / std::sqrt(in[i]);
+	}
+} // namespace snowboy
@@ -1,5 +1,29 @@
 #pragma once
+#include <cstddef>
 
 namespace snowboy {
+	struct MatrixBase;
+	struct Matrix;
+	class Vector;
+
 	int NearestPowerOfTwoCeil(int v);
-}
\ No newline at end of file
+	/**
+	 * \brief Eigen decomposition of a symmetric matrix using cyclic jacobi rotations.
+	 *
+	 * Eigenvalues are sorted in descending order, row i of eigenvectors is the eigenvector of eigenvalue i.
+	 * Meant for the small matrices found in model conversion, the cost is cubic in the size of the matrix.
+	 */
+	void SymmetricEigen(const MatrixBase& mat, Vector* eigenvalues, Matrix* eigenvectors);
+
+	/**
+	 * Vectorized element wise functions, in and out may be the same array.
+	 *
+	 * Log and exp use the cephes polynomials and are at most 1 ulp away from the correctly rounded result
+	 * for positive normal inputs (log) and inputs in [-87, 88] (exp). Blocks containing any other input
+	 * are passed to logf/expf, so zero, negative, denormal, infinite and nan inputs behave like the libm functions.
+	 * Rsqrt is computed as 1 / sqrt(x) with both operations correctly rounded, which is within 1 ulp.
+	 */
+	void VectorLog(const float* in, float* out, size_t n) noexcept;
+	void VectorExp(const float* in, float* out, size_t n) noexcept;
+	void VectorRsqrt(const float* in, float* out, size_t n) noexcept;
+} // namespace snowboy
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
 #include <snowboy-error.h>
 #include <snowboy-utils.h>
 #include <string>
+#include <thread>
 
 namespace snowboy {
 	const std::string global_snowboy_whitespace_set{" \t\n\r\f\v"};
@@ -83,6 +88,40 @@ namespace snowboy {
 		}
 	}
 
+	void ParallelFor(size_t n, const std::function<void(size_t)>& fn, size_t max_threads) {
+#ifdef __EMSCRIPTEN__
+		max_threads = 1;
+#endif
+		if (max_threads == 0) max_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		auto nthreads = std::min(max_threads, n);
+		if (nthreads <= 1) {
+			for (size_t i = 0; i < n; i++)
+				fn(i);
+			return;
+		}
+		std::atomic<size_t> next{0};
+		std::mutex mtx;
+		std::exception_ptr error;
+		auto worker = [&]() {
+			try {
+				for (auto i = next++; i < n; i = next++)
+					fn(i);
+			} catch (...) {
+				std::unique_lock<std::mutex> lck{mtx};
+				if (!error) error = std::current_exception();
+				next = n;
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(nthreads - 1);
+		for (size_t i = 1; i < nthreads; i++)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& e : threads)
+			e.join();
+		if (error) std::rethrow_exception(error);
+	}
+
 	void* SnowboyMemalign(size_t align, size_t size) {
 		void* ptr = nullptr;
 		if (posix_memalign(&ptr, align, size) == 0)
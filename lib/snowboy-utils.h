@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -15,6 +16,8 @@ namespace snowboy {
 	template <typename T>
 	inline T ConvertStringToIntegerOrFloat(const std::string& s) { return ConvertStringTo<T>(s); }
 	void FilterConfigString(bool, const std::string& prefix, std::string* config_str);
+	// Calls fn(i) for i in [0, n) on up to max_threads threads (0 = hardware concurrency)
+	void ParallelFor(size_t n, const std::function<void(size_t)>& fn, size_t max_threads = 0);
 	void* SnowboyMemalign(size_t align, size_t size);
 	void SnowboyMemalignFree(void* ptr);
 	template <typename T>
@@ -0,0 +1,129 @@
+#include <chrono>
+#include <frame-info.h>
+#include <matrix-wrapper.h>
+#include <sstream>
+#include <stream-stats.h>
+#include <trace-recorder.h>
+
+namespace snowboy {
+
+	// Time spent in upstream stages by the innermost StatsStream::Read on this thread
+	static thread_local uint64_t* t_upstream_nanoseconds = nullptr;
+
+	class StatsStream : public StreamItf {
+	public:
+		StreamItf* m_stream;
+		StageStats* m_stats;
+
+		StatsStream(StreamItf* stream, StageStats* stats)
+			: m_stream{stream}, m_stats{stats} {
+		}
+
+		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override {
+			auto parent = t_upstream_nanoseconds;
+			uint64_t upstream = 0;
+			t_upstream_nanoseconds = &upstream;
+			SNOWBOY_TRACE_SCOPE(m_stats->name);
+			auto start = std::chrono::steady_clock::now();
+			int res;
+			try {
+				res = m_stream->Read(mat, info);
+			} catch (...) {
+				t_upstream_nanoseconds = parent;
+				throw;
+			}
+			uint64_t total = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			t_upstream_nanoseconds = parent;
+			if (parent != nullptr) *parent += total;
+			m_stats->Record(mat != nullptr ? mat->rows() : 0, total > upstream ? total - upstream : 0);
+			return res;
+		}
+		virtual bool Reset() override { return m_stream->Reset(); }
+		virtual std::string Name() const override { return m_stream->Name(); }
+		virtual ~StatsStream() {}
+	};
+
+	StageStats::StageStats(std::string n)
+		: name{std::move(n)} {
+		for (auto& e : histogram)
+			e.store(0, std::memory_order_relaxed);
+	}
+
+	void StageStats::Record(uint64_t num_frames, uint64_t ns) noexcept {
+		size_t bucket = 0;
+		while (bucket + 1 < num_buckets && (ns >> (bucket + 1)) != 0)
+			bucket++;
+		calls.fetch_add(1, std::memory_order_relaxed);
+		frames.fetch_add(num_frames, std::memory_order_relaxed);
+		nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+		histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void StageStats::Clear() noexcept {
+		calls.store(0, std::memory_order_relaxed);
+		frames.store(0, std::memory_order_relaxed);
+		nanoseconds.store(0, std::memory_order_relaxed);
+		for (auto& e : histogram)
+			e.store(0, std::memory_order_relaxed);
+	}
+
+	StreamStats::StreamStats() {}
+	StreamStats::~StreamStats() {}
+
+	StatsStream* StreamStats::Decorate(StreamItf* stream) {
+		for (auto& e : m_decorators) {
+			if (e->m_stream == stream) return e.get();
+		}
+		auto name = stream->Name();
+		size_t same_name = 0;
+		for (auto& e : m_decorators) {
+			if (e->m_stream->Name() == name) same_name++;
+		}
+		if (same_name != 0) name += "#" + std::to_string(same_name + 1);
+		m_stages.emplace_back(new StageStats{name});
+		m_decorators.emplace_back(new StatsStream{stream, m_stages.back().get()});
+		return m_decorators.back().get();
+	}
+
+	StreamItf* StreamStats::Instrument(StreamItf* output) {
+		// Collect the chain first so new stages are added from input to output
+		StreamItf* chain[32];
+		size_t len = 0;
+		for (auto stream = output; stream != nullptr && len < 32;) {
+			chain[len++] = stream;
+			auto upstream = stream->m_connectedStream;
+			if (auto decorator = dynamic_cast<StatsStream*>(upstream)) upstream = decorator->m_stream;
+			stream = upstream;
+		}
+		for (size_t i = len; i-- > 0;)
+			Decorate(chain[i]);
+		for (size_t i = 0; i + 1 < len; i++) {
+			if (chain[i]->m_connectedStream == chain[i + 1]) chain[i]->Connect(Decorate(chain[i + 1]));
+		}
+		return Decorate(output);
+	}
+
+	void StreamStats::Clear() noexcept {
+		for (auto& e : m_stages)
+			e->Clear();
+	}
+
+	std::string StreamStats::ToJson() const {
+		std::stringstream res;
+		res << "{\"stages\":[";
+		for (size_t i = 0; i < m_stages.size(); i++) {
+			auto& e = *m_stages[i];
+			if (i != 0) res << ",";
+			res << "{\"name\":\"" << e.name << "\"";
+			res << ",\"calls\":" << e.calls.load(std::memory_order_relaxed);
+			res << ",\"frames\":" << e.frames.load(std::memory_order_relaxed);
+			res << ",\"nanoseconds\":" << e.nanoseconds.load(std::memory_order_relaxed);
+			res << ",\"histogram\":[";
+			for (size_t b = 0; b < StageStats::num_buckets; b++)
+				res << (b == 0 ? "" : ",") << e.histogram[b].load(std::memory_order_relaxed);
+			res << "]}";
+		}
+		res << "]}";
+		return res.str();
+	}
+} // namespace snowboy
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stream-itf.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace snowboy {
+	struct FrameInfo;
+	struct Matrix;
+	class StatsStream;
+
+	/**
+	 * Counters of a single pipeline stage.
+	 *
+	 * Times are exclusive, the time spent in the upstream stages called from Read is not included.
+	 * All counters are atomics updated with relaxed ordering, so they can be read while the pipeline runs.
+	 */
+	struct StageStats {
+		// Bucket i counts calls which took [2^i, 2^(i+1)) nanoseconds, the last bucket is open ended
+		static constexpr size_t num_buckets = 32;
+
+		std::string name;
+		std::atomic<uint64_t> calls{0};
+		std::atomic<uint64_t> frames{0};
+		std::atomic<uint64_t> nanoseconds{0};
+		std::atomic<uint64_t> histogram[num_buckets];
+
+		StageStats(std::string name);
+		void Record(uint64_t frames, uint64_t nanoseconds) noexcept;
+		void Clear() noexcept;
+	};
+
+	/**
+	 * Per stage timing of the streams of a pipeline.
+	 *
+	 * Only available if the library is built with SNOWMAN_ENABLE_STATS, otherwise Read calls the stream directly
+	 * and no stage is ever recorded.
+	 */
+	class StreamStats {
+		std::vector<std::unique_ptr<StatsStream>> m_decorators;
+		std::vector<std::unique_ptr<StageStats>> m_stages;
+		// Outputs read through Read and the decorator to read instead, filled on the first Read of each output
+		std::vector<std::pair<StreamItf*, StreamItf*>> m_outputs;
+
+		StatsStream* Decorate(StreamItf* stream);
+
+	public:
+		StreamStats();
+		StreamStats(const StreamStats&) = delete;
+		StreamStats& operator=(const StreamStats&) = delete;
+		~StreamStats();
+
+		static constexpr bool Enabled() noexcept {
+#ifdef SNOWMAN_ENABLE_STATS
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		/**
+		 * \brief Inserts a timing decorator in front of every stream of the chain ending in output.
+		 *
+		 * Streams which are already decorated are kept, so this can be called again after reconnecting streams.
+		 * \return The decorator of output which has to be read instead of output.
+		 */
+		StreamItf* Instrument(StreamItf* output);
+
+		/**
+		 * \brief Has to be called after streams of a chain read through Read were reconnected.
+		 *
+		 * The chain is instrumented again on its next Read.
+		 */
+		void Invalidate() noexcept { m_outputs.clear(); }
+
+		/**
+		 * Reads from the chain ending in output, timing every stage of it if stats are enabled.
+		 * The chain is only instrumented on the first Read after construction or Invalidate.
+		 */
+		int Read(StreamItf* output, Matrix* mat, std::vector<FrameInfo>* info) {
+#ifdef SNOWMAN_ENABLE_STATS
+			for (auto& e : m_outputs) {
+				if (e.first == output) return e.second->Read(mat, info);
+			}
+			auto decorator = Instrument(output);
+			m_outputs.emplace_back(output, decorator);
+			return decorator->Read(mat, info);
+#else
+			return output->Read(mat, info);
+#endif
+		}
+
+		const std::vector<std::unique_ptr<StageStats>>& Stages() const noexcept { return m_stages; }
+		void Clear() noexcept;
+		// Stages from input to output as a json object
+		std::string ToJson() const;
+	};
+} // namespace snowboy
@@ -2,6 +2,7 @@
 #include <limits>
 #include <snowboy-error.h>
 #include <snowboy-io.h>
+#include <snowboy-utils.h>
 #include <template-container.h>
 #include <vector-wrapper.h>
 
@@ -69,36 +70,42 @@ namespace snowboy {
 
 	void TemplateContainer::CombineTemplates(DistanceType distance) {
 		if (m_templates.size() < 2) return;
-		auto min_val = std::numeric_limits<float>::max();
-		size_t min_idx = 0;
-		for (size_t i = 0; i < m_templates.size(); i++) {
+		// Pairwise alignments are independent, run them concurrently and
+		// reduce in the original order so results do not depend on the thread count.
+		std::vector<double> sums(m_templates.size(), 0.0);
+		ParallelFor(m_templates.size(), [&](size_t i) {
+			static thread_local DtwAlignWorkspace ws;
 			auto sum = 0.0;
 			for (size_t i2 = 0; i2 < m_templates.size(); i2++) {
 				if (i != i2) {
-					sum += snowboy::DtwAlign(distance, m_templates[i], m_templates[i2], nullptr);
+					sum += snowboy::DtwAlign(distance, m_templates[i], m_templates[i2], 0, &ws, nullptr);
 				}
 			}
-			if (sum < min_val) {
+			sums[i] = sum;
+		});
+		auto min_val = std::numeric_limits<float>::max();
+		size_t min_idx = 0;
+		for (size_t i = 0; i < m_templates.size(); i++) {
+			if (sums[i] < min_val) {
 				min_idx = i;
-				min_val = sum;
+				min_val = sums[i];
 			}
 		}
+
+		// Each alignment depends on the averages of the previous ones, so this part stays serial
+		DtwAlignWorkspace ws;
+		std::vector<size_t> alignment;
 		std::vector<int> local_a0;
 		local_a0.resize(m_templates[min_idx].m_rows, 1); // Not sure if int
 
 		for (size_t local_90 = 0; local_90 < m_templates.size(); local_90++) {
 			if (min_idx != local_90) {
-				std::vector<std::vector<size_t>> local_58;
-				snowboy::DtwAlign(distance, m_templates[min_idx], m_templates[local_90], &local_58);
-				for (size_t local_a8 = 0; local_a8 < m_templates[min_idx].rows(); local_a8 += 1) {
-					if (local_58[local_a8].size() != 0) {
-						SubVector{m_templates[min_idx], local_a8}.Scale(local_a0[local_a8]);
-						for (size_t uVar10 = 0; uVar10 < local_58[local_a8].size(); uVar10++) {
-							SubVector{m_templates[min_idx], local_a8}.AddVec(1.0, SubVector{m_templates[local_90], local_58[local_a8][uVar10]});
-						}
-						local_a0[local_a8] += local_58[local_a8].size();
-						SubVector{m_templates[min_idx], local_a8}.Scale(1.0f / (float)(local_a0[local_a8]));
-					}
+				snowboy::DtwAlign(distance, m_templates[min_idx], m_templates[local_90], 0, &ws, &alignment);
+				for (size_t local_a8 = 0; local_a8 < alignment.size(); local_a8 += 1) {
+					SubVector{m_templates[min_idx], local_a8}.Scale(local_a0[local_a8]);
+					SubVector{m_templates[min_idx], local_a8}.AddVec(1.0, SubVector{m_templates[local_90], alignment[local_a8]});
+					local_a0[local_a8] += 1;
+					SubVector{m_templates[min_idx], local_a8}.Scale(1.0f / (float)(local_a0[local_a8]));
 				}
 			}
 		}
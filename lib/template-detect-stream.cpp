@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <frame-info.h>
 #include <limits>
 #include <nnet-lib.h>
@@ -5,17 +6,21 @@
 #include <snowboy-io.h>
 #include <snowboy-options.h>
 #include <template-detect-stream.h>
+#include <trace-recorder.h>
+#include <vector-wrapper.h>
 
 namespace snowboy {
 	void TemplateDetectStreamOptions::Register(const std::string& prefix, OptionsItf* opts) {
 		opts->Register(prefix, "band-width", "Band width for segmental DTW.", &dtw_options.band_width);
 		opts->Register(prefix, "distance-metric", "Distance metric for DTW, candidates are: cosine|euclidean.", &dtw_options.distance_metric);
 		opts->Register(prefix, "slide-step", "Step size for sliding window in frames.", &slide_step);
+		opts->Register(prefix, "prefilter-threshold", "Models whose mean feature vector is further away from the current window than this are skipped before DTW, 0 disables the prefilter.", &prefilter_threshold);
 		opts->Register(prefix, "sensitivity-str", "String that contains the sensitivity for each hotword, separated by comma.", &sensitivity_str);
 		opts->Register(prefix, "model-str", "String that contains hotword models, separated by comma.", &model_str);
 	}
 
-	TemplateDetectStream::TemplateDetectStream(const TemplateDetectStreamOptions& options) {
+	TemplateDetectStream::TemplateDetectStream(const TemplateDetectStreamOptions& options)
+		: m_index{ParseDistanceType(options.dtw_options.distance_metric)} {
 		m_options = options;
 		if (m_options.model_str == "")
 			throw snowboy_exception{"please specify models through --model-str"};
@@ -23,15 +28,20 @@ namespace snowboy {
 			throw snowboy_exception{"slide step size should be positive"};
 		field_x70 = 0;
 		field_x78.Resize(0, 0);
+		m_history_pos = 0;
+		m_history_rows = 0;
 		field_x90 = -100;
 		std::vector<std::string> models;
 		SplitStringToVector(m_options.model_str, ",", &models);
 		if (models.empty())
 			throw snowboy_exception{"no model can be extracted from --model-str:" + m_options.model_str};
-		m_models.resize(models.size());
-		for (size_t i = 0; i < models.size(); i++) {
-			m_models[i].ReadHotwordModel(models[i]);
+		for (auto& e : models) {
+			m_index.AddModel(TemplateModel::Load(e, m_index.m_distance));
+			m_sensitivities.push_back(m_index.m_models.back()->m_container.m_sensitivity);
 		}
+		m_index.Build(m_options.dtw_options.band_width);
+		m_candidates.reserve(m_index.NumModels());
+		m_prev_candidates.reserve(m_index.NumModels());
 		InitDtw();
 		if (m_options.sensitivity_str != "") {
 			SetSensitivity(m_options.sensitivity_str);
@@ -41,26 +51,44 @@ namespace snowboy {
 	int TemplateDetectStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
 		mat->Resize(0, 0);
 		info->clear();
-		Matrix read_mat;
-		std::vector<FrameInfo> read_info;
+		auto& read_mat = m_input;
+		auto& read_info = m_input_info;
 		auto read_res = m_connectedStream->Read(&read_mat, &read_info);
-		if ((read_res & 0xc2) == 0 && read_mat.m_rows != 0) {
-			auto old_f78_size = field_x78.m_rows;
-			field_x78.Resize(read_mat.m_rows + old_f78_size, read_mat.m_cols, MatrixResizeType::kCopyData);
-			field_x78.RowRange(old_f78_size, read_mat.m_rows).CopyFromMat(read_mat, MatrixTransposeType::kNoTrans);
+		if ((read_res & 0xc2) == 0 && read_mat.m_rows != 0 && field_x70 != 0) {
+			if (field_x78.m_rows != field_x70 * 2 || field_x78.m_cols != read_mat.m_cols) {
+				field_x78.Resize(field_x70 * 2, read_mat.m_cols, MatrixResizeType::kUndefined);
+				m_history_pos = 0;
+				m_history_rows = 0;
+			}
 
+			auto prefilter = m_options.prefilter_threshold > 0.0f;
 			for (size_t slide_pos = 0; slide_pos < read_mat.rows(); slide_pos += m_options.slide_step) {
-				for (size_t model_id = 0; model_id < field_x58.size(); model_id++) {
+				auto step = m_options.slide_step;
+				if (read_mat.m_rows < slide_pos + step) step = read_mat.m_rows - slide_pos;
+				for (size_t row = slide_pos; row < slide_pos + step; row++)
+					PushHistory(SubVector{read_mat, row});
+				auto history = field_x78.RowRange(m_history_pos + field_x70 - m_history_rows, m_history_rows);
+				SNOWBOY_TRACE_SCOPE("TemplateDetectStream::Search");
+				if (prefilter) {
+					std::swap(m_candidates, m_prev_candidates);
+					m_index.FindCandidates(history, history.rows(), m_options.prefilter_threshold, &m_candidates);
+					// Skipped DTWs restart from scratch once the model becomes a candidate again
+					auto it = m_candidates.begin();
+					for (auto model_id : m_prev_candidates) {
+						it = std::lower_bound(it, m_candidates.end(), model_id);
+						if (it != m_candidates.end() && *it == model_id) continue;
+						for (auto& e : field_x58[model_id])
+							e.Reset();
+					}
+				}
+				const auto num_models = prefilter ? m_candidates.size() : field_x58.size();
+				for (size_t i = 0; i < num_models; i++) {
+					const auto model_id = prefilter ? m_candidates[i] : i;
 					auto matched_templates = 0;
 					for (size_t template_id = 0; template_id < field_x58[model_id].size(); template_id++) {
-						auto step = m_options.slide_step;
-						if (read_mat.m_rows < slide_pos + step) step = read_mat.m_rows - slide_pos;
-						auto iVar2 = step - 1 + old_f78_size + slide_pos;
-						int window_size = field_x58[model_id][template_id].GetWindowSize();
-						window_size = (iVar2 - window_size) + 1;
-						if (window_size < 0) window_size = 0;
-						auto distance = field_x58[model_id][template_id].ComputeDtwDistance(step, field_x78.RowRange(window_size, (iVar2 - window_size) + 1));
-						if (distance < m_models[model_id].m_sensitivity) matched_templates++;
+						auto window_size = std::min(field_x58[model_id][template_id].GetWindowSize(), history.rows());
+						auto distance = field_x58[model_id][template_id].ComputeDtwDistance(step, history.RowRange(history.rows() - window_size, window_size));
+						if (distance < m_sensitivities[model_id]) matched_templates++;
 					}
 					if (field_x58[model_id].size() * 0.5f < matched_templates) {
 						mat->Resize(1, 1, MatrixResizeType::kSetZero);
@@ -74,13 +102,6 @@ namespace snowboy {
 				}
 			}
 		}
-		if (field_x70 < field_x78.rows()) {
-			auto x = field_x78.RowRange(field_x78.m_rows - field_x70, field_x70);
-			Matrix m;
-			m.Resize(x.m_rows, x.m_cols, MatrixResizeType::kUndefined);
-			m.CopyFromMat(x, MatrixTransposeType::kNoTrans);
-			field_x78 = std::move(m);
-		}
 		if ((read_res & 0x18) != 0) {
 			this->Reset();
 		}
@@ -92,10 +113,21 @@ namespace snowboy {
 			for (auto& t : m)
 				t.Reset();
 		}
-		field_x78.Resize(0, 0);
+		m_history_pos = 0;
+		m_history_rows = 0;
+		m_candidates.clear();
 		return true;
 	}
 
+	void TemplateDetectStream::PushHistory(const VectorBase& row) {
+		// Every row is stored twice, field_x70 rows apart, so the last field_x70
+		// rows are always available as one contiguous block.
+		SubVector{field_x78, m_history_pos}.CopyFromVec(row);
+		SubVector{field_x78, m_history_pos + field_x70}.CopyFromVec(row);
+		m_history_pos = (m_history_pos + 1) % field_x70;
+		m_history_rows = std::min(m_history_rows + 1, field_x70);
+	}
+
 	std::string TemplateDetectStream::Name() const {
 		return "TemplateDetectStream";
 	}
@@ -110,10 +142,10 @@ namespace snowboy {
 				parts.resize(field_x58.size(), parts[0]);
 			} else
 				throw snowboy_exception{"Number of sensitivities does not match number of models ("
-										+ std::to_string(parts.size()) + " v.s. " + std::to_string(m_models.size()) + ")"};
+										+ std::to_string(parts.size()) + " v.s. " + std::to_string(NumModels()) + ")"};
 		}
 		for (size_t i = 0; i < field_x58.size(); i++) {
-			m_models[i].m_sensitivity = parts[i];
+			m_sensitivities[i] = parts[i];
 			for (auto& e : field_x58[i]) {
 				e.SetEarlyStopThreshold(parts[i]);
 			}
@@ -122,33 +154,38 @@ namespace snowboy {
 
 	std::string TemplateDetectStream::GetSensitivity() const {
 		std::string res;
-		for (size_t i = 0; i < m_models.size(); i++) {
+		for (size_t i = 0; i < m_sensitivities.size(); i++) {
 			if (!res.empty()) res += ", ";
-			res += std::to_string(m_models[i].m_sensitivity);
+			res += std::to_string(m_sensitivities[i]);
 		}
 		return res;
 	}
 
 	void TemplateDetectStream::InitDtw() {
-		field_x58.resize(m_models.size());
-		for (size_t i = 0; i < m_models.size(); i++) {
-			auto ntemplates = m_models[i].NumTemplates();
+		field_x58.resize(NumModels());
+		for (size_t i = 0; i < NumModels(); i++) {
+			auto& model = m_index.GetModel(i).m_container;
+			auto ntemplates = model.NumTemplates();
 			field_x58[i].resize(field_x58[i].size() + ntemplates);
 			for (size_t t = 0; t < ntemplates; t++) {
 				auto& e = field_x58[i][t];
 				e.SetOptions(m_options.dtw_options);
-				auto tmpl = m_models[i].GetTemplate(t);
+				auto tmpl = model.GetTemplate(t);
 				e.SetReference(tmpl);
-				e.SetEarlyStopThreshold(m_models[i].m_sensitivity);
+				e.SetEarlyStopThreshold(m_sensitivities[i]);
 				field_x70 = std::max<size_t>(e.GetWindowSize(), field_x70);
 			}
 		}
 	}
 
+	size_t TemplateDetectStream::NumModels() const {
+		return m_index.NumModels();
+	}
+
 	size_t TemplateDetectStream::NumHotwords(size_t model_id) const {
-		if (model_id >= m_models.size()) {
+		if (model_id >= NumModels()) {
 			throw snowboy_exception{"model id runs out of range, expecting a value between [0, "
-									+ std::to_string(m_models.size()) + "] got " + std::to_string(model_id) + " instead."};
+									+ std::to_string(NumModels()) + "] got " + std::to_string(model_id) + " instead."};
 			return 0;
 		}
 		return 1;
@@ -157,8 +194,10 @@ namespace snowboy {
 	void TemplateDetectStream::UpdateModel() const {
 		std::vector<std::string> models;
 		SplitStringToVector(m_options.model_str, ",", &models);
-		for (size_t i = 0; i < models.size() && i < m_models.size(); i++) {
-			m_models[i].WriteHotwordModel(true, models[i]);
+		for (size_t i = 0; i < models.size() && i < NumModels(); i++) {
+			TemplateContainer model{m_index.GetModel(i).m_container};
+			model.m_sensitivity = m_sensitivities[i];
+			model.WriteHotwordModel(true, models[i]);
 		}
 	}
 
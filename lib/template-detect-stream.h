@@ -1,17 +1,19 @@
 #pragma once
 #include <deque>
 #include <dtw-lib.h>
+#include <frame-info.h>
 #include <matrix-wrapper.h>
 #include <memory>
 #include <stream-itf.h>
 #include <string>
-#include <template-container.h>
+#include <template-index.h>
 
 namespace snowboy {
 	struct OptionsItf;
 
 	struct TemplateDetectStreamOptions {
 		int slide_step;
+		float prefilter_threshold;
 		std::string sensitivity_str;
 		std::string model_str;
 		SlidingDtwOptions dtw_options;
@@ -19,12 +21,23 @@ namespace snowboy {
 	};
 	struct TemplateDetectStream : StreamItf {
 		TemplateDetectStreamOptions m_options;
-		std::vector<TemplateContainer> m_models;
+		TemplateIndex m_index;
+		std::vector<float> m_sensitivities;
+		// Models passing the prefilter in the current and the previous slide step
+		std::vector<size_t> m_candidates;
+		std::vector<size_t> m_prev_candidates;
 		std::vector<std::vector<SlidingDtw>> field_x58;
 		size_t field_x70;
+		// Feature history, ring buffer of field_x70 rows stored twice
 		Matrix field_x78;
+		size_t m_history_pos;
+		size_t m_history_rows;
 		int field_x90;
+		// Kept between reads to avoid allocating
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
 		void InitDtw();
+		void PushHistory(const VectorBase& row);
 
 		TemplateDetectStream(const TemplateDetectStreamOptions& options);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
@@ -34,6 +47,7 @@ namespace snowboy {
 
 		void SetSensitivity(const std::string& sensitivities);
 		std::string GetSensitivity() const;
+		size_t NumModels() const;
 		size_t NumHotwords(size_t model_id) const;
 		void UpdateModel() const;
 	};
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <model-registry.h>
+#include <snowboy-error.h>
+#include <template-index.h>
+
+namespace snowboy {
+	namespace {
+		float ComputeDistance(DistanceType distance, const VectorBase& a, const VectorBase& b) {
+			switch (distance) {
+			case DistanceType::cosine: return a.CosineDistance(b);
+			case DistanceType::euclidean: return a.EuclideanDistance(b);
+			default: throw snowboy_exception{"Unknown distance type: " + std::to_string(distance)};
+			}
+		}
+
+		void ComputeRowMean(const MatrixBase& mat, size_t offset, size_t rows, Vector* res) {
+			res->Resize(mat.cols());
+			for (size_t r = offset; r < offset + rows; r++) {
+				res->AddVec(1.0f, SubVector{mat, r});
+			}
+			if (rows != 0) res->Scale(1.0f / rows);
+		}
+	} // namespace
+
+	TemplateModel::TemplateModel(const std::string& filename, DistanceType distance) {
+		m_container.ReadHotwordModel(filename);
+		m_length = 0;
+		if (m_container.NumTemplates() == 0) return;
+		TemplateContainer combined{m_container};
+		combined.CombineTemplates(distance);
+		auto tpl = combined.GetTemplate(0);
+		m_length = tpl->rows();
+		ComputeRowMean(*tpl, 0, tpl->rows(), &m_embedding);
+	}
+
+	std::shared_ptr<const TemplateModel> TemplateModel::Load(const std::string& filename, DistanceType distance) {
+		return ModelRegistry::Instance().Get<TemplateModel>(filename, std::to_string(distance), [&]() {
+			return std::make_shared<const TemplateModel>(filename, distance);
+		});
+	}
+
+	TemplateIndex::TemplateIndex(DistanceType distance)
+		: m_distance{distance} {}
+
+	void TemplateIndex::AddModel(std::shared_ptr<const TemplateModel> model) {
+		m_models.push_back(std::move(model));
+		m_buckets.clear();
+	}
+
+	void TemplateIndex::Build(size_t bucket_width) {
+		m_buckets.clear();
+		std::vector<size_t> order;
+		for (size_t i = 0; i < m_models.size(); i++) {
+			if (m_models[i]->m_length != 0) order.push_back(i);
+		}
+		std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			return m_models[a]->m_length < m_models[b]->m_length;
+		});
+		for (auto idx : order) {
+			if (m_buckets.empty() || m_models[m_buckets.back().models.front()]->m_length + bucket_width < m_models[idx]->m_length) {
+				m_buckets.emplace_back();
+			}
+			m_buckets.back().models.push_back(idx);
+		}
+		for (auto& b : m_buckets) {
+			size_t length = 0;
+			for (auto idx : b.models) {
+				auto& emb = m_models[idx]->m_embedding;
+				if (b.centroid.size() == 0) b.centroid.Resize(emb.size());
+				b.centroid.AddVec(1.0f, emb);
+				length += m_models[idx]->m_length;
+			}
+			b.centroid.Scale(1.0f / b.models.size());
+			b.length = (length + b.models.size() / 2) / b.models.size();
+			b.radius = 0.0f;
+			for (auto idx : b.models) {
+				b.radius = std::max(b.radius, ComputeDistance(m_distance, m_models[idx]->m_embedding, b.centroid));
+			}
+		}
+	}
+
+	const TemplateModel& TemplateIndex::GetModel(size_t index) const {
+		if (index >= m_models.size())
+			throw snowboy_exception{"model id runs out of range, expecting a value between [0, "
+									+ std::to_string(m_models.size()) + "] got " + std::to_string(index) + " instead."};
+		return *m_models[index];
+	}
+
+	void TemplateIndex::FindCandidates(const MatrixBase& features, size_t end, float threshold, std::vector<size_t>* candidates) {
+		candidates->clear();
+		// Rejecting a bucket relies on the triangle inequality, which the cosine distance does not satisfy
+		const bool prune = m_distance != DistanceType::cosine;
+		// Buckets are sorted by length, so the window only grows and every row is summed once
+		auto& sum = m_sum;
+		auto& mean = m_mean;
+		sum.Resize(features.cols());
+		size_t rows_summed = 0;
+		for (auto& b : m_buckets) {
+			auto rows = std::min(b.length, end);
+			if (rows == 0) continue;
+			for (; rows_summed < rows; rows_summed++) {
+				sum.AddVec(1.0f, SubVector{features, end - rows_summed - 1});
+			}
+			mean = sum;
+			mean.Scale(1.0f / rows);
+			if (prune && ComputeDistance(m_distance, mean, b.centroid) > threshold + b.radius) continue;
+			for (auto idx : b.models) {
+				if (ComputeDistance(m_distance, mean, m_models[idx]->m_embedding) <= threshold)
+					candidates->push_back(idx);
+			}
+		}
+		std::sort(candidates->begin(), candidates->end());
+	}
+} // namespace snowboy
@@ -0,0 +1,58 @@
+#pragma once
+#include <dtw-lib.h>
+#include <matrix-wrapper.h>
+#include <memory>
+#include <string>
+#include <template-container.h>
+#include <vector-wrapper.h>
+#include <vector>
+
+namespace snowboy {
+	/**
+	 * Immutable personal model as used by TemplateDetectStream.
+	 * Instances loaded through Load() are shared by all streams using the same file, see ModelRegistry.
+	 */
+	struct TemplateModel {
+		TemplateContainer m_container;
+		// Row mean of the DTW averaged templates
+		Vector m_embedding;
+		// Length of the DTW averaged template
+		size_t m_length;
+
+		TemplateModel(const std::string& filename, DistanceType distance);
+
+		static std::shared_ptr<const TemplateModel> Load(const std::string& filename, DistanceType distance);
+	};
+
+	/**
+	 * Groups personal models by template length and rejects whole groups
+	 * based on the distance between the mean of the current feature window
+	 * and the group centroid. Only models passing the filter need to run DTW.
+	 * Groups are never rejected for cosine distance, which is not a metric.
+	 */
+	struct TemplateIndex {
+		struct Bucket {
+			size_t length;
+			Vector centroid;
+			// Largest distance of a model to the centroid
+			float radius;
+			std::vector<size_t> models;
+		};
+
+		DistanceType m_distance;
+		std::vector<std::shared_ptr<const TemplateModel>> m_models;
+		std::vector<Bucket> m_buckets;
+		// Kept between calls to FindCandidates to avoid allocating
+		Vector m_sum;
+		Vector m_mean;
+
+		TemplateIndex(DistanceType distance);
+
+		void AddModel(std::shared_ptr<const TemplateModel> model);
+		void Build(size_t bucket_width);
+		size_t NumModels() const { return m_models.size(); }
+		const TemplateModel& GetModel(size_t index) const;
+		// Replaces candidates with the ids of all models passing the filter in ascending order
+		void FindCandidates(const MatrixBase& features, size_t end, float threshold, std::vector<size_t>* candidates);
+	};
+} // namespace snowboy
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <frame-info.h>
+#include <intercept-stream.h>
+#include <snowboy-error.h>
+#include <tiered-vad-stream.h>
+
+namespace snowboy {
+
+	TieredVadStream::TieredVadStream(InterceptStream* nnet_input, StreamItf* nnet_output, size_t max_bypass_frames) {
+		if (nnet_input == nullptr || nnet_output == nullptr)
+			throw snowboy_exception{"both the input and output stream of the escalation chain are required"};
+		m_nnet_input = nnet_input;
+		m_nnet_output = nnet_output;
+		m_max_bypass_frames = max_bypass_frames;
+		Reset();
+	}
+
+	int TieredVadStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
+		auto& tmat = m_input;
+		auto& tinfo = m_input_info;
+		auto sig = m_connectedStream->Read(&tmat, &tinfo);
+		if ((sig & 0xc2) != 0) {
+			mat->Resize(0, 0);
+			info->clear();
+			return sig;
+		}
+		// Until the chain produced output we do not know the width of its rows
+		bool confident = m_output_cols != 0 && m_bypass_run < m_max_bypass_frames && !tinfo.empty()
+						 && std::all_of(tinfo.begin(), tinfo.end(), [](const FrameInfo& e) { return (e.flags & 0x2) != 0; });
+		if (!confident) {
+			m_num_escalated_frames += tinfo.size();
+			if (!tinfo.empty()) m_bypass_run = 0;
+			return ReadChain(tmat, tinfo, sig, mat, info);
+		}
+		m_num_bypassed_frames += tinfo.size();
+		m_bypass_run += tinfo.size();
+		if (m_pending_rows != 0) {
+			// Flush the chain first, its frames are older than this chunk
+			ReadChain(Matrix{}, {}, sig | 0x10, mat, info);
+		} else {
+			mat->Resize(0, 0);
+			info->clear();
+		}
+		auto rows = mat->rows();
+		mat->Resize(rows + tinfo.size(), m_output_cols, MatrixResizeType::kCopyData);
+		info->insert(info->end(), tinfo.begin(), tinfo.end());
+		return sig;
+	}
+
+	bool TieredVadStream::Reset() {
+		m_pending_rows = 0;
+		m_output_cols = 0;
+		m_bypass_run = 0;
+		m_num_bypassed_frames = 0;
+		m_num_escalated_frames = 0;
+		return true;
+	}
+
+	std::string TieredVadStream::Name() const {
+		return "TieredVadStream";
+	}
+
+	TieredVadStream::~TieredVadStream() {}
+
+	int TieredVadStream::ReadChain(const MatrixBase& mat, const std::vector<FrameInfo>& info, int signal, Matrix* out, std::vector<FrameInfo>* out_info) {
+		m_nnet_input->SetData(mat, info, static_cast<SnowboySignal>(signal));
+		auto sig = m_nnet_output->Read(out, out_info);
+		m_pending_rows += mat.rows();
+		m_pending_rows -= std::min(m_pending_rows, out->rows());
+		if ((signal & 0x18) != 0) m_pending_rows = 0;
+		if (out->rows() != 0) m_output_cols = out->cols();
+		return sig;
+	}
+
+} // namespace snowboy
@@ -0,0 +1,47 @@
+#pragma once
+#include <frame-info.h>
+#include <matrix-wrapper.h>
+#include <stream-itf.h>
+
+namespace snowboy {
+	class InterceptStream;
+
+	/**
+	 * Splits the VAD between the energy VAD and a more expensive VAD chain.
+	 *
+	 * Chunks in which every frame is flagged as confident (0x2) by the
+	 * RawEnergyVadStream keep the energy decision and are passed on directly,
+	 * their rows are zero since no features are computed for them.
+	 * All other chunks are fed into nnet_input and the result is read back from
+	 * nnet_output. Before a confident chunk is passed on, frames still buffered
+	 * in the chain are flushed, so the output keeps the input order.
+	 * After max_bypass_frames bypassed frames in a row the next chunk is escalated
+	 * regardless, so that the decisions of the chain can keep adapting the
+	 * background energy.
+	 */
+	class TieredVadStream : public StreamItf {
+		InterceptStream* m_nnet_input;
+		StreamItf* m_nnet_output;
+		// Rows fed into the chain that did not come out yet
+		size_t m_pending_rows;
+		size_t m_output_cols;
+		size_t m_max_bypass_frames;
+		size_t m_bypass_run;
+		size_t m_num_bypassed_frames;
+		size_t m_num_escalated_frames;
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
+
+		int ReadChain(const MatrixBase& mat, const std::vector<FrameInfo>& info, int signal, Matrix* out, std::vector<FrameInfo>* out_info);
+
+	public:
+		TieredVadStream(InterceptStream* nnet_input, StreamItf* nnet_output, size_t max_bypass_frames);
+		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
+		virtual bool Reset() override;
+		virtual std::string Name() const override;
+		virtual ~TieredVadStream();
+
+		size_t NumBypassedFrames() const noexcept { return m_num_bypassed_frames; }
+		size_t NumEscalatedFrames() const noexcept { return m_num_escalated_frames; }
+	};
+} // namespace snowboy
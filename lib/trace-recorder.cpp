@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <trace-recorder.h>
+#include <vector>
+
+namespace snowboy {
+
+	namespace {
+		struct TraceEvent {
+			char name[48];
+			uint64_t timestamp;
+			uint32_t thread;
+			char phase;
+		};
+
+		std::vector<TraceEvent> g_events;
+		std::atomic<bool> g_recording{false};
+		std::atomic<uint64_t> g_next{0};
+		// Number of threads currently writing an event, Stop waits for them before the buffer is read or replaced
+		std::atomic<int> g_writers{0};
+		std::chrono::steady_clock::time_point g_start;
+		std::atomic<uint32_t> g_next_thread{1};
+
+		uint32_t ThreadId() noexcept {
+			static thread_local uint32_t id = g_next_thread.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
+
+		bool Record(const char* name, size_t len, char phase) noexcept {
+			if (!g_recording.load(std::memory_order_acquire)) return false;
+			g_writers.fetch_add(1, std::memory_order_acq_rel);
+			bool recorded = false;
+			if (g_recording.load(std::memory_order_acquire)) {
+				auto& e = g_events[g_next.fetch_add(1, std::memory_order_relaxed) % g_events.size()];
+				len = std::min(len, sizeof(e.name) - 1);
+				memcpy(e.name, name, len);
+				e.name[len] = '\0';
+				e.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_start).count();
+				e.thread = ThreadId();
+				e.phase = phase;
+				recorded = true;
+			}
+			g_writers.fetch_sub(1, std::memory_order_release);
+			return recorded;
+		}
+	} // namespace
+
+	void TraceRecorder::Start(size_t max_events) {
+		Stop();
+		g_events.assign(std::max<size_t>(max_events, 1), TraceEvent{});
+		g_next.store(0, std::memory_order_relaxed);
+		g_start = std::chrono::steady_clock::now();
+		g_recording.store(true, std::memory_order_release);
+	}
+
+	void TraceRecorder::Stop() {
+		g_recording.store(false, std::memory_order_release);
+		while (g_writers.load(std::memory_order_acquire) != 0)
+			std::this_thread::yield();
+	}
+
+	bool TraceRecorder::IsRecording() noexcept {
+		return g_recording.load(std::memory_order_relaxed);
+	}
+
+	bool TraceRecorder::Begin(const char* name) noexcept {
+		return Record(name, strlen(name), 'B');
+	}
+
+	bool TraceRecorder::Begin(const std::string& name) noexcept {
+		return Record(name.data(), name.size(), 'B');
+	}
+
+	void TraceRecorder::End() noexcept {
+		Record("", 0, 'E');
+	}
+
+	std::string TraceRecorder::ToJson() {
+		std::stringstream res;
+		res << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		auto end = g_next.load(std::memory_order_acquire);
+		auto begin = end > g_events.size() ? end - g_events.size() : 0;
+		std::map<uint32_t, size_t> depth;
+		bool first = true;
+		for (auto i = begin; i < end; i++) {
+			auto& e = g_events[i % g_events.size()];
+			if (e.phase == 'B') {
+				depth[e.thread]++;
+			} else {
+				// The begin event has been overwritten
+				if (depth[e.thread] == 0) continue;
+				depth[e.thread]--;
+			}
+			if (!first) res << ",";
+			first = false;
+			res << "{\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << e.timestamp / 1000 << "." << (e.timestamp / 100) % 10 << (e.timestamp / 10) % 10 << e.timestamp % 10;
+			if (e.phase == 'B') res << ",\"name\":\"" << e.name << "\"";
+			res << "}";
+		}
+		res << "]}";
+		return res.str();
+	}
+} // namespace snowboy
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace snowboy {
+	/**
+	 * Process wide recorder of begin/end events in chrome trace event format.
+	 *
+	 * Events are written into a ring buffer of fixed size, once it is full the oldest events are overwritten.
+	 * Recording is lock free, the only cost while not recording is a relaxed atomic load. Trace points are
+	 * compiled in only if the library is built with SNOWMAN_ENABLE_TRACE.
+	 */
+	class TraceRecorder {
+	public:
+		/**
+		 * \brief Clears the buffer and starts recording.
+		 * \param max_events Size of the ring buffer in events
+		 */
+		static void Start(size_t max_events);
+		// Stops recording and waits for events which are currently written
+		static void Stop();
+		static bool IsRecording() noexcept;
+
+		// Names are truncated to 47 characters, returns false if not recording
+		static bool Begin(const char* name) noexcept;
+		static bool Begin(const std::string& name) noexcept;
+		static void End() noexcept;
+
+		/**
+		 * \brief Returns the buffered events as chrome trace event json.
+		 *
+		 * Can be loaded in chrome://tracing or https://ui.perfetto.dev. End events whose begin
+		 * was overwritten are dropped. Should be called after Stop(), events written concurrently might be missing.
+		 */
+		static std::string ToJson();
+	};
+
+	class TraceScope {
+		bool m_active;
+
+	public:
+		TraceScope(bool active) noexcept
+			: m_active{active} {}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+		~TraceScope() {
+			if (m_active) TraceRecorder::End();
+		}
+	};
+} // namespace snowboy
+
+#define SNOWBOY_TRACE_CONCAT_IMPL(a, b) a##b
+#define SNOWBOY_TRACE_CONCAT(a, b) SNOWBOY_TRACE_CONCAT_IMPL(a, b)
+#ifdef SNOWMAN_ENABLE_TRACE
+// Records the enclosing scope, name is only evaluated while recording
+#define SNOWBOY_TRACE_SCOPE(name) \
+	::snowboy::TraceScope SNOWBOY_TRACE_CONCAT(snowboy_trace_scope_, __LINE__) { ::snowboy::TraceRecorder::IsRecording() ? ::snowboy::TraceRecorder::Begin(name) : false }
+#else
+#define SNOWBOY_TRACE_SCOPE(name) \
+	do {                          \
+	} while (false)
+#endif
@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <frame-info.h>
 #include <limits>
 #include <math.h>
+#include <model-registry.h>
 #include <nnet-lib.h>
 #include <snowboy-error.h>
 #include <snowboy-io.h>
 #include <snowboy-options.h>
 #include <sstream>
+#include <trace-recorder.h>
 #include <universal-detect-stream.h>
 
 namespace snowboy {
@@ -33,6 +36,7 @@ namespace snowboy {
 		// Note: in the original code there are resize(0) calls for each vector,
 		// but this is not needed since they are constructed empty anyway.
 		ReadHotwordModel(m_options.model_str);
+		ShareNetworkPrefixes();
 		if (!m_options.smooth_window_str.empty()) SetSmoothWindowSize(m_options.smooth_window_str);
 		if (!m_options.slide_window_str.empty()) SetSlideWindowSize(m_options.slide_window_str);
 		if (!m_options.sensitivity_str.empty()) SetSensitivity(m_options.sensitivity_str);
@@ -51,67 +55,50 @@ namespace snowboy {
 	int UniversalDetectStream::Read(Matrix* mat, std::vector<FrameInfo>* info) {
 		mat->Resize(0, 0);
 		if (info) info->clear();
-		Matrix read_mat;
-		std::vector<FrameInfo> read_info;
+		auto& read_mat = m_input;
+		auto& read_info = m_input_info;
 		auto read_res = m_connectedStream->Read(&read_mat, &read_info);
 		if ((read_res & 0xc2) != 0) return read_res;
+		ComputeSharedPrefixes(read_mat, (read_res & 0x18) != 0);
 		for (size_t file = 0; file < m_model_info.size(); file++) {
-			Matrix nnet_out_mat;
-			std::vector<FrameInfo> nnet_out_info;
-			if ((read_res & 0x18) == 0)
-				m_model_info[file].network.Compute(read_mat, read_info, &nnet_out_mat, &nnet_out_info);
+			auto& nnet_out_mat = m_nnet_output;
+			auto& nnet_out_info = m_nnet_output_info;
+			ComputeNetwork(file, read_mat, read_info, (read_res & 0x18) != 0, &nnet_out_mat, &nnet_out_info);
+			FrameInfo detected_info;
+			auto hotword_id = DetectHotword(file, &nnet_out_mat, nnet_out_info, &detected_info);
+			if (hotword_id != 0) {
+				mat->Resize(1, 1);
+				mat->m_data[0] = hotword_id;
+				if (info != nullptr) info->push_back(detected_info);
+				return read_res;
+			}
+		}
+		if ((read_res & 0x18) != 0) {
+			this->Reset();
+		}
+		return read_res;
+	}
+
+	int UniversalDetectStream::DetectHotword(size_t file, Matrix* posteriors, const std::vector<FrameInfo>& nnet_out_info, FrameInfo* detected_info) {
+		SNOWBOY_TRACE_SCOPE("UniversalDetectStream::DetectHotword");
+		m_model_info[file].SmoothPosterior(posteriors);
+		for (size_t r = 0; r < posteriors->m_rows; r += m_options.slide_step) {
+			auto max = 0;
+			if (r + m_options.slide_step > posteriors->m_rows)
+				max = posteriors->m_rows;
 			else
-				m_model_info[file].network.FlushOutput(read_mat, read_info, &nnet_out_mat, &nnet_out_info);
-			m_model_info[file].SmoothPosterior(&nnet_out_mat);
-			for (size_t r = 0; r < nnet_out_mat.m_rows; r += m_options.slide_step) {
-				auto max = 0;
-				if (r + m_options.slide_step > nnet_out_mat.m_rows)
-					max = nnet_out_mat.m_rows;
-				else
-					max = r + m_options.slide_step;
-				PushSlideWindow(file, nnet_out_mat.RowRange(r, max - r));
-				const auto max_frame_id = nnet_out_info[max - 1].frame_id;
-				float fVar8 = 0.0f;
-				int local_130 = -1;
-				for (size_t i = 0; i < m_model_info[file].keywords.size(); i++) {
-					auto posterior = GetHotwordPosterior(file, i, max_frame_id);
-					if (!field_x68 || max_frame_id - field_x6c < 0x33) {
-						if (field_x60) {
-							if (3000 < max_frame_id - field_x64) {
-								field_x60 = false;
-							}
-							if (1.0f - m_model_info[file].keywords[i].high_sensitivity <= posterior && m_options.min_detection_interval < max_frame_id - field_x58)
-							{
-								if (fVar8 < posterior) {
-									local_130 = i;
-									fVar8 = posterior;
-								}
-								field_x64 = max_frame_id;
-							}
-						} else {
-							if (posterior < 1.0f - m_model_info[file].keywords[i].sensitivity || max_frame_id - field_x58 <= m_options.min_detection_interval) {
-								if (!field_x68
-									&& 1.0f - m_model_info[file].keywords[i].high_sensitivity <= posterior
-									&& posterior < 1.0f - m_model_info[file].keywords[i].sensitivity
-									&& max_frame_id - field_x58 <= m_options.min_detection_interval) {
-									field_x68 = true;
-									field_x6c = max_frame_id;
-								}
-							} else {
-								if (fVar8 < posterior) {
-									local_130 = i;
-									fVar8 = posterior;
-								}
-								if (!field_x68 && m_model_info[file].keywords[i].sensitivity < m_model_info[file].keywords[i].high_sensitivity) {
-									field_x68 = true;
-									field_x6c = max_frame_id;
-								}
-							}
+				max = r + m_options.slide_step;
+			PushSlideWindow(file, posteriors->RowRange(r, max - r));
+			const auto max_frame_id = nnet_out_info[max - 1].frame_id;
+			float fVar8 = 0.0f;
+			int local_130 = -1;
+			for (size_t i = 0; i < m_model_info[file].keywords.size(); i++) {
+				auto posterior = GetHotwordPosterior(file, i, max_frame_id);
+				if (!field_x68 || max_frame_id - field_x6c < 0x33) {
+					if (field_x60) {
+						if (3000 < max_frame_id - field_x64) {
+							field_x60 = false;
 						}
-					} else {
-						field_x68 = false;
-						field_x60 = true;
-						field_x64 = max_frame_id;
 						if (1.0f - m_model_info[file].keywords[i].high_sensitivity <= posterior && m_options.min_detection_interval < max_frame_id - field_x58)
 						{
 							if (fVar8 < posterior) {
@@ -120,31 +107,152 @@ namespace snowboy {
 							}
 							field_x64 = max_frame_id;
 						}
+					} else {
+						if (posterior < 1.0f - m_model_info[file].keywords[i].sensitivity || max_frame_id - field_x58 <= m_options.min_detection_interval) {
+							if (!field_x68
+								&& 1.0f - m_model_info[file].keywords[i].high_sensitivity <= posterior
+								&& posterior < 1.0f - m_model_info[file].keywords[i].sensitivity
+								&& max_frame_id - field_x58 <= m_options.min_detection_interval) {
+								field_x68 = true;
+								field_x6c = max_frame_id;
+							}
+						} else {
+							if (fVar8 < posterior) {
+								local_130 = i;
+								fVar8 = posterior;
+							}
+							if (!field_x68 && m_model_info[file].keywords[i].sensitivity < m_model_info[file].keywords[i].high_sensitivity) {
+								field_x68 = true;
+								field_x6c = max_frame_id;
+							}
+						}
 					}
-				}
-				if (local_130 != -1) {
-					m_model_info[file].CheckLicense();
-					field_x58 = max_frame_id;
-					field_x5c = max_frame_id;
-					ResetDetection();
-					mat->Resize(1, 1);
-					mat->m_data[0] = m_model_info[file].keywords[local_130].hotword_id;
-					if (info != nullptr) {
-						auto i = nnet_out_info[r];
-						info->push_back(i);
-						return read_res;
+				} else {
+					field_x68 = false;
+					field_x60 = true;
+					field_x64 = max_frame_id;
+					if (1.0f - m_model_info[file].keywords[i].high_sensitivity <= posterior && m_options.min_detection_interval < max_frame_id - field_x58)
+					{
+						if (fVar8 < posterior) {
+							local_130 = i;
+							fVar8 = posterior;
+						}
+						field_x64 = max_frame_id;
 					}
 				}
 			}
+			if (local_130 != -1) {
+				m_model_info[file].CheckLicense();
+				field_x58 = max_frame_id;
+				field_x5c = max_frame_id;
+				ResetDetection();
+				if (detected_info != nullptr) *detected_info = nnet_out_info[r];
+				return m_model_info[file].keywords[local_130].hotword_id;
+			}
 		}
-		if ((read_res & 0x18) != 0) {
-			this->Reset();
+		return 0;
+	}
+
+	void UniversalDetectStream::ComputeSharedPrefixes(const MatrixBase& input, bool flush) {
+		// Prefixes are fed without frame infos, the suffixes take them from the input
+		auto& info = m_discarded_info;
+		for (auto& e : m_shared_prefixes) {
+			if (!flush)
+				e.network.Compute(input, {}, &e.output, &info);
+			else
+				e.network.FlushOutput(input, {}, &e.output, &info);
+		}
+	}
+
+	void UniversalDetectStream::ComputeNetwork(size_t model_id, const MatrixBase& input, const std::vector<FrameInfo>& info, bool flush, Matrix* output, std::vector<FrameInfo>* output_info) {
+		auto& model = m_model_info[model_id];
+		if (model.shared_prefix < 0) {
+			if (!flush)
+				model.network.Compute(input, info, output, output_info);
+			else
+				model.network.FlushOutput(input, info, output, output_info);
+			return;
+		}
+		// The prefix is padded for the widest model of the group, drop the rows
+		// this model would not have seen on its own.
+		auto& prefix = m_shared_prefixes[model.shared_prefix].output;
+		size_t begin = std::min<size_t>(model.prefix_pending_rows, prefix.rows());
+		model.prefix_pending_rows -= begin;
+		size_t end = prefix.rows();
+		if (flush) end -= std::min(model.prefix_trim_rows, end - begin);
+		for (auto& e : info)
+			model.prefix_info.push_back(e);
+		auto& suffix_info = m_discarded_info;
+		auto rows = prefix.RowRange(begin, end - begin);
+		if (!flush)
+			model.suffix.Compute(rows, {}, output, &suffix_info);
+		else
+			model.suffix.FlushOutput(rows, {}, output, &suffix_info);
+		output_info->resize(output->rows());
+		for (auto& e : *output_info) {
+			if (model.prefix_info.empty()) break;
+			e = model.prefix_info.front();
+			model.prefix_info.pop_front();
+		}
+		if (flush) {
+			model.prefix_pending_rows = model.prefix_skip_rows;
+			model.prefix_info.clear();
+		}
+	}
+
+	void UniversalDetectStream::ShareNetworkPrefixes() {
+		m_shared_prefixes.clear();
+		// Copying a Nnet copies its components, make sure the prefixes are never reallocated
+		m_shared_prefixes.reserve(m_model_info.size());
+		std::vector<bool> grouped(m_model_info.size(), false);
+		for (size_t i = 0; i < m_model_info.size(); i++) {
+			if (grouped[i]) continue;
+			// Group with the models sharing the most leading components, the last
+			// component is kept per model so that every suffix is a valid network.
+			std::vector<size_t> lengths(m_model_info.size(), 0);
+			size_t length = 0;
+			for (size_t j = i + 1; j < m_model_info.size(); j++) {
+				if (grouped[j]) continue;
+				lengths[j] = m_model_info[i].network.CommonPrefixLength(m_model_info[j].network);
+				lengths[j] = std::min(lengths[j], std::min(m_model_info[i].network.NumComponents(), m_model_info[j].network.NumComponents()) - 1);
+				length = std::max(length, lengths[j]);
+			}
+			if (length == 0) continue;
+			SharedPrefix prefix;
+			prefix.models.push_back(i);
+			for (size_t j = i + 1; j < m_model_info.size(); j++) {
+				if (lengths[j] == length) prefix.models.push_back(j);
+			}
+			int left = 0, right = 0;
+			for (auto m : prefix.models) {
+				left = std::max(left, m_model_info[m].network.LeftContext());
+				right = std::max(right, m_model_info[m].network.RightContext());
+			}
+			m_shared_prefixes.push_back(std::move(prefix));
+			auto& p = m_shared_prefixes.back();
+			p.network.ShareComponents(m_model_info[i].network, 0, length);
+			p.network.SetPadding(left, right);
+			for (auto m : p.models) {
+				auto& model = m_model_info[m];
+				grouped[m] = true;
+				model.shared_prefix = m_shared_prefixes.size() - 1;
+				model.suffix.ShareComponents(model.network, length, model.network.NumComponents());
+				model.suffix.SetPadding(0, 0);
+				model.prefix_skip_rows = left - model.network.LeftContext();
+				model.prefix_trim_rows = right - model.network.RightContext();
+				model.prefix_pending_rows = model.prefix_skip_rows;
+			}
 		}
-		return read_res;
 	}
 
 	bool UniversalDetectStream::Reset() {
-		for (auto& e : m_model_info)
+		for (auto& e : m_model_info) {
+			e.network.ResetComputation();
+			e.suffix.ResetComputation();
+			e.prefix_pending_rows = e.prefix_skip_rows;
+			e.prefix_info.clear();
+		}
+		for (auto& e : m_shared_prefixes)
 			e.network.ResetComputation();
 		ResetDetection();
 		return true;
@@ -386,18 +494,30 @@ namespace snowboy {
 		SplitStringToVector(filename, global_snowboy_string_delimiter, &files);
 		if (files.empty())
 			throw snowboy_exception{"no model can be extracted from --model-str: " + filename};
-		auto s = files.size();
-		m_model_info.resize(s);
+		m_model_info.clear();
+		m_model_info.reserve(files.size());
+		m_model_sources.clear();
 
 		int hotword_id = 1;
-		for (size_t f = 0; f < files.size(); f++) {
-			Input in{files[f]};
-			auto binary = in.is_binary();
-			auto is = in.Stream();
-			m_model_info[f].ReadHotwordModel(binary, is, m_options.num_repeats, &hotword_id);
+		for (auto& e : files) {
+			m_model_sources.push_back(ModelInfo::Load(e, m_options.num_repeats));
+			m_model_info.push_back(*m_model_sources.back());
+			// The ids continue over all models
+			for (auto& kw : m_model_info.back().keywords)
+				kw.hotword_id = hotword_id++;
 		}
 	}
 
+	std::shared_ptr<const UniversalDetectStream::ModelInfo> UniversalDetectStream::ModelInfo::Load(const std::string& filename, int num_repeats) {
+		return ModelRegistry::Instance().Get<ModelInfo>(filename, std::to_string(num_repeats), [&]() {
+			auto res = std::make_shared<ModelInfo>();
+			Input in{filename};
+			int hotword_id = 1;
+			res->ReadHotwordModel(in.is_binary(), in.Stream(), num_repeats, &hotword_id);
+			return std::shared_ptr<const ModelInfo>{std::move(res)};
+		});
+	}
+
 	void UniversalDetectStream::ModelInfo::ResetDetection() {
 		for (size_t x = 0; x < field_x238.size(); x++) {
 			field_x238[x].clear();
@@ -1,8 +1,9 @@
 #pragma once
-#include <deque>
+#include <frame-info.h>
 #include <matrix-wrapper.h>
 #include <memory>
 #include <nnet-lib.h>
+#include <ring-buffer.h>
 #include <stream-itf.h>
 #include <string>
 
@@ -71,6 +72,14 @@ namespace snowboy {
 
 		struct ModelInfo {
 			Nnet network;
+			// Remaining components if the leading ones are computed by a shared prefix
+			Nnet suffix;
+			int shared_prefix = -1;
+			// Rows of the prefix output which only exist because of the padding of other models
+			size_t prefix_skip_rows = 0;
+			size_t prefix_trim_rows = 0;
+			size_t prefix_pending_rows = 0;
+			RingBuffer<FrameInfo> prefix_info;
 			std::vector<KeyWordInfo> keywords;
 			// License start
 			int64_t license_start;
@@ -82,8 +91,8 @@ namespace snowboy {
 			size_t smooth_window;
 			// Slide window
 			size_t slide_window;
-			std::vector<std::deque<float>> field_x238;
-			std::vector<std::deque<float>> field_x250;
+			std::vector<RingBuffer<float>> field_x238;
+			std::vector<RingBuffer<float>> field_x250;
 			std::vector<float> field_x268;
 			std::vector<float> field_x2b0;
 
@@ -92,12 +101,31 @@ namespace snowboy {
 			float HotwordNaiveSearch(size_t keyword_id) const;
 			size_t NumHotwords() const;
 			void ReadHotwordModel(bool binary, std::istream* is, int num_repeats, int* hotword_id);
+			// Reads the model in filename through the ModelRegistry, hotword ids start at 1
+			static std::shared_ptr<const ModelInfo> Load(const std::string& filename, int num_repeats);
 			void WriteHotwordModel(bool binary, std::ostream* os) const;
 			void ResetDetection();
 			void UpdateLicense(long, float);
 		};
 
 		std::vector<ModelInfo> m_model_info;
+		// Models as read from the files, kept so the registry knows they are in use
+		std::vector<std::shared_ptr<const ModelInfo>> m_model_sources;
+
+		// Leading network components which are identical in several models and only computed once
+		struct SharedPrefix {
+			Nnet network;
+			std::vector<size_t> models;
+			Matrix output;
+		};
+		std::vector<SharedPrefix> m_shared_prefixes;
+
+		// Kept between reads to avoid allocating
+		Matrix m_input;
+		std::vector<FrameInfo> m_input_info;
+		Matrix m_nnet_output;
+		std::vector<FrameInfo> m_nnet_output_info;
+		std::vector<FrameInfo> m_discarded_info;
 
 		UniversalDetectStream(const UniversalDetectStreamOptions& options);
 		virtual int Read(Matrix* mat, std::vector<FrameInfo>* info) override;
@@ -105,6 +133,12 @@ namespace snowboy {
 		virtual std::string Name() const override;
 		virtual ~UniversalDetectStream();
 
+		// Smooths a chunk of network output and runs the detection logic on it.
+		// Returns the detected hotword id or 0.
+		int DetectHotword(size_t model_id, Matrix* posteriors, const std::vector<FrameInfo>& info, FrameInfo* detected_info);
+		// Computes the shared prefixes for a chunk, needs to be called before ComputeNetwork.
+		void ComputeSharedPrefixes(const MatrixBase& input, bool flush);
+		void ComputeNetwork(size_t model_id, const MatrixBase& input, const std::vector<FrameInfo>& info, bool flush, Matrix* output, std::vector<FrameInfo>* output_info);
 		float GetHotwordPosterior(size_t model_id, int, int);
 		std::string GetSensitivity() const;
 		float HotwordDtwSearch(int, int) const;
@@ -123,6 +157,7 @@ namespace snowboy {
 		void SetSensitivity(const std::string&);
 		void SetSlideWindowSize(const std::string&);
 		void SetSmoothWindowSize(const std::string&);
+		void ShareNetworkPrefixes();
 		void UpdateLicense(size_t model_id, long, float);
 		void UpdateModel() const;
 		void WriteHotwordModel(bool binary, const std::string& filename) const;
@@ -52,8 +52,8 @@ namespace snowboy {
 			return 1;
 		}
 		auto cols = param_1.m_cols < 1 ? m_someMatrix.m_cols : param_1.m_cols;
-		Matrix local_b8;
-		local_b8.Resize(rows, cols);
+		auto& local_b8 = m_joinedMatrix;
+		local_b8.Resize(rows, cols, MatrixResizeType::kUndefined);
 		if (m_someMatrix.m_rows > 0) {
 			local_b8.RowRange(0, m_someMatrix.m_rows).CopyFromMat(m_someMatrix, MatrixTransposeType::kNoTrans);
 		}
@@ -61,12 +61,10 @@ namespace snowboy {
 			local_b8.RowRange(m_someMatrix.m_rows, param_1.m_rows).CopyFromMat(param_1, MatrixTransposeType::kNoTrans);
 		}
 		m_someMatrix.Resize(0, 0);
-		std::vector<FrameInfo> tinfo;
-		tinfo.reserve(param_2.size() + field_x50.size());
-		for (auto& e : field_x50)
-			tinfo.push_back(e);
-		for (auto& e : param_2)
-			tinfo.push_back(e);
+		auto& tinfo = m_joinedInfo;
+		tinfo.clear();
+		tinfo.insert(tinfo.end(), field_x50.begin(), field_x50.end());
+		tinfo.insert(tinfo.end(), param_2.begin(), param_2.end());
 		field_x50.clear();
 		int local_c8 = 1;
 		size_t lVar7 = 0;
@@ -160,12 +158,12 @@ namespace snowboy {
 			}
 			if (field_x28 <= m_someOtherMatrix.rows() + lVar7) {
 				const auto iVar2 = field_x28 - lVar7;
-				Matrix local_98;
-				local_98.Resize(field_x28, local_b8.m_cols);
+				auto& local_98 = m_tailMatrix;
+				local_98.Resize(field_x28, local_b8.m_cols, MatrixResizeType::kUndefined);
 				local_98.RowRange(0, iVar2).CopyFromMat(m_someOtherMatrix.RowRange(m_someOtherMatrix.m_rows - iVar2, iVar2), MatrixTransposeType::kNoTrans);
 				local_98.RowRange(iVar2, lVar7).CopyFromMat(local_b8.RowRange(0, lVar7), MatrixTransposeType::kNoTrans);
 				m_someOtherMatrix.Swap(&local_98);
-				std::vector<FrameInfo> pFVar6;
+				auto& pFVar6 = m_tailInfo;
 				pFVar6.resize(field_x28);
 				auto pfVar15 = field_x80.size() - iVar2;
 				for (size_t pfVar5 = 0; iVar2 != pfVar5; pfVar5++) {
@@ -174,7 +172,7 @@ namespace snowboy {
 				for (size_t i = 0; i < lVar7; i++) {
 					pFVar6[iVar2 + i] = tinfo[i];
 				}
-				field_x80 = std::move(pFVar6);
+				field_x80.swap(pFVar6);
 				// TODO: This might be a continue of the loop
 				goto LAB_0016b7aa;
 			}
@@ -215,8 +213,8 @@ namespace snowboy {
 		if (field_xa0 != 1) {
 			return ProcessCachedSignal(mat, info);
 		}
-		Matrix local_b8;
-		std::vector<FrameInfo> local_98;
+		auto& local_b8 = m_readMatrix;
+		auto& local_98 = m_readInfo;
 		auto uVar6 = m_connectedStream->Read(&local_b8, &local_98);
 		if ((uVar6 & 4) != 0) uVar6 = uVar6 & 0xfffffffb;
 		if ((uVar6 & 0xc2) != 0) {
@@ -225,9 +223,9 @@ namespace snowboy {
 			return uVar6;
 		}
 		if (!local_98.empty()) {
-			std::vector<VoiceType> local_78;
+			auto& local_78 = m_voiceTypes;
 			local_78.resize(local_98.size());
-			std::vector<VoiceStateType> local_58;
+			auto& local_58 = m_voiceStates;
 			for (size_t i = 0; i < local_98.size(); i++) {
 				local_78[i] = (local_98[i].flags & 1) ? VT_1 : VT_2;
 			}
@@ -2,9 +2,9 @@
 #include <matrix-wrapper.h>
 #include <memory>
 #include <stream-itf.h>
+#include <vad-lib.h>
 
 namespace snowboy {
-	struct VadState;
 	struct OptionsItf;
 	struct VadStateStreamOptions {
 		uint32_t min_non_voice_frames;
@@ -25,6 +25,15 @@ namespace snowboy {
 		const std::unique_ptr<VadState> m_vadstate;
 		int field_xa0;
 		int field_xa4;
+		// Scratch buffers kept between calls, so a steady stream does not allocate
+		Matrix m_readMatrix;
+		std::vector<FrameInfo> m_readInfo;
+		std::vector<VoiceType> m_voiceTypes;
+		std::vector<VoiceStateType> m_voiceStates;
+		Matrix m_joinedMatrix;
+		std::vector<FrameInfo> m_joinedInfo;
+		Matrix m_tailMatrix;
+		std::vector<FrameInfo> m_tailInfo;
 
 		int ProcessCachedSignal(Matrix*, std::vector<FrameInfo>*);
 		int ProcessDataAndInfo(const MatrixBase&, const std::vector<FrameInfo>&, Matrix*, std::vector<FrameInfo>*);
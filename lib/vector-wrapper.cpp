@@ -9,6 +9,7 @@ extern "C"
 #include <random>
 #include <snowboy-error.h>
 #include <snowboy-io.h>
+#include <snowboy-math.h>
 #include <vector-wrapper.h>
 
 namespace snowboy {
@@ -59,12 +60,15 @@ namespace snowboy {
 	}
 
 	void VectorBase::ApplyLog() noexcept {
-		for (size_t i = 0; i < m_size; i++) {
-			m_data[i] = logf(m_data[i]);
-		}
+		VectorLog(m_data, m_data, m_size);
 	}
 
 	void VectorBase::ApplyPow(float param_1) noexcept {
+		// Used by the normalization, 1 / sqrt is much cheaper than pow
+		if (param_1 == -0.5f) {
+			VectorRsqrt(m_data, m_data, m_size);
+			return;
+		}
 		for (size_t i = 0; i < m_size; i++) {
 			m_data[i] = pow(m_data[i], param_1);
 		}
@@ -72,10 +76,10 @@ namespace snowboy {
 
 	float VectorBase::ApplySoftmax() noexcept {
 		auto max = Max(), sum = 0.0f;
-		for (size_t i = 0; i < m_size; i++) {
-			m_data[i] = expf(m_data[i] - max);
+		Add(-max);
+		VectorExp(m_data, m_data, m_size);
+		for (size_t i = 0; i < m_size; i++)
 			sum += m_data[i];
-		}
 		Scale(1.0f / sum);
 		return logf(sum) + max;
 	}
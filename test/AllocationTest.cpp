@@ -0,0 +1,127 @@
+#include <fstream>
+#include <functional>
+#include <helper.h>
+#include <matrix-wrapper.h>
+#include <pipeline-detect.h>
+#include <snowboy-options.h>
+#include <snowboy-detect.h>
+
+const static auto root = detect_project_root();
+
+/**
+ * Feeds data in chunks of chunk_size samples to run, once to warm up and once more while
+ * counting heap allocations. Buffers are sized during the first pass, so the second one must not allocate.
+ */
+static void expect_steady_state(const std::vector<short>& data, size_t chunk_size, const std::function<int(const int16_t*, int)>& run) {
+	// Only whole chunks, so both passes split the audio into the same frames
+	const auto size = data.size() - data.size() % chunk_size;
+	for (size_t i = 0; i < size; i += chunk_size)
+		run(data.data() + i, chunk_size);
+	MemoryChecker check{true};
+	for (size_t i = 0; i < size; i += chunk_size)
+		run(data.data() + i, chunk_size);
+	check.stop();
+	EXPECT_EQ(check.num_allocations(), 0) << check;
+}
+
+static std::vector<short> read_all_samples() {
+	std::vector<short> res;
+	for (auto e : {"hotword1.wav", "noise1.wav", "snowboy.wav", "hotword2.wav"}) {
+		if (!file_exists(root + "audio_samples/" + e)) continue;
+		auto data = read_sample_file(root + "audio_samples/" + e);
+		res.insert(res.end(), data.begin(), data.end());
+	}
+	return res;
+}
+
+#if MEMCHECK_ENABLED
+#define SKIP_IF_MEMCHECK_DISABLED() \
+	do {                            \
+	} while (false)
+#else
+#define SKIP_IF_MEMCHECK_DISABLED() GTEST_SKIP() << "memcheck disabled due to asan"
+#endif
+
+TEST(AllocationTest, SteadyStateDetect) {
+	SKIP_IF_MEMCHECK_DISABLED();
+	auto data = read_all_samples();
+	ASSERT_FALSE(data.empty());
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(false);
+	for (size_t chunk : {160, 1600}) {
+		SCOPED_TRACE("chunk size " + std::to_string(chunk));
+		expect_steady_state(data, chunk, [&](const int16_t* d, int len) { return detector.RunDetection(d, len); });
+	}
+}
+
+TEST(AllocationTest, SteadyStateDetectMultiModel) {
+	SKIP_IF_MEMCHECK_DISABLED();
+	auto data = read_all_samples();
+	ASSERT_FALSE(data.empty());
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl," + root + "resources/models/jarvis.umdl");
+	detector.SetSensitivity("0.5,0.5,0.5");
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(true);
+	expect_steady_state(data, 1600, [&](const int16_t* d, int len) { return detector.RunDetection(d, len); });
+}
+
+TEST(AllocationTest, SteadyStateVad) {
+	SKIP_IF_MEMCHECK_DISABLED();
+	auto data = read_all_samples();
+	ASSERT_FALSE(data.empty());
+	snowboy::SnowboyVad vad(root + "resources/common.res");
+	vad.SetAudioGain(1.0);
+	vad.ApplyFrontend(false);
+	expect_steady_state(data, 1600, [&](const int16_t* d, int len) { return vad.RunVad(d, len); });
+}
+
+static void enroll_model(const std::string& filename) {
+	{
+		std::ofstream t{filename, std::ios::binary | std::ios::trunc};
+	}
+	snowboy::SnowboyPersonalEnroll enroll{root + "resources/pmdl/en/personal_enroll.res", filename};
+	for (auto e : {"record1.wav.cut", "record2.wav.cut", "record3.wav.cut"}) {
+		auto data = read_sample_file_as_string(root + "audio_samples/" + e, true);
+		ASSERT_FALSE(data.empty());
+		ASSERT_EQ(enroll.RunEnrollment(data), 0);
+	}
+}
+
+TEST(AllocationTest, SteadyStatePersonal) {
+	SKIP_IF_MEMCHECK_DISABLED();
+	enroll_model("temp_alloc_model.pmdl");
+	auto data = read_all_samples();
+	ASSERT_FALSE(data.empty());
+	snowboy::SnowboyDetect detector(root + "resources/common.res", "temp_alloc_model.pmdl");
+	detector.SetSensitivity("0.5");
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(false);
+	expect_steady_state(data, 1600, [&](const int16_t* d, int len) { return detector.RunDetection(d, len); });
+}
+
+TEST(AllocationTest, SteadyStatePersonalPrefilter) {
+	SKIP_IF_MEMCHECK_DISABLED();
+	enroll_model("temp_alloc_prefilter_model.pmdl");
+	auto data = read_all_samples();
+	ASSERT_FALSE(data.empty());
+	snowboy::PipelineDetectOptions options{};
+	options.sampleRate = 16000;
+	snowboy::PipelineDetect pipeline{options};
+	pipeline.SetResource(root + "resources/common.res");
+	// Loose enough for the model to enter and leave the candidates on the samples
+	snowboy::ParseOptions opts{""};
+	pipeline.RegisterOptions(pipeline.OptionPrefix(), &opts);
+	opts.ReadConfigString("--detectp.pdetect.prefilter-threshold=0.5");
+	pipeline.SetModel("temp_alloc_prefilter_model.pmdl," + root + "resources/models/snowboy.umdl");
+	pipeline.Init();
+	pipeline.SetMaxAudioAmplitude(32767.0f);
+	snowboy::Matrix mat;
+	expect_steady_state(data, 1600, [&](const int16_t* d, int len) {
+		mat.Resize(1, len, snowboy::MatrixResizeType::kUndefined);
+		for (int i = 0; i < len; i++)
+			mat(0, i) = d[i];
+		return pipeline.RunDetection(mat, false);
+	});
+}
@@ -1,6 +1,21 @@
+#include <cstdio>
+#include <eavesdrop-stream.h>
+#include <fstream>
 #include <helper.h>
+#include <intercept-stream.h>
 #include <matrix-wrapper.h>
+#include <model-registry.h>
+#include <pipeline-detect.h>
+#include <pipeline-vad.h>
+#include <raw-energy-vad-stream.h>
+#include <sensitivity-sweep.h>
+#include <snowboy-detect-c.h>
 #include <snowboy-detect.h>
+#include <snowboy-options.h>
+#include <stream-stats.h>
+#include <thread>
+#include <tiered-vad-stream.h>
+#include <universal-detect-stream.h>
 #include <vad-lib.h>
 #include <vector-wrapper.h>
 
@@ -226,3 +241,649 @@ TEST(ClassifyTest, LoadModels) {
 	}
 	ASSERT_FALSE(skipped_all);
 }
+
+TEST(ClassifyTest, SensitivitySweep) {
+	snowboy::SensitivitySweep sweep(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	std::vector<int> expected;
+	for (auto& e : sample_map) {
+		if (!file_exists(root + "audio_samples/" + e.first)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e.first.c_str());
+			continue;
+		}
+		auto data = read_sample_file(root + "audio_samples/" + e.first);
+		sweep.AddFile(e.first, data.data(), data.size(), std::max(e.second, 0));
+		expected.push_back(e.second);
+	}
+	ASSERT_FALSE(expected.empty());
+	auto res = sweep.Replay(0.5f);
+	ASSERT_EQ(res.size(), expected.size());
+	for (size_t i = 0; i < res.size(); i++) {
+		if (expected[i] > 0) {
+			ASSERT_FALSE(res[i].empty());
+			EXPECT_EQ(res[i].front(), expected[i]);
+		} else
+			EXPECT_TRUE(res[i].empty());
+	}
+	auto points = sweep.Run({0.1f, 0.5f, 0.9f}, {});
+	ASSERT_EQ(points.size(), 3);
+	// Recall can only go up with the sensitivity
+	EXPECT_LE(points[0].recall, points[1].recall);
+	EXPECT_LE(points[1].recall, points[2].recall);
+}
+
+TEST(ClassifyTest, SharedNetworkPrefix) {
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/snowboy.umdl," + root + "resources/models/computer.umdl," + root + "resources/models/snowboy.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	ASSERT_EQ(stream.m_shared_prefixes.size(), 1);
+	ASSERT_EQ(stream.m_shared_prefixes[0].models, std::vector<size_t>({0, 2}));
+	ASSERT_EQ(stream.m_model_info[1].shared_prefix, -1);
+
+	bool skipped_all = true;
+	for (auto& e : sample_map) {
+		if (!file_exists(root + "audio_samples/" + e.first)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e.first.c_str());
+			continue;
+		}
+		skipped_all = false;
+		auto data = read_sample_file(root + "audio_samples/" + e.first);
+		snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl," + root + "resources/models/snowboy.umdl");
+		detector.SetSensitivity("0.5,0.5");
+		detector.SetAudioGain(1.0);
+		detector.ApplyFrontend(false);
+
+		int result = detector.RunDetection(data.data(), data.size());
+		EXPECT_EQ(result, e.second) << "Failed to correctly classify sample " << e.first;
+	}
+	ASSERT_FALSE(skipped_all);
+}
+
+TEST(ClassifyTest, SharedNetworkPrefixDifferentSuffix) {
+	// These models start with the same two components and differ in everything after them
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/computer.umdl," + root + "resources/models/hey_extreme.umdl," + root + "resources/models/view_glass.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	ASSERT_EQ(stream.m_shared_prefixes.size(), 1);
+	ASSERT_EQ(stream.m_shared_prefixes[0].models, std::vector<size_t>({0, 1, 2}));
+	ASSERT_EQ(stream.m_shared_prefixes[0].network.NumComponents(), 2);
+
+	// Reference networks computing every component on their own
+	std::vector<snowboy::Nnet> unshared;
+	for (auto& e : stream.m_model_info)
+		unshared.emplace_back(e.network);
+
+	unsigned int seed = 0;
+	snowboy::Matrix input;
+	input.Resize(97, unshared[0].InputDim());
+	for (size_t r = 0; r < input.rows(); r++) {
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	}
+	std::vector<std::vector<float>> shared_out(unshared.size()), unshared_out(unshared.size());
+	std::vector<std::vector<unsigned int>> shared_ids(unshared.size()), unshared_ids(unshared.size());
+	auto append = [](const snowboy::Matrix& out, const std::vector<snowboy::FrameInfo>& info, std::vector<float>* values, std::vector<unsigned int>* ids) {
+		for (size_t r = 0; r < out.rows(); r++) {
+			for (size_t c = 0; c < out.cols(); c++)
+				values->push_back(out(r, c));
+		}
+		for (auto& e : info)
+			ids->push_back(e.frame_id);
+	};
+	for (size_t pos = 0; pos < input.rows(); pos += 13) {
+		auto len = std::min<size_t>(13, input.rows() - pos);
+		auto flush = pos + len == input.rows();
+		auto rows = input.RowRange(pos, len);
+		std::vector<snowboy::FrameInfo> info(len);
+		for (size_t r = 0; r < len; r++)
+			info[r] = {static_cast<unsigned int>(pos + r), 0};
+		stream.ComputeSharedPrefixes(rows, flush);
+		for (size_t m = 0; m < unshared.size(); m++) {
+			snowboy::Matrix out;
+			std::vector<snowboy::FrameInfo> out_info;
+			stream.ComputeNetwork(m, rows, info, flush, &out, &out_info);
+			append(out, out_info, &shared_out[m], &shared_ids[m]);
+			out_info.clear();
+			if (!flush)
+				unshared[m].Compute(rows, info, &out, &out_info);
+			else
+				unshared[m].FlushOutput(rows, info, &out, &out_info);
+			append(out, out_info, &unshared_out[m], &unshared_ids[m]);
+		}
+	}
+	for (size_t m = 0; m < unshared.size(); m++) {
+		ASSERT_EQ(shared_ids[m].size(), input.rows()) << "model " << m;
+		ASSERT_EQ(shared_ids[m], unshared_ids[m]) << "model " << m;
+		ASSERT_EQ(shared_out[m].size(), unshared_out[m].size()) << "model " << m;
+		for (size_t i = 0; i < shared_out[m].size(); i++)
+			ASSERT_NEAR(shared_out[m][i], unshared_out[m][i], 1e-5) << "model " << m << " value " << i;
+	}
+	// The suffixes are really different, otherwise this would not test anything
+	ASSERT_NE(shared_out[0], shared_out[1]);
+	ASSERT_NE(shared_out[0], shared_out[2]);
+}
+
+TEST(ClassifyTest, GateNonVoice) {
+	std::vector<short> data;
+	unsigned int seed = 0;
+	for (auto& e : {"hotword1.wav", "noise1.wav", "snowboy.wav", "sample1.wav"}) {
+		if (!file_exists(root + "audio_samples/" + e)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e);
+			continue;
+		}
+		auto sample = read_sample_file(root + "audio_samples/" + e);
+		data.insert(data.end(), sample.begin(), sample.end());
+		// Five seconds of near silence between the samples
+		for (size_t i = 0; i < 16000 * 5; i++)
+			data.push_back(static_cast<short>(rand_r(&seed) % 21) - 10);
+	}
+	ASSERT_FALSE(data.empty());
+
+	// Chunk index and hotword of every detection
+	std::vector<std::pair<size_t, int>> results[2];
+	size_t suspended_chunks = 0, suspensions = 0;
+	for (int gate = 0; gate < 2; gate++) {
+		snowboy::PipelineDetectOptions options{};
+		options.sampleRate = 16000;
+		snowboy::PipelineDetect pipeline{options};
+		pipeline.SetResource(root + "resources/common.res");
+		// The bundled resource already drops non-voice frames, which hides the effect of gating
+		snowboy::ParseOptions opts{""};
+		pipeline.RegisterOptions(pipeline.OptionPrefix(), &opts);
+		opts.ReadConfigString("--detectp.vads2.remove-non-voice=false");
+		pipeline.SetModel(root + "resources/models/snowboy.umdl");
+		pipeline.Init();
+		pipeline.SetMaxAudioAmplitude(32767.0f);
+		pipeline.GateNonVoice(gate != 0);
+		for (size_t i = 0; i < data.size(); i += 1600) {
+			snowboy::Matrix mat;
+			mat.Resize(1, std::min<size_t>(1600, data.size() - i));
+			for (size_t c = 0; c < mat.cols(); c++)
+				mat(0, c) = data[i + c];
+			auto was_suspended = pipeline.DetectorsSuspended();
+			auto res = pipeline.RunDetection(mat, false);
+			if (res > 0) results[gate].push_back({i / 1600, res});
+			if (pipeline.DetectorsSuspended()) {
+				suspended_chunks++;
+				if (!was_suspended) suspensions++;
+			}
+		}
+	}
+	ASSERT_FALSE(results[0].empty());
+	// Same hotwords in the same chunks
+	ASSERT_EQ(results[0], results[1]);
+	// Every silence between the samples is gated once, and most of its 50 chunks are skipped
+	ASSERT_GE(suspensions, 3);
+	ASSERT_GE(suspended_chunks, suspensions * 30);
+}
+
+TEST(ClassifyTest, GateNonVoiceMinLength) {
+	if (!file_exists(root + "audio_samples/hotword1.wav")) {
+		GTEST_WARN("Skiping because audio file is missing!");
+		return;
+	}
+	auto data = read_sample_file(root + "audio_samples/hotword1.wav");
+	// Short pauses inside speech never suspend the detectors
+	unsigned int seed = 0;
+	std::vector<short> silence(16000 * 2);
+	for (auto& e : silence)
+		e = static_cast<short>(rand_r(&seed) % 21) - 10;
+
+	snowboy::PipelineDetectOptions options{};
+	options.sampleRate = 16000;
+	snowboy::PipelineDetect pipeline{options};
+	pipeline.SetResource(root + "resources/common.res");
+	snowboy::ParseOptions opts{""};
+	pipeline.RegisterOptions(pipeline.OptionPrefix(), &opts);
+	opts.ReadConfigString("--detectp.vads2.remove-non-voice=false --detectp.gate-min-non-voice-frames=150");
+	pipeline.SetModel(root + "resources/models/snowboy.umdl");
+	pipeline.Init();
+	pipeline.SetMaxAudioAmplitude(32767.0f);
+	pipeline.GateNonVoice(true);
+	auto run = [&](const std::vector<short>& samples) {
+		size_t suspended = 0;
+		for (size_t i = 0; i < samples.size(); i += 1600) {
+			snowboy::Matrix mat;
+			mat.Resize(1, std::min<size_t>(1600, samples.size() - i));
+			for (size_t c = 0; c < mat.cols(); c++)
+				mat(0, c) = samples[i + c];
+			pipeline.RunDetection(mat, false);
+			suspended += pipeline.DetectorsSuspended();
+		}
+		return suspended;
+	};
+	run(silence);
+	ASSERT_TRUE(pipeline.DetectorsSuspended());
+	run(data);
+	ASSERT_FALSE(pipeline.DetectorsSuspended());
+	// Half a second of non-voice is below the 1.5s minimum
+	std::vector<short> pause(silence.begin(), silence.begin() + 8000);
+	ASSERT_EQ(run(pause), 0);
+	run(data);
+	// Only the last half second of the silence is gated
+	auto suspended = run(silence);
+	ASSERT_GT(suspended, 0);
+	ASSERT_LE(suspended, 6);
+}
+
+TEST(ClassifyTest, RunDetectionParallel) {
+	std::vector<short> data;
+	unsigned int seed = 0;
+	// Long enough for a handful of segments, the hotwords end up at different offsets relative to the segment boundaries
+	for (int round = 0; round < 6; round++) {
+		for (auto& e : {"hotword1.wav", "noise1.wav", "snowboy.wav", "sample1.wav", "hotword2.wav", "noise2.wav"}) {
+			if (!file_exists(root + "audio_samples/" + e)) continue;
+			auto sample = read_sample_file(root + "audio_samples/" + e);
+			data.insert(data.end(), sample.begin(), sample.end());
+			auto gap = 1600 * (round + 1) + rand_r(&seed) % 16000;
+			for (size_t i = 0; i < gap; i++)
+				data.push_back(static_cast<short>(rand_r(&seed) % 21) - 10);
+		}
+	}
+	ASSERT_FALSE(data.empty());
+
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(false);
+	std::vector<std::pair<int, size_t>> expected;
+	for (size_t i = 0; i < data.size(); i += 1600) {
+		auto len = std::min<size_t>(1600, data.size() - i);
+		auto res = detector.RunDetection(data.data() + i, len, i + len == data.size());
+		if (res > 0) expected.emplace_back(res, i + len);
+	}
+	ASSERT_GT(expected.size(), 6);
+
+	for (int threads : {1, 3, 8}) {
+		SCOPED_TRACE("threads " + std::to_string(threads));
+		std::vector<std::pair<int, size_t>> actual;
+		for (auto& e : detector.RunDetectionParallel(data.data(), data.size(), threads))
+			actual.emplace_back(e.hotword, e.position);
+		EXPECT_EQ(actual, expected);
+	}
+}
+
+TEST(ClassifyTest, RunDetectionParallelVoiced) {
+	// Reversed recordings are voice without the hotword, the segment boundaries fall into long voiced stretches
+	std::vector<short> data;
+	for (int round = 0; round < 4; round++) {
+		for (auto& e : {"hotword1.wav", "snowboy.wav", "hotword2.wav"}) {
+			if (!file_exists(root + "audio_samples/" + e)) continue;
+			auto sample = read_sample_file(root + "audio_samples/" + e);
+			data.insert(data.end(), sample.begin(), sample.end());
+			for (int rep = 0; rep <= round % 3; rep++) {
+				for (auto& v : {"record1.wav.cut", "hotword3_fail.wav", "record2.wav.cut", "record3.wav.cut"}) {
+					if (!file_exists(root + "audio_samples/" + v)) continue;
+					auto voice = read_sample_file(root + "audio_samples/" + v);
+					data.insert(data.end(), voice.rbegin(), voice.rend());
+				}
+			}
+		}
+	}
+	ASSERT_FALSE(data.empty());
+
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	std::vector<std::pair<int, size_t>> expected;
+	size_t voiced = 0, chunks = 0;
+	for (size_t i = 0; i < data.size(); i += 1600, chunks++) {
+		auto len = std::min<size_t>(1600, data.size() - i);
+		auto res = detector.RunDetection(data.data() + i, len, i + len == data.size());
+		if (res > 0) expected.emplace_back(res, i + len);
+		voiced += res != -2;
+	}
+	ASSERT_GT(voiced, chunks * 9 / 10);
+	ASSERT_GT(expected.size(), 10);
+
+	for (int threads : {2, 3, 8}) {
+		SCOPED_TRACE("threads " + std::to_string(threads));
+		std::vector<std::pair<int, size_t>> exact, approximate;
+		for (auto& e : detector.RunDetectionParallel(data.data(), data.size(), threads, 1600, true))
+			exact.emplace_back(e.hotword, e.position);
+		EXPECT_EQ(exact, expected);
+		// The smoothed posteriors remember the audio since the last detection, only the start matches for sure
+		for (auto& e : detector.RunDetectionParallel(data.data(), data.size(), threads))
+			approximate.emplace_back(e.hotword, e.position);
+		EXPECT_NEAR(approximate.size(), expected.size(), expected.size() / 10);
+		EXPECT_EQ(approximate.front(), expected.front());
+	}
+}
+
+TEST(ClassifyTest, Clone) {
+	{
+		std::ofstream t{"temp_clone_model.pmdl", std::ios::binary | std::ios::trunc};
+	}
+	{
+		snowboy::SnowboyPersonalEnroll enroll{root + "resources/pmdl/en/personal_enroll.res", "temp_clone_model.pmdl"};
+		for (auto e : {"record1.wav.cut", "record2.wav.cut", "record3.wav.cut"}) {
+			auto data = read_sample_file_as_string(root + "audio_samples/" + e, true);
+			ASSERT_FALSE(data.empty());
+			ASSERT_EQ(enroll.RunEnrollment(data), 0);
+		}
+	}
+	std::vector<std::vector<short>> samples;
+	for (auto& e : sample_map) {
+		if (file_exists(root + "audio_samples/" + e.first)) samples.push_back(read_sample_file(root + "audio_samples/" + e.first));
+	}
+	ASSERT_FALSE(samples.empty());
+
+	snowboy::SnowboyDetect detector(root + "resources/common.res", "temp_clone_model.pmdl," + root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.4,0.6");
+	detector.SetHighSensitivity("0.4,0.7");
+	detector.SetAudioGain(1.5);
+	detector.ApplyFrontend(true);
+	// Leave some state behind, the clone has to start fresh
+	detector.RunDetection(samples[0].data(), samples[0].size() / 2);
+	auto clone = detector.Clone();
+	ASSERT_TRUE(detector.Reset());
+	EXPECT_EQ(clone->GetSensitivity(), detector.GetSensitivity());
+	EXPECT_EQ(clone->NumHotwords(), detector.NumHotwords());
+
+	auto run = [&](snowboy::SnowboyDetect* d, std::vector<int>* out) {
+		for (auto& data : samples) {
+			for (size_t i = 0; i < data.size(); i += 1600)
+				out->push_back(d->RunDetection(data.data() + i, std::min<size_t>(1600, data.size() - i)));
+			d->Reset();
+		}
+	};
+	std::vector<int> expected, actual;
+	run(&detector, &expected);
+	// Both share the networks and templates, so run them at the same time
+	std::thread other{run, &detector, &expected};
+	run(clone.get(), &actual);
+	other.join();
+	ASSERT_EQ(actual.size() * 2, expected.size());
+	EXPECT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin()));
+	EXPECT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + actual.size()));
+
+	snowboy::SnowboyVad vad(root + "resources/common.res");
+	vad.SetTieredVad(true);
+	auto vad_clone = vad.Clone();
+	for (auto& data : samples) {
+		for (size_t i = 0; i < data.size(); i += 1600) {
+			auto len = std::min<size_t>(1600, data.size() - i);
+			ASSERT_EQ(vad_clone->RunVad(data.data() + i, len), vad.RunVad(data.data() + i, len));
+		}
+	}
+
+	snowboy::SnowboyDetect plain(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	auto c_detector = SNOWMAN_Detect_Create((root + "resources/common.res").c_str(), (root + "resources/models/snowboy.umdl").c_str());
+	ASSERT_NE(c_detector, nullptr);
+	auto c_clone = SNOWMAN_Detect_Clone(c_detector);
+	// The clone keeps the shared models alive
+	SNOWMAN_Detect_Destroy(c_detector);
+	ASSERT_NE(c_clone, nullptr);
+	EXPECT_EQ(SNOWMAN_Detect_RunDetectionShort(c_clone, samples[0].data(), samples[0].size(), 1), plain.RunDetection(samples[0].data(), samples[0].size(), true));
+	SNOWMAN_Detect_Destroy(c_clone);
+	EXPECT_EQ(SNOWMAN_Detect_Clone(nullptr), nullptr);
+	EXPECT_EQ(SNOWMAN_Vad_Clone(nullptr), nullptr);
+}
+
+TEST(ClassifyTest, ModelRegistry) {
+	using snowboy::UniversalDetectStream;
+	auto& registry = snowboy::ModelRegistry::Instance();
+	registry.Clear();
+	const auto model = root + "resources/models/snowboy.umdl";
+	auto a = UniversalDetectStream::ModelInfo::Load(model, 1);
+	EXPECT_EQ(UniversalDetectStream::ModelInfo::Load(model, 1).get(), a.get());
+	EXPECT_NE(UniversalDetectStream::ModelInfo::Load(model, 2).get(), a.get());
+	EXPECT_EQ(registry.Size(), 2);
+
+	std::vector<std::vector<short>> samples;
+	for (auto& e : sample_map) {
+		if (file_exists(root + "audio_samples/" + e.first)) samples.push_back(read_sample_file(root + "audio_samples/" + e.first));
+	}
+	ASSERT_FALSE(samples.empty());
+	auto run = [&](std::vector<int>* out) {
+		snowboy::SnowboyDetect detector(root + "resources/common.res", model);
+		detector.SetSensitivity("0.5");
+		detector.ApplyFrontend(false);
+		for (auto& data : samples) {
+			out->push_back(detector.RunDetection(data.data(), data.size()));
+			detector.Reset();
+		}
+	};
+	std::vector<int> cached, loaded;
+	run(&cached);
+	registry.SetEnabled(false);
+	EXPECT_EQ(registry.Size(), 0);
+	run(&loaded);
+	EXPECT_EQ(registry.Size(), 0);
+	registry.SetEnabled(true);
+	EXPECT_EQ(cached, loaded);
+	{
+		// Hotword ids continue over all models, even if they are shared
+		snowboy::SnowboyDetect detector(root + "resources/common.res", model + "," + root + "resources/models/jarvis.umdl," + model);
+		EXPECT_EQ(detector.NumHotwords(), 4);
+	}
+
+	{
+		std::ofstream out{"temp_registry_model.umdl", std::ios::binary | std::ios::trunc};
+		out << read_file(model);
+	}
+	auto b = UniversalDetectStream::ModelInfo::Load("temp_registry_model.umdl", 1);
+	EXPECT_EQ(b->keywords.size(), 1);
+	EXPECT_EQ(UniversalDetectStream::ModelInfo::Load("./temp_registry_model.umdl", 1).get(), b.get());
+	{
+		std::ofstream out{"temp_registry_model.umdl", std::ios::binary | std::ios::trunc};
+		out << read_file(root + "resources/models/jarvis.umdl");
+	}
+	// Changed files are loaded again
+	auto c = UniversalDetectStream::ModelInfo::Load("temp_registry_model.umdl", 1);
+	EXPECT_NE(c.get(), b.get());
+	EXPECT_EQ(c->keywords.size(), 2);
+
+	registry.Evict("temp_registry_model.umdl");
+	std::vector<std::shared_ptr<const UniversalDetectStream::ModelInfo>> concurrent(8);
+	std::vector<std::thread> threads;
+	for (auto& e : concurrent)
+		threads.emplace_back([&e]() { e = UniversalDetectStream::ModelInfo::Load("temp_registry_model.umdl", 1); });
+	for (auto& e : threads)
+		e.join();
+	for (auto& e : concurrent)
+		EXPECT_EQ(e.get(), concurrent[0].get());
+	EXPECT_NE(concurrent[0].get(), c.get());
+
+	// Only the registry holds the models now
+	a.reset();
+	b.reset();
+	c.reset();
+	concurrent.clear();
+	EXPECT_GT(registry.EvictUnused(), 0);
+	EXPECT_EQ(registry.Size(), 0);
+
+	registry.SetRetainUnused(false);
+	auto d = UniversalDetectStream::ModelInfo::Load(model, 1);
+	EXPECT_EQ(UniversalDetectStream::ModelInfo::Load(model, 1).get(), d.get());
+	std::weak_ptr<const UniversalDetectStream::ModelInfo> weak = d;
+	d.reset();
+	EXPECT_TRUE(weak.expired());
+	registry.SetRetainUnused(true);
+	std::remove("temp_registry_model.umdl");
+}
+
+TEST(ClassifyTest, TieredVad) {
+	std::vector<short> data;
+	unsigned int seed = 0;
+	for (auto& e : {"hotword1.wav", "noise1.wav", "snowboy.wav", "sample1.wav"}) {
+		if (!file_exists(root + "audio_samples/" + e)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e);
+			continue;
+		}
+		auto sample = read_sample_file(root + "audio_samples/" + e);
+		data.insert(data.end(), sample.begin(), sample.end());
+		for (size_t i = 0; i < 16000 * 5; i++)
+			data.push_back(static_cast<short>(rand_r(&seed) % 21) - 10);
+	}
+	ASSERT_FALSE(data.empty());
+
+	std::vector<int> results[2];
+	size_t bypassed = 0;
+	for (int tiered = 0; tiered < 2; tiered++) {
+		snowboy::PipelineVadOptions options{};
+		options.sampleRate = 16000;
+		snowboy::PipelineVad pipeline{options};
+		pipeline.SetResource(root + "resources/common.res");
+		pipeline.Init();
+		pipeline.SetMaxAudioAmplitude(32767.0f);
+		pipeline.SetTieredVad(tiered != 0);
+		// Compare against the full path with the same background estimate
+		pipeline.m_rawEnergyVadStream->m_exact_bg_energy = true;
+		for (size_t i = 0; i < data.size(); i += 1600) {
+			snowboy::Matrix mat;
+			mat.Resize(1, std::min<size_t>(1600, data.size() - i));
+			for (size_t c = 0; c < mat.cols(); c++)
+				mat(0, c) = data[i + c];
+			results[tiered].push_back(pipeline.RunVad(mat, false));
+		}
+		if (tiered) bypassed = pipeline.m_tieredVadStream->NumBypassedFrames();
+	}
+	ASSERT_NE(bypassed, 0);
+	// The energy VAD is allowed to disagree with the network near the voice boundaries
+	size_t mismatches = 0;
+	for (size_t i = 0; i < results[0].size(); i++)
+		mismatches += results[0][i] != results[1][i];
+	ASSERT_LE(mismatches, results[0].size() / 50);
+	ASSERT_NE(std::count(results[0].begin(), results[0].end(), 0), 0);
+}
+
+static size_t count_substr(const std::string& s, const std::string& sub) {
+	size_t res = 0;
+	for (auto pos = s.find(sub); pos != std::string::npos; pos = s.find(sub, pos + 1))
+		res++;
+	return res;
+}
+
+static uint64_t stage_counter(const std::string& stats, const std::string& stage, const std::string& counter) {
+	auto pos = stats.find("{\"name\":\"" + stage + "\"");
+	if (pos == std::string::npos) return 0;
+	pos = stats.find("\"" + counter + "\":", pos);
+	return std::stoull(stats.substr(pos + counter.size() + 3));
+}
+
+TEST(ClassifyTest, StreamStatsInstrument) {
+	// Decorators are always compiled, only the pipelines skip them without SNOWMAN_ENABLE_STATS
+	snowboy::InterceptStream input;
+	snowboy::Matrix eavesdropped;
+	snowboy::EavesdropStream eavesdrop{&eavesdropped, nullptr};
+	eavesdrop.Connect(&input);
+	snowboy::StreamStats stats;
+	auto output = stats.Instrument(&eavesdrop);
+	ASSERT_NE(output, &eavesdrop);
+	ASSERT_NE(eavesdrop.m_connectedStream, &input);
+	// Instrumenting again reuses the decorators
+	ASSERT_EQ(stats.Instrument(&eavesdrop), output);
+	ASSERT_EQ(stats.Stages().size(), 2);
+	ASSERT_EQ(stats.Stages()[0]->name, "InterceptStream");
+	ASSERT_EQ(stats.Stages()[1]->name, "EavesdropStream");
+
+	snowboy::Matrix mat;
+	mat.Resize(3, 160);
+	std::vector<snowboy::FrameInfo> info(3);
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	ASSERT_EQ(output->Read(&mat, &info), 0x20);
+	ASSERT_EQ(mat.rows(), 3);
+	ASSERT_EQ(stats.Stages()[0]->calls, 1);
+	ASSERT_EQ(stats.Stages()[0]->frames, 3);
+	ASSERT_EQ(stats.Stages()[1]->calls, 1);
+
+	// Reset is passed on to the decorated stream
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	ASSERT_TRUE(eavesdrop.m_connectedStream->Reset());
+	ASSERT_EQ(output->Read(&mat, &info), 0x100);
+	ASSERT_EQ(mat.rows(), 0);
+}
+
+TEST(ClassifyTest, PipelineStats) {
+	if (!file_exists(root + "audio_samples/hotword1.wav")) {
+		GTEST_WARN("Skiping because audio file is missing!");
+		return;
+	}
+	auto data = read_sample_file(root + "audio_samples/hotword1.wav");
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	auto run = [&]() {
+		for (size_t i = 0; i < data.size(); i += 1600)
+			detector.RunDetection(data.data() + i, std::min<size_t>(1600, data.size() - i), false);
+	};
+	run();
+	auto stats = detector.GetStats();
+#ifndef SNOWMAN_ENABLE_STATS
+	ASSERT_EQ(stats, "{\"stages\":[]}");
+	GTEST_SKIP() << "pipeline stats need SNOWMAN_ENABLE_STATS";
+#else
+	for (auto stage : {"InterceptStream", "GainControlStream", "FramerStream", "RawEnergyVadStream", "VadStateStream", "FftStream",
+					   "MfccStream", "RawNnetVadStream", "EavesdropStream", "VadStateStream#2", "InterceptStream#2", "UniversalDetectStream"}) {
+		ASSERT_GT(stage_counter(stats, stage, "calls"), 0) << stage << " " << stats;
+	}
+	// Stages are only recorded once per stream, the frontend is not connected yet
+	ASSERT_EQ(stats.find("\"FrontendStream\""), std::string::npos) << stats;
+	ASSERT_EQ(count_substr(stats, "\"name\":"), 12) << stats;
+	// 10ms frame shift, the pipeline is reset once the hotword is found
+	auto frames = stage_counter(stats, "MfccStream", "frames");
+	ASSERT_GT(frames, 0);
+	ASSERT_LE(frames, data.size() / 160);
+	ASSERT_EQ(stage_counter(stats, "FftStream", "frames"), frames);
+	ASSERT_GT(stage_counter(stats, "UniversalDetectStream", "nanoseconds"), 0);
+	// Every stage is called at least once per chunk
+	ASSERT_GE(stage_counter(stats, "FramerStream", "calls"), (data.size() + 1599) / 1600);
+
+	detector.ResetStats();
+	stats = detector.GetStats();
+	ASSERT_EQ(stage_counter(stats, "FramerStream", "calls"), 0);
+	ASSERT_EQ(stage_counter(stats, "UniversalDetectStream", "nanoseconds"), 0);
+
+	// Reconnecting the frontend instruments the chain again
+	detector.Reset();
+	detector.ApplyFrontend(true);
+	run();
+	stats = detector.GetStats();
+	ASSERT_GT(stage_counter(stats, "FrontendStream", "calls"), 0) << stats;
+	ASSERT_EQ(stage_counter(stats, "FrontendStream", "calls"), stage_counter(stats, "FramerStream", "calls")) << stats;
+	ASSERT_EQ(count_substr(stats, "\"name\":"), 13) << stats;
+
+	snowboy::SnowboyVad vad(root + "resources/common.res");
+	vad.RunVad(data.data(), data.size(), false);
+	stats = vad.GetStats();
+	ASSERT_GT(stage_counter(stats, "RawNnetVadStream", "calls"), 0) << stats;
+	ASSERT_GT(stage_counter(stats, "VadStateStream#2", "frames"), 0) << stats;
+#endif
+}
+
+TEST(ClassifyTest, PipelineTrace) {
+	if (!file_exists(root + "audio_samples/hotword1.wav")) {
+		GTEST_WARN("Skiping because audio file is missing!");
+		return;
+	}
+	auto data = read_sample_file(root + "audio_samples/hotword1.wav");
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	auto run = [&]() {
+		for (size_t i = 0; i < data.size(); i += 1600)
+			detector.RunDetection(data.data() + i, std::min<size_t>(1600, data.size() - i), false);
+		detector.Reset();
+	};
+
+	snowboy::StartTrace(1 << 16);
+	run();
+	snowboy::StopTrace();
+	auto trace = snowboy::GetTraceJson();
+#ifndef SNOWMAN_ENABLE_TRACE
+	ASSERT_EQ(trace, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}");
+#else
+	for (auto name : {"PipelineDetect::RunDetection", "FramerStream", "MfccStream", "UniversalDetectStream", "Nnet::Compute", "AffineComponent", "SoftmaxComponent", "UniversalDetectStream::DetectHotword"})
+		ASSERT_NE(trace.find(std::string("\"name\":\"") + name + "\""), std::string::npos) << name;
+	ASSERT_EQ(count_substr(trace, "\"ph\":\"B\""), count_substr(trace, "\"ph\":\"E\""));
+	ASSERT_EQ(count_substr(trace, "\"ph\":\"B\""), count_substr(trace, "\"name\":\""));
+
+	// Once the ring buffer wrapped only the most recent events are kept
+	snowboy::StartTrace(64);
+	run();
+	snowboy::StopTrace();
+	trace = snowboy::GetTraceJson();
+	ASSERT_LE(count_substr(trace, "\"ph\":"), 64);
+	ASSERT_GE(count_substr(trace, "\"ph\":\"B\""), count_substr(trace, "\"ph\":\"E\""));
+	ASSERT_GT(count_substr(trace, "\"ph\":\"E\""), 0);
+#endif
+}
@@ -78,3 +78,24 @@ TEST(DtwTest, Random2) {
 		EXPECT_EQ(t[i][0], 32);
 	}
 }
+
+TEST(DtwTest, Banded) {
+	unsigned int seed = 42;
+	auto m1 = random_matrix(&seed);
+	auto m2 = random_matrix(&seed);
+
+	snowboy::DtwAlignWorkspace ws;
+	std::vector<size_t> t;
+	auto full = snowboy::DtwAlign(snowboy::cosine, m1, m2, nullptr);
+	auto res = snowboy::DtwAlign(snowboy::cosine, m1, m2, m2.rows(), &ws, &t);
+	ASSERT_EQ(res, full);
+	ASSERT_EQ(t.size(), m1.rows());
+
+	res = snowboy::DtwAlign(snowboy::cosine, m1, m2, 3, &ws, &t);
+	ASSERT_GE(res, full);
+	ASSERT_EQ(t.size(), m1.rows());
+	for (size_t i = 1; i < t.size(); i++) {
+		ASSERT_LE(t[i - 1], t[i]);
+		ASSERT_LT(t[i], m2.rows());
+	}
+}
@@ -0,0 +1,249 @@
+#include <agc.h>
+#include <algorithm>
+#include <cmath>
+#include <frontend-lib.h>
+#include <helper.h>
+#include <map>
+#include <ns3.h>
+#include <set>
+#include <snowboy-detect.h>
+
+const static std::map<std::string, int> sample_map{
+	{"hotword1.wav", 1},
+	{"hotword2.wav", 1},
+	{"hotword3.wav", 1},
+	{"hotword3_fail.wav", 0},
+	{"noise1.wav", -2},
+	{"noise2.wav", -2},
+	{"noise3.wav", -2},
+	{"sample1.wav", 1},
+	{"snowboy.wav", 1},
+	{"alma1.wav", -2}};
+
+// Rejected at sensitivity 0.5 but accepted from 0.54 on, removing the background noise pushes them over the threshold
+const static std::set<std::pair<std::string, std::string>> near_misses{{"snowboy.umdl", "hotword3_fail.wav"}};
+
+const static auto root = detect_project_root();
+
+static double energy(const std::vector<short>& data, size_t begin, size_t end) {
+	double res = 0.0;
+	for (size_t i = begin; i < end; i++)
+		res += static_cast<double>(data[i]) * data[i];
+	return res;
+}
+
+TEST(FrontendTest, ComplexFFT) {
+	unsigned int seed = 1;
+	for (int stages = 4; stages <= 10; stages++) {
+		const int n = 1 << stages;
+		std::vector<int16_t> frfi(2 * n);
+		std::vector<double> ref(2 * n);
+		for (auto& e : frfi)
+			e = rand_r(&seed) % 32768 - 16384;
+		for (int k = 0; k < n; k++) {
+			double re = 0.0, im = 0.0;
+			for (int t = 0; t < n; t++) {
+				auto a = -2.0 * M_PI * k * t / n;
+				re += frfi[2 * t] * cos(a) - frfi[2 * t + 1] * sin(a);
+				im += frfi[2 * t] * sin(a) + frfi[2 * t + 1] * cos(a);
+			}
+			ref[2 * k] = re / n;
+			ref[2 * k + 1] = im / n;
+		}
+		TSpl_ComplexBitReverse(frfi.data(), stages);
+		TSpl_ComplexFFT(frfi.data(), stages, 1);
+		for (int i = 0; i < 2 * n; i++)
+			ASSERT_NEAR(frfi[i], ref[i], 4.0) << "stages " << stages << " index " << i;
+	}
+}
+
+TEST(FrontendTest, NoiseSuppression) {
+	int status = 0;
+	auto ns = NS3_Init(16000, 160, &status);
+	ASSERT_EQ(status, 1);
+	ASSERT_EQ(NS3_SetPara(ns, "NS_Power", "2"), 1);
+	ASSERT_EQ(NS3_SetPara(ns, "NS_Power", "5"), 4);
+
+	// Two seconds of white noise, a 1kHz tone in the second one
+	unsigned int seed = 1;
+	std::vector<short> noise(32000), tone(32000), in(32000), out(32000);
+	for (size_t i = 0; i < in.size(); i++) {
+		noise[i] = rand_r(&seed) % 2001 - 1000;
+		tone[i] = i < 16000 ? 0 : 8000 * sin(2.0 * M_PI * 1000.0 * i / 16000.0);
+		in[i] = noise[i] + tone[i];
+	}
+	for (size_t i = 0; i < in.size(); i += 160)
+		NS3_Process(ns, in.data() + i, out.data() + i);
+	NS3_Exit(ns);
+
+	// Output is delayed by the block overlap
+	const size_t delay = 96;
+	EXPECT_LT(energy(out, 8000 + delay, 16000), energy(in, 8000, 16000 - delay) * 0.1);
+	double error = 0.0;
+	for (size_t i = 20000; i < 32000; i++) {
+		double d = out[i] - tone[i - delay];
+		error += d * d;
+	}
+	EXPECT_LT(error, energy(tone, 20000, 32000) * 0.05);
+}
+
+TEST(FrontendTest, AutomaticGainControl) {
+	int status = 0;
+	auto agc = AGC_Init(16000, 160, 1, &status);
+	ASSERT_EQ(status, 1);
+	ASSERT_EQ(AGC_SetPara(agc, "AGC_Level", "2"), 1);
+	ASSERT_EQ(AGC_SetPara(agc, "AGC_Power", "12"), 1);
+
+	std::vector<short> in(8 * 16000), out(8 * 16000);
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = 2000 * sin(2.0 * M_PI * 440.0 * i / 16000.0);
+	for (size_t i = 0; i < in.size(); i += 160)
+		AGC_Process(agc, in.data() + i, out.data() + i);
+	AGC_Exit(agc);
+
+	auto peak = [&out](size_t begin, size_t end) {
+		auto res = 0;
+		for (size_t i = begin; i < end; i++)
+			res = std::max(res, std::abs(out[i]));
+		return res;
+	};
+	// The gain rises by 3dB per second at most, half a second is about the length of a hotword
+	EXPECT_LT(peak(8000, 16000), peak(0, 8000) * 1.2);
+	// 12dB at most, so a peak of 2000 is raised to roughly 8000 without clipping
+	EXPECT_GT(peak(7 * 16000, 8 * 16000), 7000);
+	EXPECT_LE(peak(7 * 16000, 8 * 16000), 8000);
+}
+
+TEST(FrontendTest, ClassifySamples) {
+	bool skipped_all = true;
+	for (auto& e : sample_map) {
+		if (!file_exists(root + "audio_samples/" + e.first)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e.first.c_str());
+			continue;
+		}
+		skipped_all = false;
+		auto data = read_sample_file(root + "audio_samples/" + e.first);
+		snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+		detector.SetSensitivity("0.5");
+		detector.SetAudioGain(1.0);
+		detector.ApplyFrontend(true);
+
+		int result = detector.RunDetection(data.data(), data.size());
+		if (near_misses.count({"snowboy.umdl", e.first}) != 0)
+			EXPECT_GE(result, 0) << "Failed to correctly classify sample " << e.first;
+		else
+			EXPECT_EQ(result, e.second) << "Failed to correctly classify sample " << e.first;
+	}
+	ASSERT_FALSE(skipped_all);
+}
+
+TEST(FrontendTest, ClassifySamplesChunked) {
+	bool skipped_all = true;
+	for (auto& e : sample_map) {
+		if (!file_exists(root + "audio_samples/" + e.first)) {
+			GTEST_WARN("Skiping %s because audio file is missing!", e.first.c_str());
+			continue;
+		}
+		skipped_all = false;
+		auto data = read_sample_file(root + "audio_samples/" + e.first);
+		snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+		detector.SetSensitivity("0.5");
+		detector.SetAudioGain(1.0);
+		detector.ApplyFrontend(true);
+
+		// The frontend works on 10ms blocks, chunks of 100ms keep the detector input aligned
+		int result = -3;
+		const auto chunksize = 1600;
+		for (size_t i = 0; i < data.size(); i += chunksize) {
+			auto len = std::min<int>(chunksize, data.size() - i);
+			result = std::max(result, detector.RunDetection(data.data() + i, len, len != chunksize));
+		}
+		if (near_misses.count({"snowboy.umdl", e.first}) != 0)
+			EXPECT_GE(result, 0) << "Failed to correctly classify sample " << e.first;
+		else if (e.second > 0)
+			EXPECT_EQ(result, e.second) << "Failed to correctly classify sample " << e.first;
+		else {
+			EXPECT_LE(result, 0) << "Failed to correctly classify sample " << e.first;
+			EXPECT_GE(result, -2) << "Failed to correctly classify sample " << e.first;
+		}
+	}
+	ASSERT_FALSE(skipped_all);
+}
+
+TEST(FrontendTest, UniversalModelsUnchanged) {
+	// The bundled samples are clean, the frontend must not change any decision apart from the near misses
+	const std::string models[]{"computer.umdl", "hey_extreme.umdl", "jarvis.umdl", "neoya.umdl",
+							   "smart_mirror.umdl", "snowboy.umdl", "subex.umdl", "view_glass.umdl"};
+	for (auto& model : models) {
+		for (auto& e : sample_map) {
+			if (!file_exists(root + "audio_samples/" + e.first) || near_misses.count({model, e.first}) != 0) continue;
+			auto data = read_sample_file(root + "audio_samples/" + e.first);
+			int results[2];
+			for (int frontend = 0; frontend < 2; frontend++) {
+				snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/" + model);
+				std::string sensitivity = "0.5";
+				for (int i = 1; i < detector.NumHotwords(); i++)
+					sensitivity += ",0.5";
+				detector.SetSensitivity(sensitivity);
+				detector.SetAudioGain(1.0);
+				detector.ApplyFrontend(frontend != 0);
+				results[frontend] = detector.RunDetection(data.data(), data.size());
+			}
+			EXPECT_EQ(results[1], results[0]) << model << " changed its result on " << e.first;
+		}
+	}
+}
+
+TEST(FrontendTest, NoisyDetection) {
+	const std::string hotwords[]{"hotword1.wav", "hotword2.wav", "hotword3.wav", "sample1.wav", "snowboy.wav"};
+	// Every hotword twice with a second of pause before each of them
+	std::vector<short> clean;
+	std::vector<std::pair<size_t, size_t>> words;
+	for (int round = 0; round < 2; round++) {
+		for (auto& e : hotwords) {
+			if (!file_exists(root + "audio_samples/" + e)) {
+				GTEST_WARN("Skiping %s because audio file is missing!", e.c_str());
+				continue;
+			}
+			auto data = read_sample_file(root + "audio_samples/" + e, true);
+			clean.resize(clean.size() + 16000, 0);
+			words.emplace_back(clean.size(), clean.size() + data.size());
+			clean.insert(clean.end(), data.begin(), data.end());
+		}
+	}
+	ASSERT_FALSE(words.empty());
+	clean.resize(clean.size() + 16000, 0);
+
+	// Number of words detected within half a second after their end, every detection has to belong to a word
+	auto detect = [&](const std::vector<short>& data, bool frontend) {
+		snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+		detector.SetSensitivity("0.5");
+		detector.SetAudioGain(1.0);
+		detector.ApplyFrontend(frontend);
+		std::set<size_t> detected;
+		for (size_t i = 0; i < data.size(); i += 1600) {
+			if (detector.RunDetection(data.data() + i, std::min<size_t>(1600, data.size() - i)) <= 0) continue;
+			auto word = std::find_if(words.begin(), words.end(), [&](const std::pair<size_t, size_t>& w) { return i + 1600 >= w.first && i + 1600 <= w.second + 8000; });
+			EXPECT_NE(word, words.end()) << "Detection outside of a word at " << i << " with frontend " << frontend;
+			if (word != words.end()) detected.insert(word - words.begin());
+		}
+		return detected.size();
+	};
+
+	// Stationary white noise and a low rumble, both loud enough to mask about half of the words
+	unsigned int seed = 1;
+	std::vector<short> white(clean.size()), rumble(clean.size());
+	float lowpass = 0.0f;
+	for (size_t i = 0; i < clean.size(); i++) {
+		auto noise = static_cast<float>(rand_r(&seed)) / RAND_MAX * 2.0f - 1.0f;
+		lowpass = 0.95f * lowpass + 0.05f * noise;
+		white[i] = std::min(std::max(clean[i] + 5000.0f * noise, -32768.0f), 32767.0f);
+		rumble[i] = std::min(std::max(clean[i] + 6000.0f * lowpass, -32768.0f), 32767.0f);
+	}
+	for (auto& noisy : {white, rumble}) {
+		auto without = detect(noisy, false);
+		auto with = detect(noisy, true);
+		EXPECT_LE(without, words.size() * 2 / 3);
+		EXPECT_GE(with, without + words.size() / 4) << "Frontend did not improve detection in noise, " << with << " vs " << without << " of " << words.size();
+	}
+}
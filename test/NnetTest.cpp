@@ -0,0 +1,374 @@
+#include <frame-info.h>
+#include <helper.h>
+#include <matrix-wrapper.h>
+#include <nnet-component.h>
+#include <nnet-lib.h>
+#include <snowboy-io.h>
+#include <sstream>
+#include <universal-detect-stream.h>
+
+const static auto root = detect_project_root();
+
+static void run_network(snowboy::Nnet* nnet, const snowboy::Matrix& input, const std::vector<size_t>& chunks, snowboy::Matrix* output, std::vector<snowboy::FrameInfo>* info) {
+	std::vector<snowboy::Matrix> parts;
+	size_t rows = 0, pos = 0;
+	for (size_t i = 0; pos < input.rows(); i++) {
+		auto len = std::min(chunks[i % chunks.size()], input.rows() - pos);
+		std::vector<snowboy::FrameInfo> in_info(len);
+		for (size_t r = 0; r < len; r++)
+			in_info[r] = {static_cast<unsigned int>(pos + r), 0};
+		snowboy::Matrix out;
+		std::vector<snowboy::FrameInfo> out_info;
+		if (pos + len == input.rows())
+			nnet->FlushOutput(input.RowRange(pos, len), in_info, &out, &out_info);
+		else
+			nnet->Compute(input.RowRange(pos, len), in_info, &out, &out_info);
+		ASSERT_EQ(out.rows(), out_info.size());
+		info->insert(info->end(), out_info.begin(), out_info.end());
+		rows += out.rows();
+		parts.push_back(std::move(out));
+		pos += len;
+	}
+	output->Resize(rows, nnet->OutputDim());
+	rows = 0;
+	for (auto& e : parts) {
+		if (e.rows() == 0) continue;
+		output->RowRange(rows, e.rows()).CopyFromMat(e, snowboy::MatrixTransposeType::kNoTrans);
+		rows += e.rows();
+	}
+}
+
+TEST(NnetTest, StreamingMatchesChunked) {
+	for (auto model : {"snowboy.umdl", "computer.umdl"}) {
+		snowboy::UniversalDetectStreamOptions options{};
+		options.slide_step = 1;
+		options.model_str = root + "resources/models/" + model;
+		snowboy::UniversalDetectStream stream{options};
+		auto& network = stream.m_model_info[0].network;
+		ASSERT_TRUE(network.IsStreaming());
+		ASSERT_GT(network.LeftContext() + network.RightContext(), 0);
+
+		unsigned int seed = 0;
+		snowboy::Matrix input;
+		input.Resize(237, network.InputDim());
+		for (size_t r = 0; r < input.rows(); r++) {
+			for (size_t c = 0; c < input.cols(); c++)
+				input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+		}
+
+		snowboy::Nnet chunked{network};
+		chunked.SetStreaming(false);
+		snowboy::Matrix expected;
+		std::vector<snowboy::FrameInfo> expected_info;
+		run_network(&chunked, input, {40}, &expected, &expected_info);
+		ASSERT_EQ(expected.rows(), input.rows());
+
+		for (auto& chunks : std::vector<std::vector<size_t>>{{1}, {3, 1, 7}, {40}, {500}}) {
+			snowboy::Nnet streaming{network};
+			snowboy::Matrix output;
+			std::vector<snowboy::FrameInfo> info;
+			run_network(&streaming, input, chunks, &output, &info);
+			ASSERT_EQ(output.rows(), expected.rows()) << model;
+			ASSERT_EQ(info.size(), expected_info.size()) << model;
+			for (size_t r = 0; r < output.rows(); r++) {
+				ASSERT_EQ(info[r].frame_id, expected_info[r].frame_id);
+				for (size_t c = 0; c < output.cols(); c++)
+					ASSERT_NEAR(output(r, c), expected(r, c), 1e-5) << model << " row " << r << " col " << c;
+			}
+		}
+	}
+}
+
+TEST(NnetTest, ChunkPlanCache) {
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/snowboy.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	auto& network = stream.m_model_info[0].network;
+
+	unsigned int seed = 0;
+	snowboy::Matrix input;
+	input.Resize(200, network.InputDim());
+	for (size_t r = 0; r < input.rows(); r++) {
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	}
+
+	snowboy::Nnet streaming{network};
+	snowboy::Matrix expected;
+	std::vector<snowboy::FrameInfo> expected_info;
+	run_network(&streaming, input, {40}, &expected, &expected_info);
+
+	snowboy::Nnet chunked{network};
+	chunked.SetStreaming(false);
+	ASSERT_EQ(chunked.NumCachedChunkPlans(), 0);
+
+	// Jittery chunk sizes with more distinct sizes than cached plans keep evicting them
+	snowboy::Matrix output;
+	std::vector<snowboy::FrameInfo> info;
+	run_network(&chunked, input, {3, 1, 7, 2, 5, 1, 11, 4, 6, 8, 9, 10}, &output, &info);
+	ASSERT_EQ(chunked.NumCachedChunkPlans(), 8);
+	ASSERT_EQ(output.rows(), expected.rows());
+	for (size_t r = 0; r < output.rows(); r++) {
+		for (size_t c = 0; c < output.cols(); c++)
+			ASSERT_NEAR(output(r, c), expected(r, c), 1e-5) << "row " << r << " col " << c;
+	}
+}
+
+TEST(NnetTest, PlannedActivationsDoNotAllocate) {
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/snowboy.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	auto& network = stream.m_model_info[0].network;
+
+	unsigned int seed = 0;
+	snowboy::Matrix input;
+	input.Resize(16, network.InputDim());
+	for (size_t r = 0; r < input.rows(); r++) {
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	}
+
+	for (auto streaming : {true, false}) {
+		snowboy::Nnet nnet{network};
+		nnet.SetStreaming(streaming);
+		nnet.SetMaxChunkSize(input.rows());
+		snowboy::Matrix output;
+		output.Reserve(input.rows() + nnet.LeftContext() + nnet.RightContext(), nnet.OutputDim());
+		std::vector<snowboy::FrameInfo> in_info(input.rows()), out_info;
+		out_info.reserve(input.rows() + nnet.LeftContext() + nnet.RightContext());
+
+		snowboy::Matrix::ResetAllocStats();
+		for (auto len : {16, 5, 1, 16, 9, 2, 16}) {
+			nnet.Compute(input.RowRange(0, len), std::vector<snowboy::FrameInfo>(in_info.begin(), in_info.begin() + len), &output, &out_info);
+		}
+		ASSERT_EQ(snowboy::Matrix::NumAllocs(), 0) << (streaming ? "streaming" : "chunked");
+	}
+}
+
+TEST(NnetTest, SparseAffineComponent) {
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/snowboy.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	auto& network = stream.m_model_info[0].network;
+
+	unsigned int seed = 0;
+	snowboy::Matrix input;
+	input.Resize(61, network.InputDim());
+	for (size_t r = 0; r < input.rows(); r++) {
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	}
+
+	snowboy::Nnet dense{network};
+	snowboy::Matrix expected;
+	std::vector<snowboy::FrameInfo> expected_info;
+	run_network(&dense, input, {13}, &expected, &expected_info);
+
+	// Without pruning the sparse kernel has to reproduce the dense result
+	snowboy::Nnet sparse{network};
+	ASSERT_GT(sparse.SparsifyAffineComponents(0.0f, 0.0f), 0);
+	snowboy::Matrix output;
+	std::vector<snowboy::FrameInfo> info;
+	run_network(&sparse, input, {13}, &output, &info);
+	ASSERT_EQ(output.rows(), expected.rows());
+	for (size_t r = 0; r < output.rows(); r++) {
+		for (size_t c = 0; c < output.cols(); c++)
+			ASSERT_NEAR(output(r, c), expected(r, c), 1e-4) << "row " << r << " col " << c;
+	}
+
+	// Chunks of fewer than four frames take the per frame gather path
+	for (auto& chunks : std::vector<std::vector<size_t>>{{1}, {2}, {3}, {1, 2, 3}}) {
+		snowboy::Nnet small{network};
+		ASSERT_GT(small.SparsifyAffineComponents(0.0f, 0.0f), 0);
+		run_network(&small, input, chunks, &output, &info);
+		ASSERT_EQ(output.rows(), expected.rows());
+		for (size_t r = 0; r < output.rows(); r++) {
+			for (size_t c = 0; c < output.cols(); c++)
+				ASSERT_NEAR(output(r, c), expected(r, c), 1e-4) << "chunk " << chunks[0] << " row " << r << " col " << c;
+		}
+	}
+
+	// Pruned networks survive writing and reading
+	snowboy::Nnet pruned{network};
+	ASSERT_EQ(pruned.SparsifyAffineComponents(0.05f, 1.0f), 0);
+	ASSERT_GT(pruned.SparsifyAffineComponents(0.05f, 0.0f), 0);
+	std::stringstream ss;
+	pruned.Write(true, &ss);
+	snowboy::Nnet reread;
+	reread.Read(true, &ss);
+	snowboy::Matrix pruned_output, reread_output;
+	run_network(&pruned, input, {13}, &pruned_output, &info);
+	run_network(&reread, input, {13}, &reread_output, &info);
+	ASSERT_EQ(pruned_output.rows(), reread_output.rows());
+	for (size_t r = 0; r < pruned_output.rows(); r++) {
+		for (size_t c = 0; c < pruned_output.cols(); c++)
+			ASSERT_EQ(pruned_output(r, c), reread_output(r, c)) << "row " << r << " col " << c;
+	}
+}
+
+TEST(NnetTest, SparseAffineComponentFewRows) {
+	unsigned int seed = 0;
+	snowboy::Matrix linear, input;
+	snowboy::Vector bias;
+	linear.Resize(24, 40);
+	bias.Resize(24);
+	input.Resize(13, 40);
+	for (auto mat : {&linear, &input}) {
+		for (size_t r = 0; r < mat->rows(); r++) {
+			for (size_t c = 0; c < mat->cols(); c++)
+				(*mat)(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+		}
+	}
+	for (size_t i = 0; i < bias.size(); i++)
+		bias[i] = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	std::stringstream ss;
+	snowboy::WriteToken(true, "<AffineComponent>", &ss);
+	snowboy::WriteToken(true, "<LinearParams>", &ss);
+	linear.Write(true, &ss);
+	snowboy::WriteToken(true, "<BiasParams>", &ss);
+	bias.Write(true, &ss);
+	snowboy::WriteToken(true, "</AffineComponent>", &ss);
+	auto dense = snowboy::Component::ReadNew(true, &ss);
+
+	// Every row count below the block size, plus a partial and a full block for reference
+	snowboy::SparseAffineComponent sparse{static_cast<const snowboy::AffineComponent&>(*dense), 0.0f};
+	for (size_t rows : {1, 2, 3, 5, 13}) {
+		snowboy::ChunkInfo in_info{40, 1, 0, rows - 1}, out_info{24, 1, 0, rows - 1};
+		snowboy::Matrix expected, output;
+		dense->Propagate(in_info, out_info, snowboy::Matrix{input.RowRange(0, rows)}, &expected);
+		sparse.Propagate(in_info, out_info, snowboy::Matrix{input.RowRange(0, rows)}, &output);
+		ASSERT_EQ(output.rows(), rows);
+		for (size_t r = 0; r < output.rows(); r++) {
+			for (size_t c = 0; c < output.cols(); c++)
+				ASSERT_NEAR(output(r, c), expected(r, c), 1e-4) << "rows " << rows << " row " << r << " col " << c;
+		}
+	}
+}
+
+TEST(NnetTest, FactorizedAffineComponent) {
+	unsigned int seed = 0;
+	snowboy::Matrix linear, input;
+	snowboy::Vector bias;
+	linear.Resize(24, 40);
+	bias.Resize(24);
+	input.Resize(7, 40);
+	for (auto mat : {&linear, &input}) {
+		for (size_t r = 0; r < mat->rows(); r++) {
+			for (size_t c = 0; c < mat->cols(); c++)
+				(*mat)(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+		}
+	}
+	for (size_t i = 0; i < bias.size(); i++)
+		bias[i] = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	std::stringstream ss;
+	snowboy::WriteToken(true, "<AffineComponent>", &ss);
+	snowboy::WriteToken(true, "<LinearParams>", &ss);
+	linear.Write(true, &ss);
+	snowboy::WriteToken(true, "<BiasParams>", &ss);
+	bias.Write(true, &ss);
+	snowboy::WriteToken(true, "</AffineComponent>", &ss);
+	auto dense = snowboy::Component::ReadNew(true, &ss);
+
+	snowboy::ChunkInfo in_info{40, 1, 0, 6}, out_info{24, 1, 0, 6};
+	snowboy::Matrix expected, output;
+	dense->Propagate(in_info, out_info, snowboy::Matrix{input}, &expected);
+	// At full rank the factorization is exact
+	snowboy::FactorizedAffineComponent full{static_cast<const snowboy::AffineComponent&>(*dense), 24};
+	full.Propagate(in_info, out_info, snowboy::Matrix{input}, &output);
+	for (size_t r = 0; r < output.rows(); r++) {
+		for (size_t c = 0; c < output.cols(); c++)
+			ASSERT_NEAR(output(r, c), expected(r, c), 1e-3) << "row " << r << " col " << c;
+	}
+	// Lower ranks lose precision
+	float prev_error = 0.0f;
+	for (size_t rank : {20, 12, 4}) {
+		snowboy::FactorizedAffineComponent factorized{static_cast<const snowboy::AffineComponent&>(*dense), rank};
+		ASSERT_EQ(factorized.Rank(), rank);
+		factorized.Propagate(in_info, out_info, snowboy::Matrix{input}, &output);
+		float error = 0.0f;
+		for (size_t r = 0; r < output.rows(); r++) {
+			for (size_t c = 0; c < output.cols(); c++)
+				error += (output(r, c) - expected(r, c)) * (output(r, c) - expected(r, c));
+		}
+		ASSERT_GT(error, prev_error);
+		prev_error = error;
+	}
+
+	// Factorized networks survive writing and reading
+	snowboy::UniversalDetectStreamOptions options{};
+	options.slide_step = 1;
+	options.model_str = root + "resources/models/snowboy.umdl";
+	snowboy::UniversalDetectStream stream{options};
+	snowboy::Nnet factorized{stream.m_model_info[0].network};
+	ASSERT_EQ(factorized.FactorizeAffineComponents(48), 3);
+	std::stringstream model;
+	factorized.Write(true, &model);
+	snowboy::Nnet reread;
+	reread.Read(true, &model);
+	input.Resize(61, factorized.InputDim());
+	for (size_t r = 0; r < input.rows(); r++) {
+		for (size_t c = 0; c < input.cols(); c++)
+			input(r, c) = (rand_r(&seed) % 2000) / 1000.0f - 1.0f;
+	}
+	std::vector<snowboy::FrameInfo> info;
+	run_network(&factorized, input, {13}, &expected, &info);
+	run_network(&reread, input, {13}, &output, &info);
+	ASSERT_EQ(output.rows(), expected.rows());
+	for (size_t r = 0; r < output.rows(); r++) {
+		for (size_t c = 0; c < output.cols(); c++)
+			ASSERT_EQ(output(r, c), expected(r, c)) << "row " << r << " col " << c;
+	}
+}
+
+TEST(NnetTest, PosteriorMapComponent) {
+	// Dense groups use the matrix product, sparse ones the gather
+	for (auto& test : std::vector<std::pair<int, std::vector<std::vector<int>>>>{
+			 {12, {{0, 3, 5}, {1}, {2, 7, 8, 11}}},
+			 {100, {{5}, {17, 42}}}}) {
+		auto input_dim = test.first;
+		auto& groups = test.second;
+		std::stringstream ss;
+		snowboy::WriteToken(true, "<PosteriorMapComponent>", &ss);
+		snowboy::WriteToken(true, "<InputDim>", &ss);
+		snowboy::WriteBasicType<int32_t>(true, input_dim, &ss);
+		snowboy::WriteToken(true, "<OutputDim>", &ss);
+		snowboy::WriteBasicType<int32_t>(true, groups.size() + 1, &ss);
+		snowboy::WriteToken(true, "<Indices>", &ss);
+		for (auto& e : groups)
+			snowboy::WriteIntegerVector(true, e, &ss);
+		snowboy::WriteToken(true, "</PosteriorMapComponent>", &ss);
+		auto component = snowboy::Component::ReadNew(true, &ss);
+		std::stringstream written;
+		component->Write(true, &written);
+		auto reread = snowboy::Component::ReadNew(true, &written);
+
+		unsigned int seed = 0;
+		snowboy::Matrix input;
+		input.Resize(9, input_dim);
+		for (size_t r = 0; r < input.rows(); r++) {
+			for (size_t c = 0; c < input.cols(); c++)
+				input(r, c) = (rand_r(&seed) % 1000) / 1000.0f / input_dim;
+		}
+		snowboy::ChunkInfo in_info{static_cast<size_t>(input_dim), 1, 0, 8}, out_info{groups.size() + 1, 1, 0, 8};
+		for (auto& e : {component.get(), reread.get()}) {
+			snowboy::Matrix output;
+			e->Propagate(in_info, out_info, snowboy::Matrix{input}, &output);
+			ASSERT_EQ(output.rows(), input.rows());
+			ASSERT_EQ(output.cols(), groups.size() + 1);
+			for (size_t r = 0; r < input.rows(); r++) {
+				float total = 0.0f;
+				for (size_t g = 0; g < groups.size(); g++) {
+					float sum = 0.0f;
+					for (auto idx : groups[g])
+						sum += input(r, idx);
+					total += sum;
+					ASSERT_NEAR(output(r, g + 1), sum, 1e-6) << "row " << r << " group " << g;
+				}
+				ASSERT_NEAR(output(r, 0), 1.0f - total, 1e-6) << "row " << r;
+			}
+		}
+	}
+}
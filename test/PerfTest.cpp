@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cblas.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <helper.h>
+#include <limits>
+#include <map>
+#include <snowboy-detect.h>
+#include <sstream>
+
+const static auto root = detect_project_root();
+
+const static std::string samples[]{
+	"hotword1.wav",
+	"hotword2.wav",
+	"hotword3.wav",
+	"hotword3_fail.wav",
+	"noise1.wav",
+	"noise2.wav",
+	"noise3.wav",
+	"sample1.wav",
+	"snowboy.wav"};
+
+// 100ms of audio, what most clients feed per call
+constexpr size_t chunk_size = 1600;
+// The fastest of these runs is compared, slower ones are most likely disturbed by other processes
+constexpr int num_runs = 3;
+// Frames per chunk and layer sizes of the calibration workload, similar to a small universal model
+constexpr int calibration_frames = 10;
+constexpr int calibration_dim = 256;
+constexpr int calibration_sample_rate = 16000;
+
+namespace {
+	struct PerfResult {
+		// Processing time divided by the audio duration
+		double rtf;
+		// 99th percentile of the time spent in a single call
+		double p99_ms;
+	};
+
+	// A PerfResult relative to the calibration workload
+	struct RelativeResult {
+		// Real time factor divided by the one of the calibration
+		double rtf;
+		// p99 latency divided by the mean time the calibration spends per chunk
+		double p99;
+	};
+
+	/**
+	 * Minimal json reader for the baseline file.
+	 *
+	 * Only supports objects, strings and numbers. Numbers are returned with the
+	 * keys of their enclosing objects joined by '/', e.g. "workloads/vad/rtf".
+	 */
+	class BaselineReader {
+		const std::string& m_str;
+		size_t m_pos = 0;
+
+		void SkipWhitespace() {
+			while (m_pos < m_str.size() && isspace(m_str[m_pos]))
+				m_pos++;
+		}
+		void Expect(char c) {
+			SkipWhitespace();
+			if (m_pos >= m_str.size() || m_str[m_pos] != c) throw std::runtime_error(std::string("expected '") + c + "' at offset " + std::to_string(m_pos));
+			m_pos++;
+		}
+		std::string ReadString() {
+			Expect('"');
+			auto end = m_str.find('"', m_pos);
+			if (end == std::string::npos) throw std::runtime_error("unterminated string");
+			auto res = m_str.substr(m_pos, end - m_pos);
+			m_pos = end + 1;
+			return res;
+		}
+		void ReadValue(const std::string& key, std::map<std::string, double>* out) {
+			SkipWhitespace();
+			if (m_pos >= m_str.size()) throw std::runtime_error("unexpected end of file");
+			if (m_str[m_pos] == '{') {
+				ReadObject(key.empty() ? key : key + "/", out);
+			} else if (m_str[m_pos] == '"') {
+				ReadString();
+			} else {
+				const char* begin = m_str.c_str() + m_pos;
+				char* end = nullptr;
+				auto value = strtod(begin, &end);
+				if (end == begin) throw std::runtime_error("invalid number at offset " + std::to_string(m_pos));
+				m_pos += end - begin;
+				(*out)[key] = value;
+			}
+		}
+		void ReadObject(const std::string& prefix, std::map<std::string, double>* out) {
+			Expect('{');
+			SkipWhitespace();
+			if (m_pos < m_str.size() && m_str[m_pos] == '}') {
+				m_pos++;
+				return;
+			}
+			while (true) {
+				auto key = ReadString();
+				Expect(':');
+				ReadValue(prefix + key, out);
+				SkipWhitespace();
+				if (m_pos < m_str.size() && m_str[m_pos] == ',') {
+					m_pos++;
+					continue;
+				}
+				Expect('}');
+				return;
+			}
+		}
+
+	public:
+		BaselineReader(const std::string& str)
+			: m_str{str} {}
+
+		std::map<std::string, double> Read() {
+			std::map<std::string, double> res;
+			ReadObject("", &res);
+			return res;
+		}
+	};
+
+	const std::map<std::string, double>& baseline() {
+		static const auto res = [] {
+			auto content = read_file(root + "test/perf-baseline.json");
+			if (content.empty()) throw std::runtime_error("test/perf-baseline.json is missing");
+			return BaselineReader{content}.Read();
+		}();
+		return res;
+	}
+
+	double tolerance() {
+		if (auto env = getenv("SNOWMAN_PERF_TOLERANCE")) return atof(env);
+		return baseline().at("tolerance");
+	}
+
+	std::map<std::string, RelativeResult>& results() {
+		static std::map<std::string, RelativeResult> res;
+		return res;
+	}
+
+	PerfResult calibration();
+	double calibration_chunk_ms() {
+		return calibration().rtf * chunk_size * 1000.0 / calibration_sample_rate;
+	}
+
+	// Writes the measured values in the baseline format if SNOWMAN_PERF_RESULTS is set
+	class ResultWriter : public ::testing::Environment {
+	public:
+		void TearDown() override {
+			auto path = getenv("SNOWMAN_PERF_RESULTS");
+			if (path == nullptr || results().empty()) return;
+			std::ofstream out{path, std::ios::trunc};
+			out << "{\n\t\"tolerance\": " << baseline().at("tolerance") << ",\n\t\"calibration\": {\"rtf\": " << calibration().rtf << ", \"chunk_ms\": " << calibration_chunk_ms() << "},\n\t\"workloads\": {";
+			bool first = true;
+			for (auto& e : results()) {
+				out << (first ? "" : ",") << "\n\t\t\"" << e.first << "\": {\"rtf\": " << e.second.rtf << ", \"p99\": " << e.second.p99 << "}";
+				first = false;
+			}
+			out << "\n\t}\n}\n";
+		}
+	};
+	const auto result_writer = ::testing::AddGlobalTestEnvironment(new ResultWriter);
+
+	std::vector<std::vector<short>> read_samples() {
+		std::vector<std::vector<short>> res;
+		for (auto& e : samples) {
+			if (!file_exists(root + "audio_samples/" + e)) continue;
+			res.push_back(read_sample_file(root + "audio_samples/" + e, true));
+		}
+		return res;
+	}
+
+	/**
+	 * Feeds every sample in chunks of chunk_size samples to run and calls reset after each sample.
+	 * Only run is timed.
+	 */
+	PerfResult measure(const std::function<void(const int16_t*, int)>& run, const std::function<void()>& reset, int sample_rate, int runs = num_runs) {
+		auto audio = read_samples();
+		size_t total_samples = 0;
+		for (auto& e : audio)
+			total_samples += e.size();
+		if (total_samples == 0) throw std::runtime_error("no audio samples found");
+
+		PerfResult best{std::numeric_limits<double>::max(), 0};
+		std::vector<double> latencies;
+		for (int i = 0; i < runs; i++) {
+			latencies.clear();
+			double total = 0;
+			for (auto& data : audio) {
+				for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+					auto start = std::chrono::steady_clock::now();
+					run(data.data() + pos, std::min(chunk_size, data.size() - pos));
+					std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+					latencies.push_back(took.count());
+					total += took.count();
+				}
+				reset();
+			}
+			auto rtf = total / (total_samples / static_cast<double>(sample_rate));
+			if (rtf >= best.rtf) continue;
+			auto p99 = latencies.begin() + (latencies.size() - 1) * 99 / 100;
+			std::nth_element(latencies.begin(), p99, latencies.end());
+			best = {rtf, *p99 * 1000.0};
+		}
+		return best;
+	}
+
+	/**
+	 * Timing of a fixed workload that does not depend on the library, measured like the real ones.
+	 *
+	 * Every chunk runs two layers of matrix products through blas and a scalar filter over the
+	 * samples, roughly the mix of the networks and the feature extraction. The budgets are relative
+	 * to it, so they carry over to machines of different speed. Latencies are compared to its mean
+	 * time per chunk, its own p99 is too noisy to divide by.
+	 */
+	PerfResult calibration() {
+		static const auto res = [] {
+			std::vector<float> input(calibration_frames * calibration_dim), hidden(input.size()), weights(calibration_dim * calibration_dim);
+			for (size_t i = 0; i < weights.size(); i++)
+				weights[i] = static_cast<float>(i % 17) / 17.0f - 0.5f;
+			float state = 0;
+			auto run = [&](const int16_t* data, int len) {
+				for (size_t i = 0; i < input.size(); i++)
+					input[i] = data[i % len] / 32768.0f;
+				cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, calibration_frames, calibration_dim, calibration_dim, 1.0f, input.data(), calibration_dim, weights.data(), calibration_dim, 0.0f, hidden.data(), calibration_dim);
+				cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, calibration_frames, calibration_dim, calibration_dim, 1.0f, hidden.data(), calibration_dim, weights.data(), calibration_dim, 0.0f, input.data(), calibration_dim);
+				for (int i = 0; i < len; i++)
+					state = state * 0.97f + data[i] * (1.0f / 32768.0f) + input[i % input.size()] * 1e-6f;
+			};
+			auto res = measure(run, [&]() { state = 0; }, calibration_sample_rate, 3 * num_runs);
+			// Keeps the filter from being optimized away
+			if (state == std::numeric_limits<float>::infinity()) std::abort();
+			return res;
+		}();
+		return res;
+	}
+
+	void check_budget(const std::string& workload, const PerfResult& res) {
+		auto calib = calibration();
+		const auto calib_chunk_ms = calibration_chunk_ms();
+		RelativeResult rel{res.rtf / calib.rtf, res.p99_ms / calib_chunk_ms};
+		results()[workload] = rel;
+		auto& base = baseline();
+		auto rtf = base.find("workloads/" + workload + "/rtf");
+		auto p99 = base.find("workloads/" + workload + "/p99");
+		if (rtf == base.end() || p99 == base.end()) {
+			ADD_FAILURE() << "No baseline for " << workload << ", measured rtf=" << rel.rtf << " p99=" << rel.p99 << " relative to the calibration";
+			return;
+		}
+		const auto tol = tolerance();
+		EXPECT_LE(rel.rtf, rtf->second * tol) << workload << ": real time factor regressed, " << res.rtf << " is " << rel.rtf << " times the calibration, baseline " << rtf->second << " with tolerance " << tol;
+		EXPECT_LE(rel.p99, p99->second * tol) << workload << ": p99 chunk latency regressed, " << res.p99_ms << "ms is " << rel.p99 << " calibration chunks, baseline " << p99->second << " with tolerance " << tol;
+		::testing::Test::RecordProperty("rtf", std::to_string(res.rtf));
+		::testing::Test::RecordProperty("p99_ms", std::to_string(res.p99_ms));
+		::testing::Test::RecordProperty("calibration_rtf", std::to_string(calib.rtf));
+		::testing::Test::RecordProperty("calibration_chunk_ms", std::to_string(calib_chunk_ms));
+	}
+} // namespace
+
+#if !MEMCHECK_ENABLED || defined(__SANITIZE_THREAD__)
+#define SKIP_IF_DISABLED() GTEST_SKIP() << "timings are meaningless with sanitizers"
+#elif !defined(NDEBUG)
+#define SKIP_IF_DISABLED() GTEST_SKIP() << "timings are meaningless in debug builds"
+#else
+#define SKIP_IF_DISABLED() \
+	do {                   \
+	} while (false)
+#endif
+
+class PerfModelTest : public ::testing::TestWithParam<std::string> {};
+
+TEST_P(PerfModelTest, Detect) {
+	SKIP_IF_DISABLED();
+	std::string models, sensitivity;
+	std::stringstream param{GetParam()};
+	for (std::string model; std::getline(param, model, '+');)
+		models += (models.empty() ? "" : ",") + root + "resources/models/" + model;
+	snowboy::SnowboyDetect detector(root + "resources/common.res", models);
+	// Models with several hotwords need one sensitivity each
+	for (int i = 0; i < detector.NumHotwords(); i++)
+		sensitivity += (sensitivity.empty() ? "" : ",") + std::string("0.5");
+	detector.SetSensitivity(sensitivity);
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(false);
+	auto res = measure([&](const int16_t* data, int len) { detector.RunDetection(data, len); }, [&]() { detector.Reset(); }, detector.SampleRate());
+	check_budget("detect/" + GetParam(), res);
+}
+
+INSTANTIATE_TEST_SUITE_P(Models, PerfModelTest,
+						 ::testing::Values("snowboy.umdl", "computer.umdl", "hey_extreme.umdl", "jarvis.umdl", "neoya.umdl",
+										   "smart_mirror.umdl", "subex.umdl", "view_glass.umdl",
+										   "computer.umdl+hey_extreme.umdl+view_glass.umdl+snowboy.umdl"),
+						 [](const ::testing::TestParamInfo<std::string>& info) {
+							 auto name = info.param;
+							 std::replace_if(
+								 name.begin(), name.end(), [](char c) { return !isalnum(c); }, '_');
+							 return name;
+						 });
+
+TEST(PerfTest, Vad) {
+	SKIP_IF_DISABLED();
+	snowboy::SnowboyVad vad(root + "resources/common.res");
+	vad.SetAudioGain(1.0);
+	vad.ApplyFrontend(false);
+	auto res = measure([&](const int16_t* data, int len) { vad.RunVad(data, len); }, [&]() { vad.Reset(); }, vad.SampleRate());
+	check_budget("vad", res);
+}
+
+TEST(PerfTest, DetectFrontend) {
+	SKIP_IF_DISABLED();
+	snowboy::SnowboyDetect detector(root + "resources/common.res", root + "resources/models/snowboy.umdl");
+	detector.SetSensitivity("0.5");
+	detector.SetAudioGain(1.0);
+	detector.ApplyFrontend(true);
+	auto res = measure([&](const int16_t* data, int len) { detector.RunDetection(data, len); }, [&]() { detector.Reset(); }, detector.SampleRate());
+	check_budget("detect_frontend/snowboy.umdl", res);
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <dtw-lib.h>
+#include <helper.h>
+#include <matrix-wrapper.h>
+#include <memory>
+#include <template-container.h>
+#include <template-index.h>
+#include <vector-wrapper.h>
+
+static snowboy::Matrix make_template(unsigned int* seed, size_t rows, float offset) {
+	snowboy::Matrix m;
+	m.Resize(rows, 16);
+	for (size_t r = 0; r < m.rows(); r++) {
+		for (size_t c = 0; c < m.cols(); c++) {
+			m(r, c) = offset + (rand_r(seed) % 1000) / 1000.0f;
+		}
+	}
+	return m;
+}
+
+static void write_model(const std::string& file, unsigned int* seed, size_t rows, float offset) {
+	snowboy::TemplateContainer c{0.4f};
+	for (size_t i = 0; i < 3; i++)
+		c.AddTemplate(make_template(seed, rows + i, offset));
+	c.WriteHotwordModel(true, file);
+}
+
+TEST(TemplateTest, ModelIsShared) {
+	unsigned int seed = 0;
+	write_model("temp_shared_model.pmdl", &seed, 40, 0.0f);
+	auto a = snowboy::TemplateModel::Load("temp_shared_model.pmdl", snowboy::euclidean);
+	auto b = snowboy::TemplateModel::Load("temp_shared_model.pmdl", snowboy::euclidean);
+	ASSERT_EQ(a.get(), b.get());
+	ASSERT_EQ(a->m_container.NumTemplates(), 3);
+	ASSERT_EQ(a->m_embedding.size(), 16);
+	auto c = snowboy::TemplateModel::Load("temp_shared_model.pmdl", snowboy::cosine);
+	ASSERT_NE(a.get(), c.get());
+}
+
+TEST(TemplateTest, IndexPrefilter) {
+	unsigned int seed = 0;
+	write_model("temp_index_a.pmdl", &seed, 40, 0.0f);
+	write_model("temp_index_b.pmdl", &seed, 42, 5.0f);
+	write_model("temp_index_c.pmdl", &seed, 90, 0.0f);
+
+	snowboy::TemplateIndex index{snowboy::euclidean};
+	index.AddModel(snowboy::TemplateModel::Load("temp_index_a.pmdl", snowboy::euclidean));
+	index.AddModel(snowboy::TemplateModel::Load("temp_index_b.pmdl", snowboy::euclidean));
+	index.AddModel(snowboy::TemplateModel::Load("temp_index_c.pmdl", snowboy::euclidean));
+	index.Build(20);
+	ASSERT_EQ(index.m_buckets.size(), 2);
+
+	auto features = make_template(&seed, 100, 5.0f);
+	std::vector<size_t> candidates;
+	index.FindCandidates(features, features.rows(), 1.0f, &candidates);
+	ASSERT_EQ(candidates, std::vector<size_t>({1}));
+	index.FindCandidates(features, features.rows(), 100.0f, &candidates);
+	ASSERT_EQ(candidates, std::vector<size_t>({0, 1, 2}));
+}
+
+TEST(TemplateTest, IndexCosine) {
+	unsigned int seed = 0;
+	write_model("temp_index_a.pmdl", &seed, 40, 0.0f);
+	// Two models 90 degrees apart in one bucket, the query is 40 degrees off the first one
+	std::shared_ptr<snowboy::TemplateModel> models[2];
+	for (size_t i = 0; i < 2; i++) {
+		models[i] = std::make_shared<snowboy::TemplateModel>("temp_index_a.pmdl", snowboy::cosine);
+		models[i]->m_embedding.Set(0.0f);
+		models[i]->m_embedding(i) = 1.0f;
+	}
+	snowboy::TemplateIndex index{snowboy::cosine};
+	for (auto& e : models)
+		index.AddModel(e);
+	index.Build(20);
+	ASSERT_EQ(index.m_buckets.size(), 1);
+
+	snowboy::Matrix features;
+	features.Resize(40, 16);
+	for (size_t r = 0; r < features.rows(); r++) {
+		features(r, 0) = std::cos(40.0f * M_PI / 180.0f);
+		features(r, 1) = -std::sin(40.0f * M_PI / 180.0f);
+	}
+	// The cosine distance to the centroid exceeds threshold plus radius, so it can not be used to reject the bucket
+	auto query = snowboy::SubVector{features, 0}.CosineDistance(index.m_buckets[0].centroid);
+	ASSERT_GT(query, 0.12f + models[0]->m_embedding.CosineDistance(index.m_buckets[0].centroid));
+	std::vector<size_t> candidates;
+	index.FindCandidates(features, features.rows(), 0.12f, &candidates);
+	ASSERT_EQ(candidates, std::vector<size_t>({0}));
+}
+
+TEST(TemplateTest, IndexMatchesExhaustive) {
+	unsigned int seed = 0;
+	std::vector<std::string> files;
+	for (size_t i = 0; i < 8; i++) {
+		files.push_back("temp_index_" + std::to_string(i) + ".pmdl");
+		write_model(files.back(), &seed, 30 + 15 * i, (i % 3) * 0.3f);
+	}
+	for (auto distance : {snowboy::euclidean, snowboy::cosine}) {
+		snowboy::TemplateIndex index{distance};
+		for (auto& e : files)
+			index.AddModel(snowboy::TemplateModel::Load(e, distance));
+		index.Build(20);
+		ASSERT_GT(index.m_buckets.size(), 2);
+
+		auto features = make_template(&seed, 120, 0.3f);
+		for (size_t end : {60, 120}) {
+			for (float threshold : {0.001f, 0.01f, 0.05f, 0.2f, 1.0f, 2.0f}) {
+				SCOPED_TRACE("distance " + std::to_string(distance) + " end " + std::to_string(end) + " threshold " + std::to_string(threshold));
+				// Every model compared against the mean of the window of its bucket
+				std::vector<size_t> expected;
+				for (auto& b : index.m_buckets) {
+					auto rows = std::min(b.length, end);
+					snowboy::Vector mean;
+					mean.Resize(features.cols());
+					for (size_t r = end - rows; r < end; r++)
+						mean.AddVec(1.0f, snowboy::SubVector{features, r});
+					mean.Scale(1.0f / rows);
+					for (auto idx : b.models) {
+						auto& emb = index.GetModel(idx).m_embedding;
+						auto dist = distance == snowboy::cosine ? mean.CosineDistance(emb) : mean.EuclideanDistance(emb);
+						if (dist <= threshold) expected.push_back(idx);
+					}
+				}
+				std::sort(expected.begin(), expected.end());
+				std::vector<size_t> candidates;
+				index.FindCandidates(features, end, threshold, &candidates);
+				ASSERT_EQ(candidates, expected);
+			}
+		}
+	}
+	for (auto& e : files)
+		std::remove(e.c_str());
+}
@@ -0,0 +1,196 @@
+#include <cmath>
+#include <frame-info.h>
+#include <helper.h>
+#include <intercept-stream.h>
+#include <matrix-wrapper.h>
+#include <pipeline-detect.h>
+#include <pipeline-vad.h>
+#include <raw-energy-vad-stream.h>
+#include <snowboy-options.h>
+
+const static auto root = detect_project_root();
+
+static snowboy::RawEnergyVadStreamOptions raw_energy_options(bool init_bg_energy, uint32_t bg_buffer_size) {
+	snowboy::RawEnergyVadStreamOptions res{};
+	res.init_bg_energy = init_bg_energy;
+	res.bg_energy_threshold = 2.0f;
+	res.bg_energy_cap = 12.0f;
+	res.bg_buffer_size = bg_buffer_size;
+	res.raw_buffer_extra = 0;
+	res.confident_margin = -1.0f;
+	return res;
+}
+
+// Frames with the log energies first_energy, first_energy + 1, ... in the first column and zeros in the others
+static void make_frames(unsigned int first_id, float first_energy, size_t rows, size_t cols, snowboy::Matrix* mat, std::vector<snowboy::FrameInfo>* info) {
+	mat->Resize(rows, cols);
+	info->resize(rows);
+	for (size_t r = 0; r < rows; r++) {
+		(*mat)(r, 0) = std::sqrt(std::exp(first_energy + r));
+		(*info)[r].frame_id = first_id + r;
+		(*info)[r].flags = 0;
+	}
+}
+
+TEST(VadTest, InitBgEnergyStream) {
+	snowboy::InterceptStream input;
+	snowboy::RawEnergyVadStream vad{raw_energy_options(true, 6)};
+	vad.Connect(&input);
+
+	// More columns than rows per read, the initial frames used to be copied with the column count as row count
+	snowboy::Matrix mat, out;
+	std::vector<snowboy::FrameInfo> info, out_info;
+	make_frames(1, 1.0f, 4, 8, &mat, &info);
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	vad.Read(&out, &out_info);
+	ASSERT_EQ(out.rows(), 0);
+	ASSERT_TRUE(out_info.empty());
+
+	make_frames(5, 5.0f, 4, 8, &mat, &info);
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	vad.Read(&out, &out_info);
+	ASSERT_EQ(out.rows(), 8);
+	ASSERT_EQ(out_info.size(), 8);
+	for (size_t r = 0; r < out_info.size(); r++) {
+		ASSERT_EQ(out_info[r].frame_id, r + 1);
+		ASSERT_NEAR(out(r, 0), std::sqrt(std::exp(1.0f + r)), 1e-3f);
+	}
+	// The second half of the buffered frames, log energies 4 to 8
+	EXPECT_NEAR(vad.m_bg_energy, 6.0f, 1e-4f);
+	EXPECT_EQ(out_info[4].flags & 1, 0);
+	EXPECT_EQ(out_info[7].flags & 1, 0);
+	EXPECT_EQ(out_info[0].flags & 1, 0);
+
+	make_frames(9, 9.0f, 4, 8, &mat, &info);
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	vad.Read(&out, &out_info);
+	ASSERT_EQ(out.rows(), 4);
+	EXPECT_EQ(out_info[2].flags & 1, 1);
+}
+
+TEST(VadTest, BackgroundEnergyFrameIdGap) {
+	snowboy::InterceptStream input;
+	snowboy::RawEnergyVadStream vad{raw_energy_options(false, 4)};
+	vad.Connect(&input);
+
+	snowboy::Matrix mat, out;
+	std::vector<snowboy::FrameInfo> info, out_info;
+	vad.m_exact_bg_energy = true;
+	make_frames(1, 1.0f, 10, 4, &mat, &info);
+	input.SetData(mat, info, static_cast<snowboy::SnowboySignal>(0x20));
+	vad.Read(&out, &out_info);
+	ASSERT_EQ(out.rows(), 10);
+
+	// Frames 5 and 6 were removed further down the pipeline, all others are reported as non-voice
+	std::vector<snowboy::FrameInfo> reported;
+	for (auto& e : out_info) {
+		if (e.frame_id == 5 || e.frame_id == 6) continue;
+		reported.push_back(e);
+		reported.back().flags = 0;
+	}
+	vad.UpdateBackgroundEnergy(reported);
+	// The buffer holds the last four reported frames, the ones behind the gap
+	EXPECT_EQ(vad.m_bg_energies_count, 4);
+	EXPECT_NEAR(vad.m_bg_energy, 8.5f, 1e-4f);
+
+	// Frames are only used once
+	vad.UpdateBackgroundEnergy(reported);
+	EXPECT_NEAR(vad.m_bg_energy, 8.5f, 1e-4f);
+}
+
+TEST(VadTest, InitBgEnergyPipeline) {
+	if (!file_exists(root + "audio_samples/snowboy.wav")) {
+		GTEST_WARN("Skiping because audio file is missing!");
+		return;
+	}
+	auto data = read_sample_file(root + "audio_samples/snowboy.wav");
+	for (size_t chunk : {160, 1600}) {
+		SCOPED_TRACE("chunk size " + std::to_string(chunk));
+		snowboy::PipelineDetectOptions detect_options{};
+		detect_options.sampleRate = 16000;
+		snowboy::PipelineDetect detect{detect_options};
+		detect.SetResource(root + "resources/common.res");
+		snowboy::ParseOptions detect_opts{""};
+		detect.RegisterOptions(detect.OptionPrefix(), &detect_opts);
+		detect_opts.ReadConfigString("--" + detect.OptionPrefix() + ".vadr1.init-bg-energy=true");
+		detect.SetModel(root + "resources/models/snowboy.umdl");
+		detect.Init();
+		detect.SetMaxAudioAmplitude(32767.0f);
+
+		snowboy::PipelineVadOptions vad_options{};
+		vad_options.sampleRate = 16000;
+		snowboy::PipelineVad vad{vad_options};
+		vad.SetResource(root + "resources/common.res");
+		snowboy::ParseOptions vad_opts{""};
+		vad.RegisterOptions(vad.OptionPrefix(), &vad_opts);
+		vad_opts.ReadConfigString("--" + vad.OptionPrefix() + ".vadr1.init-bg-energy=true");
+		vad.Init();
+		vad.SetMaxAudioAmplitude(32767.0f);
+
+		int detected = 0;
+		bool voice = false;
+		for (size_t i = 0; i < data.size(); i += chunk) {
+			snowboy::Matrix mat;
+			mat.Resize(1, std::min<size_t>(chunk, data.size() - i));
+			for (size_t c = 0; c < mat.cols(); c++)
+				mat(0, c) = data[i + c];
+			detected = std::max(detected, detect.RunDetection(mat, i + chunk >= data.size()));
+			voice |= vad.RunVad(mat, i + chunk >= data.size()) == 0;
+		}
+		EXPECT_EQ(detected, 1);
+		EXPECT_TRUE(voice);
+	}
+}
+
+TEST(VadTest, BackgroundEnergy) {
+	if (!file_exists(root + "audio_samples/sample1.wav")) {
+		GTEST_WARN("Skiping because audio file is missing!");
+		return;
+	}
+	auto data = read_sample_file(root + "audio_samples/sample1.wav");
+	for (bool exact : {false, true}) {
+		SCOPED_TRACE(exact ? "exact" : "original");
+		snowboy::PipelineVadOptions options{};
+		options.sampleRate = 16000;
+		snowboy::PipelineVad pipeline{options};
+		pipeline.SetResource(root + "resources/common.res");
+		pipeline.Init();
+		pipeline.SetMaxAudioAmplitude(32767.0f);
+		// Only the tiered VAD uses the exact estimate by default
+		ASSERT_FALSE(pipeline.m_rawEnergyVadStream->m_exact_bg_energy);
+		pipeline.m_rawEnergyVadStream->m_exact_bg_energy = exact;
+		float first_estimate = 0.0f;
+		bool first_set = false;
+		for (size_t i = 0; i < data.size(); i += 1600) {
+			snowboy::Matrix mat;
+			mat.Resize(1, std::min<size_t>(1600, data.size() - i));
+			for (size_t c = 0; c < mat.cols(); c++)
+				mat(0, c) = data[i + c];
+			pipeline.RunVad(mat, false);
+			if (!first_set && pipeline.m_rawEnergyVadStream->m_bg_energy_valid) {
+				first_estimate = pipeline.m_rawEnergyVadStream->m_bg_energy;
+				first_set = true;
+			}
+		}
+		ASSERT_TRUE(first_set);
+		if (exact) {
+			// Mean log energy of the last 60 non-voice frames
+			EXPECT_NEAR(first_estimate, 9.6451f, 1e-3f);
+			EXPECT_NEAR(pipeline.m_rawEnergyVadStream->m_bg_energy, 9.1624f, 1e-3f);
+		} else {
+			// The original sum is an int the energies are only ever subtracted from, it keeps falling
+			EXPECT_NEAR(first_estimate, -0.6f, 1e-3f);
+			EXPECT_NEAR(pipeline.m_rawEnergyVadStream->m_bg_energy, -45.2333f, 1e-3f);
+		}
+	}
+
+	snowboy::PipelineVadOptions options{};
+	options.sampleRate = 16000;
+	snowboy::PipelineVad pipeline{options};
+	pipeline.SetResource(root + "resources/common.res");
+	pipeline.Init();
+	pipeline.SetTieredVad(true);
+	EXPECT_TRUE(pipeline.m_rawEnergyVadStream->m_exact_bg_energy);
+	pipeline.SetTieredVad(false);
+	EXPECT_FALSE(pipeline.m_rawEnergyVadStream->m_exact_bg_energy);
+}
@@ -1,5 +1,12 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <helper.h>
+#include <limits>
+#include <matrix-wrapper.h>
+#include <snowboy-math.h>
 #include <vector-wrapper.h>
+#include <vector>
 
 using namespace snowboy;
 
@@ -211,3 +218,128 @@ TEST(VectorTest, MoveAssign) {
 		ASSERT_EQ(v.data(), nullptr);
 	}
 }
+
+static int64_t UlpDistance(float a, float b) {
+	auto ordered = [](float f) {
+		int32_t i;
+		memcpy(&i, &f, sizeof(i));
+		return i < 0 ? -static_cast<int64_t>(i & 0x7fffffff) : static_cast<int64_t>(i);
+	};
+	return std::llabs(ordered(a) - ordered(b));
+}
+
+TEST(VectorTest, VectorLogAccuracy) {
+	std::vector<float> in, out;
+	for (uint32_t bits = 0x00800000; bits < 0x7f800000; bits += 4099) {
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		in.push_back(f);
+	}
+	out.resize(in.size());
+	VectorLog(in.data(), out.data(), in.size());
+	for (size_t i = 0; i < in.size(); i++)
+		ASSERT_LE(UlpDistance(out[i], static_cast<float>(std::log(static_cast<double>(in[i])))), 1) << in[i];
+
+	// Special values go through the libm fallback
+	float special[] = {1.0f, 2.0f, 0.0f, -1.0f, 1e-40f, std::numeric_limits<float>::infinity(), 3.0f, 4.0f, 5.0f};
+	float res[9];
+	VectorLog(special, res, 9);
+	ASSERT_EQ(res[0], 0.0f);
+	ASSERT_EQ(res[2], -std::numeric_limits<float>::infinity());
+	ASSERT_TRUE(std::isnan(res[3]));
+	ASSERT_EQ(res[4], logf(1e-40f));
+	ASSERT_EQ(res[5], std::numeric_limits<float>::infinity());
+	ASSERT_LE(UlpDistance(res[8], logf(5.0f)), 1);
+}
+
+TEST(VectorTest, VectorExpAccuracy) {
+	std::vector<float> in, out;
+	for (float x = -87.0f; x <= 88.0f; x += 0.00137f)
+		in.push_back(x);
+	out.resize(in.size());
+	VectorExp(in.data(), out.data(), in.size());
+	for (size_t i = 0; i < in.size(); i++)
+		ASSERT_LE(UlpDistance(out[i], static_cast<float>(std::exp(static_cast<double>(in[i])))), 1) << in[i];
+
+	float special[] = {0.0f, -200.0f, 200.0f, 1.0f, -std::numeric_limits<float>::infinity()};
+	float res[5];
+	VectorExp(special, res, 5);
+	ASSERT_EQ(res[0], 1.0f);
+	ASSERT_EQ(res[1], 0.0f);
+	ASSERT_EQ(res[2], std::numeric_limits<float>::infinity());
+	ASSERT_LE(UlpDistance(res[3], expf(1.0f)), 1);
+	ASSERT_EQ(res[4], 0.0f);
+}
+
+TEST(VectorTest, ApplyPowRsqrt) {
+	Vector v;
+	v.Resize(1003);
+	for (size_t i = 0; i < v.size(); i++)
+		v[i] = 1e-3f + i * 0.731f;
+	Vector expected = v;
+	v.ApplyPow(-0.5f);
+	for (size_t i = 0; i < v.size(); i++)
+		ASSERT_LE(UlpDistance(v[i], static_cast<float>(1.0 / std::sqrt(static_cast<double>(expected[i])))), 1);
+}
+
+TEST(VectorTest, ApplySoftmax) {
+	Vector v;
+	v.Resize(37);
+	for (size_t i = 0; i < v.size(); i++)
+		v[i] = (static_cast<int>(i * 7919) % 41) * 0.5f - 10.0f;
+	Vector in = v;
+	auto log_sum = v.ApplySoftmax();
+	double max = in[0];
+	for (size_t i = 0; i < in.size(); i++)
+		max = std::max<double>(max, in[i]);
+	double sum = 0;
+	for (size_t i = 0; i < in.size(); i++)
+		sum += std::exp(in[i] - max);
+	ASSERT_NEAR(log_sum, std::log(sum) + max, 1e-4);
+	for (size_t i = 0; i < in.size(); i++)
+		ASSERT_NEAR(v[i], std::exp(in[i] - max) / sum, 1e-6);
+}
+
+TEST(VectorTest, MatrixApplySoftmaxPerRow) {
+	// Three columns leave padding between the rows which must not leak into the sums
+	for (size_t cols : {3, 8, 17}) {
+		Matrix m;
+		m.Resize(11, cols);
+		for (size_t r = 0; r < m.rows(); r++)
+			for (size_t c = 0; c < cols; c++)
+				m(r, c) = static_cast<float>((r * 31 + c * 17) % 23) - 11.0f;
+		Matrix in = m;
+		m.ApplySoftmaxPerRow();
+		for (size_t r = 0; r < m.rows(); r++) {
+			Vector expected;
+			expected.Resize(cols);
+			for (size_t c = 0; c < cols; c++)
+				expected[c] = in(r, c);
+			expected.ApplySoftmax();
+			for (size_t c = 0; c < cols; c++)
+				ASSERT_NEAR(m(r, c), expected[c], 1e-6);
+		}
+	}
+}
+
+TEST(VectorTest, MatrixResizeCopyDataWithinCapacity) {
+	Matrix m;
+	m.Resize(16, 6, MatrixResizeType::kUndefined);
+	for (size_t r = 0; r < m.rows(); r++)
+		for (size_t c = 0; c < m.cols(); c++)
+			m(r, c) = r * 100 + c;
+	auto data = m.m_data;
+	m.Resize(4, 5, MatrixResizeType::kCopyData);
+	m.Resize(10, 7, MatrixResizeType::kCopyData);
+	ASSERT_EQ(m.m_data, data);
+	ASSERT_EQ(m.rows(), 10);
+	ASSERT_EQ(m.cols(), 7);
+	for (size_t r = 0; r < m.rows(); r++) {
+		for (size_t c = 0; c < m.cols(); c++) {
+			if (r < 4 && c < 5)
+				ASSERT_EQ(m(r, c), r * 100 + c);
+			else
+				ASSERT_EQ(m(r, c), 0.0f);
+		}
+	}
+}
@@ -147,6 +147,9 @@ std::string md5sum_file(const std::string& file) {
 }
 
 static MemoryChecker::snapshot* g_mc_info = nullptr;
+static MemoryChecker* g_mc_checker = nullptr;
+// Set while the hooks capture a stacktrace, backtrace itself might allocate
+static thread_local bool t_mc_capturing = false;
 
 void MemoryChecker::stacktrace::capture() {
 	auto res = ::backtrace(trace, 50);
@@ -154,12 +157,35 @@ void MemoryChecker::stacktrace::capture() {
 		trace[i] = nullptr;
 }
 
-MemoryChecker::MemoryChecker() {
+MemoryChecker::MemoryChecker(bool capture_traces)
+	: capture_traces{capture_traces} {
+	// The first call to backtrace loads libgcc, make sure this is not counted
+	if (capture_traces) {
+		stacktrace warmup;
+		warmup.capture();
+	}
+	g_mc_checker = this;
 	g_mc_info = &info;
 }
 
 MemoryChecker::~MemoryChecker() {
+	stop();
+}
+
+void MemoryChecker::stop() noexcept {
+	if (g_mc_checker != this) return;
 	g_mc_info = nullptr;
+	g_mc_checker = nullptr;
+}
+
+static void mc_capture(size_t size) {
+	auto checker = g_mc_checker;
+	if (checker == nullptr || !checker->capture_traces || checker->num_traces >= MemoryChecker::max_traces) return;
+	t_mc_capturing = true;
+	auto& e = checker->traces[checker->num_traces++];
+	e.size = size;
+	e.trace.capture();
+	t_mc_capturing = false;
 }
 
 extern "C" void* __libc_malloc(size_t);
@@ -168,9 +194,10 @@ extern "C" void __libc_free(void*);
 extern "C" void* __libc_memalign(size_t alignment, size_t size);
 
 void* mc_malloc(size_t size, const void* caller) {
-	if (g_mc_info == nullptr) return __libc_malloc(size);
+	if (g_mc_info == nullptr || t_mc_capturing) return __libc_malloc(size);
 
 	void* ptr = __libc_malloc(size);
+	mc_capture(size);
 
 	g_mc_info->num_malloc++;
 	if (ptr == nullptr) {
@@ -193,10 +220,11 @@ void* mc_malloc(size_t size, const void* caller) {
 }
 
 void* mc_realloc(void* cptr, size_t size, const void* caller) {
-	if (g_mc_info == nullptr) return __libc_realloc(cptr, size);
+	if (g_mc_info == nullptr || t_mc_capturing) return __libc_realloc(cptr, size);
 
 	auto oldsize = malloc_usable_size(cptr);
 	void* ptr = __libc_realloc(cptr, size);
+	mc_capture(size);
 
 	g_mc_info->num_realloc++;
 	if (ptr == nullptr) {
@@ -221,7 +249,7 @@ void* mc_realloc(void* cptr, size_t size, const void* caller) {
 }
 
 void mc_free(void* ptr, const void* caller) {
-	if (g_mc_info == nullptr) return __libc_free(ptr);
+	if (g_mc_info == nullptr || t_mc_capturing) return __libc_free(ptr);
 	if (ptr == nullptr) return;
 	auto oldsize = malloc_usable_size(ptr);
 
@@ -234,7 +262,8 @@ void mc_free(void* ptr, const void* caller) {
 
 void* mc_memalign(size_t alignment, size_t size, const void* caller) {
 	void* ptr = __libc_memalign(alignment, size);
-	if (g_mc_info == nullptr) return ptr;
+	if (g_mc_info == nullptr || t_mc_capturing) return ptr;
+	mc_capture(size);
 
 	g_mc_info->num_memalign++;
 	if (ptr == nullptr) {
@@ -288,6 +317,10 @@ std::ostream& operator<<(std::ostream& str, const MemoryChecker& o) {
 	str << "num_chunks_allocated_max = " << o.info.num_chunks_allocated_max << "\n";
 	str << "num_bytes_allocated =      " << o.info.num_bytes_allocated << "\n";
 	str << "num_bytes_allocated_max =  " << o.info.num_bytes_allocated_max << "\n";
+	for (size_t i = 0; i < o.num_traces; i++) {
+		str << "==== Allocation " << i << " of " << o.traces[i].size << " bytes ====\n";
+		str << o.traces[i].trace;
+	}
 	return str;
 }
 
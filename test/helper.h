@@ -77,8 +77,25 @@ struct MemoryChecker {
 	};
 	snapshot info;
 
-	MemoryChecker();
+	struct allocation {
+		size_t size;
+		stacktrace trace;
+	};
+	// Call stacks of the first allocations, only captured if requested in the constructor
+	static constexpr size_t max_traces = 8;
+	bool capture_traces;
+	size_t num_traces = 0;
+	allocation traces[max_traces];
+
+	MemoryChecker(bool capture_traces = false);
+	MemoryChecker(const MemoryChecker&) = delete;
+	MemoryChecker& operator=(const MemoryChecker&) = delete;
 	~MemoryChecker();
+
+	// Stops counting, the results stay available
+	void stop() noexcept;
+
+	ssize_t num_allocations() const noexcept { return info.num_malloc + info.num_realloc + info.num_memalign; }
 };
 
 std::ostream& operator<<(std::ostream& str, const MemoryChecker::stacktrace& o);
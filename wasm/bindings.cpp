@@ -107,10 +107,13 @@ EMSCRIPTEN_BINDINGS(snowman) {
 		.function("SampleRate", &snowboy::SnowboyDetect::SampleRate)
 		.function("NumChannels", &snowboy::SnowboyDetect::NumChannels)
 		.function("BitsPerSample", &snowboy::SnowboyDetect::BitsPerSample)
+		.function("GetStats", &snowboy::SnowboyDetect::GetStats)
+		.function("ResetStats", &snowboy::SnowboyDetect::ResetStats)
 		.function("GetSensitivity", &snowboy::SnowboyDetect::GetSensitivity)
 		.function("NumHotwords", &snowboy::SnowboyDetect::NumHotwords)
 		.function("SetAudioGain", &snowboy::SnowboyDetect::SetAudioGain)
 		.function("ApplyFrontend", &snowboy::SnowboyDetect::ApplyFrontend)
+		.function("GateNonVoice", &snowboy::SnowboyDetect::GateNonVoice)
 		.function("Reset", &snowboy::SnowboyDetect::Reset)
 		.function("RunDetectionI16", &SnowboyDetect_RunDetectionI16)
 		.function("RunDetectionI32", &SnowboyDetect_RunDetectionI32)
@@ -121,8 +124,11 @@ EMSCRIPTEN_BINDINGS(snowman) {
 		.function("SampleRate", &snowboy::SnowboyVad::SampleRate)
 		.function("NumChannels", &snowboy::SnowboyVad::NumChannels)
 		.function("BitsPerSample", &snowboy::SnowboyVad::BitsPerSample)
+		.function("GetStats", &snowboy::SnowboyVad::GetStats)
+		.function("ResetStats", &snowboy::SnowboyVad::ResetStats)
 		.function("SetAudioGain", &snowboy::SnowboyVad::SetAudioGain)
 		.function("ApplyFrontend", &snowboy::SnowboyVad::ApplyFrontend)
+		.function("SetTieredVad", &snowboy::SnowboyVad::SetTieredVad)
 		.function("RunVadI16", &SnowboyVad_RunVadI16)
 		.function("RunVadI32", &SnowboyVad_RunVadI32)
 		.function("RunVadF32", &SnowboyVad_RunVadF32);
@@ -132,6 +138,8 @@ EMSCRIPTEN_BINDINGS(snowman) {
 		.function("SampleRate", &snowboy::SnowboyPersonalEnroll::SampleRate)
 		.function("NumChannels", &snowboy::SnowboyPersonalEnroll::NumChannels)
 		.function("BitsPerSample", &snowboy::SnowboyPersonalEnroll::BitsPerSample)
+		.function("GetStats", &snowboy::SnowboyPersonalEnroll::GetStats)
+		.function("ResetStats", &snowboy::SnowboyPersonalEnroll::ResetStats)
 		.function("GetNumTemplates", &snowboy::SnowboyPersonalEnroll::GetNumTemplates)
 		.function("Reset", &snowboy::SnowboyPersonalEnroll::Reset)
 		.function("RunEnrollmentI16", &SnowboyPersonalEnroll_RunEnrollmentI16)
@@ -143,6 +151,8 @@ EMSCRIPTEN_BINDINGS(snowman) {
 		.function("SampleRate", &snowboy::SnowboyTemplateCut::SampleRate)
 		.function("NumChannels", &snowboy::SnowboyTemplateCut::NumChannels)
 		.function("BitsPerSample", &snowboy::SnowboyTemplateCut::BitsPerSample)
+		.function("GetStats", &snowboy::SnowboyTemplateCut::GetStats)
+		.function("ResetStats", &snowboy::SnowboyTemplateCut::ResetStats)
 		.function("Reset", &snowboy::SnowboyTemplateCut::Reset)
 		.function("CutTemplateI16", &SnowboyTemplateCut_CutTemplateI16)
 		.function("CutTemplateI32", &SnowboyTemplateCut_CutTemplateI32)